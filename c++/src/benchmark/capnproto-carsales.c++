@@ -116,6 +116,17 @@ public:
     }
     return result;
   }
+  static void evolve(ParkingLot::Builder request) {
+    // A few cars burn some fuel, and one is repainted.
+    auto cars = request.getCars();
+    if (cars.size() == 0) return;
+
+    for (int i = 0; i < 3; i++) {
+      Car::Builder car = cars[fastRand(cars.size())];
+      car.setFuelLevel(car.getFuelLevel() / 2);
+    }
+    cars[fastRand(cars.size())].setColor((Color)fastRand((uint)Color::SILVER + 1));
+  }
   static void handleRequest(ParkingLot::Reader request, TotalValue::Builder response) {
     uint64_t result = 0;
     for (auto car: request.getCars()) {
@@ -133,7 +144,6 @@ public:
 }  // namespace capnp
 
 int main(int argc, char* argv[]) {
-  return capnp::benchmark::benchmarkMain<
-      capnp::benchmark::capnp::BenchmarkTypes,
+  return capnp::benchmark::capnp::replicatingBenchmarkMain<
       capnp::benchmark::capnp::CarSalesTestCase>(argc, argv);
 }
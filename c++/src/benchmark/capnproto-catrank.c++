@@ -116,6 +116,18 @@ public:
     }
   }
 
+  static void evolve(SearchResultList::Builder request) {
+    // A few results are rescored, and one gets a new snippet.
+    auto list = request.getResults();
+    if (list.size() == 0) return;
+
+    for (int i = 0; i < 5; i++) {
+      SearchResult::Builder result = list[fastRand(list.size())];
+      result.setScore(result.getScore() + 1);
+    }
+    list[fastRand(list.size())].setSnippet(" updated snippet with a cat ");
+  }
+
   static bool checkResponse(SearchResultList::Reader response, int expectedGoodCount) {
     int goodCount = 0;
     for (auto result: response.getResults()) {
@@ -135,7 +147,6 @@ public:
 }  // namespace capnp
 
 int main(int argc, char* argv[]) {
-  return capnp::benchmark::benchmarkMain<
-      capnp::benchmark::capnp::BenchmarkTypes,
+  return capnp::benchmark::capnp::replicatingBenchmarkMain<
       capnp::benchmark::capnp::CatRankTestCase>(argc, argv);
 }
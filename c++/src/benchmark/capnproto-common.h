@@ -29,11 +29,14 @@
 #include "common.h"
 #include <capnp/serialize.h>
 #include <capnp/serialize-packed.h>
+#include <capnp/diff.h>
 #include <kj/debug.h>
 #if HAVE_SNAPPY
 #include <capnp/serialize-snappy.h>
 #endif  // HAVE_SNAPPY
 #include <thread>
+#include <chrono>
+#include <string.h>
 
 namespace capnp {
 namespace benchmark {
@@ -101,6 +104,42 @@ struct Packed {
   }
 };
 
+struct PackedScalar {
+  // Like Packed, but forces the portable scalar packing kernel, so that it can be compared against
+  // the vectorized kernels which Packed selects automatically.
+
+  typedef kj::BufferedInputStreamWrapper BufferedInput;
+
+  class MessageReader: private _::PackedInputStream, public InputStreamMessageReader {
+  public:
+    MessageReader(kj::BufferedInputStream& inputStream,
+                  ReaderOptions options = ReaderOptions(),
+                  kj::ArrayPtr<word> scratchSpace = nullptr)
+      : PackedInputStream(inputStream, _::PackingKernel::SCALAR),
+        InputStreamMessageReader(static_cast<PackedInputStream&>(*this), options, scratchSpace) {}
+  };
+
+  class ArrayMessageReader: private kj::ArrayInputStream, public MessageReader {
+  public:
+    ArrayMessageReader(kj::ArrayPtr<const byte> array,
+                       ReaderOptions options = ReaderOptions(),
+                       kj::ArrayPtr<word> scratchSpace = nullptr)
+      : ArrayInputStream(array),
+        MessageReader(*this, options, scratchSpace) {}
+  };
+
+  static inline void write(kj::BufferedOutputStream& output, MessageBuilder& builder) {
+    _::PackedOutputStream packedOutput(output, _::PackingKernel::SCALAR);
+    writeMessage(packedOutput, builder);
+  }
+
+  static inline void write(kj::OutputStream& output, MessageBuilder& builder) {
+    byte buffer[8192];
+    kj::BufferedOutputStreamWrapper bufferedOutput(output, kj::arrayPtr(buffer, sizeof(buffer)));
+    write(bufferedOutput, builder);
+  }
+};
+
 #if HAVE_SNAPPY
 static byte snappyReadBuffer[SNAPPY_BUFFER_SIZE];
 static byte snappyWriteBuffer[SNAPPY_BUFFER_SIZE];
@@ -236,6 +275,37 @@ struct UseScratch {
   };
 };
 
+MessageBuilderPool builderPool;
+
+struct UsePool {
+  // Builders take their segments from a MessageBuilderPool, so after the first few iterations
+  // building a message allocates nothing, without the caller having to manage scratch space.
+  // Readers are the same as NoScratch.
+
+  typedef NoScratch::ScratchSpace ScratchSpace;
+
+  template <typename Compression>
+  class MessageReader: public NoScratch::MessageReader<Compression> {
+  public:
+    inline MessageReader(typename Compression::BufferedInput& input, ScratchSpace& scratch)
+        : NoScratch::MessageReader<Compression>(input, scratch) {}
+  };
+
+  template <typename Compression>
+  class ArrayMessageReader: public NoScratch::ArrayMessageReader<Compression> {
+  public:
+    inline ArrayMessageReader(kj::ArrayPtr<const byte> input, ScratchSpace& scratch)
+        : NoScratch::ArrayMessageReader<Compression>(input, scratch) {}
+  };
+
+  class MessageBuilder: public PooledMessageBuilder {
+  public:
+    inline MessageBuilder(ScratchSpace& scratch): PooledMessageBuilder(builderPool) {}
+  };
+
+  typedef NoScratch::ObjectSizeCounter ObjectSizeCounter;
+};
+
 // =======================================================================================
 
 template <typename TestCase, typename ReuseStrategy, typename Compression>
@@ -405,17 +475,81 @@ struct BenchmarkMethods {
 struct BenchmarkTypes {
   typedef capnp::Uncompressed Uncompressed;
   typedef capnp::Packed Packed;
+  typedef capnp::PackedScalar PackedScalar;
 #if HAVE_SNAPPY
   typedef capnp::SnappyCompressed SnappyCompressed;
 #endif  // HAVE_SNAPPY
 
   typedef capnp::UseScratch ReusableResources;
   typedef capnp::NoScratch SingleUseResources;
+  typedef capnp::UsePool PooledResources;
 
   template <typename TestCase, typename ReuseStrategy, typename Compression>
   struct BenchmarkMethods: public capnp::BenchmarkMethods<TestCase, ReuseStrategy, Compression> {};
 };
 
+// =======================================================================================
+// Replication
+//
+// `replicate` mode models keeping a replica of each message up to date:  every iteration generates
+// a request, copies it to the replica, applies a small change to the original with
+// `TestCase::evolve()`, and brings the replica up to date with a patch (see capnp/diff.h) rather
+// than the whole message.  Prints the total patch size, then a comparison with the message size.
+
+template <typename TestCase>
+int replicate(uint64_t iters) {
+  typedef typename TestCase::Request Request;
+
+  uint64_t messageBytes = 0;
+  uint64_t patchBytes = 0;
+  std::chrono::steady_clock::duration patchTime(0);
+
+  for (uint64_t i = 0; i < iters; i++) {
+    MallocMessageBuilder original;
+    TestCase::setupRequest(original.initRoot<Request>());
+    MallocMessageBuilder replica;
+    replica.setRoot(original.getRoot<Request>().asReader());
+
+    TestCase::evolve(original.getRoot<Request>());
+
+    auto start = std::chrono::steady_clock::now();
+    MallocMessageBuilder patch;
+    computePatch(replica.getRoot<Request>().asReader(), original.getRoot<Request>().asReader(),
+                 patch.initRoot<diff::Patch>());
+    applyPatch(replica.getRoot<Request>(), patch.getRoot<diff::Patch>().asReader());
+    patchTime += std::chrono::steady_clock::now() - start;
+
+    if (replica.getRoot<AnyPointer>().asReader().equals(
+            original.getRoot<AnyPointer>().asReader()) != Equality::EQUAL) {
+      throw std::logic_error("Patched replica doesn't match.");
+    }
+
+    messageBytes += computeSerializedSizeInWords(original) * sizeof(word);
+    patchBytes += computeSerializedSizeInWords(patch) * sizeof(word);
+  }
+
+  uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(patchTime).count();
+  fprintf(stdout, "%llu\n", (long long unsigned int)patchBytes);
+  fprintf(stdout, "message: %llu bytes/iter  patch: %llu bytes/iter (%.1f%%)  "
+                  "compute+apply: %llu ns/iter\n",
+          (long long unsigned int)(messageBytes / iters),
+          (long long unsigned int)(patchBytes / iters),
+          100.0 * patchBytes / messageBytes,
+          (long long unsigned int)(nanos / iters));
+  return 0;
+}
+
+template <typename TestCase>
+int replicatingBenchmarkMain(int argc, char* argv[]) {
+  // Like benchmarkMain(), but also accepts `replicate ITERATION_COUNT`, for test cases which
+  // define `evolve()`.
+
+  if (argc == 3 && strcmp(argv[1], "replicate") == 0) {
+    return replicate<TestCase>(strtoull(argv[2], nullptr, 0));
+  }
+  return benchmarkMain<BenchmarkTypes, TestCase>(argc, argv);
+}
+
 }  // namespace capnp
 }  // namespace benchmark
 }  // namespace capnp
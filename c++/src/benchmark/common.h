@@ -251,6 +251,10 @@ uint64_t doBenchmark2(const std::string& mode, const std::string& reuse, uint64_
     return doBenchmark<
         BenchmarkTypes, TestCase, typename BenchmarkTypes::SingleUseResources, Compression>(
             mode, iters);
+  } else if (reuse == "pool") {
+    return doBenchmark<
+        BenchmarkTypes, TestCase, typename BenchmarkTypes::PooledResources, Compression>(
+            mode, iters);
   } else {
     fprintf(stderr, "Unknown reuse mode: %s\n", reuse.c_str());
     exit(1);
@@ -266,6 +270,9 @@ uint64_t doBenchmark3(const std::string& mode, const std::string& reuse,
   } else if (compression == "packed") {
     return doBenchmark2<BenchmarkTypes, TestCase, typename BenchmarkTypes::Packed>(
         mode, reuse, iters);
+  } else if (compression == "packed-scalar") {
+    return doBenchmark2<BenchmarkTypes, TestCase, typename BenchmarkTypes::PackedScalar>(
+        mode, reuse, iters);
 #if HAVE_SNAPPY
   } else if (compression == "snappy") {
     return doBenchmark2<BenchmarkTypes, TestCase, typename BenchmarkTypes::SnappyCompressed>(
@@ -0,0 +1,134 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+// Measures copying a message into a builder along the graft path (the source is laid out in
+// pre-order, as copies always are, so it moves with one memcpy()) against the recursive copy (the
+// same content built in an order that defeats the graft).
+//
+// `deep` copies a balanced expression tree sixteen levels deep; `wide` copies a list of ten
+// thousand search results.
+//
+// USAGE:  graft-copy deep|wide ITERATION_COUNT
+
+#include "catrank.capnp.h"
+#include "eval.capnp.h"
+#include <capnp/message.h>
+#include <kj/string.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace capnp {
+namespace benchmark {
+namespace capnp {
+
+void buildDeep(Expression::Builder expression, uint depth, uint& counter) {
+  // Fills in the right operand before the left one, so the children aren't in pre-order.
+  expression.setOp(Operation::ADD);
+  if (depth == 0) {
+    expression.getRight().setValue(counter++);
+    expression.getLeft().setValue(counter++);
+  } else {
+    buildDeep(expression.getRight().initExpression(), depth - 1, counter);
+    buildDeep(expression.getLeft().initExpression(), depth - 1, counter);
+  }
+}
+
+void buildWide(SearchResultList::Builder list) {
+  // Allocates each result's snippet before its URL, so the text isn't in pre-order.
+  auto results = list.initResults(10000);
+  for (uint i = 0; i < results.size(); i++) {
+    auto result = results[i];
+    result.setScore(i);
+    result.setSnippet(kj::str("snippet number ", i, " which is long enough to need its own words"));
+    result.setUrl(kj::str("http://example.com/", i));
+  }
+}
+
+template <typename T>
+double timeCopies(typename T::Reader source, uint64_t iters, size_t& wordCount) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < iters; i++) {
+    MallocMessageBuilder builder(source.totalSize().wordCount + 16);
+    builder.setRoot(source);
+    wordCount = builder.getSegmentsForOutput()[0].size();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iters;
+}
+
+template <typename T>
+int compare(MallocMessageBuilder& outOfOrder, uint64_t iters) {
+  // Both sources must fit in one segment, since far pointers also defeat the graft.
+  MallocMessageBuilder preorder(outOfOrder.getRoot<T>().asReader().totalSize().wordCount + 16);
+  preorder.setRoot(outOfOrder.getRoot<T>().asReader());
+
+  size_t graftWords, recursiveWords;
+  double graftNanos = timeCopies<T>(preorder.getRoot<T>().asReader(), iters, graftWords);
+  double recursiveNanos = timeCopies<T>(outOfOrder.getRoot<T>().asReader(), iters, recursiveWords);
+
+  if (preorder.getSegmentsForOutput().size() != 1 ||
+      outOfOrder.getSegmentsForOutput().size() != 1) {
+    fprintf(stderr, "ERROR: the source doesn't fit in one segment.\n");
+    return 1;
+  }
+  if (graftWords != recursiveWords) {
+    fprintf(stderr, "ERROR: the two copies differ in size (%zu vs %zu words).\n",
+            graftWords, recursiveWords);
+    return 1;
+  }
+
+  printf("words: %zu  graft ns/copy: %.0f  recursive ns/copy: %.0f  speedup: %.2fx\n",
+         graftWords, graftNanos, recursiveNanos, recursiveNanos / graftNanos);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "USAGE:  %s deep|wide ITERATION_COUNT\n", argv[0]);
+    return 1;
+  }
+
+  uint64_t iters = strtoull(argv[2], nullptr, 0);
+
+  MallocMessageBuilder outOfOrder(1 << 19);
+  if (strcmp(argv[1], "deep") == 0) {
+    uint counter = 0;
+    buildDeep(outOfOrder.initRoot<Expression>(), 15, counter);
+    return compare<Expression>(outOfOrder, iters);
+  } else if (strcmp(argv[1], "wide") == 0) {
+    buildWide(outOfOrder.initRoot<SearchResultList>());
+    return compare<SearchResultList>(outOfOrder, iters);
+  } else {
+    fprintf(stderr, "Unknown shape: %s\n", argv[1]);
+    return 1;
+  }
+}
+
+}  // namespace capnp
+}  // namespace benchmark
+}  // namespace capnp
+
+int main(int argc, char* argv[]) {
+  return capnp::benchmark::capnp::main(argc, argv);
+}
@@ -158,12 +158,14 @@ struct BenchmarkMethods {
 struct BenchmarkTypes {
   typedef void Uncompressed;
   typedef void Packed;
+  typedef void PackedScalar;
 #if HAVE_SNAPPY
   typedef void SnappyCompressed;
 #endif  // HAVE_SNAPPY
 
   typedef ReusableObjects ReusableResources;
   typedef SingleUseObjects SingleUseResources;
+  typedef ReusableObjects PooledResources;
 
   template <typename TestCase, typename ReuseStrategy, typename Compression>
   struct BenchmarkMethods: public null::BenchmarkMethods<TestCase, ReuseStrategy, Compression> {};
@@ -342,12 +342,14 @@ struct BenchmarkMethods {
 struct BenchmarkTypes {
   typedef protobuf::Uncompressed Uncompressed;
   typedef protobuf::Uncompressed Packed;
+  typedef protobuf::Uncompressed PackedScalar;
 #if HAVE_SNAPPY
   typedef protobuf::SnappyCompressed SnappyCompressed;
 #endif  // HAVE_SNAPPY
 
   typedef protobuf::ReusableMessages ReusableResources;
   typedef protobuf::SingleUseMessages SingleUseResources;
+  typedef protobuf::ReusableMessages PooledResources;
 
   template <typename TestCase, typename ReuseStrategy, typename Compression>
   struct BenchmarkMethods
@@ -116,12 +116,14 @@ enum class Mode {
 
 enum class Reuse {
   YES,
-  NO
+  NO,
+  POOL
 };
 
 enum class Compression {
   NONE,
   PACKED,
+  PACKED_SCALAR,
   SNAPPY
 };
 
@@ -171,6 +173,9 @@ TestResult runTest(Product product, TestCase testCase, Mode mode, Reuse reuse,
     case Reuse::NO:
       argv[2] = strdup("no-reuse");
       break;
+    case Reuse::POOL:
+      argv[2] = strdup("pool");
+      break;
   }
 
   switch (compression) {
@@ -180,6 +185,9 @@ TestResult runTest(Product product, TestCase testCase, Mode mode, Reuse reuse,
     case Compression::PACKED:
       argv[3] = strdup("packed");
       break;
+    case Compression::PACKED_SCALAR:
+      argv[3] = strdup("packed-scalar");
+      break;
     case Compression::SNAPPY:
       argv[3] = strdup("snappy");
       break;
@@ -284,6 +292,15 @@ void reportOldNewComparisonHeader() {
   cout << setfill('=') << setw(85) << "" << setfill(' ') << endl;
 }
 
+void reportPackingKernelComparisonHeader() {
+  cout << setw(40) << left << "Measure"
+       << setw(15) << right << "Scalar"
+       << setw(15) << right << "Vectorized"
+       << setw(15) << right << "Improvement"
+       << endl;
+  cout << setfill('=') << setw(85) << "" << setfill(' ') << endl;
+}
+
 class Gain {
 public:
   Gain(double oldValue, double newValue)
@@ -369,6 +386,7 @@ int main(int argc, char* argv[]) {
   Compression compression = Compression::NONE;
   uint64_t iters = 1;
   const char* oldDir = nullptr;
+  bool comparePackingKernels = false;
 
   for (int i = 1; i < argc; i++) {
     string arg = argv[i];
@@ -384,6 +402,8 @@ int main(int argc, char* argv[]) {
       testCase = TestCase::CARSALES;
     } else if (arg == "snappy") {
       compression = Compression::SNAPPY;
+    } else if (arg == "packkernels") {
+      comparePackingKernels = true;
     } else if (arg == "-c") {
       ++i;
       if (i == argc) {
@@ -450,6 +470,7 @@ int main(int argc, char* argv[]) {
       cout << "* no compression" << endl;
       break;
     case Compression::PACKED:
+    case Compression::PACKED_SCALAR:
       cout << "* de-zero packing for Cap'n Proto" << endl;
       cout << "* standard packing for Protobuf" << endl;
       break;
@@ -494,6 +515,12 @@ int main(int argc, char* argv[]) {
       Product::CAPNPROTO, testCase, Mode::OBJECT_SIZE, Reuse::NO, compression, iters).objectSize;
   reportResults("Cap'n Proto w/o object reuse", iters, capnpNoReuse);
 
+  TestResult capnpPool = runTest(
+      Product::CAPNPROTO, testCase, Mode::OBJECTS, Reuse::POOL, compression, iters);
+  capnpPool.objectSize = runTest(
+      Product::CAPNPROTO, testCase, Mode::OBJECT_SIZE, Reuse::POOL, compression, iters).objectSize;
+  reportResults("Cap'n Proto w/ builder pool", iters, capnpPool);
+
   TestResult protobuf = runTest(
       Product::PROTOBUF, testCase, mode, Reuse::YES, compression, iters);
   protobuf.objectSize = protobufBase.objectSize;
@@ -508,6 +535,14 @@ int main(int argc, char* argv[]) {
   capnpPacked.objectSize = capnpBase.objectSize;
   reportResults("Cap'n Proto packed I/O", iters, capnpPacked);
 
+  TestResult capnpPackedScalar;
+  if (comparePackingKernels) {
+    capnpPackedScalar = runTest(
+        Product::CAPNPROTO, testCase, mode, Reuse::YES, Compression::PACKED_SCALAR, iters);
+    capnpPackedScalar.objectSize = capnpBase.objectSize;
+    reportResults("Cap'n Proto packed I/O (scalar)", iters, capnpPackedScalar);
+  }
+
   size_t protobufBinarySize = fileSize("protobuf-" + std::string(testCaseName(testCase)));
   size_t capnpBinarySize = fileSize("capnproto-" + std::string(testCaseName(testCase)));
   size_t protobufCodeSize = fileSize(std::string(testCaseName(testCase)) + ".pb.cc")
@@ -585,6 +620,9 @@ int main(int argc, char* argv[]) {
   reportComparison("object manipulation time w/o reuse (us)", "",
       ((int64_t)protobufNoReuse.time.user - (int64_t)nullCaseNoReuse.time.user) / 1000.0,
       ((int64_t)capnpNoReuse.time.user - (int64_t)nullCaseNoReuse.time.user) / 1000.0, iters);
+  reportComparison("object manipulation time w/ pool (us)", "",
+      ((int64_t)protobufBase.time.user - (int64_t)nullCase.time.user) / 1000.0,
+      ((int64_t)capnpPool.time.user - (int64_t)nullCase.time.user) / 1000.0, iters);
   reportComparison("I/O time (us)", "",
       ((int64_t)protobuf.time.user - (int64_t)protobufBase.time.user) / 1000.0,
       ((int64_t)capnp.time.user - (int64_t)capnpBase.time.user) / 1000.0, iters);
@@ -603,6 +641,23 @@ int main(int argc, char* argv[]) {
   reportComparison("generated obj size (KiB)", "",
       protobufObjSize / 1024.0, capnpObjSize / 1024.0, 1);
 
+  if (comparePackingKernels) {
+    cout << endl;
+    reportPackingKernelComparisonHeader();
+
+    reportComparison("packed I/O time (us)", "",
+        ((int64_t)capnpPackedScalar.time.user - (int64_t)capnpBase.time.user) / 1000.0,
+        ((int64_t)capnpPacked.time.user - (int64_t)capnpBase.time.user) / 1000.0, iters);
+    reportIntComparison("packed message size (bytes)", "",
+                        capnpPackedScalar.messageSize, capnpPacked.messageSize, iters);
+
+    if (capnpPackedScalar.messageSize != capnpPacked.messageSize) {
+      // The kernels must produce identical bytes, so any difference in size is a bug.
+      cout << "ERROR: vectorized and scalar packing produced different output sizes." << endl;
+      return 1;
+    }
+  }
+
   if (oldDir != nullptr) {
     cout << endl;
     reportOldNewComparisonHeader();
@@ -0,0 +1,114 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Measures how well a single MessageReader scales when shared by many threads.  The message is
+// built out of many small segments, so each traversal performs many segment lookups in the
+// reader's arena.
+//
+// USAGE:  shared-reader THREAD_COUNT ITERATION_COUNT
+
+#include "catrank.capnp.h"
+#include <capnp/message.h>
+#include <capnp/serialize.h>
+#include <kj/thread.h>
+#include <kj/vector.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace capnp {
+namespace benchmark {
+namespace capnp {
+
+kj::Array<word> buildMessage(uint& segmentCount) {
+  // Small fixed-size segments spread the results across hundreds of segments.
+  MallocMessageBuilder builder(128, AllocationStrategy::FIXED_SIZE);
+  auto list = builder.initRoot<SearchResultList>().initResults(1000);
+  for (uint i = 0; i < list.size(); i++) {
+    auto result = list[i];
+    result.setScore(i);
+    result.setUrl(kj::str("http://example.com/", i));
+    result.setSnippet(kj::str("snippet number ", i, " which is long enough to need its own words"));
+  }
+  segmentCount = builder.getSegmentsForOutput().size();
+  return messageToFlatArray(builder);
+}
+
+uint64_t traverse(SearchResultList::Reader list) {
+  uint64_t total = 0;
+  for (auto result: list.getResults()) {
+    total += result.getScore();
+    total += result.getUrl().size();
+    total += result.getSnippet().size();
+  }
+  return total;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "USAGE:  %s THREAD_COUNT ITERATION_COUNT\n", argv[0]);
+    return 1;
+  }
+
+  uint threadCount = strtoul(argv[1], nullptr, 0);
+  uint64_t iters = strtoull(argv[2], nullptr, 0);
+
+  uint segmentCount;
+  kj::Array<word> words = buildMessage(segmentCount);
+  ReaderOptions options;
+  options.traversalLimitInWords = kj::maxValue;
+  FlatArrayMessageReader reader(words, options);
+  auto root = reader.getRoot<SearchResultList>();
+
+  auto start = std::chrono::steady_clock::now();
+  kj::Vector<uint64_t> totals(threadCount);
+  totals.resize(threadCount);
+  {
+    kj::Vector<kj::Own<kj::Thread>> threads(threadCount);
+    for (uint i = 0; i < threadCount; i++) {
+      uint64_t& total = totals[i];
+      threads.add(kj::heap<kj::Thread>([&total, root, iters]() {
+        for (uint64_t j = 0; j < iters; j++) {
+          total += traverse(root);
+        }
+      }));
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  uint64_t checksum = 0;
+  for (auto total: totals) checksum += total;
+
+  uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  printf("segments: %u  threads: %u  traversals: %llu  ns/traversal: %.0f  (checksum %llu)\n",
+         segmentCount, threadCount,
+         (unsigned long long)(iters * threadCount),
+         (double)nanos / (iters * threadCount), (unsigned long long)checksum);
+  return 0;
+}
+
+}  // namespace capnp
+}  // namespace benchmark
+}  // namespace capnp
+
+int main(int argc, char* argv[]) {
+  return capnp::benchmark::capnp::main(argc, argv);
+}
@@ -25,6 +25,7 @@
 #include <kj/debug.h>
 #include <kj/refcount.h>
 #include <vector>
+#include <algorithm>
 #include <string.h>
 #include <stdio.h>
 
@@ -64,6 +65,29 @@ ReaderArena::ReaderArena(MessageReader* message)
 
 ReaderArena::~ReaderArena() noexcept(false) {}
 
+namespace {
+
+template <typename T>
+inline T* loadAcquire(T* const& ptr) {
+#if _MSC_VER
+  // MSVC gives volatile accesses acquire/release semantics.
+  return *static_cast<T* const volatile*>(&ptr);
+#else
+  return __atomic_load_n(&ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+template <typename T>
+inline void storeRelease(T*& ptr, T* value) {
+#if _MSC_VER
+  *static_cast<T* volatile*>(&ptr) = value;
+#else
+  __atomic_store_n(&ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+}  // namespace
+
 SegmentReader* ReaderArena::tryGetSegment(SegmentId id) {
   if (id == SegmentId(0)) {
     if (segment0.getArray() == nullptr) {
@@ -73,32 +97,67 @@ SegmentReader* ReaderArena::tryGetSegment(SegmentId id) {
     }
   }
 
+  uint index = id.value - 1;
+  SegmentTable* table = loadAcquire(segmentTable);
+  if (table != nullptr && index < table->slots.size()) {
+    SegmentReader* result = loadAcquire(table->slots[index]);
+    if (result != nullptr) {
+      return result;
+    }
+  }
+
+  return tryGetSegmentSlow(id);
+}
+
+SegmentReader* ReaderArena::tryGetSegmentSlow(SegmentId id) {
   auto lock = moreSegments.lockExclusive();
 
-  SegmentMap* segments = nullptr;
-  KJ_IF_MAYBE(s, *lock) {
-    auto iter = s->get()->find(id.value);
-    if (iter != s->get()->end()) {
-      return iter->second;
-    }
-    segments = *s;
+  // Another thread may have created the segment since we looked.  Under the lock, `segmentTable`
+  // can't change, so plain reads are fine.
+  uint index = id.value - 1;
+  SegmentTable* table = segmentTable;
+  if (table != nullptr && index < table->slots.size() && table->slots[index] != nullptr) {
+    return table->slots[index];
   }
 
+  // Only grow the table once we know the segment exists, so that a bogus far pointer can't make
+  // us allocate a huge table.
   kj::ArrayPtr<const word> newSegment = message->getSegment(id.value);
   if (newSegment == nullptr) {
     return nullptr;
   }
 
-  if (*lock == nullptr) {
-    // OK, the segment exists, so allocate the map.
-    auto s = kj::heap<SegmentMap>();
-    segments = s;
-    *lock = kj::mv(s);
+  MoreSegments* state;
+  KJ_IF_MAYBE(s, *lock) {
+    state = *s;
+  } else {
+    auto newState = kj::heap<MoreSegments>();
+    state = newState;
+    *lock = kj::mv(newState);
+  }
+
+  if (table == nullptr || index >= table->slots.size()) {
+    size_t oldSize = table == nullptr ? 0 : table->slots.size();
+    size_t newSize = kj::max(kj::max(oldSize * 2, size_t(index) + 1), size_t(4));
+
+    auto newTable = kj::heap<SegmentTable>();
+    newTable->slots = kj::heapArray<SegmentReader*>(newSize);
+    for (size_t i = 0; i < newSize; i++) {
+      newTable->slots[i] = i < oldSize ? table->slots[i] : nullptr;
+    }
+
+    table = newTable;
+    state->tables.add(kj::mv(newTable));
+    storeRelease(segmentTable, table);
   }
 
   auto segment = kj::heap<SegmentReader>(this, id, newSegment, &readLimiter);
+  if (segment0.isValidated()) {
+    segment->markValidated();
+  }
   SegmentReader* result = segment;
-  segments->insert(std::make_pair(id.value, mv(segment)));
+  state->readers.add(kj::mv(segment));
+  storeRelease(table->slots[index], result);
   return result;
 }
 
@@ -108,6 +167,17 @@ void ReaderArena::reportReadLimitReached() {
   }
 }
 
+void ReaderArena::markValidated() {
+  // Segments created later copy segment0's flag under the same lock.
+  auto lock = moreSegments.lockExclusive();
+  segment0.markValidated();
+  KJ_IF_MAYBE(s, *lock) {
+    for (auto& reader: (*s)->readers) {
+      reader->markValidated();
+    }
+  }
+}
+
 // =======================================================================================
 
 BuilderArena::BuilderArena(MessageBuilder* message)
@@ -132,7 +202,15 @@ BuilderArena::BuilderArena(MessageBuilder* message,
     segmentWithSpace = builders.back();
 
     this->moreSegments = kj::heap<MultiSegmentState>(
-        MultiSegmentState { kj::mv(builders), kj::mv(forOutput) });
+        MultiSegmentState { kj::mv(builders), kj::mv(forOutput), kj::Vector<FreeSpace>() });
+
+    // Make any room left in the earlier segments available to allocate().
+    addFreeSpace(&segment0);
+    for (auto& builder: KJ_ASSERT_NONNULL(moreSegments)->builders) {
+      if (builder.get() != segmentWithSpace) {
+        addFreeSpace(builder);
+      }
+    }
 
   } else {
     segmentWithSpace = &segment0;
@@ -169,21 +247,27 @@ BuilderArena::AllocateResult BuilderArena::allocate(WordCount amount) {
     return AllocateResult { &segment0, segment0.allocate(amount) };
   } else {
     if (segmentWithSpace != nullptr) {
-      // Check if there is space in an existing segment.
-      // TODO(perf):  Check for available space in more than just the last segment.  We don't
-      //   want this to be O(n), though, so we'll need to maintain some sort of table.  Complicating
-      //   matters, we want SegmentBuilders::allocate() to be fast, so we can't update any such
-      //   table when allocation actually happens.  Instead, we could have a priority queue based
-      //   on the last-known available size, and then re-check the size when we pop segments off it
-      //   and shove them to the back of the queue if they have become too small.
+      // Check if there is space in the segment we allocated from most recently.
       word* attempt = segmentWithSpace->allocate(amount);
       if (attempt != nullptr) {
         return AllocateResult { segmentWithSpace, attempt };
       }
     }
 
-    // Need to allocate a new segment.
+    // Check if some earlier segment still has room.
+    SegmentBuilder* segment;
+    word* attempt = tryAllocateFromFreeSpace(amount, segment);
+    if (attempt != nullptr) {
+      return AllocateResult { segment, attempt };
+    }
+
+    // Need to allocate a new segment.  Remember whatever is left over in the segment we're
+    // moving away from.
+    SegmentBuilder* previous = segmentWithSpace;
     SegmentBuilder* result = addSegmentInternal(message->allocateSegment(amount / WORDS));
+    if (previous != nullptr) {
+      addFreeSpace(previous);
+    }
 
     // Check this new segment first the next time we need to allocate.
     segmentWithSpace = result;
@@ -193,6 +277,42 @@ BuilderArena::AllocateResult BuilderArena::allocate(WordCount amount) {
   }
 }
 
+word* BuilderArena::tryAllocateFromFreeSpace(WordCount amount, SegmentBuilder*& segment) {
+  // The heap is keyed on the free space each segment had when we last looked at it, which may
+  // have shrunk since due to allocations made directly in the segment (e.g. when a pointer's
+  // target lands in the pointer's own segment).  So, re-check the top segment and, if it has
+  // become too small, push it back with its real size.  Each retry lowers some segment's key
+  // below `amount`, so this terminates.
+
+  KJ_IF_MAYBE(s, moreSegments) {
+    kj::Vector<FreeSpace>& heap = s->get()->freeSpace;
+    while (heap.size() > 0 && heap.front().words * WORDS >= amount) {
+      std::pop_heap(heap.begin(), heap.end());
+      segment = heap.back().segment;
+      heap.removeLast();
+
+      word* attempt = segment->allocate(amount);
+      addFreeSpace(segment);
+      if (attempt != nullptr) {
+        return attempt;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+void BuilderArena::addFreeSpace(SegmentBuilder* segment) {
+  uint words = segment->available() / WORDS;
+  if (words == 0) return;
+
+  KJ_IF_MAYBE(s, moreSegments) {
+    kj::Vector<FreeSpace>& heap = s->get()->freeSpace;
+    heap.add(FreeSpace { words, segment });
+    std::push_heap(heap.begin(), heap.end());
+  }
+}
+
 SegmentBuilder* BuilderArena::addExternalSegment(kj::ArrayPtr<const word> content) {
   return addSegmentInternal(content);
 }
@@ -225,6 +345,42 @@ SegmentBuilder* BuilderArena::addSegmentInternal(kj::ArrayPtr<T> content) {
   return result;
 }
 
+void BuilderArena::replaceWith(BuilderArena& other) {
+  KJ_REQUIRE(other.moreSegments == nullptr, "can only replace with a single-segment arena");
+  kj::ArrayPtr<const word> content = other.segment0.currentlyAllocated();
+
+  // Zero everything we've written so far, so that memory handed back to us later is zero'd as
+  // the MessageBuilder expects.
+  if (segment0.getArena() != nullptr) {
+    segment0.reset();
+  }
+  KJ_IF_MAYBE(s, moreSegments) {
+    for (auto& builder: s->get()->builders) {
+      if (builder->isWritable()) {
+        builder->reset();
+      }
+    }
+  }
+  moreSegments = nullptr;
+
+  if (segment0.getArena() == nullptr || segment0.available() < content.size() * WORDS) {
+    // Re-allocate segment0 in-place, as allocate() does for the first segment.  The caller has
+    // agreed that no pointers into the old segment remain.
+    kj::ArrayPtr<word> ptr = message->allocateSegment(content.size());
+    kj::dtor(segment0);
+    kj::ctor(segment0, this, SegmentId(0), ptr, &this->dummyLimiter);
+  }
+  segmentWithSpace = &segment0;
+
+  word* target = segment0.allocate(content.size() * WORDS);
+  KJ_ASSERT(target != nullptr);
+  memcpy(static_cast<void*>(target), content.begin(), content.asBytes().size());
+
+#if !CAPNP_LITE
+  localCapTable.capTable = kj::mv(other.localCapTable.capTable);
+#endif  // !CAPNP_LITE
+}
+
 kj::ArrayPtr<const kj::ArrayPtr<const word>> BuilderArena::getSegmentsForOutput() {
   // Although this is a read-only method, we shouldn't need to lock a mutex here because if this
   // is called multiple times simultaneously, we should only be overwriting the array with the
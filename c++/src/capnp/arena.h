@@ -37,7 +37,6 @@
 #include "common.h"
 #include "message.h"
 #include "layout.h"
-#include <unordered_map>
 
 #if !CAPNP_LITE
 #include "capability.h"
@@ -137,9 +136,16 @@ public:
   inline void unread(WordCount64 amount);
   // Add back some words to the ReadLimiter.
 
+  inline bool isValidated();
+  // True if the whole message containing this segment has been validated by
+  // `MessageReader::validate()`.  Bounds checks and read limiting are skipped for such segments.
+
+  inline void markValidated();
+
 private:
   Arena* arena;
   SegmentId id;
+  bool validated = false;
   kj::ArrayPtr<const word> ptr;
   ReadLimiter* readLimiter;
 
@@ -170,6 +176,9 @@ public:
 
   inline kj::ArrayPtr<const word> currentlyAllocated();
 
+  inline WordCount available();
+  // Number of words that can still be allocated from this segment.
+
   inline void reset();
 
   inline bool isWritable() { return !readOnly; }
@@ -218,6 +227,10 @@ public:
   SegmentReader* tryGetSegment(SegmentId id) override;
   void reportReadLimitReached() override;
 
+  void markValidated();
+  // Mark every segment of the message, including ones not yet loaded, as validated.  Must not be
+  // called while other threads are reading the message.
+
 private:
   MessageReader* message;
   ReadLimiter readLimiter;
@@ -225,15 +238,29 @@ private:
   // Optimize for single-segment messages so that small messages are handled quickly.
   SegmentReader segment0;
 
-  typedef std::unordered_map<uint, kj::Own<SegmentReader>> SegmentMap;
-  kj::MutexGuarded<kj::Maybe<kj::Own<SegmentMap>>> moreSegments;
-  // We need to mutex-guard the segment map because we lazily initialize segments when they are
-  // first requested, but a Reader is allowed to be used concurrently in multiple threads.  Luckily
-  // this only applies to large messages.
-  //
-  // TODO(perf):  Thread-local thing instead?  Some kind of lockless map?  Or do sharing of data
-  //   in a different way, where you have to construct a new MessageReader in each thread (but
-  //   possibly backed by the same data)?
+  struct SegmentTable {
+    // SegmentReaders for segments 1 and up, indexed by ID - 1.  A table never changes size; when
+    // a segment ID beyond the end is needed, a bigger copy is made and published in its place.
+    // Each slot is written at most once, from null to its final value.
+    kj::Array<SegmentReader*> slots;
+  };
+
+  struct MoreSegments {
+    kj::Vector<kj::Own<SegmentReader>> readers;
+    kj::Vector<kj::Own<SegmentTable>> tables;
+    // Every table ever published, since other threads may still be looking at an old one.
+  };
+
+  SegmentTable* segmentTable = nullptr;
+  // Latest published table, read without locking.  Published with release semantics after its
+  // contents are filled in, as is each new slot value.
+
+  kj::MutexGuarded<kj::Maybe<kj::Own<MoreSegments>>> moreSegments;
+  // Segments are created lazily when first requested, and a Reader is allowed to be used
+  // concurrently in multiple threads, so creating a segment happens under this lock.  Looking up
+  // a segment that already exists goes through `segmentTable` and never locks.
+
+  SegmentReader* tryGetSegmentSlow(SegmentId id);
 };
 
 class BuilderArena final: public Arena {
@@ -294,6 +321,14 @@ public:
   // from disk (until the message itself is written out).  `Orphanage` provides the public API for
   // this feature.
 
+  void replaceWith(BuilderArena& other);
+  // Discard the entire content of this arena and replace it with a copy of `other`'s, which must
+  // consist of exactly one segment.  The capability table is moved from `other`.  The content
+  // goes into segment 0 if it fits, otherwise into a freshly-allocated segment which becomes the
+  // new segment 0; all other segments are dropped from the arena (their memory still belongs to
+  // the MessageBuilder).  Any outstanding pointers into the arena are invalidated.  Used to
+  // implement compactMessage().
+
   // implements Arena ------------------------------------------------
   SegmentReader* tryGetSegment(SegmentId id) override;
   void reportReadLimitReached() override;
@@ -311,6 +346,8 @@ private:
 
   private:
     kj::Vector<kj::Maybe<kj::Own<ClientHook>>> capTable;
+
+    friend class BuilderArena;
 #endif // ! CAPNP_LITE
   };
 
@@ -319,9 +356,24 @@ private:
   SegmentBuilder segment0;
   kj::ArrayPtr<const word> segment0ForOutput;
 
+  struct FreeSpace {
+    uint words;
+    // Free space in the segment when it was last checked.  Allocations made directly through the
+    // SegmentBuilder aren't reported back to the arena, so this may be an overestimate.
+
+    SegmentBuilder* segment;
+
+    inline bool operator<(const FreeSpace& other) const { return words < other.words; }
+  };
+
   struct MultiSegmentState {
     kj::Vector<kj::Own<SegmentBuilder>> builders;
     kj::Vector<kj::ArrayPtr<const word>> forOutput;
+
+    kj::Vector<FreeSpace> freeSpace;
+    // Max-heap of segments other than `segmentWithSpace` which had room left over last time we
+    // looked.  allocate() falls back to these before allocating a new segment, so that messages
+    // which interleave small and large objects don't leave half-empty segments behind.
   };
   kj::Maybe<kj::Own<MultiSegmentState>> moreSegments;
 
@@ -330,6 +382,9 @@ private:
   // segment.  This is not necessarily the last segment because addExternalSegment() may add a
   // segment that is already-full, in which case we don't update this pointer.
 
+  word* tryAllocateFromFreeSpace(WordCount amount, SegmentBuilder*& segment);
+  void addFreeSpace(SegmentBuilder* segment);
+
   template <typename T>  // Can be `word` or `const word`.
   SegmentBuilder* addSegmentInternal(kj::ArrayPtr<T> content);
 };
@@ -383,6 +438,8 @@ inline WordCount SegmentReader::getOffsetTo(const word* ptr) {
 inline WordCount SegmentReader::getSize() { return ptr.size() * WORDS; }
 inline kj::ArrayPtr<const word> SegmentReader::getArray() { return ptr; }
 inline void SegmentReader::unread(WordCount64 amount) { readLimiter->unread(amount); }
+inline bool SegmentReader::isValidated() { return validated; }
+inline void SegmentReader::markValidated() { validated = true; }
 
 // -------------------------------------------------------------------
 
@@ -431,6 +488,10 @@ inline kj::ArrayPtr<const word> SegmentBuilder::currentlyAllocated() {
   return kj::arrayPtr(ptr.begin(), pos - ptr.begin());
 }
 
+inline WordCount SegmentBuilder::available() {
+  return intervalLength(pos, ptr.end());
+}
+
 inline void SegmentBuilder::reset() {
   word* start = getPtrUnchecked(0 * WORDS);
   memset(start, 0, (pos - start) * sizeof(word));
@@ -192,10 +192,26 @@ public:
                       kj::Maybe<MessageSize> sizeHint, kj::Own<ClientHook> client)
       : message(kj::heap<MallocMessageBuilder>(firstSegmentSize(sizeHint))),
         interfaceId(interfaceId), methodId(methodId), client(kj::mv(client)) {}
+  inline LocalRequest(uint64_t interfaceId, uint16_t methodId,
+                      MessageSizeTracker& sizeTracker, kj::Own<ClientHook> client)
+      : message(kj::heap<MallocMessageBuilder>(sizeTracker.suggestFirstSegmentWords())),
+        interfaceId(interfaceId), methodId(methodId), client(kj::mv(client)),
+        sizeTracker(&sizeTracker) {}
+  // `sizeTracker` belongs to the LocalClient referenced by `client`.  The params size is recorded
+  // at send() rather than when the builder is destroyed, since the call context may release its
+  // client reference before it destroys the params.
 
   RemotePromise<AnyPointer> send() override {
     KJ_REQUIRE(message.get() != nullptr, "Already called send() on this request.");
 
+    KJ_IF_MAYBE(tracker, sizeTracker) {
+      size_t size = 0;
+      for (auto& segment: message->getSegmentsForOutput()) {
+        size += segment.size();
+      }
+      tracker->record(size);
+    }
+
     // For the lambda capture.
     uint64_t interfaceId = this->interfaceId;
     uint16_t methodId = this->methodId;
@@ -239,6 +255,7 @@ private:
   uint64_t interfaceId;
   uint16_t methodId;
   kj::Own<ClientHook> client;
+  MessageSizeTracker* sizeTracker = nullptr;
 };
 
 // =======================================================================================
@@ -462,8 +479,14 @@ public:
 
   Request<AnyPointer, AnyPointer> newCall(
       uint64_t interfaceId, uint16_t methodId, kj::Maybe<MessageSize> sizeHint) override {
-    auto hook = kj::heap<LocalRequest>(
-        interfaceId, methodId, sizeHint, kj::addRef(*this));
+    kj::Own<LocalRequest> hook;
+    if (sizeHint == nullptr) {
+      // No hint from the caller, so size the params from earlier calls to the same method.
+      auto& tracker = paramSizes[std::make_pair(interfaceId, methodId)];
+      hook = kj::heap<LocalRequest>(interfaceId, methodId, tracker, kj::addRef(*this));
+    } else {
+      hook = kj::heap<LocalRequest>(interfaceId, methodId, sizeHint, kj::addRef(*this));
+    }
     auto root = hook->message->getRoot<AnyPointer>();
     return Request<AnyPointer, AnyPointer>(root, kj::mv(hook));
   }
@@ -535,6 +558,7 @@ private:
   kj::Own<Capability::Server> server;
   _::CapabilityServerSetBase* capServerSet = nullptr;
   void* ptr = nullptr;
+  std::map<std::pair<uint64_t, uint16_t>, MessageSizeTracker> paramSizes;
 };
 
 kj::Own<ClientHook> Capability::Client::makeLocalClient(kj::Own<Capability::Server>&& server) {
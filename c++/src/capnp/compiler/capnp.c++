@@ -38,7 +38,9 @@
 #include <sys/types.h>
 #include <capnp/serialize.h>
 #include <capnp/serialize-packed.h>
+#include <capnp/serialize-log.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 
 #if _WIN32
@@ -87,7 +89,9 @@ public:
              .addSubCommand("encode", KJ_BIND_METHOD(*this, getEncodeMain),
                             "Encode text Cap'n Proto message to binary.")
              .addSubCommand("eval", KJ_BIND_METHOD(*this, getEvalMain),
-                            "Evaluate a const from a schema file.");
+                            "Evaluate a const from a schema file.")
+             .addSubCommand("log", KJ_BIND_METHOD(*this, getLogMain),
+                            "Verify, index, or look up messages in a message log.");
       addGlobalOptions(builder);
       return builder.build();
     }
@@ -225,6 +229,28 @@ public:
     return builder.build();
   }
 
+  kj::MainFunc getLogMain() {
+    kj::MainBuilder builder(context, VERSION_STRING,
+          "Inspects <log-file>, a file of messages in standard serialization format as written by "
+          "capnp::MessageLogWriter (from <capnp/serialize-log.h>) or by repeated calls to "
+          "capnp::writeMessageToFd().  By default, checks that every message can be located "
+          "and reports whether the file has a valid index.",
+
+          "Looking up a message with --get uses the index, so it doesn't read the rest of the "
+          "file.  Without a valid index, the whole file is scanned first.");
+    builder.addOption({'i', "index"}, KJ_BIND_METHOD(*this, setLogIndex),
+                      "After checking the messages as above, build the file's index if it is "
+                      "missing or damaged, first truncating any partially-written message at "
+                      "the end of the file.")
+           .addOptionWithArg({'n', "get"}, KJ_BIND_METHOD(*this, setLogGet), "<n>",
+                             "Write message number <n> (counting from zero) to standard output "
+                             "in standard serialization format, e.g. to pipe into "
+                             "`capnp decode`.")
+           .expectArg("<log-file>", KJ_BIND_METHOD(*this, setLogFile))
+           .callAfterParsing(KJ_BIND_METHOD(*this, processLog));
+    return builder.build();
+  }
+
   void addGlobalOptions(kj::MainBuilder& builder) {
     builder.addOptionWithArg({'I', "import-path"}, KJ_BIND_METHOD(*this, addImportPath), "<dir>",
                              "Add <dir> to the list of directories searched for non-relative "
@@ -1424,6 +1450,82 @@ public:
     KJ_CLANG_KNOWS_THIS_IS_UNREACHABLE_BUT_GCC_DOESNT;
   }
 
+public:
+  // -----------------------------------------------------------------
+
+  kj::MainBuilder::Validity setLogIndex() {
+    if (logGet != nullptr) return "cannot be used with --get";
+    logIndex = true;
+    return true;
+  }
+
+  kj::MainBuilder::Validity setLogGet(kj::StringPtr index) {
+    if (logIndex) return "cannot be used with --index";
+    // strtoull() would happily accept a negative number and wrap it around.
+    if (index.size() == 0 || index[0] < '0' || index[0] > '9') {
+      return "not an integer";
+    }
+    char* end;
+    logGet = strtoull(index.cStr(), &end, 10);
+    if (*end != '\0') {
+      return "not an integer";
+    }
+    return true;
+  }
+
+  kj::MainBuilder::Validity setLogFile(kj::StringPtr file) {
+    logFile = file;
+    return true;
+  }
+
+  kj::MainBuilder::Validity processLog() {
+    int flags = logIndex ? O_RDWR : O_RDONLY;
+#if _WIN32
+    flags |= O_BINARY;
+#endif
+    int fd;
+    KJ_SYSCALL(fd = open(logFile.cStr(), flags), logFile);
+    kj::AutoCloseFd closer(fd);
+
+    MessageLogReader reader(fd);
+
+    KJ_IF_MAYBE(index, logGet) {
+      if (*index >= reader.size()) {
+        return kj::str("log has only ", reader.size(), " messages");
+      }
+      auto words = reader[*index];
+      kj::FdOutputStream(STDOUT_FILENO).write(words.begin(), words.asBytes().size());
+      context.exit();
+    }
+
+    // Make sure every message can be located and that its segment table is sane.
+    const word* previousEnd = nullptr;
+    for (auto words: reader) {
+      KJ_REQUIRE(words.begin() >= previousEnd, "message log index is out of order");
+      FlatArrayMessageReader message(words);
+      KJ_REQUIRE(message.getEnd() == words.end(), "message log index is corrupt");
+      previousEnd = words.end();
+    }
+
+    if (logIndex) {
+      // Only index a log whose messages have all checked out.
+      MessageLogWriter writer(fd);
+      bool recovered = writer.wasRecovered();
+      uint64_t count = writer.size();
+      writer.finish();
+      context.exitInfo(kj::str(logFile, ": ", count, " messages; ",
+          recovered ? "index rebuilt" : "index was already valid"));
+    }
+
+    if (reader.wasRecovered()) {
+      context.exitError(kj::str(logFile, ": ", reader.size(), " messages; "
+          "no valid index (use --index to build one)"));
+    } else {
+      context.exitInfo(kj::str(logFile, ": ", reader.size(), " messages; index OK"));
+    }
+    KJ_CLANG_KNOWS_THIS_IS_UNREACHABLE_BUT_GCC_DOESNT;
+  }
+
 private:
   void writeFlat(DynamicStruct::Reader value, kj::BufferedOutputStream& output) {
     // Always copy the message to a flat array so that the output is predictable (one segment,
@@ -1546,6 +1648,11 @@ private:
   StructSchema rootType;
   // For the "decode" and "encode" commands.
 
+  kj::StringPtr logFile;
+  bool logIndex = false;
+  kj::Maybe<uint64_t> logGet;
+  // For the "log" command.
+
   struct SourceFile {
     uint64_t id;
     kj::StringPtr name;
@@ -0,0 +1,169 @@
+// Copyright (c) 2017 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "diff.h"
+#include "message.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+#include "test-util.h"
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+template <typename T>
+bool sameContent(T a, T b) {
+  return AnyStruct::Reader(a).equals(AnyStruct::Reader(b)) == Equality::EQUAL;
+}
+
+KJ_TEST("identical messages produce an empty patch") {
+  MallocMessageBuilder fromMessage, toMessage;
+  initTestMessage(fromMessage.initRoot<TestAllTypes>());
+  initTestMessage(toMessage.initRoot<TestAllTypes>());
+
+  MallocMessageBuilder patchMessage;
+  auto patch = patchMessage.initRoot<diff::Patch>();
+  computePatch(fromMessage.getRoot<TestAllTypes>().asReader(),
+               toMessage.getRoot<TestAllTypes>().asReader(), patch);
+
+  KJ_EXPECT(!patch.hasChanged());
+  KJ_EXPECT(!patch.hasValues());
+  KJ_EXPECT(!patch.hasStructs());
+  KJ_EXPECT(!patch.hasLists());
+}
+
+KJ_TEST("patch round trip") {
+  MallocMessageBuilder fromMessage, toMessage;
+  auto from = fromMessage.initRoot<TestAllTypes>();
+  initTestMessage(from);
+  toMessage.setRoot(from.asReader());
+  auto to = toMessage.getRoot<TestAllTypes>();
+
+  to.setInt32Field(12345);
+  to.setFloat64Field(-0.0);
+  to.setTextField("changed");
+  to.disownDataField();
+  to.getStructField().setUInt8Field(7);
+  to.getStructField().getStructField().setTextField("deeper");
+  to.getStructList()[1].setTextField("element");
+  {
+    // Grow the list by one element.
+    auto orphan = to.disownStructList();
+    auto old = orphan.getReader();
+    auto list = to.initStructList(old.size() + 1);
+    for (uint i = 0; i < old.size(); i++) {
+      list.setWithCaveats(i, old[i]);
+    }
+    list[old.size()].setInt16Field(-3);
+    list[old.size()].setTextField("appended");
+  }
+  to.setInt16List({1, 2, 3});
+
+  MallocMessageBuilder patchMessage;
+  auto patch = patchMessage.initRoot<diff::Patch>();
+  computePatch(from.asReader(), to.asReader(), patch);
+
+  KJ_EXPECT(patch.getChanged().size() == 5);
+  KJ_EXPECT(patch.getStructs().size() == 1);
+  KJ_EXPECT(patch.getLists().size() == 1);
+  KJ_EXPECT(patch.getLists()[0].getSize() == 4);
+  KJ_EXPECT(patch.getLists()[0].getElements().size() == 2);
+  KJ_EXPECT(patch.totalSize().wordCount < to.totalSize().wordCount / 2);
+
+  applyPatch(from, patch.asReader());
+  KJ_EXPECT(sameContent(from.asReader(), to.asReader()));
+  KJ_EXPECT(!from.hasDataField());
+  KJ_EXPECT(from.asReader().getStructList()[3].getTextField() == "appended");
+}
+
+KJ_TEST("patch shrinking a list") {
+  MallocMessageBuilder fromMessage, toMessage;
+  auto from = fromMessage.initRoot<TestAllTypes>();
+  initTestMessage(from);
+  auto to = toMessage.initRoot<TestAllTypes>();
+  initTestMessage(to);
+
+  auto list = to.initStructList(1);
+  list[0].setTextField("structlist 1");
+
+  MallocMessageBuilder patchMessage;
+  auto patch = patchMessage.initRoot<diff::Patch>();
+  computePatch(from.asReader(), to.asReader(), patch);
+  KJ_EXPECT(!patch.hasChanged());
+  KJ_EXPECT(patch.getLists().size() == 1);
+  KJ_EXPECT(patch.getLists()[0].getElements().size() == 0);
+
+  applyPatch(from, patch.asReader());
+  KJ_EXPECT(sameContent(from.asReader(), to.asReader()));
+}
+
+KJ_TEST("patch unions and groups") {
+  MallocMessageBuilder fromMessage, toMessage;
+  auto from = fromMessage.initRoot<test::TestGroups>();
+  auto to = toMessage.initRoot<test::TestGroups>();
+
+  from.getGroups().initFoo().setGarply("foo");
+  to.getGroups().initBar().setGrault("bar");
+
+  MallocMessageBuilder patchMessage;
+  auto patch = patchMessage.initRoot<diff::Patch>();
+  computePatch(from.asReader(), to.asReader(), patch);
+  KJ_EXPECT(patch.getChanged().size() == 1);
+
+  applyPatch(from, patch.asReader());
+  KJ_EXPECT(sameContent(from.asReader(), to.asReader()));
+  KJ_EXPECT(from.getGroups().isBar());
+  KJ_EXPECT(from.asReader().getGroups().getBar().getGrault() == "bar");
+
+  MallocMessageBuilder fromUnionMessage, toUnionMessage;
+  auto fromUnion = fromUnionMessage.initRoot<test::TestUnnamedUnion>();
+  auto toUnion = toUnionMessage.initRoot<test::TestUnnamedUnion>();
+  fromUnion.setFoo(123);
+  fromUnion.setBefore("before");
+  toUnion.setBar(456);
+  toUnion.setBefore("before");
+
+  MallocMessageBuilder unionPatchMessage;
+  auto unionPatch = unionPatchMessage.initRoot<diff::Patch>();
+  computePatch(fromUnion.asReader(), toUnion.asReader(), unionPatch);
+  KJ_EXPECT(unionPatch.getChanged().size() == 1);
+
+  applyPatch(fromUnion, unionPatch.asReader());
+  KJ_EXPECT(fromUnion.isBar());
+  KJ_EXPECT(fromUnion.getBar() == 456);
+  KJ_EXPECT(fromUnion.asReader().getBefore() == "before");
+}
+
+KJ_TEST("applyPatch rejects out-of-range fields") {
+  MallocMessageBuilder targetMessage;
+  auto target = targetMessage.initRoot<TestAllTypes>();
+
+  MallocMessageBuilder patchMessage;
+  auto patch = patchMessage.initRoot<diff::Patch>();
+  patch.initChanged(1).set(0, 1000);
+  patch.getValues().initAs<TestAllTypes>();
+
+  KJ_EXPECT_THROW_MESSAGE("field not in the schema", applyPatch(target, patch.asReader()));
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
@@ -0,0 +1,328 @@
+// Copyright (c) 2017 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "diff.h"
+#include <kj/debug.h>
+#include <kj/vector.h>
+#include <string.h>
+
+namespace capnp {
+
+namespace {
+
+bool isPointerSlot(StructSchema::Field field) {
+  if (field.getProto().isGroup()) return false;
+  switch (field.getType().which()) {
+    case schema::Type::TEXT:
+    case schema::Type::DATA:
+    case schema::Type::LIST:
+    case schema::Type::STRUCT:
+    case schema::Type::INTERFACE:
+    case schema::Type::ANY_POINTER:
+      return true;
+    default:
+      return false;
+  }
+}
+
+AnyPointer::Reader getPointerSlot(DynamicStruct::Reader reader, StructSchema::Field field) {
+  // Works for groups too, since a group's reader shares its parent's pointer section.  The
+  // section may be shorter than the schema says, e.g. for a default-valued struct or one written
+  // with an older version of the schema; the missing pointers are null.
+  auto pointers = reader.as<AnyStruct>().getPointerSection();
+  auto offset = field.getProto().getSlot().getOffset();
+  return offset < pointers.size() ? pointers[offset] : AnyPointer::Reader();
+}
+
+bool scalarsEqual(DynamicValue::Reader a, DynamicValue::Reader b) {
+  switch (a.getType()) {
+    case DynamicValue::VOID:
+      return true;
+    case DynamicValue::BOOL:
+      return a.as<bool>() == b.as<bool>();
+    case DynamicValue::INT:
+      return a.as<int64_t>() == b.as<int64_t>();
+    case DynamicValue::UINT:
+      return a.as<uint64_t>() == b.as<uint64_t>();
+    case DynamicValue::FLOAT: {
+      // Compare bit patterns, so that NaNs compare equal to themselves and 0.0 != -0.0.
+      double x = a.as<double>(), y = b.as<double>();
+      return memcmp(&x, &y, sizeof(double)) == 0;
+    }
+    case DynamicValue::ENUM:
+      return a.as<DynamicEnum>().getRaw() == b.as<DynamicEnum>().getRaw();
+    default:
+      KJ_FAIL_ASSERT("not a scalar", a.getType());
+  }
+}
+
+bool structsEqual(DynamicStruct::Reader a, DynamicStruct::Reader b);
+
+bool fieldsEqual(DynamicStruct::Reader a, DynamicStruct::Reader b, StructSchema::Field field) {
+  if (field.getProto().isGroup()) {
+    return structsEqual(a.get(field).as<DynamicStruct>(), b.get(field).as<DynamicStruct>());
+  } else if (isPointerSlot(field)) {
+    return getPointerSlot(a, field).equals(getPointerSlot(b, field)) == Equality::EQUAL;
+  } else {
+    return scalarsEqual(a.get(field), b.get(field));
+  }
+}
+
+bool structsEqual(DynamicStruct::Reader a, DynamicStruct::Reader b) {
+  // Field-by-field comparison, used for groups, which don't have a pointer of their own that we
+  // could hand to AnyPointer::Reader::equals().
+
+  KJ_IF_MAYBE(field, a.which()) {
+    KJ_IF_MAYBE(otherField, b.which()) {
+      if (*field != *otherField || !fieldsEqual(a, b, *field)) return false;
+    } else {
+      return false;
+    }
+  } else if (b.which() != nullptr) {
+    return false;
+  }
+
+  for (auto field: a.getSchema().getNonUnionFields()) {
+    if (!fieldsEqual(a, b, field)) return false;
+  }
+  return true;
+}
+
+// =======================================================================================
+// The diff is first computed into the tree below and only then written out, so that the sizes
+// of the patch's lists are known up front and unchanged subtrees leave no garbage in the patch
+// message.
+
+struct StructDiff;
+
+struct ChildDiff {
+  uint index;  // field index, or element index within a list
+  kj::Own<StructDiff> diff;
+};
+
+struct ListDiff {
+  uint field;
+  uint size;
+  kj::Vector<ChildDiff> elements;
+};
+
+struct StructDiff {
+  DynamicStruct::Reader to;
+  kj::Vector<StructSchema::Field> changed;
+  kj::Vector<ChildDiff> structs;
+  kj::Vector<ListDiff> lists;
+
+  inline bool isEmpty() const {
+    return changed.size() == 0 && structs.size() == 0 && lists.size() == 0;
+  }
+};
+
+kj::Maybe<kj::Own<StructDiff>> diffStructs(DynamicStruct::Reader from, DynamicStruct::Reader to);
+
+kj::Maybe<ListDiff> diffLists(StructSchema::Field field,
+                              DynamicList::Reader from, DynamicList::Reader to) {
+  // Elements past the end of `from` are diffed against the default value, which is what
+  // applyPatch() will find there after resizing the list.
+  auto empty = AnyPointer::Reader().getAs<DynamicStruct>(
+      to.getSchema().getElementType().asStruct());
+
+  ListDiff result { field.getIndex(), to.size(), {} };
+  for (uint i = 0; i < to.size(); i++) {
+    auto old = i < from.size() ? from[i].as<DynamicStruct>() : empty;
+    KJ_IF_MAYBE(diff, diffStructs(old, to[i].as<DynamicStruct>())) {
+      result.elements.add(ChildDiff { i, kj::mv(*diff) });
+    }
+  }
+
+  if (result.elements.size() == 0 && from.size() == to.size()) {
+    return nullptr;
+  }
+  return kj::mv(result);
+}
+
+void diffField(DynamicStruct::Reader from, DynamicStruct::Reader to, StructSchema::Field field,
+               StructDiff& result) {
+  if (isPointerSlot(field) && from.has(field) && to.has(field)) {
+    auto type = field.getType();
+    if (type.isStruct()) {
+      KJ_IF_MAYBE(diff, diffStructs(from.get(field).as<DynamicStruct>(),
+                                    to.get(field).as<DynamicStruct>())) {
+        result.structs.add(ChildDiff { field.getIndex(), kj::mv(*diff) });
+      }
+      return;
+    } else if (type.isList() && type.asList().getElementType().isStruct()) {
+      KJ_IF_MAYBE(diff, diffLists(field, from.get(field).as<DynamicList>(),
+                                  to.get(field).as<DynamicList>())) {
+        result.lists.add(kj::mv(*diff));
+      }
+      return;
+    }
+  }
+
+  if (!fieldsEqual(from, to, field)) {
+    result.changed.add(field);
+  }
+}
+
+kj::Maybe<kj::Own<StructDiff>> diffStructs(DynamicStruct::Reader from, DynamicStruct::Reader to) {
+  auto result = kj::heap<StructDiff>();
+  result->to = to;
+
+  KJ_IF_MAYBE(field, to.which()) {
+    bool sameMember = false;
+    KJ_IF_MAYBE(oldField, from.which()) {
+      sameMember = *oldField == *field;
+    }
+    if (sameMember) {
+      diffField(from, to, *field, *result);
+    } else {
+      result->changed.add(*field);
+    }
+  }
+
+  for (auto field: to.getSchema().getNonUnionFields()) {
+    diffField(from, to, field, *result);
+  }
+
+  if (result->isEmpty()) {
+    return nullptr;
+  }
+  return kj::mv(result);
+}
+
+void writePatch(const StructDiff& diff, diff::Patch::Builder patch) {
+  if (diff.changed.size() > 0) {
+    auto changed = patch.initChanged(diff.changed.size());
+    auto values = patch.initValues().initAs<DynamicStruct>(diff.to.getSchema());
+    for (uint i = 0; i < diff.changed.size(); i++) {
+      auto field = diff.changed[i];
+      changed.set(i, field.getIndex());
+      if (isPointerSlot(field) && !diff.to.has(field)) {
+        // clear() still sets the union discriminant, so applyPatch() can tell which member of
+        // the union was made active.
+        values.clear(field);
+      } else {
+        values.set(field, diff.to.get(field));
+      }
+    }
+  }
+
+  if (diff.structs.size() > 0) {
+    auto structs = patch.initStructs(diff.structs.size());
+    for (uint i = 0; i < diff.structs.size(); i++) {
+      structs[i].setField(diff.structs[i].index);
+      writePatch(*diff.structs[i].diff, structs[i].initPatch());
+    }
+  }
+
+  if (diff.lists.size() > 0) {
+    auto lists = patch.initLists(diff.lists.size());
+    for (uint i = 0; i < diff.lists.size(); i++) {
+      auto& list = diff.lists[i];
+      lists[i].setField(list.field);
+      lists[i].setSize(list.size);
+      auto elements = lists[i].initElements(list.elements.size());
+      for (uint j = 0; j < list.elements.size(); j++) {
+        elements[j].setIndex(list.elements[j].index);
+        writePatch(*list.elements[j].diff, elements[j].initPatch());
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void computePatch(DynamicStruct::Reader from, DynamicStruct::Reader to,
+                  diff::Patch::Builder patch) {
+  KJ_REQUIRE(from.getSchema() == to.getSchema(), "Can't diff structs of different types.",
+             from.getSchema().getProto().getDisplayName(),
+             to.getSchema().getProto().getDisplayName());
+
+  KJ_IF_MAYBE(diff, diffStructs(from, to)) {
+    writePatch(**diff, patch);
+  }
+}
+
+void applyPatch(DynamicStruct::Builder target, diff::Patch::Reader patch) {
+  auto schema = target.getSchema();
+  auto fields = schema.getFields();
+
+  if (patch.hasChanged()) {
+    auto values = patch.getValues().getAs<DynamicStruct>(schema);
+    for (auto index: patch.getChanged()) {
+      KJ_REQUIRE(index < fields.size(), "Patch refers to a field not in the schema.", index) {
+        continue;
+      }
+      auto field = fields[index];
+      if (isPointerSlot(field) && !values.has(field)) {
+        target.clear(field);
+      } else {
+        target.set(field, values.get(field));
+      }
+    }
+  }
+
+  for (auto structPatch: patch.getStructs()) {
+    KJ_REQUIRE(structPatch.getField() < fields.size(),
+               "Patch refers to a field not in the schema.", structPatch.getField()) {
+      continue;
+    }
+    auto field = fields[structPatch.getField()];
+    KJ_REQUIRE(!field.getProto().isGroup() && field.getType().isStruct(),
+               "Struct patch applied to a field that isn't a struct.") {
+      continue;
+    }
+    applyPatch(target.get(field).as<DynamicStruct>(), structPatch.getPatch());
+  }
+
+  for (auto listPatch: patch.getLists()) {
+    KJ_REQUIRE(listPatch.getField() < fields.size(),
+               "Patch refers to a field not in the schema.", listPatch.getField()) {
+      continue;
+    }
+    auto field = fields[listPatch.getField()];
+    KJ_REQUIRE(!field.getProto().isGroup() && field.getType().isList() &&
+               field.getType().asList().getElementType().isStruct(),
+               "List patch applied to a field that isn't a list of structs.") {
+      continue;
+    }
+
+    auto size = listPatch.getSize();
+    auto list = target.get(field).as<DynamicList>();
+    if (list.size() != size) {
+      auto old = target.disown(field);
+      auto oldList = old.getReader().as<DynamicList>();
+      list = target.init(field, size).as<DynamicList>();
+      for (uint i = 0; i < kj::min(oldList.size(), size); i++) {
+        list.set(i, oldList[i]);
+      }
+    }
+
+    for (auto element: listPatch.getElements()) {
+      KJ_REQUIRE(element.getIndex() < size, "Patch refers to a list element out of bounds.") {
+        continue;
+      }
+      applyPatch(list[element.getIndex()].as<DynamicStruct>(), element.getPatch());
+    }
+  }
+}
+
+}  // namespace capnp
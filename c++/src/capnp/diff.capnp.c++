@@ -0,0 +1,380 @@
+// Generated by Cap'n Proto compiler, DO NOT EDIT
+// source: diff.capnp
+
+#include "diff.capnp.h"
+
+namespace capnp {
+namespace schemas {
+static const ::capnp::_::AlignedData<101> b_ccdbe0dbfa74f8e8 = {
+  {   0,   0,   0,   0,   5,   0,   6,   0,
+    232, 248, 116, 250, 219, 224, 219, 204,
+     17,   0,   0,   0,   1,   0,   0,   0,
+    144, 132,  34, 202,   4,  87,  38, 249,
+      4,   0,   7,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     21,   0,   0,   0, 186,   0,   0,   0,
+     29,   0,   0,   0,  55,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     73,   0,   0,   0, 231,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     99,  97, 112, 110, 112,  47, 100, 105,
+    102, 102,  46,  99,  97, 112, 110, 112,
+     58,  80,  97, 116,  99, 104,   0,   0,
+     12,   0,   0,   0,   1,   0,   1,   0,
+    124,  14, 253, 135,  12, 167, 178, 181,
+     17,   0,   0,   0,  98,   0,   0,   0,
+     23, 239, 189,  68,  85,  71,  21, 240,
+     17,   0,   0,   0,  82,   0,   0,   0,
+    127, 118, 117,  38, 117, 176,  55, 174,
+     17,   0,   0,   0, 106,   0,   0,   0,
+     83, 116, 114, 117,  99, 116,  80,  97,
+    116,  99, 104,   0,   0,   0,   0,   0,
+     76, 105, 115, 116,  80,  97, 116,  99,
+    104,   0,   0,   0,   0,   0,   0,   0,
+     69, 108, 101, 109, 101, 110, 116,  80,
+     97, 116,  99, 104,   0,   0,   0,   0,
+     16,   0,   0,   0,   3,   0,   4,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   1,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     97,   0,   0,   0,  66,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     92,   0,   0,   0,   3,   0,   1,   0,
+    120,   0,   0,   0,   2,   0,   1,   0,
+      1,   0,   0,   0,   1,   0,   0,   0,
+      0,   0,   1,   0,   1,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    117,   0,   0,   0,  58,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    112,   0,   0,   0,   3,   0,   1,   0,
+    124,   0,   0,   0,   2,   0,   1,   0,
+      2,   0,   0,   0,   2,   0,   0,   0,
+      0,   0,   1,   0,   2,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    121,   0,   0,   0,  66,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    116,   0,   0,   0,   3,   0,   1,   0,
+    144,   0,   0,   0,   2,   0,   1,   0,
+      3,   0,   0,   0,   3,   0,   0,   0,
+      0,   0,   1,   0,   3,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    141,   0,   0,   0,  50,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    136,   0,   0,   0,   3,   0,   1,   0,
+    164,   0,   0,   0,   2,   0,   1,   0,
+     99, 104,  97, 110, 103, 101, 100,   0,
+     14,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   3,   0,   1,   0,
+      7,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     14,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    118,  97, 108, 117, 101, 115,   0,   0,
+     18,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     18,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    115, 116, 114, 117,  99, 116, 115,   0,
+     14,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   3,   0,   1,   0,
+     16,   0,   0,   0,   0,   0,   0,   0,
+    124,  14, 253, 135,  12, 167, 178, 181,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     14,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    108, 105, 115, 116, 115,   0,   0,   0,
+     14,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   3,   0,   1,   0,
+     16,   0,   0,   0,   0,   0,   0,   0,
+     23, 239, 189,  68,  85,  71,  21, 240,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     14,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0, }
+};
+::capnp::word const* const bp_ccdbe0dbfa74f8e8 = b_ccdbe0dbfa74f8e8.words;
+#if !CAPNP_LITE
+static const ::capnp::_::RawSchema* const d_ccdbe0dbfa74f8e8[] = {
+  &s_b5b2a70c87fd0e7c,
+  &s_f015475544bdef17,
+};
+static const uint16_t m_ccdbe0dbfa74f8e8[] = {0, 3, 2, 1};
+static const uint16_t i_ccdbe0dbfa74f8e8[] = {0, 1, 2, 3};
+const ::capnp::_::RawSchema s_ccdbe0dbfa74f8e8 = {
+  0xccdbe0dbfa74f8e8, b_ccdbe0dbfa74f8e8.words, 101, d_ccdbe0dbfa74f8e8, m_ccdbe0dbfa74f8e8,
+  2, 4, i_ccdbe0dbfa74f8e8, nullptr, nullptr, { &s_ccdbe0dbfa74f8e8, nullptr, nullptr, 0, 0, nullptr }
+};
+#endif  // !CAPNP_LITE
+static const ::capnp::_::AlignedData<49> b_b5b2a70c87fd0e7c = {
+  {   0,   0,   0,   0,   5,   0,   6,   0,
+    124,  14, 253, 135,  12, 167, 178, 181,
+     23,   0,   0,   0,   1,   0,   1,   0,
+    232, 248, 116, 250, 219, 224, 219, 204,
+      1,   0,   7,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     21,   0,   0,   0,  26,   1,   0,   0,
+     37,   0,   0,   0,   7,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     33,   0,   0,   0, 119,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     99,  97, 112, 110, 112,  47, 100, 105,
+    102, 102,  46,  99,  97, 112, 110, 112,
+     58,  80,  97, 116,  99, 104,  46,  83,
+    116, 114, 117,  99, 116,  80,  97, 116,
+     99, 104,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   1,   0,   1,   0,
+      8,   0,   0,   0,   3,   0,   4,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   1,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     41,   0,   0,   0,  50,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     36,   0,   0,   0,   3,   0,   1,   0,
+     48,   0,   0,   0,   2,   0,   1,   0,
+      1,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   1,   0,   1,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     45,   0,   0,   0,  50,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     40,   0,   0,   0,   3,   0,   1,   0,
+     52,   0,   0,   0,   2,   0,   1,   0,
+    102, 105, 101, 108, 100,   0,   0,   0,
+      7,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      7,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    112,  97, 116,  99, 104,   0,   0,   0,
+     16,   0,   0,   0,   0,   0,   0,   0,
+    232, 248, 116, 250, 219, 224, 219, 204,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     16,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0, }
+};
+::capnp::word const* const bp_b5b2a70c87fd0e7c = b_b5b2a70c87fd0e7c.words;
+#if !CAPNP_LITE
+static const ::capnp::_::RawSchema* const d_b5b2a70c87fd0e7c[] = {
+  &s_ccdbe0dbfa74f8e8,
+};
+static const uint16_t m_b5b2a70c87fd0e7c[] = {0, 1};
+static const uint16_t i_b5b2a70c87fd0e7c[] = {0, 1};
+const ::capnp::_::RawSchema s_b5b2a70c87fd0e7c = {
+  0xb5b2a70c87fd0e7c, b_b5b2a70c87fd0e7c.words, 49, d_b5b2a70c87fd0e7c, m_b5b2a70c87fd0e7c,
+  1, 2, i_b5b2a70c87fd0e7c, nullptr, nullptr, { &s_b5b2a70c87fd0e7c, nullptr, nullptr, 0, 0, nullptr }
+};
+#endif  // !CAPNP_LITE
+static const ::capnp::_::AlignedData<69> b_f015475544bdef17 = {
+  {   0,   0,   0,   0,   5,   0,   6,   0,
+     23, 239, 189,  68,  85,  71,  21, 240,
+     23,   0,   0,   0,   1,   0,   1,   0,
+    232, 248, 116, 250, 219, 224, 219, 204,
+      1,   0,   7,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     21,   0,   0,   0,  10,   1,   0,   0,
+     37,   0,   0,   0,   7,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     33,   0,   0,   0, 175,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     99,  97, 112, 110, 112,  47, 100, 105,
+    102, 102,  46,  99,  97, 112, 110, 112,
+     58,  80,  97, 116,  99, 104,  46,  76,
+    105, 115, 116,  80,  97, 116,  99, 104,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   1,   0,   1,   0,
+     12,   0,   0,   0,   3,   0,   4,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   1,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     69,   0,   0,   0,  50,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     64,   0,   0,   0,   3,   0,   1,   0,
+     76,   0,   0,   0,   2,   0,   1,   0,
+      1,   0,   0,   0,   1,   0,   0,   0,
+      0,   0,   1,   0,   1,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     73,   0,   0,   0,  42,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     68,   0,   0,   0,   3,   0,   1,   0,
+     80,   0,   0,   0,   2,   0,   1,   0,
+      2,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   1,   0,   2,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     77,   0,   0,   0,  74,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     76,   0,   0,   0,   3,   0,   1,   0,
+    104,   0,   0,   0,   2,   0,   1,   0,
+    102, 105, 101, 108, 100,   0,   0,   0,
+      7,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      7,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    115, 105, 122, 101,   0,   0,   0,   0,
+      8,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      8,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    101, 108, 101, 109, 101, 110, 116, 115,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     14,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   3,   0,   1,   0,
+     16,   0,   0,   0,   0,   0,   0,   0,
+    127, 118, 117,  38, 117, 176,  55, 174,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     14,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0, }
+};
+::capnp::word const* const bp_f015475544bdef17 = b_f015475544bdef17.words;
+#if !CAPNP_LITE
+static const ::capnp::_::RawSchema* const d_f015475544bdef17[] = {
+  &s_ae37b0752675767f,
+};
+static const uint16_t m_f015475544bdef17[] = {2, 0, 1};
+static const uint16_t i_f015475544bdef17[] = {0, 1, 2};
+const ::capnp::_::RawSchema s_f015475544bdef17 = {
+  0xf015475544bdef17, b_f015475544bdef17.words, 69, d_f015475544bdef17, m_f015475544bdef17,
+  1, 3, i_f015475544bdef17, nullptr, nullptr, { &s_f015475544bdef17, nullptr, nullptr, 0, 0, nullptr }
+};
+#endif  // !CAPNP_LITE
+static const ::capnp::_::AlignedData<49> b_ae37b0752675767f = {
+  {   0,   0,   0,   0,   5,   0,   6,   0,
+    127, 118, 117,  38, 117, 176,  55, 174,
+     23,   0,   0,   0,   1,   0,   1,   0,
+    232, 248, 116, 250, 219, 224, 219, 204,
+      1,   0,   7,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     21,   0,   0,   0,  34,   1,   0,   0,
+     37,   0,   0,   0,   7,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     33,   0,   0,   0, 119,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     99,  97, 112, 110, 112,  47, 100, 105,
+    102, 102,  46,  99,  97, 112, 110, 112,
+     58,  80,  97, 116,  99, 104,  46,  69,
+    108, 101, 109, 101, 110, 116,  80,  97,
+    116,  99, 104,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   1,   0,   1,   0,
+      8,   0,   0,   0,   3,   0,   4,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   1,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     41,   0,   0,   0,  50,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     36,   0,   0,   0,   3,   0,   1,   0,
+     48,   0,   0,   0,   2,   0,   1,   0,
+      1,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   1,   0,   1,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     45,   0,   0,   0,  50,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     40,   0,   0,   0,   3,   0,   1,   0,
+     52,   0,   0,   0,   2,   0,   1,   0,
+    105, 110, 100, 101, 120,   0,   0,   0,
+      8,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      8,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    112,  97, 116,  99, 104,   0,   0,   0,
+     16,   0,   0,   0,   0,   0,   0,   0,
+    232, 248, 116, 250, 219, 224, 219, 204,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     16,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0, }
+};
+::capnp::word const* const bp_ae37b0752675767f = b_ae37b0752675767f.words;
+#if !CAPNP_LITE
+static const ::capnp::_::RawSchema* const d_ae37b0752675767f[] = {
+  &s_ccdbe0dbfa74f8e8,
+};
+static const uint16_t m_ae37b0752675767f[] = {0, 1};
+static const uint16_t i_ae37b0752675767f[] = {0, 1};
+const ::capnp::_::RawSchema s_ae37b0752675767f = {
+  0xae37b0752675767f, b_ae37b0752675767f.words, 49, d_ae37b0752675767f, m_ae37b0752675767f,
+  1, 2, i_ae37b0752675767f, nullptr, nullptr, { &s_ae37b0752675767f, nullptr, nullptr, 0, 0, nullptr }
+};
+#endif  // !CAPNP_LITE
+}  // namespace schemas
+}  // namespace capnp
+
+// =======================================================================================
+
+namespace capnp {
+namespace diff {
+
+// Patch
+constexpr uint16_t Patch::_capnpPrivate::dataWordSize;
+constexpr uint16_t Patch::_capnpPrivate::pointerCount;
+#if !CAPNP_LITE
+constexpr ::capnp::Kind Patch::_capnpPrivate::kind;
+constexpr ::capnp::_::RawSchema const* Patch::_capnpPrivate::schema;
+constexpr ::capnp::_::RawBrandedSchema const* Patch::_capnpPrivate::brand;
+#endif  // !CAPNP_LITE
+
+// Patch::StructPatch
+constexpr uint16_t Patch::StructPatch::_capnpPrivate::dataWordSize;
+constexpr uint16_t Patch::StructPatch::_capnpPrivate::pointerCount;
+#if !CAPNP_LITE
+constexpr ::capnp::Kind Patch::StructPatch::_capnpPrivate::kind;
+constexpr ::capnp::_::RawSchema const* Patch::StructPatch::_capnpPrivate::schema;
+constexpr ::capnp::_::RawBrandedSchema const* Patch::StructPatch::_capnpPrivate::brand;
+#endif  // !CAPNP_LITE
+
+// Patch::ListPatch
+constexpr uint16_t Patch::ListPatch::_capnpPrivate::dataWordSize;
+constexpr uint16_t Patch::ListPatch::_capnpPrivate::pointerCount;
+#if !CAPNP_LITE
+constexpr ::capnp::Kind Patch::ListPatch::_capnpPrivate::kind;
+constexpr ::capnp::_::RawSchema const* Patch::ListPatch::_capnpPrivate::schema;
+constexpr ::capnp::_::RawBrandedSchema const* Patch::ListPatch::_capnpPrivate::brand;
+#endif  // !CAPNP_LITE
+
+// Patch::ElementPatch
+constexpr uint16_t Patch::ElementPatch::_capnpPrivate::dataWordSize;
+constexpr uint16_t Patch::ElementPatch::_capnpPrivate::pointerCount;
+#if !CAPNP_LITE
+constexpr ::capnp::Kind Patch::ElementPatch::_capnpPrivate::kind;
+constexpr ::capnp::_::RawSchema const* Patch::ElementPatch::_capnpPrivate::schema;
+constexpr ::capnp::_::RawBrandedSchema const* Patch::ElementPatch::_capnpPrivate::brand;
+#endif  // !CAPNP_LITE
+
+
+}  // namespace
+}  // namespace
+
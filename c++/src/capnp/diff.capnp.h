@@ -0,0 +1,755 @@
+// Generated by Cap'n Proto compiler, DO NOT EDIT
+// source: diff.capnp
+
+#ifndef CAPNP_INCLUDED_f9265704ca228490_
+#define CAPNP_INCLUDED_f9265704ca228490_
+
+#include <capnp/generated-header-support.h>
+
+#if CAPNP_VERSION != 6000
+#error "Version mismatch between generated code and library headers.  You must use the same version of the Cap'n Proto compiler and library."
+#endif
+
+
+namespace capnp {
+namespace schemas {
+
+CAPNP_DECLARE_SCHEMA(ccdbe0dbfa74f8e8);
+CAPNP_DECLARE_SCHEMA(b5b2a70c87fd0e7c);
+CAPNP_DECLARE_SCHEMA(f015475544bdef17);
+CAPNP_DECLARE_SCHEMA(ae37b0752675767f);
+
+}  // namespace schemas
+}  // namespace capnp
+
+namespace capnp {
+namespace diff {
+
+struct Patch {
+  Patch() = delete;
+
+  class Reader;
+  class Builder;
+  class Pipeline;
+  struct StructPatch;
+  struct ListPatch;
+  struct ElementPatch;
+
+  struct _capnpPrivate {
+    CAPNP_DECLARE_STRUCT_HEADER(ccdbe0dbfa74f8e8, 0, 4)
+    #if !CAPNP_LITE
+    static constexpr ::capnp::_::RawBrandedSchema const* brand = &schema->defaultBrand;
+    #endif  // !CAPNP_LITE
+  };
+};
+
+struct Patch::StructPatch {
+  StructPatch() = delete;
+
+  class Reader;
+  class Builder;
+  class Pipeline;
+
+  struct _capnpPrivate {
+    CAPNP_DECLARE_STRUCT_HEADER(b5b2a70c87fd0e7c, 1, 1)
+    #if !CAPNP_LITE
+    static constexpr ::capnp::_::RawBrandedSchema const* brand = &schema->defaultBrand;
+    #endif  // !CAPNP_LITE
+  };
+};
+
+struct Patch::ListPatch {
+  ListPatch() = delete;
+
+  class Reader;
+  class Builder;
+  class Pipeline;
+
+  struct _capnpPrivate {
+    CAPNP_DECLARE_STRUCT_HEADER(f015475544bdef17, 1, 1)
+    #if !CAPNP_LITE
+    static constexpr ::capnp::_::RawBrandedSchema const* brand = &schema->defaultBrand;
+    #endif  // !CAPNP_LITE
+  };
+};
+
+struct Patch::ElementPatch {
+  ElementPatch() = delete;
+
+  class Reader;
+  class Builder;
+  class Pipeline;
+
+  struct _capnpPrivate {
+    CAPNP_DECLARE_STRUCT_HEADER(ae37b0752675767f, 1, 1)
+    #if !CAPNP_LITE
+    static constexpr ::capnp::_::RawBrandedSchema const* brand = &schema->defaultBrand;
+    #endif  // !CAPNP_LITE
+  };
+};
+
+// =======================================================================================
+
+class Patch::Reader {
+public:
+  typedef Patch Reads;
+
+  Reader() = default;
+  inline explicit Reader(::capnp::_::StructReader base): _reader(base) {}
+
+  inline ::capnp::MessageSize totalSize() const {
+    return _reader.totalSize().asPublic();
+  }
+
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const {
+    return ::capnp::_::structString(_reader, *_capnpPrivate::brand);
+  }
+#endif  // !CAPNP_LITE
+
+  inline bool hasChanged() const;
+  inline  ::capnp::List< ::uint16_t>::Reader getChanged() const;
+
+  inline bool hasValues() const;
+  inline ::capnp::AnyPointer::Reader getValues() const;
+
+  inline bool hasStructs() const;
+  inline  ::capnp::List< ::capnp::diff::Patch::StructPatch>::Reader getStructs() const;
+
+  inline bool hasLists() const;
+  inline  ::capnp::List< ::capnp::diff::Patch::ListPatch>::Reader getLists() const;
+
+private:
+  ::capnp::_::StructReader _reader;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::List;
+  friend class ::capnp::MessageBuilder;
+  friend class ::capnp::Orphanage;
+};
+
+class Patch::Builder {
+public:
+  typedef Patch Builds;
+
+  Builder() = delete;  // Deleted to discourage incorrect usage.
+                       // You can explicitly initialize to nullptr instead.
+  inline Builder(decltype(nullptr)) {}
+  inline explicit Builder(::capnp::_::StructBuilder base): _builder(base) {}
+  inline operator Reader() const { return Reader(_builder.asReader()); }
+  inline Reader asReader() const { return *this; }
+
+  inline ::capnp::MessageSize totalSize() const { return asReader().totalSize(); }
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const { return asReader().toString(); }
+#endif  // !CAPNP_LITE
+
+  inline bool hasChanged();
+  inline  ::capnp::List< ::uint16_t>::Builder getChanged();
+  inline void setChanged( ::capnp::List< ::uint16_t>::Reader value);
+  inline void setChanged(::kj::ArrayPtr<const  ::uint16_t> value);
+  inline  ::capnp::List< ::uint16_t>::Builder initChanged(unsigned int size);
+  inline void adoptChanged(::capnp::Orphan< ::capnp::List< ::uint16_t>>&& value);
+  inline ::capnp::Orphan< ::capnp::List< ::uint16_t>> disownChanged();
+
+  inline bool hasValues();
+  inline ::capnp::AnyPointer::Builder getValues();
+  inline ::capnp::AnyPointer::Builder initValues();
+
+  inline bool hasStructs();
+  inline  ::capnp::List< ::capnp::diff::Patch::StructPatch>::Builder getStructs();
+  inline void setStructs( ::capnp::List< ::capnp::diff::Patch::StructPatch>::Reader value);
+  inline  ::capnp::List< ::capnp::diff::Patch::StructPatch>::Builder initStructs(unsigned int size);
+  inline void adoptStructs(::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::StructPatch>>&& value);
+  inline ::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::StructPatch>> disownStructs();
+
+  inline bool hasLists();
+  inline  ::capnp::List< ::capnp::diff::Patch::ListPatch>::Builder getLists();
+  inline void setLists( ::capnp::List< ::capnp::diff::Patch::ListPatch>::Reader value);
+  inline  ::capnp::List< ::capnp::diff::Patch::ListPatch>::Builder initLists(unsigned int size);
+  inline void adoptLists(::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::ListPatch>>&& value);
+  inline ::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::ListPatch>> disownLists();
+
+private:
+  ::capnp::_::StructBuilder _builder;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  friend class ::capnp::Orphanage;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+};
+
+#if !CAPNP_LITE
+class Patch::Pipeline {
+public:
+  typedef Patch Pipelines;
+
+  inline Pipeline(decltype(nullptr)): _typeless(nullptr) {}
+  inline explicit Pipeline(::capnp::AnyPointer::Pipeline&& typeless)
+      : _typeless(kj::mv(typeless)) {}
+
+private:
+  ::capnp::AnyPointer::Pipeline _typeless;
+  friend class ::capnp::PipelineHook;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+};
+#endif  // !CAPNP_LITE
+
+class Patch::StructPatch::Reader {
+public:
+  typedef StructPatch Reads;
+
+  Reader() = default;
+  inline explicit Reader(::capnp::_::StructReader base): _reader(base) {}
+
+  inline ::capnp::MessageSize totalSize() const {
+    return _reader.totalSize().asPublic();
+  }
+
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const {
+    return ::capnp::_::structString(_reader, *_capnpPrivate::brand);
+  }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint16_t getField() const;
+
+  inline bool hasPatch() const;
+  inline  ::capnp::diff::Patch::Reader getPatch() const;
+
+private:
+  ::capnp::_::StructReader _reader;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::List;
+  friend class ::capnp::MessageBuilder;
+  friend class ::capnp::Orphanage;
+};
+
+class Patch::StructPatch::Builder {
+public:
+  typedef StructPatch Builds;
+
+  Builder() = delete;  // Deleted to discourage incorrect usage.
+                       // You can explicitly initialize to nullptr instead.
+  inline Builder(decltype(nullptr)) {}
+  inline explicit Builder(::capnp::_::StructBuilder base): _builder(base) {}
+  inline operator Reader() const { return Reader(_builder.asReader()); }
+  inline Reader asReader() const { return *this; }
+
+  inline ::capnp::MessageSize totalSize() const { return asReader().totalSize(); }
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const { return asReader().toString(); }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint16_t getField();
+  inline void setField( ::uint16_t value);
+
+  inline bool hasPatch();
+  inline  ::capnp::diff::Patch::Builder getPatch();
+  inline void setPatch( ::capnp::diff::Patch::Reader value);
+  inline  ::capnp::diff::Patch::Builder initPatch();
+  inline void adoptPatch(::capnp::Orphan< ::capnp::diff::Patch>&& value);
+  inline ::capnp::Orphan< ::capnp::diff::Patch> disownPatch();
+
+private:
+  ::capnp::_::StructBuilder _builder;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  friend class ::capnp::Orphanage;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+};
+
+#if !CAPNP_LITE
+class Patch::StructPatch::Pipeline {
+public:
+  typedef StructPatch Pipelines;
+
+  inline Pipeline(decltype(nullptr)): _typeless(nullptr) {}
+  inline explicit Pipeline(::capnp::AnyPointer::Pipeline&& typeless)
+      : _typeless(kj::mv(typeless)) {}
+
+  inline  ::capnp::diff::Patch::Pipeline getPatch();
+private:
+  ::capnp::AnyPointer::Pipeline _typeless;
+  friend class ::capnp::PipelineHook;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+};
+#endif  // !CAPNP_LITE
+
+class Patch::ListPatch::Reader {
+public:
+  typedef ListPatch Reads;
+
+  Reader() = default;
+  inline explicit Reader(::capnp::_::StructReader base): _reader(base) {}
+
+  inline ::capnp::MessageSize totalSize() const {
+    return _reader.totalSize().asPublic();
+  }
+
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const {
+    return ::capnp::_::structString(_reader, *_capnpPrivate::brand);
+  }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint16_t getField() const;
+
+  inline  ::uint32_t getSize() const;
+
+  inline bool hasElements() const;
+  inline  ::capnp::List< ::capnp::diff::Patch::ElementPatch>::Reader getElements() const;
+
+private:
+  ::capnp::_::StructReader _reader;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::List;
+  friend class ::capnp::MessageBuilder;
+  friend class ::capnp::Orphanage;
+};
+
+class Patch::ListPatch::Builder {
+public:
+  typedef ListPatch Builds;
+
+  Builder() = delete;  // Deleted to discourage incorrect usage.
+                       // You can explicitly initialize to nullptr instead.
+  inline Builder(decltype(nullptr)) {}
+  inline explicit Builder(::capnp::_::StructBuilder base): _builder(base) {}
+  inline operator Reader() const { return Reader(_builder.asReader()); }
+  inline Reader asReader() const { return *this; }
+
+  inline ::capnp::MessageSize totalSize() const { return asReader().totalSize(); }
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const { return asReader().toString(); }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint16_t getField();
+  inline void setField( ::uint16_t value);
+
+  inline  ::uint32_t getSize();
+  inline void setSize( ::uint32_t value);
+
+  inline bool hasElements();
+  inline  ::capnp::List< ::capnp::diff::Patch::ElementPatch>::Builder getElements();
+  inline void setElements( ::capnp::List< ::capnp::diff::Patch::ElementPatch>::Reader value);
+  inline  ::capnp::List< ::capnp::diff::Patch::ElementPatch>::Builder initElements(unsigned int size);
+  inline void adoptElements(::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::ElementPatch>>&& value);
+  inline ::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::ElementPatch>> disownElements();
+
+private:
+  ::capnp::_::StructBuilder _builder;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  friend class ::capnp::Orphanage;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+};
+
+#if !CAPNP_LITE
+class Patch::ListPatch::Pipeline {
+public:
+  typedef ListPatch Pipelines;
+
+  inline Pipeline(decltype(nullptr)): _typeless(nullptr) {}
+  inline explicit Pipeline(::capnp::AnyPointer::Pipeline&& typeless)
+      : _typeless(kj::mv(typeless)) {}
+
+private:
+  ::capnp::AnyPointer::Pipeline _typeless;
+  friend class ::capnp::PipelineHook;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+};
+#endif  // !CAPNP_LITE
+
+class Patch::ElementPatch::Reader {
+public:
+  typedef ElementPatch Reads;
+
+  Reader() = default;
+  inline explicit Reader(::capnp::_::StructReader base): _reader(base) {}
+
+  inline ::capnp::MessageSize totalSize() const {
+    return _reader.totalSize().asPublic();
+  }
+
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const {
+    return ::capnp::_::structString(_reader, *_capnpPrivate::brand);
+  }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint32_t getIndex() const;
+
+  inline bool hasPatch() const;
+  inline  ::capnp::diff::Patch::Reader getPatch() const;
+
+private:
+  ::capnp::_::StructReader _reader;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::List;
+  friend class ::capnp::MessageBuilder;
+  friend class ::capnp::Orphanage;
+};
+
+class Patch::ElementPatch::Builder {
+public:
+  typedef ElementPatch Builds;
+
+  Builder() = delete;  // Deleted to discourage incorrect usage.
+                       // You can explicitly initialize to nullptr instead.
+  inline Builder(decltype(nullptr)) {}
+  inline explicit Builder(::capnp::_::StructBuilder base): _builder(base) {}
+  inline operator Reader() const { return Reader(_builder.asReader()); }
+  inline Reader asReader() const { return *this; }
+
+  inline ::capnp::MessageSize totalSize() const { return asReader().totalSize(); }
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const { return asReader().toString(); }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint32_t getIndex();
+  inline void setIndex( ::uint32_t value);
+
+  inline bool hasPatch();
+  inline  ::capnp::diff::Patch::Builder getPatch();
+  inline void setPatch( ::capnp::diff::Patch::Reader value);
+  inline  ::capnp::diff::Patch::Builder initPatch();
+  inline void adoptPatch(::capnp::Orphan< ::capnp::diff::Patch>&& value);
+  inline ::capnp::Orphan< ::capnp::diff::Patch> disownPatch();
+
+private:
+  ::capnp::_::StructBuilder _builder;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  friend class ::capnp::Orphanage;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+};
+
+#if !CAPNP_LITE
+class Patch::ElementPatch::Pipeline {
+public:
+  typedef ElementPatch Pipelines;
+
+  inline Pipeline(decltype(nullptr)): _typeless(nullptr) {}
+  inline explicit Pipeline(::capnp::AnyPointer::Pipeline&& typeless)
+      : _typeless(kj::mv(typeless)) {}
+
+  inline  ::capnp::diff::Patch::Pipeline getPatch();
+private:
+  ::capnp::AnyPointer::Pipeline _typeless;
+  friend class ::capnp::PipelineHook;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+};
+#endif  // !CAPNP_LITE
+
+// =======================================================================================
+
+inline bool Patch::Reader::hasChanged() const {
+  return !_reader.getPointerField(0 * ::capnp::POINTERS).isNull();
+}
+inline bool Patch::Builder::hasChanged() {
+  return !_builder.getPointerField(0 * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::List< ::uint16_t>::Reader Patch::Reader::getChanged() const {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::uint16_t>>::get(
+      _reader.getPointerField(0 * ::capnp::POINTERS));
+}
+inline  ::capnp::List< ::uint16_t>::Builder Patch::Builder::getChanged() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::uint16_t>>::get(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+inline void Patch::Builder::setChanged( ::capnp::List< ::uint16_t>::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::uint16_t>>::set(
+      _builder.getPointerField(0 * ::capnp::POINTERS), value);
+}
+inline void Patch::Builder::setChanged(::kj::ArrayPtr<const  ::uint16_t> value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::uint16_t>>::set(
+      _builder.getPointerField(0 * ::capnp::POINTERS), value);
+}
+inline  ::capnp::List< ::uint16_t>::Builder Patch::Builder::initChanged(unsigned int size) {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::uint16_t>>::init(
+      _builder.getPointerField(0 * ::capnp::POINTERS), size);
+}
+inline void Patch::Builder::adoptChanged(
+    ::capnp::Orphan< ::capnp::List< ::uint16_t>>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::uint16_t>>::adopt(
+      _builder.getPointerField(0 * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::List< ::uint16_t>> Patch::Builder::disownChanged() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::uint16_t>>::disown(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+
+inline bool Patch::Reader::hasValues() const {
+  return !_reader.getPointerField(1 * ::capnp::POINTERS).isNull();
+}
+inline bool Patch::Builder::hasValues() {
+  return !_builder.getPointerField(1 * ::capnp::POINTERS).isNull();
+}
+inline ::capnp::AnyPointer::Reader Patch::Reader::getValues() const {
+  return ::capnp::AnyPointer::Reader(
+      _reader.getPointerField(1 * ::capnp::POINTERS));
+}
+inline ::capnp::AnyPointer::Builder Patch::Builder::getValues() {
+  return ::capnp::AnyPointer::Builder(
+      _builder.getPointerField(1 * ::capnp::POINTERS));
+}
+inline ::capnp::AnyPointer::Builder Patch::Builder::initValues() {
+  auto result = ::capnp::AnyPointer::Builder(
+      _builder.getPointerField(1 * ::capnp::POINTERS));
+  result.clear();
+  return result;
+}
+
+inline bool Patch::Reader::hasStructs() const {
+  return !_reader.getPointerField(2 * ::capnp::POINTERS).isNull();
+}
+inline bool Patch::Builder::hasStructs() {
+  return !_builder.getPointerField(2 * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::List< ::capnp::diff::Patch::StructPatch>::Reader Patch::Reader::getStructs() const {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::StructPatch>>::get(
+      _reader.getPointerField(2 * ::capnp::POINTERS));
+}
+inline  ::capnp::List< ::capnp::diff::Patch::StructPatch>::Builder Patch::Builder::getStructs() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::StructPatch>>::get(
+      _builder.getPointerField(2 * ::capnp::POINTERS));
+}
+inline void Patch::Builder::setStructs( ::capnp::List< ::capnp::diff::Patch::StructPatch>::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::StructPatch>>::set(
+      _builder.getPointerField(2 * ::capnp::POINTERS), value);
+}
+inline  ::capnp::List< ::capnp::diff::Patch::StructPatch>::Builder Patch::Builder::initStructs(unsigned int size) {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::StructPatch>>::init(
+      _builder.getPointerField(2 * ::capnp::POINTERS), size);
+}
+inline void Patch::Builder::adoptStructs(
+    ::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::StructPatch>>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::StructPatch>>::adopt(
+      _builder.getPointerField(2 * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::StructPatch>> Patch::Builder::disownStructs() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::StructPatch>>::disown(
+      _builder.getPointerField(2 * ::capnp::POINTERS));
+}
+
+inline bool Patch::Reader::hasLists() const {
+  return !_reader.getPointerField(3 * ::capnp::POINTERS).isNull();
+}
+inline bool Patch::Builder::hasLists() {
+  return !_builder.getPointerField(3 * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::List< ::capnp::diff::Patch::ListPatch>::Reader Patch::Reader::getLists() const {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ListPatch>>::get(
+      _reader.getPointerField(3 * ::capnp::POINTERS));
+}
+inline  ::capnp::List< ::capnp::diff::Patch::ListPatch>::Builder Patch::Builder::getLists() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ListPatch>>::get(
+      _builder.getPointerField(3 * ::capnp::POINTERS));
+}
+inline void Patch::Builder::setLists( ::capnp::List< ::capnp::diff::Patch::ListPatch>::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ListPatch>>::set(
+      _builder.getPointerField(3 * ::capnp::POINTERS), value);
+}
+inline  ::capnp::List< ::capnp::diff::Patch::ListPatch>::Builder Patch::Builder::initLists(unsigned int size) {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ListPatch>>::init(
+      _builder.getPointerField(3 * ::capnp::POINTERS), size);
+}
+inline void Patch::Builder::adoptLists(
+    ::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::ListPatch>>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ListPatch>>::adopt(
+      _builder.getPointerField(3 * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::ListPatch>> Patch::Builder::disownLists() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ListPatch>>::disown(
+      _builder.getPointerField(3 * ::capnp::POINTERS));
+}
+
+inline  ::uint16_t Patch::StructPatch::Reader::getField() const {
+  return _reader.getDataField< ::uint16_t>(
+      0 * ::capnp::ELEMENTS);
+}
+
+inline  ::uint16_t Patch::StructPatch::Builder::getField() {
+  return _builder.getDataField< ::uint16_t>(
+      0 * ::capnp::ELEMENTS);
+}
+inline void Patch::StructPatch::Builder::setField( ::uint16_t value) {
+  _builder.setDataField< ::uint16_t>(
+      0 * ::capnp::ELEMENTS, value);
+}
+
+inline bool Patch::StructPatch::Reader::hasPatch() const {
+  return !_reader.getPointerField(0 * ::capnp::POINTERS).isNull();
+}
+inline bool Patch::StructPatch::Builder::hasPatch() {
+  return !_builder.getPointerField(0 * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::diff::Patch::Reader Patch::StructPatch::Reader::getPatch() const {
+  return ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::get(
+      _reader.getPointerField(0 * ::capnp::POINTERS));
+}
+inline  ::capnp::diff::Patch::Builder Patch::StructPatch::Builder::getPatch() {
+  return ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::get(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+#if !CAPNP_LITE
+inline  ::capnp::diff::Patch::Pipeline Patch::StructPatch::Pipeline::getPatch() {
+  return  ::capnp::diff::Patch::Pipeline(_typeless.getPointerField(0));
+}
+#endif  // !CAPNP_LITE
+inline void Patch::StructPatch::Builder::setPatch( ::capnp::diff::Patch::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::set(
+      _builder.getPointerField(0 * ::capnp::POINTERS), value);
+}
+inline  ::capnp::diff::Patch::Builder Patch::StructPatch::Builder::initPatch() {
+  return ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::init(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+inline void Patch::StructPatch::Builder::adoptPatch(
+    ::capnp::Orphan< ::capnp::diff::Patch>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::adopt(
+      _builder.getPointerField(0 * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::diff::Patch> Patch::StructPatch::Builder::disownPatch() {
+  return ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::disown(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+
+inline  ::uint16_t Patch::ListPatch::Reader::getField() const {
+  return _reader.getDataField< ::uint16_t>(
+      0 * ::capnp::ELEMENTS);
+}
+
+inline  ::uint16_t Patch::ListPatch::Builder::getField() {
+  return _builder.getDataField< ::uint16_t>(
+      0 * ::capnp::ELEMENTS);
+}
+inline void Patch::ListPatch::Builder::setField( ::uint16_t value) {
+  _builder.setDataField< ::uint16_t>(
+      0 * ::capnp::ELEMENTS, value);
+}
+
+inline  ::uint32_t Patch::ListPatch::Reader::getSize() const {
+  return _reader.getDataField< ::uint32_t>(
+      1 * ::capnp::ELEMENTS);
+}
+
+inline  ::uint32_t Patch::ListPatch::Builder::getSize() {
+  return _builder.getDataField< ::uint32_t>(
+      1 * ::capnp::ELEMENTS);
+}
+inline void Patch::ListPatch::Builder::setSize( ::uint32_t value) {
+  _builder.setDataField< ::uint32_t>(
+      1 * ::capnp::ELEMENTS, value);
+}
+
+inline bool Patch::ListPatch::Reader::hasElements() const {
+  return !_reader.getPointerField(0 * ::capnp::POINTERS).isNull();
+}
+inline bool Patch::ListPatch::Builder::hasElements() {
+  return !_builder.getPointerField(0 * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::List< ::capnp::diff::Patch::ElementPatch>::Reader Patch::ListPatch::Reader::getElements() const {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ElementPatch>>::get(
+      _reader.getPointerField(0 * ::capnp::POINTERS));
+}
+inline  ::capnp::List< ::capnp::diff::Patch::ElementPatch>::Builder Patch::ListPatch::Builder::getElements() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ElementPatch>>::get(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+inline void Patch::ListPatch::Builder::setElements( ::capnp::List< ::capnp::diff::Patch::ElementPatch>::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ElementPatch>>::set(
+      _builder.getPointerField(0 * ::capnp::POINTERS), value);
+}
+inline  ::capnp::List< ::capnp::diff::Patch::ElementPatch>::Builder Patch::ListPatch::Builder::initElements(unsigned int size) {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ElementPatch>>::init(
+      _builder.getPointerField(0 * ::capnp::POINTERS), size);
+}
+inline void Patch::ListPatch::Builder::adoptElements(
+    ::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::ElementPatch>>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ElementPatch>>::adopt(
+      _builder.getPointerField(0 * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::List< ::capnp::diff::Patch::ElementPatch>> Patch::ListPatch::Builder::disownElements() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::diff::Patch::ElementPatch>>::disown(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+
+inline  ::uint32_t Patch::ElementPatch::Reader::getIndex() const {
+  return _reader.getDataField< ::uint32_t>(
+      0 * ::capnp::ELEMENTS);
+}
+
+inline  ::uint32_t Patch::ElementPatch::Builder::getIndex() {
+  return _builder.getDataField< ::uint32_t>(
+      0 * ::capnp::ELEMENTS);
+}
+inline void Patch::ElementPatch::Builder::setIndex( ::uint32_t value) {
+  _builder.setDataField< ::uint32_t>(
+      0 * ::capnp::ELEMENTS, value);
+}
+
+inline bool Patch::ElementPatch::Reader::hasPatch() const {
+  return !_reader.getPointerField(0 * ::capnp::POINTERS).isNull();
+}
+inline bool Patch::ElementPatch::Builder::hasPatch() {
+  return !_builder.getPointerField(0 * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::diff::Patch::Reader Patch::ElementPatch::Reader::getPatch() const {
+  return ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::get(
+      _reader.getPointerField(0 * ::capnp::POINTERS));
+}
+inline  ::capnp::diff::Patch::Builder Patch::ElementPatch::Builder::getPatch() {
+  return ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::get(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+#if !CAPNP_LITE
+inline  ::capnp::diff::Patch::Pipeline Patch::ElementPatch::Pipeline::getPatch() {
+  return  ::capnp::diff::Patch::Pipeline(_typeless.getPointerField(0));
+}
+#endif  // !CAPNP_LITE
+inline void Patch::ElementPatch::Builder::setPatch( ::capnp::diff::Patch::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::set(
+      _builder.getPointerField(0 * ::capnp::POINTERS), value);
+}
+inline  ::capnp::diff::Patch::Builder Patch::ElementPatch::Builder::initPatch() {
+  return ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::init(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+inline void Patch::ElementPatch::Builder::adoptPatch(
+    ::capnp::Orphan< ::capnp::diff::Patch>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::adopt(
+      _builder.getPointerField(0 * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::diff::Patch> Patch::ElementPatch::Builder::disownPatch() {
+  return ::capnp::_::PointerHelpers< ::capnp::diff::Patch>::disown(
+      _builder.getPointerField(0 * ::capnp::POINTERS));
+}
+
+}  // namespace
+}  // namespace
+
+#endif  // CAPNP_INCLUDED_f9265704ca228490_
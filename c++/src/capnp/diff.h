@@ -0,0 +1,66 @@
+// Copyright (c) 2017 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef CAPNP_DIFF_H_
+#define CAPNP_DIFF_H_
+
+#if defined(__GNUC__) && !defined(CAPNP_HEADER_WARNINGS)
+#pragma GCC system_header
+#endif
+
+#include "dynamic.h"
+#include <capnp/diff.capnp.h>
+
+namespace capnp {
+
+void computePatch(DynamicStruct::Reader from, DynamicStruct::Reader to,
+                  diff::Patch::Builder patch);
+// Fills in `patch` with a description of how to turn `from` into `to`, which must be of the same
+// struct type.  Unchanged fields and subtrees are not included, so for a large message with few
+// changes the patch is much smaller than `to`.
+//
+// Primitive fields and groups are compared by value.  Struct fields and lists of structs which
+// are non-null on both sides are compared recursively, element by element in the case of lists.
+// All other pointer fields (text, data, other lists, AnyPointer) are compared by canonical
+// equality (see `AnyPointer::Reader::equals()`) and copied in full if they differ.  Capabilities
+// are always considered changed.
+
+void applyPatch(DynamicStruct::Builder target, diff::Patch::Reader patch);
+// Applies a patch produced by `computePatch()` to `target`, which should hold the `from` value
+// the patch was computed against.  Afterwards `target` is equal to `to`, modulo fields unknown
+// to the schema used to compute the patch.
+//
+// Elements dropped from a patched list, and the old value of any list whose size changed, are
+// left behind in the target message as garbage; see "Orphans" in orphan.h.
+
+template <typename Reader>
+inline void computePatch(Reader from, Reader to, diff::Patch::Builder patch) {
+  computePatch(toDynamic(from), toDynamic(to), patch);
+}
+template <typename Builder>
+inline void applyPatch(Builder target, diff::Patch::Reader patch) {
+  applyPatch(toDynamic(target), patch);
+}
+// Convenience overloads for generated types.
+
+}  // namespace capnp
+
+#endif  // CAPNP_DIFF_H_
@@ -649,6 +649,59 @@ TEST(Encoding, ListUpgrade) {
   checkList(reader.getAnyPointerField().getAs<List<uint16_t>>(), {12, 34, 56});
 }
 
+TEST(Encoding, BulkPrimitiveList) {
+  MallocMessageBuilder builder;
+  auto root = builder.initRoot<test::TestAnyPointer>();
+
+  double values[4] = {1.5, -2.25, 1e100, 0};
+  auto list = root.getAnyPointerField().initAs<List<double>>(4);
+  list.setFrom(values);
+  checkList(list.asReader(), {1.5, -2.25, 1e100, 0});
+
+  double copy[4];
+  list.asReader().copyTo(copy);
+  EXPECT_EQ(0, memcmp(values, copy, sizeof(values)));
+
+#if CAPNP_WIRE_VALUES_ARE_NATIVE
+  KJ_IF_MAYBE(ptr, list.asPtr()) {
+    ASSERT_EQ(4u, ptr->size());
+    (*ptr)[3] = 7;
+    EXPECT_EQ(7, list[3]);
+  } else {
+    ADD_FAILURE() << "Expected a direct view of List(Float64).";
+  }
+  KJ_EXPECT(list.asReader().asPtr() != nullptr);
+#endif
+
+  // A struct list read as a primitive list is not contiguous, but bulk copies still work.
+  auto structs = root.getAnyPointerField().initAs<List<test::TestLists::Struct32>>(3);
+  structs[0].setF(12);
+  structs[1].setF(34);
+  structs[2].setF(56);
+
+  auto upgraded = root.getAnyPointerField().getAs<List<uint32_t>>();
+  KJ_EXPECT(upgraded.asPtr() == nullptr);
+  KJ_EXPECT(upgraded.asReader().asPtr() == nullptr);
+
+  uint32_t words[3];
+  upgraded.copyTo(words);
+  EXPECT_EQ(12u, words[0]);
+  EXPECT_EQ(34u, words[1]);
+  EXPECT_EQ(56u, words[2]);
+
+  uint32_t newWords[3] = {7, 8, 9};
+  upgraded.setFrom(newWords);
+  EXPECT_EQ(7u, structs[0].getF());
+  EXPECT_EQ(8u, structs[1].getF());
+  EXPECT_EQ(9u, structs[2].getF());
+
+  // Mismatched sizes are rejected even in release builds, since the copy would overrun.
+  uint32_t tooMany[4] = {1, 2, 3, 4};
+  KJ_EXPECT_THROW_MESSAGE("doesn't match", upgraded.setFrom(tooMany));
+  KJ_EXPECT_THROW_MESSAGE("doesn't match", upgraded.copyTo(tooMany));
+  EXPECT_EQ(7u, structs[0].getF());
+}
+
 TEST(Encoding, BitListDowngrade) {
   // NO LONGER SUPPORTED -- We check for exceptions thrown.
 
@@ -1391,6 +1444,92 @@ TEST(Encoding, StructSetters) {
   }
 }
 
+TEST(Encoding, GraftPreorderSubtree) {
+  // A message built by copying is laid out in pre-order, so copying it again takes the graft path.
+  MallocMessageBuilder original;
+  initTestMessage(original.getRoot<TestAllTypes>());
+
+  MallocMessageBuilder preorder;
+  preorder.setRoot(original.getRoot<TestAllTypes>().asReader());
+  auto source = preorder.getRoot<TestAllTypes>().asReader();
+
+  {
+    MallocMessageBuilder builder;
+    builder.setRoot(source);
+    checkTestMessage(builder.getRoot<TestAllTypes>());
+
+    // A graft reproduces the source exactly.
+    auto expected = preorder.getSegmentsForOutput();
+    auto actual = builder.getSegmentsForOutput();
+    ASSERT_EQ(1u, expected.size());
+    ASSERT_EQ(1u, actual.size());
+    ASSERT_EQ(expected[0].size(), actual[0].size());
+    EXPECT_EQ(0, memcmp(expected[0].begin(), actual[0].begin(), expected[0].asBytes().size()));
+  }
+
+  {
+    // Graft into an existing message, at a different position, spilling into a new segment.
+    MallocMessageBuilder builder(8, AllocationStrategy::FIXED_SIZE);
+    auto root = builder.initRoot<TestAllTypes>();
+    root.setTextField("before");
+    root.setStructField(source);
+    root.setStructList(source.getStructList());
+    root.setTextList(source.getTextList());
+    checkTestMessage(root.getStructField());
+    EXPECT_EQ("before", root.getTextField());
+    ASSERT_EQ(3u, root.getStructList().size());
+    EXPECT_EQ("structlist 3", root.getStructList()[2].getTextField());
+    checkList(root.getTextList(), {"plugh", "xyzzy", "thud"});
+
+    auto orphan = builder.getOrphanage().newOrphanCopy(source);
+    checkTestMessage(orphan.getReader());
+  }
+
+  {
+    // Deep and wide trees.
+    MallocMessageBuilder tree;
+    auto node = tree.initRoot<TestAllTypes>();
+    for (uint i = 0; i < 32; i++) {
+      node.setUInt32Field(i);
+      auto list = node.initStructList(100);
+      for (uint j = 0; j < list.size(); j++) {
+        list[j].setUInt32Field(j);
+        list[j].setTextField(kj::str(i, ":", j));
+      }
+      node = node.initStructField();
+    }
+
+    // Keep the copies in one segment, so that there are no far pointers.
+    uint size = tree.getRoot<TestAllTypes>().totalSize().wordCount + 1;
+    MallocMessageBuilder copy1(size);
+    copy1.setRoot(tree.getRoot<TestAllTypes>().asReader());
+    MallocMessageBuilder copy2(size);
+    copy2.setRoot(copy1.getRoot<TestAllTypes>().asReader());
+    EXPECT_EQ(1u, copy2.getSegmentsForOutput().size());
+
+    auto reader = copy2.getRoot<TestAllTypes>().asReader();
+    for (uint i = 0; i < 32; i++) {
+      EXPECT_EQ(i, reader.getUInt32Field());
+      auto list = reader.getStructList();
+      ASSERT_EQ(100u, list.size());
+      EXPECT_EQ(99u, list[99].getUInt32Field());
+      EXPECT_EQ(kj::str(i, ":99"), list[99].getTextField());
+      reader = reader.getStructField();
+    }
+  }
+
+  {
+    // A multi-segment source has far pointers, so it is copied the regular way.
+    MallocMessageBuilder multiSegment(0, AllocationStrategy::FIXED_SIZE);
+    initTestMessage(multiSegment.initRoot<TestAllTypes>());
+    EXPECT_GT(multiSegment.getSegmentsForOutput().size(), 2u);
+
+    MallocMessageBuilder builder;
+    builder.setRoot(multiSegment.getRoot<TestAllTypes>().asReader());
+    checkTestMessage(builder.getRoot<TestAllTypes>());
+  }
+}
+
 TEST(Encoding, OneBitStructSetters) {
   // Test case of setting a 1-bit struct.
 
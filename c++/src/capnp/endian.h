@@ -74,6 +74,9 @@ namespace _ {  // private
     !CAPNP_DISABLE_ENDIAN_DETECTION
 // CPU is little-endian.  We can just read/write the memory directly.
 
+#define CAPNP_WIRE_VALUES_ARE_NATIVE 1
+// Arrays of WireValue<T> can be reinterpreted as arrays of T.
+
 template <typename T>
 class DirectWireValue {
 public:
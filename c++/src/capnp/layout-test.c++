@@ -368,13 +368,14 @@ TEST(WireFormat, StructRoundTrip_MultipleSegmentsWithMultipleAllocations) {
   ASSERT_EQ(6u, segments.size());
 
   // Check that each segment has the expected size.  Recall that each object will be prefixed by an
-  // extra word if its parent is in a different segment.
+  // extra word if its parent is in a different segment.  Once a segment fills up, the arena goes
+  // back to fill the space left over in earlier segments before allocating a new one.
   EXPECT_EQ( 8u, segments[0].size());  // root ref + struct + sub
-  EXPECT_EQ( 3u, segments[1].size());  // 3-element int32 list
+  EXPECT_EQ( 7u, segments[1].size());  // 3-element int32 list + list list sublist 3,4
   EXPECT_EQ(10u, segments[2].size());  // struct list
   EXPECT_EQ( 8u, segments[3].size());  // struct list substructs
   EXPECT_EQ( 8u, segments[4].size());  // list list + sublist 1,2
-  EXPECT_EQ( 7u, segments[5].size());  // list list sublist 3,4,5
+  EXPECT_EQ( 3u, segments[5].size());  // list list sublist 5
 
   checkStruct(builder);
   checkStruct(builder.asReader());
@@ -382,6 +383,35 @@ TEST(WireFormat, StructRoundTrip_MultipleSegmentsWithMultipleAllocations) {
       .getStruct(nullptr));
 }
 
+TEST(WireFormat, AllocateFromEarlierSegments) {
+  MallocMessageBuilder message(8, AllocationStrategy::FIXED_SIZE);
+  BuilderArena arena(&message);
+
+  auto first = arena.allocate(5 * WORDS);   // segment 0, 3 words left
+  auto second = arena.allocate(6 * WORDS);  // segment 1, 2 words left
+  auto third = arena.allocate(7 * WORDS);   // segment 2, 1 word left
+  EXPECT_EQ(3u, arena.getSegmentsForOutput().size());
+
+  // Segment 2 is too small, so these should come out of the largest earlier segments rather than
+  // creating new segments.
+  auto fourth = arena.allocate(3 * WORDS);
+  EXPECT_EQ(first.segment, fourth.segment);
+  auto fifth = arena.allocate(2 * WORDS);
+  EXPECT_EQ(second.segment, fifth.segment);
+  auto sixth = arena.allocate(1 * WORDS);
+  EXPECT_EQ(third.segment, sixth.segment);
+  EXPECT_EQ(3u, arena.getSegmentsForOutput().size());
+
+  // Everything is full now.
+  auto seventh = arena.allocate(1 * WORDS);
+  EXPECT_EQ(4u, arena.getSegmentsForOutput().size());
+  EXPECT_EQ(3u, seventh.segment->getSegmentId().value);
+
+  for (auto segment: arena.getSegmentsForOutput().slice(0, 3)) {
+    EXPECT_EQ(8u, segment.size());
+  }
+}
+
 inline bool isNan(float f) { return f != f; }
 inline bool isNan(double f) { return f != f; }
 
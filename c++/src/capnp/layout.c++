@@ -312,13 +312,14 @@ struct WireHelpers {
 
   static KJ_ALWAYS_INLINE(bool boundsCheck(
       SegmentReader* segment, const word* start, const word* end)) {
-    // If segment is null, this is an unchecked message, so we don't do bounds checks.
-    return segment == nullptr || segment->containsInterval(start, end);
+    // If segment is null, this is an unchecked message, so we don't do bounds checks.  If the
+    // segment is validated, the whole message was already checked by MessageReader::validate().
+    return segment == nullptr || segment->isValidated() || segment->containsInterval(start, end);
   }
 
   static KJ_ALWAYS_INLINE(bool amplifiedRead(SegmentReader* segment, WordCount virtualAmount)) {
     // If segment is null, this is an unchecked message, so we don't do read limiter checks.
-    return segment == nullptr || segment->amplifiedRead(virtualAmount);
+    return segment == nullptr || segment->isValidated() || segment->amplifiedRead(virtualAmount);
   }
 
   static KJ_ALWAYS_INLINE(word* allocate(
@@ -1544,9 +1545,258 @@ struct WireHelpers {
     }
   }
 
+  // -----------------------------------------------------------------
+  // Grafting
+  //
+  // Every copy made by copyPointer() lays its objects out in pre-order:  each object is followed
+  // by the objects its pointers reach, in pointer order, with no gaps.  A source subtree laid out
+  // that way (with no far or capability pointers) can be copied as one memcpy() of its whole
+  // range, because all of its internal pointers are relative and stay valid when the range moves
+  // together.  Large sub-objects that were themselves copied into a cache are the typical case.
+
+  struct PreorderScan {
+    const word* cursor;
+    // Where the next object must start.
+
+    WordCount64 amplification;
+    // Virtual words read by lists of zero-sized elements.  Charged only if the graft happens.
+  };
+
+  static KJ_ALWAYS_INLINE(bool inBounds(
+      SegmentReader* segment, const word* start, const word* end)) {
+    // Like boundsCheck(), but doesn't count against the read limit:  the scan may still fall
+    // back to a regular copy, which does its own accounting.
+    if (segment == nullptr || segment->isValidated()) {
+      return true;
+    }
+    auto array = segment->getArray();
+    return start >= array.begin() && end <= array.end() && start <= end;
+  }
+
+  static bool isPreorderObject(SegmentReader* segment, const WirePointer* ref,
+                               PreorderScan& scan, int nestingLimit) {
+    // Check that the object `ref` points to starts exactly at `scan.cursor` and, together with
+    // its descendants, is laid out in pre-order.  On success, advances `scan.cursor` past the
+    // subtree.  Anything unusual -- including anything that would be an error -- returns false,
+    // so that the regular copy can handle (and report) it.
+
+    const word* ptr = ref->target();
+    if (nestingLimit <= 0 || ptr != scan.cursor) {
+      return false;
+    }
+
+    switch (ref->kind()) {
+      case WirePointer::STRUCT: {
+        WordCount size = ref->structRef.wordSize();
+        if (!inBounds(segment, ptr, ptr + size)) {
+          return false;
+        }
+        scan.cursor = ptr + size;
+        return isPreorderPointers(segment,
+            reinterpret_cast<const WirePointer*>(ptr + ref->structRef.dataSize.get()),
+            ref->structRef.ptrCount.get() / POINTERS, scan, nestingLimit - 1);
+      }
+
+      case WirePointer::LIST: {
+        ElementSize elementSize = ref->listRef.elementSize();
+
+        if (elementSize == ElementSize::INLINE_COMPOSITE) {
+          WordCount wordCount = ref->listRef.inlineCompositeWordCount();
+          if (!inBounds(segment, ptr, ptr + POINTER_SIZE_IN_WORDS + wordCount)) {
+            return false;
+          }
+
+          const WirePointer* tag = reinterpret_cast<const WirePointer*>(ptr);
+          if (tag->kind() != WirePointer::STRUCT) {
+            return false;
+          }
+
+          ElementCount elementCount = tag->inlineCompositeListElementCount();
+          WordCount dataSize = tag->structRef.dataSize.get();
+          WordCount elementSize = tag->structRef.wordSize();
+          if (elementSize * (elementCount / ELEMENTS) != wordCount) {
+            return false;
+          }
+          if (elementSize == 0 * WORDS) {
+            scan.amplification += elementCount * (1 * WORDS / ELEMENTS);
+          }
+
+          scan.cursor = ptr + POINTER_SIZE_IN_WORDS + wordCount;
+          const word* element = ptr + POINTER_SIZE_IN_WORDS;
+          for (uint i = 0; i < elementCount / ELEMENTS; i++) {
+            if (!isPreorderPointers(segment,
+                    reinterpret_cast<const WirePointer*>(element + dataSize),
+                    tag->structRef.ptrCount.get() / POINTERS, scan, nestingLimit - 1)) {
+              return false;
+            }
+            element += elementSize;
+          }
+          return true;
+        } else {
+          ElementCount elementCount = ref->listRef.elementCount();
+          if (elementSize == ElementSize::VOID) {
+            scan.amplification += elementCount * (1 * WORDS / ELEMENTS);
+          }
+
+          auto step = (dataBitsPerElement(elementSize) +
+                       pointersPerElement(elementSize) * BITS_PER_POINTER);
+          WordCount64 wordCount = roundBitsUpToWords(ElementCount64(elementCount) * step);
+          if (!inBounds(segment, ptr, ptr + wordCount)) {
+            return false;
+          }
+
+          scan.cursor = ptr + wordCount;
+          if (elementSize == ElementSize::POINTER) {
+            return isPreorderPointers(segment, reinterpret_cast<const WirePointer*>(ptr),
+                                      elementCount / ELEMENTS, scan, nestingLimit - 1);
+          }
+          return true;
+        }
+      }
+
+      default:
+        // Far and capability pointers can't be copied verbatim.
+        return false;
+    }
+  }
+
+  static bool isPreorderPointers(SegmentReader* segment, const WirePointer* refs, uint count,
+                                 PreorderScan& scan, int nestingLimit) {
+    for (uint i = 0; i < count; i++) {
+      if (!refs[i].isNull() && !isPreorderObject(segment, refs + i, scan, nestingLimit)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static bool chargeGraft(SegmentReader* segment, const word* children,
+                          const PreorderScan& scan) {
+    // Count a successful scan against the read limit, as the regular copy would have.  `children`
+    // is the end of the root object, which the caller has already accounted for.
+    return boundsCheck(segment, children, scan.cursor) &&
+        (scan.amplification == 0 * WORDS ||
+         amplifiedRead(segment, WordCount(kj::min(scan.amplification / WORDS,
+                                                  uint64_t(kj::maxValue))) * WORDS));
+  }
+
+  static bool findExtent(SegmentReader* segment, const WirePointer* refs, uint count,
+                         const word*& begin, const word*& end, int nestingLimit) {
+    // Widen [begin, end) to cover every object reachable from `refs`.  Returns false if any of
+    // them is out-of-bounds or reached through a far or capability pointer, i.e. if the subtree
+    // can't be lifted out of its segment as-is.  Unlike the pre-order scan, objects may be visited
+    // more than once, so every visit counts against the read limit.
+
+    for (uint i = 0; i < count; i++) {
+      const WirePointer* ref = refs + i;
+      if (ref->isNull()) {
+        continue;
+      }
+      if (nestingLimit <= 0) {
+        return false;
+      }
+
+      const word* ptr = ref->target();
+      const word* objectEnd;
+      switch (ref->kind()) {
+        case WirePointer::STRUCT:
+          objectEnd = ptr + ref->structRef.wordSize();
+          if (!boundsCheck(segment, ptr, objectEnd) ||
+              !findExtent(segment,
+                  reinterpret_cast<const WirePointer*>(ptr + ref->structRef.dataSize.get()),
+                  ref->structRef.ptrCount.get() / POINTERS, begin, end, nestingLimit - 1)) {
+            return false;
+          }
+          break;
+
+        case WirePointer::LIST: {
+          ElementSize elementSize = ref->listRef.elementSize();
+          if (elementSize == ElementSize::INLINE_COMPOSITE) {
+            WordCount wordCount = ref->listRef.inlineCompositeWordCount();
+            objectEnd = ptr + POINTER_SIZE_IN_WORDS + wordCount;
+            if (!boundsCheck(segment, ptr, objectEnd)) {
+              return false;
+            }
+
+            const WirePointer* tag = reinterpret_cast<const WirePointer*>(ptr);
+            ElementCount elementCount = tag->inlineCompositeListElementCount();
+            WordCount elementWords = tag->structRef.wordSize();
+            if (tag->kind() != WirePointer::STRUCT ||
+                elementWords * ElementCount64(elementCount) / ELEMENTS > wordCount) {
+              return false;
+            }
+            if (elementWords == 0 * WORDS &&
+                !amplifiedRead(segment, elementCount * (1 * WORDS / ELEMENTS))) {
+              return false;
+            }
+
+            const word* element = ptr + POINTER_SIZE_IN_WORDS;
+            for (uint j = 0; j < elementCount / ELEMENTS; j++) {
+              if (!findExtent(segment,
+                      reinterpret_cast<const WirePointer*>(element + tag->structRef.dataSize.get()),
+                      tag->structRef.ptrCount.get() / POINTERS, begin, end, nestingLimit - 1)) {
+                return false;
+              }
+              element += elementWords;
+            }
+          } else {
+            ElementCount elementCount = ref->listRef.elementCount();
+            auto step = (dataBitsPerElement(elementSize) +
+                         pointersPerElement(elementSize) * BITS_PER_POINTER);
+            objectEnd = ptr + roundBitsUpToWords(ElementCount64(elementCount) * step);
+            if (!boundsCheck(segment, ptr, objectEnd)) {
+              return false;
+            }
+            if (elementSize == ElementSize::VOID &&
+                !amplifiedRead(segment, elementCount * (1 * WORDS / ELEMENTS))) {
+              return false;
+            }
+            if (elementSize == ElementSize::POINTER &&
+                !findExtent(segment, reinterpret_cast<const WirePointer*>(ptr),
+                            elementCount / ELEMENTS, begin, end, nestingLimit - 1)) {
+              return false;
+            }
+          }
+          break;
+        }
+
+        default:
+          return false;
+      }
+
+      begin = kj::min(begin, ptr);
+      end = kj::max(end, objectEnd);
+    }
+
+    return true;
+  }
+
   static SegmentAnd<word*> setStructPointer(
       SegmentBuilder* segment, CapTableBuilder* capTable, WirePointer* ref, StructReader value,
-      BuilderArena* orphanArena = nullptr, bool canonical = false) {
+      BuilderArena* orphanArena = nullptr, bool canonical = false, bool graft = true) {
+    // If `graft` is true and the source subtree is laid out in pre-order, it is copied with one
+    // memcpy().  Recursive copies of children pass false, so that the pre-order scan is only
+    // made once per copy.
+
+    if (graft && !canonical && value.dataSize % BITS_PER_WORD == 0 * BITS) {
+      WordCount dataWords = value.dataSize / BITS_PER_WORD;
+      const word* start = reinterpret_cast<const word*>(value.data);
+      PreorderScan scan = { start + dataWords, 0 * WORDS };
+      if (reinterpret_cast<const word*>(value.pointers) == scan.cursor) {
+        scan.cursor += value.pointerCount * WORDS_PER_POINTER;
+        const word* children = scan.cursor;
+        if (isPreorderPointers(value.segment, value.pointers, value.pointerCount / POINTERS,
+                               scan, value.nestingLimit) &&
+            chargeGraft(value.segment, children, scan)) {
+          WordCount totalSize = intervalLength(start, scan.cursor);
+          word* ptr = allocate(ref, segment, capTable, totalSize, WirePointer::STRUCT, orphanArena);
+          ref->structRef.set(dataWords, value.pointerCount);
+          memcpy(ptr, start, totalSize * BYTES_PER_WORD / BYTES);
+          return { segment, ptr };
+        }
+      }
+    }
+
     ByteCount dataSize = roundBitsUpToBytes(value.dataSize);
     WirePointerCount ptrCount = value.pointerCount;
 
@@ -1614,7 +1864,7 @@ struct WireHelpers {
     for (uint i = 0; i < ptrCount / POINTERS; i++) {
       copyPointer(segment, capTable, pointerSection + i,
                   value.segment, value.capTable, value.pointers + i,
-                  value.nestingLimit, nullptr, canonical);
+                  value.nestingLimit, nullptr, canonical, false);
     }
 
     return { segment, ptr };
@@ -1637,9 +1887,54 @@ struct WireHelpers {
 
   static SegmentAnd<word*> setListPointer(
       SegmentBuilder* segment, CapTableBuilder* capTable, WirePointer* ref, ListReader value,
-      BuilderArena* orphanArena = nullptr, bool canonical = false) {
+      BuilderArena* orphanArena = nullptr, bool canonical = false, bool graft = true) {
+    // `graft` is as for setStructPointer().  Lists of data are a single memcpy() anyway.
+
     WordCount totalSize = roundBitsUpToWords(value.elementCount * value.step);
 
+    if (graft && !canonical) {
+      const word* start = reinterpret_cast<const word*>(value.ptr);
+      PreorderScan scan = { start + totalSize, 0 * WORDS };
+
+      if (value.elementSize == ElementSize::POINTER) {
+        if (isPreorderPointers(value.segment, reinterpret_cast<const WirePointer*>(start),
+                               value.elementCount / ELEMENTS, scan, value.nestingLimit) &&
+            chargeGraft(value.segment, start + totalSize, scan)) {
+          WordCount graftSize = intervalLength(start, scan.cursor);
+          word* ptr = allocate(ref, segment, capTable, graftSize, WirePointer::LIST, orphanArena);
+          ref->listRef.set(ElementSize::POINTER, value.elementCount);
+          memcpy(ptr, start, graftSize * BYTES_PER_WORD / BYTES);
+          return { segment, ptr };
+        }
+      } else if (value.elementSize == ElementSize::INLINE_COMPOSITE &&
+                 value.structDataSize % BITS_PER_WORD == 0 * BITS) {
+        WordCount dataSize = value.structDataSize / BITS_PER_WORD;
+        WordCount elementSize = dataSize + value.structPointerCount * WORDS_PER_POINTER;
+        bool preorder =
+            elementSize * (1 * ELEMENTS) == value.step * (1 * ELEMENTS) / BITS_PER_WORD;
+        const word* element = start;
+        for (uint i = 0; preorder && i < value.elementCount / ELEMENTS; i++) {
+          preorder = isPreorderPointers(value.segment,
+              reinterpret_cast<const WirePointer*>(element + dataSize),
+              value.structPointerCount / POINTERS, scan, value.nestingLimit);
+          element += elementSize;
+        }
+
+        if (preorder && chargeGraft(value.segment, start + totalSize, scan)) {
+          WordCount graftSize = intervalLength(start, scan.cursor);
+          word* ptr = allocate(ref, segment, capTable, graftSize + POINTER_SIZE_IN_WORDS,
+                               WirePointer::LIST, orphanArena);
+          ref->listRef.setInlineComposite(totalSize);
+
+          WirePointer* tag = reinterpret_cast<WirePointer*>(ptr);
+          tag->setKindAndInlineCompositeListElementCount(WirePointer::STRUCT, value.elementCount);
+          tag->structRef.set(dataSize, value.structPointerCount);
+          memcpy(ptr + POINTER_SIZE_IN_WORDS, start, graftSize * BYTES_PER_WORD / BYTES);
+          return { segment, ptr };
+        }
+      }
+    }
+
     if (value.elementSize != ElementSize::INLINE_COMPOSITE) {
       // List of non-structs.
       word* ptr = allocate(ref, segment, capTable, totalSize, WirePointer::LIST, orphanArena);
@@ -1651,7 +1946,7 @@ struct WireHelpers {
           copyPointer(segment, capTable, reinterpret_cast<WirePointer*>(ptr) + i,
                       value.segment, value.capTable,
                       reinterpret_cast<const WirePointer*>(value.ptr) + i,
-                      value.nestingLimit, nullptr, canonical);
+                      value.nestingLimit, nullptr, canonical, false);
         }
       } else {
         // List of data.
@@ -1726,7 +2021,7 @@ struct WireHelpers {
         for (uint j = 0; j < ptrCount / POINTERS; j++) {
           copyPointer(segment, capTable, reinterpret_cast<WirePointer*>(dst),
               value.segment, value.capTable, reinterpret_cast<const WirePointer*>(src),
-              value.nestingLimit, nullptr, canonical);
+              value.nestingLimit, nullptr, canonical, false);
           dst += POINTER_SIZE_IN_WORDS;
           src += POINTER_SIZE_IN_WORDS;
         }
@@ -1741,17 +2036,17 @@ struct WireHelpers {
       SegmentBuilder* dstSegment, CapTableBuilder* dstCapTable, WirePointer* dst,
       SegmentReader* srcSegment, CapTableReader* srcCapTable, const WirePointer* src,
       int nestingLimit, BuilderArena* orphanArena = nullptr,
-      bool canonical = false)) {
+      bool canonical = false, bool graft = true)) {
     return copyPointer(dstSegment, dstCapTable, dst,
                        srcSegment, srcCapTable, src, src->target(),
-                       nestingLimit, orphanArena, canonical);
+                       nestingLimit, orphanArena, canonical, graft);
   }
 
   static SegmentAnd<word*> copyPointer(
       SegmentBuilder* dstSegment, CapTableBuilder* dstCapTable, WirePointer* dst,
       SegmentReader* srcSegment, CapTableReader* srcCapTable, const WirePointer* src,
       const word* srcTarget, int nestingLimit,
-      BuilderArena* orphanArena = nullptr, bool canonical = false) {
+      BuilderArena* orphanArena = nullptr, bool canonical = false, bool graft = true) {
     // Deep-copy the object pointed to by src into dst.  It turns out we can't reuse
     // readStructPointer(), etc. because they do type checking whereas here we want to accept any
     // valid pointer.
@@ -1788,7 +2083,7 @@ struct WireHelpers {
                          src->structRef.dataSize.get() * BITS_PER_WORD,
                          src->structRef.ptrCount.get(),
                          nestingLimit - 1),
-            orphanArena, canonical);
+            orphanArena, canonical, graft);
 
       case WirePointer::LIST: {
         ElementSize elementSize = src->listRef.elementSize();
@@ -1836,7 +2131,7 @@ struct WireHelpers {
                          tag->structRef.dataSize.get() * BITS_PER_WORD,
                          tag->structRef.ptrCount.get(), ElementSize::INLINE_COMPOSITE,
                          nestingLimit - 1),
-              orphanArena, canonical);
+              orphanArena, canonical, graft);
         } else {
           BitCount dataSize = dataBitsPerElement(elementSize) * ELEMENTS;
           WirePointerCount pointerCount = pointersPerElement(elementSize) * ELEMENTS;
@@ -1861,7 +2156,7 @@ struct WireHelpers {
           return setListPointer(dstSegment, dstCapTable, dst,
               ListReader(srcSegment, srcCapTable, ptr, elementCount, step, dataSize, pointerCount,
                          elementSize, nestingLimit - 1),
-              orphanArena, canonical);
+              orphanArena, canonical, graft);
         }
       }
 
@@ -3238,6 +3533,82 @@ OrphanBuilder OrphanBuilder::referenceExternalData(BuilderArena* arena, Data::Re
   return result;
 }
 
+OrphanBuilder OrphanBuilder::referenceExternal(
+    BuilderArena* arena, CapTableBuilder* capTable, StructReader reader) {
+  WordCount dataWords = reader.dataSize / BITS_PER_WORD;
+  const word* begin = reinterpret_cast<const word*>(reader.data);
+  const word* end = begin + dataWords + reader.pointerCount * WORDS_PER_POINTER;
+
+  if (reader.segment == nullptr || reader.segment->getArena() == arena ||
+      reader.dataSize % BITS_PER_WORD != 0 * BITS ||
+      reinterpret_cast<const word*>(reader.pointers) != begin + dataWords ||
+      !WireHelpers::findExtent(reader.segment, reader.pointers, reader.pointerCount / POINTERS,
+                               begin, end, reader.nestingLimit)) {
+    return copy(arena, capTable, reader);
+  }
+
+  OrphanBuilder result;
+  result.tagAsPtr()->setKindForOrphan(WirePointer::STRUCT);
+  result.tagAsPtr()->structRef.set(dataWords, reader.pointerCount);
+  result.segment = arena->addExternalSegment(kj::arrayPtr(begin, end));
+  result.capTable = capTable;
+
+  // const_cast OK here because we will check whether the segment is writable when we try to get
+  // a builder.
+  result.location = const_cast<word*>(reinterpret_cast<const word*>(reader.data));
+
+  return result;
+}
+
+OrphanBuilder OrphanBuilder::referenceExternal(
+    BuilderArena* arena, CapTableBuilder* capTable, ListReader reader) {
+  const word* location = reinterpret_cast<const word*>(reader.ptr);
+  WordCount wordCount = WireHelpers::roundBitsUpToWords(reader.elementCount * reader.step);
+  const word* begin = location;
+  const word* end = location + wordCount;
+  if (reader.elementSize == ElementSize::INLINE_COMPOSITE) {
+    // Include the tag.
+    location -= POINTER_SIZE_IN_WORDS;
+    begin = location;
+  }
+
+  bool contained = reader.segment != nullptr && reader.segment->getArena() != arena &&
+                   WireHelpers::boundsCheck(reader.segment, begin, end);
+  if (contained && reader.elementSize == ElementSize::POINTER) {
+    contained = WireHelpers::findExtent(reader.segment,
+        reinterpret_cast<const WirePointer*>(reader.ptr), reader.elementCount / ELEMENTS,
+        begin, end, reader.nestingLimit);
+  } else if (contained && reader.elementSize == ElementSize::INLINE_COMPOSITE) {
+    const word* element = reinterpret_cast<const word*>(reader.ptr);
+    WordCount dataWords = reader.structDataSize / BITS_PER_WORD;
+    for (uint i = 0; contained && i < reader.elementCount / ELEMENTS; i++) {
+      contained = WireHelpers::findExtent(reader.segment,
+          reinterpret_cast<const WirePointer*>(element + dataWords),
+          reader.structPointerCount / POINTERS, begin, end, reader.nestingLimit);
+      element += reader.step * (1 * ELEMENTS) / BITS_PER_WORD;
+    }
+  }
+  if (!contained) {
+    return copy(arena, capTable, reader);
+  }
+
+  OrphanBuilder result;
+  result.tagAsPtr()->setKindForOrphan(WirePointer::LIST);
+  if (reader.elementSize == ElementSize::INLINE_COMPOSITE) {
+    result.tagAsPtr()->listRef.setInlineComposite(wordCount);
+  } else {
+    result.tagAsPtr()->listRef.set(reader.elementSize, reader.elementCount);
+  }
+  result.segment = arena->addExternalSegment(kj::arrayPtr(begin, end));
+  result.capTable = capTable;
+
+  // const_cast OK here because we will check whether the segment is writable when we try to get
+  // a builder.
+  result.location = const_cast<word*>(location);
+
+  return result;
+}
+
 StructBuilder OrphanBuilder::asStruct(StructSize size) {
   KJ_DASSERT(tagAsPtr()->isNull() == (location == nullptr));
 
@@ -35,6 +35,7 @@
 
 #include <kj/common.h>
 #include <kj/memory.h>
+#include <kj/debug.h>
 #include "common.h"
 #include "blob.h"
 #include "endian.h"
@@ -126,7 +127,7 @@ template <> struct ElementSizeForType<Void> { static constexpr ElementSize value
 template <> struct ElementSizeForType<bool> { static constexpr ElementSize value = ElementSize::BIT; };
 
 // Lists and blobs are pointers, not structs.
-template <typename T, bool b> struct ElementSizeForType<List<T, b>> {
+template <typename T, Kind k> struct ElementSizeForType<List<T, k>> {
   static constexpr ElementSize value = ElementSize::POINTER;
 };
 template <> struct ElementSizeForType<Text> {
@@ -648,6 +649,7 @@ private:
 
   friend class ListReader;
   friend class StructBuilder;
+  friend class OrphanBuilder;
   friend struct WireHelpers;
 };
 
@@ -688,6 +690,17 @@ public:
       ElementCount index, kj::NoInfer<T> value));
   // Set the element at the given index.
 
+  template <typename T>
+  inline kj::Maybe<kj::ArrayPtr<T>> getDataElementsDirect();
+  // If the elements are stored contiguously in the host's byte order -- i.e. the host is
+  // little-endian and the list has not been upgraded to a struct list -- return them as an array
+  // of T.  Otherwise return null.  T must not be bool or Void.
+
+  template <typename T>
+  void setDataElements(kj::ArrayPtr<const T> values);
+  // Set every element from `values`, which must have size() elements.  This is a single memcpy()
+  // whenever getDataElementsDirect() would succeed.
+
   KJ_ALWAYS_INLINE(PointerBuilder getPointerElement(ElementCount index));
 
   StructBuilder getStructElement(ElementCount index);
@@ -759,6 +772,15 @@ public:
   KJ_ALWAYS_INLINE(T getDataElement(ElementCount index) const);
   // Get the element of the given type at the given index.
 
+  template <typename T>
+  inline kj::Maybe<kj::ArrayPtr<const T>> getDataElementsDirect() const;
+  // Like ListBuilder::getDataElementsDirect().
+
+  template <typename T>
+  void getDataElements(kj::ArrayPtr<T> out) const;
+  // Copy every element into `out`, which must have size() elements.  This is a single memcpy()
+  // whenever getDataElementsDirect() would succeed.
+
   KJ_ALWAYS_INLINE(PointerReader getPointerElement(ElementCount index) const);
 
   StructReader getStructElement(ElementCount index) const;
@@ -850,6 +872,14 @@ public:
 
   static OrphanBuilder referenceExternalData(BuilderArena* arena, Data::Reader data);
 
+  static OrphanBuilder referenceExternal(
+      BuilderArena* arena, CapTableBuilder* capTable, StructReader reader);
+  static OrphanBuilder referenceExternal(
+      BuilderArena* arena, CapTableBuilder* capTable, ListReader reader);
+  // Reference the object (and everything reachable from it) in place by making the range of its
+  // segment that contains it an external segment of `arena`.  Falls back to copy() if the
+  // subtree isn't contained in a single segment or contains capabilities.
+
   OrphanBuilder& operator=(const OrphanBuilder& other) = delete;
   inline OrphanBuilder& operator=(OrphanBuilder&& other);
 
@@ -1157,6 +1187,54 @@ inline void ListBuilder::setDataElement<bool>(ElementCount index, bool value) {
 template <>
 inline void ListBuilder::setDataElement<Void>(ElementCount index, Void value) {}
 
+template <typename T>
+inline kj::Maybe<kj::ArrayPtr<T>> ListBuilder::getDataElementsDirect() {
+  static_assert(elementSizeForType<T>() != ElementSize::BIT &&
+                elementSizeForType<T>() != ElementSize::VOID,
+                "Bit and Void lists are not stored as arrays of T.");
+#if CAPNP_WIRE_VALUES_ARE_NATIVE
+  if (step == bitsPerElement<T>()) {
+    return kj::arrayPtr(reinterpret_cast<T*>(ptr), elementCount / ELEMENTS);
+  }
+#endif
+  return nullptr;
+}
+
+template <typename T>
+inline void ListBuilder::setDataElements(kj::ArrayPtr<const T> values) {
+  KJ_REQUIRE(values.size() * ELEMENTS == elementCount,
+             "List size doesn't match the number of values.") { return; }
+  KJ_IF_MAYBE(direct, getDataElementsDirect<T>()) {
+    if (values.size() > 0) {
+      memcpy(direct->begin(), values.begin(), values.size() * sizeof(T));
+    }
+  } else {
+    for (uint i = 0; i < values.size(); i++) {
+      setDataElement<T>(i * ELEMENTS, values[i]);
+    }
+  }
+}
+
+#if CAPNP_CANONICALIZE_NAN
+// A plain copy would not canonicalize NaNs.
+template <>
+inline void ListBuilder::setDataElements<float>(kj::ArrayPtr<const float> values) {
+  KJ_REQUIRE(values.size() * ELEMENTS == elementCount,
+             "List size doesn't match the number of values.") { return; }
+  for (uint i = 0; i < values.size(); i++) {
+    setDataElement<float>(i * ELEMENTS, values[i]);
+  }
+}
+template <>
+inline void ListBuilder::setDataElements<double>(kj::ArrayPtr<const double> values) {
+  KJ_REQUIRE(values.size() * ELEMENTS == elementCount,
+             "List size doesn't match the number of values.") { return; }
+  for (uint i = 0; i < values.size(); i++) {
+    setDataElement<double>(i * ELEMENTS, values[i]);
+  }
+}
+#endif
+
 inline PointerBuilder ListBuilder::getPointerElement(ElementCount index) {
   return PointerBuilder(segment, capTable,
       reinterpret_cast<WirePointer*>(ptr + index * step / BITS_PER_BYTE));
@@ -1184,6 +1262,34 @@ inline Void ListReader::getDataElement<Void>(ElementCount index) const {
   return VOID;
 }
 
+template <typename T>
+inline kj::Maybe<kj::ArrayPtr<const T>> ListReader::getDataElementsDirect() const {
+  static_assert(elementSizeForType<T>() != ElementSize::BIT &&
+                elementSizeForType<T>() != ElementSize::VOID,
+                "Bit and Void lists are not stored as arrays of T.");
+#if CAPNP_WIRE_VALUES_ARE_NATIVE
+  if (step == bitsPerElement<T>()) {
+    return kj::arrayPtr(reinterpret_cast<const T*>(ptr), elementCount / ELEMENTS);
+  }
+#endif
+  return nullptr;
+}
+
+template <typename T>
+inline void ListReader::getDataElements(kj::ArrayPtr<T> out) const {
+  KJ_REQUIRE(out.size() * ELEMENTS == elementCount,
+             "Output buffer size doesn't match the list size.") { return; }
+  KJ_IF_MAYBE(direct, getDataElementsDirect<T>()) {
+    if (out.size() > 0) {
+      memcpy(out.begin(), direct->begin(), out.size() * sizeof(T));
+    }
+  } else {
+    for (uint i = 0; i < out.size(); i++) {
+      out[i] = getDataElement<T>(i * ELEMENTS);
+    }
+  }
+}
+
 inline PointerReader ListReader::getPointerElement(ElementCount index) const {
   return PointerReader(segment, capTable,
       reinterpret_cast<const WirePointer*>(ptr + index * step / BITS_PER_BYTE), nestingLimit);
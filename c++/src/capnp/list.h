@@ -124,6 +124,18 @@ struct List<T, Kind::PRIMITIVE> {
     inline Iterator begin() const { return Iterator(this, 0); }
     inline Iterator end() const { return Iterator(this, size()); }
 
+    inline kj::Maybe<kj::ArrayPtr<const T>> asPtr() const {
+      // Direct view of the elements, available when they are laid out exactly like an array of T:
+      // the host is little-endian and the list was not written as a struct list.  Not available
+      // for List(Bool) or List(Void).
+      return reader.template getDataElementsDirect<T>();
+    }
+    inline void copyTo(kj::ArrayPtr<T> out) const {
+      // Copy all elements into `out`, which must be exactly size() long.  A single memcpy() when
+      // asPtr() would succeed, an element-by-element loop otherwise.
+      reader.template getDataElements<T>(out);
+    }
+
   private:
     _::ListReader reader;
     template <typename U, Kind K>
@@ -165,6 +177,17 @@ struct List<T, Kind::PRIMITIVE> {
     inline Iterator begin() { return Iterator(this, 0); }
     inline Iterator end() { return Iterator(this, size()); }
 
+    inline kj::Maybe<kj::ArrayPtr<T>> asPtr() {
+      // Like Reader::asPtr(), but writable.
+      return builder.template getDataElementsDirect<T>();
+    }
+    inline void copyTo(kj::ArrayPtr<T> out) const { asReader().copyTo(out); }
+    inline void setFrom(kj::ArrayPtr<const T> values) {
+      // Set all elements from `values`, which must be exactly size() long.  A single memcpy() when
+      // asPtr() would succeed (and NaN canonicalization is not enabled), a loop otherwise.
+      builder.template setDataElements<T>(values);
+    }
+
   private:
     _::ListBuilder builder;
     template <typename U, Kind K>
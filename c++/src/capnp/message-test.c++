@@ -48,6 +48,64 @@ TEST(Message, MallocBuilderWithFirstSegment) {
   EXPECT_EQ(16u, segment.size());
 }
 
+TEST(Message, PooledBuilder) {
+  MessageBuilderPool pool(2);
+
+  const word* firstSegment;
+  {
+    PooledMessageBuilder builder(pool);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    checkTestMessage(builder.getRoot<TestAllTypes>().asReader());
+    ASSERT_EQ(1u, builder.getSegmentsForOutput().size());
+    firstSegment = builder.getSegmentsForOutput()[0].begin();
+  }
+
+  auto stats = pool.getStats();
+  EXPECT_EQ(0u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(1u, stats.cachedSegments);
+
+  {
+    // The second message should get the same, fully re-zeroed, segment.
+    PooledMessageBuilder builder(pool);
+    kj::ArrayPtr<word> segment = builder.allocateSegment(1);
+    EXPECT_EQ(firstSegment, segment.begin());
+    for (auto& w: segment) {
+      EXPECT_EQ(0u, *reinterpret_cast<uint64_t*>(&w));
+    }
+    EXPECT_EQ(0u, pool.getStats().cachedSegments);
+  }
+
+  stats = pool.getStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+
+  {
+    // A message big enough to need several segments.  Only the largest two are kept.
+    PooledMessageBuilder builder(pool);
+    auto root = builder.initRoot<TestAllTypes>();
+    root.initTextList(4);
+    for (uint i = 0; i < 4; i++) {
+      kj::String text = kj::heapString(8000);
+      memset(text.begin(), 'a' + i, text.size());
+      root.getTextList().set(i, text);
+    }
+    EXPECT_LT(2u, builder.getSegmentsForOutput().size());
+  }
+
+  stats = pool.getStats();
+  EXPECT_EQ(2u, stats.cachedSegments);
+
+  {
+    PooledMessageBuilder builder(pool);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    checkTestMessage(builder.getRoot<TestAllTypes>().asReader());
+  }
+
+  EXPECT_EQ(stats.hits + 1, pool.getStats().hits);
+  EXPECT_EQ(stats.misses, pool.getStats().misses);
+}
+
 class TestInitMessageBuilder: public MessageBuilder {
 public:
   TestInitMessageBuilder(kj::ArrayPtr<SegmentInit> segments): MessageBuilder(segments) {}
@@ -151,6 +209,117 @@ TEST(Message, MessageBuilderInitSpaceAvailable) {
             kj::implicitCast<void*>(builder2.getRoot<TestAllTypes>().getTextField().begin()));
 }
 
+TEST(Message, Compact) {
+  MallocMessageBuilder builder(1, AllocationStrategy::FIXED_SIZE);
+  auto root = builder.initRoot<TestAllTypes>();
+  initTestMessage(root);
+
+  // Leave some holes behind.
+  root.setTextField("this text will be overwritten");
+  root.setTextField("foo");
+  root.disownStructList();
+  root.initStructList(3);
+  initTestMessage(root);
+
+  auto segments = builder.getSegmentsForOutput();
+  EXPECT_LT(1u, segments.size());
+
+  compactMessage(builder);
+
+  size_t size = builder.getRoot<TestAllTypes>().totalSize().wordCount + 1;
+  segments = builder.getSegmentsForOutput();
+  ASSERT_EQ(1u, segments.size());
+  EXPECT_EQ(size, segments[0].size());
+  checkTestMessage(builder.getRoot<TestAllTypes>());
+
+  // Compacting again is a no-op.
+  const word* start = segments[0].begin();
+  compactMessage(builder);
+  segments = builder.getSegmentsForOutput();
+  ASSERT_EQ(1u, segments.size());
+  EXPECT_EQ(start, segments[0].begin());
+
+  // The message can still be modified.
+  builder.getRoot<TestAllTypes>().setTextField("bar");
+  EXPECT_EQ("bar", builder.getRoot<TestAllTypes>().getTextField());
+}
+
+TEST(Message, CompactInFirstSegment) {
+  // When the first segment is big enough, it is reused.
+  MallocMessageBuilder builder(2048);
+  auto root = builder.initRoot<TestAllTypes>();
+  initTestMessage(root);
+  root.setTextField("this text will be overwritten");
+  root.setTextField("foo");
+
+  auto segments = builder.getSegmentsForOutput();
+  ASSERT_EQ(1u, segments.size());
+  const word* start = segments[0].begin();
+  size_t oldSize = segments[0].size();
+
+  compactMessage(builder);
+
+  segments = builder.getSegmentsForOutput();
+  ASSERT_EQ(1u, segments.size());
+  EXPECT_EQ(start, segments[0].begin());
+  EXPECT_LT(segments[0].size(), oldSize);
+
+  // Everything past the compacted content is zero'd again.
+  for (auto& w: kj::arrayPtr(segments[0].end(), start + oldSize)) {
+    EXPECT_EQ(0u, *reinterpret_cast<const uint64_t*>(&w));
+  }
+
+  auto reader = builder.getRoot<TestAllTypes>().asReader();
+  EXPECT_EQ("foo", reader.getTextField());
+  EXPECT_EQ(-12345678, reader.getInt32Field());
+}
+
+TEST(Message, Validate) {
+  MallocMessageBuilder builder(1, AllocationStrategy::FIXED_SIZE);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+
+  auto segments = builder.getSegmentsForOutput();
+  EXPECT_LT(1u, segments.size());
+
+  // Allow enough traversal for validation (which also counts far pointer landing pads), but not
+  // for several full reads of the message.
+  ReaderOptions options;
+  options.traversalLimitInWords = builder.getRoot<TestAllTypes>().totalSize().wordCount * 2;
+
+  {
+    SegmentArrayMessageReader reader(segments, options);
+    kj::Maybe<kj::Exception> e = kj::runCatchingExceptions([&]() {
+      for (uint i = 0; i < 5; i++) {
+        checkTestMessage(reader.getRoot<TestAllTypes>());
+      }
+    });
+    KJ_EXPECT(e != nullptr, "Repeated reads should have exceeded the limit.");
+  }
+
+  {
+    // After validation, reads are no longer counted.
+    SegmentArrayMessageReader reader(segments, options);
+    reader.validate();
+    for (uint i = 0; i < 5; i++) {
+      checkTestMessage(reader.getRoot<TestAllTypes>());
+    }
+    reader.validate();  // no-op
+    checkTestMessage(reader.getRoot<TestAllTypes>());
+  }
+}
+
+TEST(Message, ValidateRejectsOutOfBounds) {
+  // A root struct pointer whose one-word data section lies past the end of the segment.
+  AlignedData<2> data = {{0x10,0,0,0, 1,0,0,0, 0,0,0,0,0,0,0,0}};
+  kj::ArrayPtr<const word> segments[1] = { kj::arrayPtr(data.words, 2) };
+
+  SegmentArrayMessageReader reader(segments);
+  kj::Maybe<kj::Exception> e = kj::runCatchingExceptions([&]() {
+    reader.validate();
+  });
+  KJ_EXPECT(e != nullptr, "Should have thrown an exception.");
+}
+
 TEST(Message, ReadWriteDataStruct) {
   MallocMessageBuilder builder;
   auto root = builder.getRoot<TestAllTypes>();
@@ -168,6 +337,63 @@ TEST(Message, ReadWriteDataStruct) {
   checkTestMessageAllZero(defaultValue<TestAllTypes>());
 }
 
+TEST(Message, MessageSizeTracker) {
+  MessageSizeTracker tracker(90, 100);
+  EXPECT_EQ(100u, tracker.suggestFirstSegmentWords());
+
+  for (uint i = 0; i < 9; i++) {
+    tracker.record(20);
+  }
+  tracker.record(5000);
+
+  // 90% of messages fit in the [16, 32) bucket, but none of them needed more than 20 words.
+  EXPECT_EQ(20u, tracker.suggestFirstSegmentWords());
+
+  tracker.record(5000);
+  EXPECT_EQ(5000u, tracker.suggestFirstSegmentWords());
+
+  // Within a bucket, the suggestion is interpolated rather than rounded up to the next power of
+  // two.
+  for (uint i = 0; i < 8; i++) {
+    tracker.record(4100);
+  }
+  tracker.record(8000);
+  EXPECT_EQ(7447u, tracker.suggestFirstSegmentWords());
+
+  // Old observations decay as new ones arrive.
+  for (uint i = 0; i < 1000; i++) {
+    tracker.record(300);
+  }
+  EXPECT_EQ(300u, tracker.suggestFirstSegmentWords());
+
+  // A single observation is reproduced exactly.
+  MessageSizeTracker single(100);
+  single.record(100);
+  EXPECT_EQ(100u, single.suggestFirstSegmentWords());
+}
+
+TEST(Message, MallocBuilderWithSizeTracker) {
+  MessageSizeTracker tracker(100, 8);
+
+  {
+    MallocMessageBuilder builder(tracker);
+    EXPECT_EQ(8u, builder.allocateSegment(1).size());
+    initTestMessage(builder.initRoot<TestAllTypes>());
+  }
+
+  // The builder recorded its final size, so the next one starts out big enough.
+  {
+    MallocMessageBuilder builder(tracker);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    EXPECT_EQ(1u, builder.getSegmentsForOutput().size());
+  }
+
+  // A builder that was never used records nothing.
+  uint suggestion = tracker.suggestFirstSegmentWords();
+  { MallocMessageBuilder builder(tracker); }
+  EXPECT_EQ(suggestion, tracker.suggestFirstSegmentWords());
+}
+
 // TODO(test):  More tests.
 
 }  // namespace
@@ -80,6 +80,62 @@ bool MessageReader::isCanonical() {
                                   .isCanonical(&readHead);
 }
 
+void compactMessage(MessageBuilder& message) {
+  if (!message.allocatedArena) {
+    // Nothing has been allocated yet, so there's nothing to compact.
+    return;
+  }
+
+  auto root = message.getRootInternal().asReader();
+  size_t size = root.targetSize().wordCount + POINTER_SIZE_IN_WORDS / WORDS;
+
+  auto segments = message.getSegmentsForOutput();
+  if (segments.size() == 1 && segments[0].size() == size) {
+    // Every word in the one segment is reachable, so the message is already compact.
+    return;
+  }
+
+  auto buffer = kj::heapArray<word>(size);
+  memset(buffer.asBytes().begin(), 0, buffer.asBytes().size());
+  FlatMessageBuilder compacted(buffer);
+  compacted.setRoot(root);
+  compacted.requireFilled();
+
+  message.arena()->replaceWith(*kj::implicitCast<MessageBuilder&>(compacted).arena());
+}
+
+
+void MessageReader::validate() {
+  if (!allocatedArena) {
+    static_assert(sizeof(_::ReaderArena) <= sizeof(arenaSpace),
+        "arenaSpace is too small to hold a ReaderArena.  Please increase it.  This will break "
+        "ABI compatibility.");
+    new(arena()) _::ReaderArena(this);
+    allocatedArena = true;
+  }
+
+  _::SegmentReader* segment = arena()->tryGetSegment(_::SegmentId(0));
+  KJ_REQUIRE(segment != nullptr &&
+             segment->containsInterval(segment->getStartPtr(), segment->getStartPtr() + 1),
+             "Message did not contain a root pointer.") {
+    return;
+  }
+
+  if (segment->isValidated()) return;
+
+  // Computing the total size visits every object in the message with all checks enabled.  When
+  // exceptions are disabled the checks don't unwind, so collect any failure here and only mark
+  // the message validated if there was none.
+  KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+    _::PointerReader::getRoot(segment, nullptr, segment->getStartPtr(), options.nestingLimit)
+        .targetSize();
+  })) {
+    kj::throwRecoverableException(kj::mv(*exception));
+    return;
+  }
+
+  arena()->markValidated();
+}
 
 AnyPointer::Reader MessageReader::getRootInternal() {
   if (!allocatedArena) {
@@ -196,6 +252,59 @@ kj::ArrayPtr<const word> SegmentArrayMessageReader::getSegment(uint id) {
 
 // -------------------------------------------------------------------
 
+constexpr uint MessageSizeTracker::BUCKET_COUNT;
+constexpr uint MessageSizeTracker::DECAY_INTERVAL;
+
+MessageSizeTracker::MessageSizeTracker(uint percentile, uint defaultWords)
+    : percentile(kj::min(kj::max(percentile, 1u), 100u)), defaultWords(defaultWords) {
+  memset(counts, 0, sizeof(counts));
+  memset(largest, 0, sizeof(largest));
+}
+
+uint MessageSizeTracker::suggestFirstSegmentWords() const {
+  if (total == 0) {
+    return defaultWords;
+  }
+
+  // Find the first bucket at which the running count reaches the percentile.
+  uint64_t threshold = (uint64_t(total) * percentile + 99) / 100;
+  uint64_t seen = 0;
+  for (uint i = 0; i < BUCKET_COUNT; i++) {
+    if (seen + counts[i] >= threshold) {
+      // Bucket i holds sizes in [2^i, 2^(i+1)).  Assume they're spread evenly across it, but don't
+      // suggest more than the biggest one we've actually seen.
+      uint64_t low = uint64_t(1) << i;
+      uint64_t estimate = low + low * (threshold - seen) / counts[i];
+      return kj::max(1u, uint(kj::min(estimate, uint64_t(largest[i]))));
+    }
+    seen += counts[i];
+  }
+
+  return defaultWords;
+}
+
+void MessageSizeTracker::record(size_t words) {
+  uint bucket = 0;
+  while (bucket + 1 < BUCKET_COUNT && (words >> (bucket + 1)) != 0) {
+    ++bucket;
+  }
+
+  ++counts[bucket];
+  largest[bucket] = kj::max(largest[bucket], uint(kj::min(words, size_t(kj::maxValue))));
+  if (++total >= DECAY_INTERVAL) {
+    total = 0;
+    for (uint i = 0; i < BUCKET_COUNT; i++) {
+      counts[i] /= 2;
+      if (counts[i] == 0) {
+        largest[i] = 0;
+      }
+      total += counts[i];
+    }
+  }
+}
+
+// -------------------------------------------------------------------
+
 struct MallocMessageBuilder::MoreSegments {
   std::vector<void*> segments;
 };
@@ -216,7 +325,23 @@ MallocMessageBuilder::MallocMessageBuilder(
           "First segment must be zeroed.");
 }
 
+MallocMessageBuilder::MallocMessageBuilder(
+    MessageSizeTracker& sizeTracker, AllocationStrategy allocationStrategy)
+    : nextSize(sizeTracker.suggestFirstSegmentWords()), allocationStrategy(allocationStrategy),
+      ownFirstSegment(true), returnedFirstSegment(false), firstSegment(nullptr),
+      sizeTracker(&sizeTracker) {}
+
 MallocMessageBuilder::~MallocMessageBuilder() noexcept(false) {
+  KJ_IF_MAYBE(tracker, sizeTracker) {
+    size_t words = 0;
+    for (auto& segment: getSegmentsForOutput()) {
+      words += segment.size();
+    }
+    if (words > 0) {
+      tracker->record(words);
+    }
+  }
+
   if (returnedFirstSegment) {
     if (ownFirstSegment) {
       free(firstSegment);
@@ -282,6 +407,132 @@ kj::ArrayPtr<word> MallocMessageBuilder::allocateSegment(uint minimumSize) {
 
 // -------------------------------------------------------------------
 
+struct MessageBuilderPool::SegmentHeader {
+  // Placed immediately before the words of each pooled segment, so that neither the pool nor its
+  // builders need any other storage to keep track of segments.
+
+  SegmentHeader* next;
+  size_t size;
+
+  kj::ArrayPtr<word> words() {
+    return kj::arrayPtr(reinterpret_cast<word*>(this + 1), size);
+  }
+};
+
+MessageBuilderPool::MessageBuilderPool(
+    uint maxCachedSegments, uint firstSegmentWords, AllocationStrategy allocationStrategy)
+    : maxCachedSegments(maxCachedSegments), firstSegmentWords(firstSegmentWords),
+      allocationStrategy(allocationStrategy), stats({0, 0, 0, 0}) {}
+
+MessageBuilderPool::~MessageBuilderPool() noexcept(false) {
+  while (cached != nullptr) {
+    SegmentHeader* next = cached->next;
+    free(cached);
+    cached = next;
+  }
+}
+
+MessageBuilderPool::Stats MessageBuilderPool::getStats() const {
+  return stats;
+}
+
+MessageBuilderPool::SegmentHeader* MessageBuilderPool::take(
+    uint minimumSize, uint preferredSize) {
+  static_assert(sizeof(SegmentHeader) % sizeof(word) == 0,
+                "SegmentHeader must be a whole number of words to keep segments aligned.");
+
+  if (cached != nullptr && cached->size >= minimumSize) {
+    // Hand out the largest segment we have even if it's bigger than preferred: it's already
+    // zeroed, and a bigger segment means fewer segments later.
+    SegmentHeader* result = cached;
+    cached = result->next;
+    result->next = nullptr;
+    ++stats.hits;
+    --stats.cachedSegments;
+    stats.cachedWords -= result->size;
+    return result;
+  }
+
+  ++stats.misses;
+  size_t size = kj::max(minimumSize, preferredSize);
+  void* result = calloc(size * sizeof(word) + sizeof(SegmentHeader), 1);
+  if (result == nullptr) {
+    KJ_FAIL_SYSCALL("calloc(size * sizeof(word) + sizeof(SegmentHeader), 1)", ENOMEM, size);
+  }
+  SegmentHeader* header = reinterpret_cast<SegmentHeader*>(result);
+  header->size = size;
+  return header;
+}
+
+void MessageBuilderPool::giveBack(SegmentHeader* list) {
+  while (list != nullptr) {
+    SegmentHeader* segment = list;
+    list = list->next;
+
+    // Insert in order, largest first.
+    SegmentHeader** pos = &cached;
+    while (*pos != nullptr && (*pos)->size >= segment->size) {
+      pos = &(*pos)->next;
+    }
+    segment->next = *pos;
+    *pos = segment;
+    ++stats.cachedSegments;
+    stats.cachedWords += segment->size;
+  }
+
+  // Drop the smallest segments beyond the limit.
+  SegmentHeader** pos = &cached;
+  for (uint i = 0; i < maxCachedSegments && *pos != nullptr; i++) {
+    pos = &(*pos)->next;
+  }
+  SegmentHeader* excess = *pos;
+  *pos = nullptr;
+  while (excess != nullptr) {
+    SegmentHeader* next = excess->next;
+    --stats.cachedSegments;
+    stats.cachedWords -= excess->size;
+    free(excess);
+    excess = next;
+  }
+}
+
+PooledMessageBuilder::PooledMessageBuilder(MessageBuilderPool& pool)
+    : pool(pool), nextSize(pool.firstSegmentWords) {}
+
+PooledMessageBuilder::~PooledMessageBuilder() noexcept(false) {
+  if (segments == nullptr) return;
+
+  // Zero out exactly the words that were used, so that the segments can be handed out again.
+  // Output segments that aren't ours (e.g. external data) are skipped.
+  for (auto output: getSegmentsForOutput()) {
+    for (auto segment = segments; segment != nullptr; segment = segment->next) {
+      if (segment->words().begin() == output.begin()) {
+        memset(segment->words().asBytes().begin(), 0, output.size() * sizeof(word));
+        break;
+      }
+    }
+  }
+
+  pool.giveBack(segments);
+}
+
+kj::ArrayPtr<word> PooledMessageBuilder::allocateSegment(uint minimumSize) {
+  MessageBuilderPool::SegmentHeader* segment = pool.take(minimumSize, nextSize);
+  uint size = segment->size;
+
+  if (pool.allocationStrategy == AllocationStrategy::GROW_HEURISTICALLY) {
+    // Same as MallocMessageBuilder:  After the first segment, nextSize equals the total size
+    // allocated so far.
+    nextSize = segments == nullptr ? size : nextSize + size;
+  }
+
+  segment->next = segments;
+  segments = segment;
+  return segment->words();
+}
+
+// -------------------------------------------------------------------
+
 FlatMessageBuilder::FlatMessageBuilder(kj::ArrayPtr<word> array): array(array), allocated(false) {}
 FlatMessageBuilder::~FlatMessageBuilder() noexcept(false) {}
 
@@ -83,6 +83,21 @@ struct ReaderOptions {
   // stack overflow, yet high enough that it is never a problem in practice.
 };
 
+class ReaderSegmentAllocator {
+  // Supplies the memory into which stream-based readers (`InputStreamMessageReader`,
+  // `StreamFdMessageReader`, and the async `readMessage()`) read each segment of an incoming
+  // message.  By default those readers read the whole message into a single contiguous buffer;
+  // given an allocator, they instead allocate every segment separately and fill them all with a
+  // single scatter read, so that a large multi-segment message never needs one giant allocation.
+
+public:
+  virtual kj::Array<word> allocateSegment(uint size) = 0;
+  // Allocate space for a segment of exactly `size` words.  The returned array is destroyed when
+  // the MessageReader that requested it is destroyed, so an implementation that pools segments
+  // can use a custom `kj::ArrayDisposer` to find out when the space is free again.  The contents
+  // need not be initialized; they will be overwritten by the read.
+};
+
 class MessageReader {
   // Abstract interface for an object used to read a Cap'n Proto message.  Subclasses of
   // MessageReader are responsible for reading the raw, flat message content.  Callers should
@@ -122,6 +137,19 @@ public:
   bool isCanonical();
   // Returns whether the message encoded in the reader is in canonical form.
 
+  void validate();
+  // Traverses the whole message once, starting from the root, checking every pointer for
+  // out-of-bounds targets, unknown far pointer segments, and cycles (via the nesting and
+  // traversal limits in ReaderOptions).  Throws if the message is invalid.  On success, all
+  // subsequent reads from this message skip per-pointer bounds checks and no longer count against
+  // the traversal limit, which makes repeated reads of long-lived messages -- e.g. in an in-memory
+  // cache -- considerably cheaper.
+  //
+  // Checks that do not depend on the message's layout in memory, such as type mismatches between
+  // a pointer and the schema, are still performed on each read.  Call this before the reader is
+  // shared between threads.  Only use this for messages from a trusted source, since limits on
+  // "amplified" reads of zero-sized list elements are also skipped afterwards.
+
 private:
   ReaderOptions options;
 
@@ -244,6 +272,8 @@ private:
   _::BuilderArena* arena() { return reinterpret_cast<_::BuilderArena*>(arenaSpace); }
   _::SegmentBuilder* getRootSegment();
   AnyPointer::Builder getRootInternal();
+
+  friend void compactMessage(MessageBuilder& message);
 };
 
 template <typename RootType>
@@ -278,6 +308,17 @@ void copyToUnchecked(Reader&& reader, kj::ArrayPtr<word> uncheckedBuffer);
 // readMessageUnchecked().  The buffer's size must be exactly reader.totalSizeInWords() + 1,
 // otherwise an exception will be thrown.  The buffer must be zero'd before calling.
 
+void compactMessage(MessageBuilder& message);
+// Rewrite the message so that it consists of a single segment containing only the objects
+// reachable from the root, laid out contiguously.  Space left behind by discarded orphans,
+// overwritten pointers, or resized lists is dropped, as are any far pointers.  Does nothing if the
+// message is already a single segment with no unreachable words.
+//
+// The message is rebuilt in its existing first segment when it is big enough; otherwise a new
+// segment is allocated.  Memory for the segments that are no longer used is not released until
+// the MessageBuilder is destroyed.  All existing Builders, Readers, and Orphans pointing into the
+// message are invalidated.
+
 template <typename RootType>
 typename RootType::Reader readDataStruct(kj::ArrayPtr<const word> data);
 // Interprets the given data as a single, data-only struct. Only primitive fields (booleans,
@@ -346,6 +387,39 @@ enum class AllocationStrategy: uint8_t {
 constexpr uint SUGGESTED_FIRST_SEGMENT_WORDS = 1024;
 constexpr AllocationStrategy SUGGESTED_ALLOCATION_STRATEGY = AllocationStrategy::GROW_HEURISTICALLY;
 
+class MessageSizeTracker {
+  // Learns a good first segment size for a family of similar messages -- e.g. all messages built
+  // at one call site, or all requests to one method -- from the sizes those messages actually
+  // ended up with.  Pass one to MallocMessageBuilder's constructor instead of guessing
+  // `firstSegmentWords`.
+  //
+  // Recent sizes are kept in a histogram of power-of-two buckets whose counts are halved
+  // periodically, so old observations fade out and the suggestion follows the workload.  The
+  // suggested size is interpolated within the bucket containing the chosen percentile, and never
+  // exceeds the largest size recorded in that bucket.  Not thread-safe.
+
+public:
+  explicit MessageSizeTracker(uint percentile = 95,
+                              uint defaultWords = SUGGESTED_FIRST_SEGMENT_WORDS);
+  // `defaultWords` is suggested until the first size has been recorded.
+
+  uint suggestFirstSegmentWords() const;
+
+  void record(size_t words);
+  // Record the final size of a message (all segments, in words).
+
+private:
+  static constexpr uint BUCKET_COUNT = 32;
+  static constexpr uint DECAY_INTERVAL = 256;
+
+  uint percentile;
+  uint defaultWords;
+  uint total = 0;
+  uint counts[BUCKET_COUNT];
+  uint largest[BUCKET_COUNT];
+  // Largest size recorded in each bucket since it was last empty.
+};
+
 class MallocMessageBuilder: public MessageBuilder {
   // A simple MessageBuilder that uses malloc() (actually, calloc()) to allocate segments.  This
   // implementation should be reasonable for any case that doesn't require writing the message to
@@ -375,6 +449,11 @@ public:
   // firstSegment MUST be zero-initialized.  MallocMessageBuilder's destructor will write new zeros
   // over any space that was used so that it can be reused.
 
+  explicit MallocMessageBuilder(MessageSizeTracker& sizeTracker,
+      AllocationStrategy allocationStrategy = SUGGESTED_ALLOCATION_STRATEGY);
+  // This version asks `sizeTracker` for the first segment size, and records the message's final
+  // size with it on destruction.  `sizeTracker` must outlive the builder.
+
   KJ_DISALLOW_COPY(MallocMessageBuilder);
   virtual ~MallocMessageBuilder() noexcept(false);
 
@@ -389,10 +468,84 @@ private:
 
   void* firstSegment;
 
+  MessageSizeTracker* sizeTracker = nullptr;
+
   struct MoreSegments;
   kj::Maybe<kj::Own<MoreSegments>> moreSegments;
 };
 
+class MessageBuilderPool {
+  // A cache of zeroed segments which `PooledMessageBuilder`s draw from and give back, so that an
+  // application building many messages one after another reaches a steady state in which building
+  // a message performs no heap allocation at all.  When a `PooledMessageBuilder` is destroyed, it
+  // zeros only the words that its message actually used and returns its segments to the pool,
+  // which keeps the largest ones, up to a limit, for later builders.
+  //
+  // A pool is not thread-safe.  Keep one per thread (or per event loop).  All builders drawing
+  // from the pool must be destroyed before the pool is.
+
+public:
+  explicit MessageBuilderPool(uint maxCachedSegments = 4,
+      uint firstSegmentWords = SUGGESTED_FIRST_SEGMENT_WORDS,
+      AllocationStrategy allocationStrategy = SUGGESTED_ALLOCATION_STRATEGY);
+  // `maxCachedSegments` bounds how many segments the pool holds on to while no builder is using
+  // them.  The other parameters have the same meaning as for `MallocMessageBuilder` and apply
+  // whenever a builder needs a segment that the pool can't supply.
+
+  KJ_DISALLOW_COPY(MessageBuilderPool);
+  ~MessageBuilderPool() noexcept(false);
+
+  struct Stats {
+    uint64_t hits;
+    // Number of segment allocations satisfied from the cache.
+
+    uint64_t misses;
+    // Number of segment allocations that had to fall back to calloc().
+
+    uint cachedSegments;
+    size_t cachedWords;
+    // Segments currently held by the pool and their total size.
+  };
+
+  Stats getStats() const;
+
+private:
+  struct SegmentHeader;
+
+  uint maxCachedSegments;
+  uint firstSegmentWords;
+  AllocationStrategy allocationStrategy;
+
+  SegmentHeader* cached = nullptr;
+  // Linked list of cached segments, largest first.
+
+  Stats stats;
+
+  SegmentHeader* take(uint minimumSize, uint preferredSize);
+  void giveBack(SegmentHeader* list);
+
+  friend class PooledMessageBuilder;
+};
+
+class PooledMessageBuilder: public MessageBuilder {
+  // A MessageBuilder which takes its segments from a `MessageBuilderPool` and returns them,
+  // re-zeroed, when destroyed.  Otherwise behaves like `MallocMessageBuilder`.
+
+public:
+  explicit PooledMessageBuilder(MessageBuilderPool& pool);
+  KJ_DISALLOW_COPY(PooledMessageBuilder);
+  virtual ~PooledMessageBuilder() noexcept(false);
+
+  virtual kj::ArrayPtr<word> allocateSegment(uint minimumSize) override;
+
+private:
+  MessageBuilderPool& pool;
+  uint nextSize;
+
+  MessageBuilderPool::SegmentHeader* segments = nullptr;
+  // Segments allocated so far, most recent first.
+};
+
 class FlatMessageBuilder: public MessageBuilder {
   // THIS IS NOT THE CLASS YOU'RE LOOKING FOR.
   //
@@ -1026,6 +1026,74 @@ TEST(Orphans, ReferenceExternalData_NoZeroImmediateAbandon) {
   }
 }
 
+TEST(Orphans, ReferenceExternal) {
+  MallocMessageBuilder source;
+  {
+    auto root = source.initRoot<TestAllTypes>();
+    root.setTextField("not referenced");
+    initTestMessage(root.initStructField());
+  }
+  ASSERT_EQ(1u, source.getSegmentsForOutput().size());
+  auto sourceSegment = source.getSegmentsForOutput()[0];
+  auto sourceWords = kj::heapArray<word>(sourceSegment);
+  kj::ArrayPtr<const word> sourceSegments[1] = { sourceWords.asPtr() };
+  SegmentArrayMessageReader reader(sourceSegments);
+
+  MallocMessageBuilder builder;
+  auto orphanage = builder.getOrphanage();
+  auto orphan = orphanage.referenceExternal(reader.getRoot<TestAllTypes>().getStructField());
+
+  // The struct's part of the source segment was added as a new segment.
+  {
+    auto segments = builder.getSegmentsForOutput();
+    ASSERT_EQ(2u, segments.size());
+    EXPECT_TRUE(segments[1].begin() >= sourceWords.begin());
+    EXPECT_TRUE(segments[1].end() <= sourceWords.end());
+    EXPECT_LT(segments[1].size(), sourceWords.size());
+  }
+
+  EXPECT_ANY_THROW(orphan.get());
+  checkTestMessage(orphan.getReader());
+
+  auto root = builder.initRoot<TestAllTypes>();
+  root.adoptStructField(kj::mv(orphan));
+  root.adoptStructList(orphanage.referenceExternal(
+      reader.getRoot<TestAllTypes>().getStructField().getStructList()));
+  root.adoptTextList(orphanage.referenceExternal(
+      reader.getRoot<TestAllTypes>().getStructField().getTextList()));
+  EXPECT_EQ(4u, builder.getSegmentsForOutput().size());
+
+  EXPECT_ANY_THROW(root.getStructField());
+  checkTestMessage(root.asReader().getStructField());
+  EXPECT_EQ("structlist 2", root.asReader().getStructList()[1].getTextField());
+  checkList(root.asReader().getTextList(), {"plugh", "xyzzy", "thud"});
+
+  // The written-out message is self-contained.
+  {
+    SegmentArrayMessageReader output(builder.getSegmentsForOutput());
+    checkTestMessage(output.getRoot<TestAllTypes>().getStructField());
+  }
+
+  // Overwriting or abandoning external objects doesn't touch the source.
+  root.initStructField();
+  root.disownStructList();
+  EXPECT_EQ(0, memcmp(sourceWords.begin(), sourceSegment.begin(),
+                      sourceWords.asBytes().size()));
+}
+
+TEST(Orphans, ReferenceExternalFallsBackToCopy) {
+  // A multi-segment source has far pointers, so its objects can't be referenced in place.
+  MallocMessageBuilder source(0, AllocationStrategy::FIXED_SIZE);
+  initTestMessage(source.initRoot<TestAllTypes>());
+  ASSERT_GT(source.getSegmentsForOutput().size(), 2u);
+  SegmentArrayMessageReader reader(source.getSegmentsForOutput());
+
+  MallocMessageBuilder builder;
+  auto orphan = builder.getOrphanage().referenceExternal(reader.getRoot<TestAllTypes>());
+  EXPECT_EQ(1u, builder.getSegmentsForOutput().size());
+  checkTestMessage(orphan.get());
+}
+
 TEST(Orphans, TruncateData) {
   MallocMessageBuilder message;
   auto orphan = message.getOrphanage().newOrphan<Data>(17);
@@ -175,6 +175,22 @@ public:
   // into the message tree without copying it.  This is particularly useful when referencing very
   // large blobs, such as whole mmap'd files.
 
+  template <typename Reader>
+  Orphan<FromReader<Reader>> referenceExternal(Reader reader) const;
+  // Like referenceExternalData(), but for a struct or list read from another message:  creates an
+  // orphan that refers to the object where it already lies, without copying it.  The words of the
+  // other message's segment spanned by the object and everything reachable from it become a new
+  // segment of this message, and so are written out as-is (e.g. by writeMessage()'s gather write)
+  // when this message is.  The same SEVERE restrictions apply:
+  // - The other message's memory must remain valid until this `MessageBuilder` is destroyed.
+  // - You cannot obtain a Builder for the object or anything inside it.
+  // - Any words that lie between the object's parts in the other message are written out too, so
+  //   the other message must not contain anything that the recipient of this one shouldn't see.
+  //
+  // If the object isn't contained in one segment of the other message (i.e. it is reached through
+  // far pointers), contains capabilities, or comes from this same message, it is copied instead,
+  // exactly as by newOrphanCopy().
+
 private:
   _::BuilderArena* arena;
   _::CapTableBuilder* capTable;
@@ -411,6 +427,15 @@ inline Orphan<FromReader<Reader>> Orphanage::newOrphanCopy(Reader copyFrom) cons
       arena, capTable, GetInnerReader<FromReader<Reader>>::apply(copyFrom)));
 }
 
+template <typename Reader>
+inline Orphan<FromReader<Reader>> Orphanage::referenceExternal(Reader reader) const {
+  static_assert(kind<FromReader<Reader>>() == Kind::STRUCT ||
+                kind<FromReader<Reader>>() == Kind::LIST,
+                "referenceExternal() takes a struct or list; see referenceExternalData() for Data.");
+  return Orphan<FromReader<Reader>>(_::OrphanBuilder::referenceExternal(
+      arena, capTable, GetInnerReader<FromReader<Reader>>::apply(reader)));
+}
+
 template <typename T>
 inline Orphan<List<ListElementType<FromReader<T>>>>
 Orphanage::newOrphanConcat(kj::ArrayPtr<T> lists) const {
@@ -24,6 +24,7 @@
 #include <capnp/rpc.capnp.h>
 #include <kj/debug.h>
 #include <kj/thread.h>
+#include <kj/vector.h>
 #include <kj/compat/gtest.h>
 
 // TODO(cleanup): Auto-generate stringification functions for union discriminants.
@@ -68,11 +69,15 @@ private:
 };
 
 kj::AsyncIoProvider::PipeThread runServer(kj::AsyncIoProvider& ioProvider,
-                                          int& callCount, int& handleCount) {
+                                          int& callCount, int& handleCount,
+                                          bool packed = false) {
   return ioProvider.newPipeThread(
-      [&callCount, &handleCount](
+      [&callCount, &handleCount, packed](
        kj::AsyncIoProvider& ioProvider, kj::AsyncIoStream& stream, kj::WaitScope& waitScope) {
     TwoPartyVatNetwork network(stream, rpc::twoparty::Side::SERVER);
+    if (packed) {
+      network.usePackedEncoding();
+    }
     TestRestorer restorer(callCount, handleCount);
     auto server = makeRpcServer(network, restorer);
     network.onDisconnect().wait(waitScope);
@@ -141,6 +146,69 @@ TEST(TwoPartyNetwork, Basic) {
   EXPECT_TRUE(barFailed);
 }
 
+TEST(TwoPartyNetwork, BufferedReads) {
+  auto ioContext = kj::setupAsyncIo();
+  int callCount = 0;
+  int handleCount = 0;
+
+  auto serverThread = runServer(*ioContext.provider, callCount, handleCount);
+  TwoPartyVatNetwork network(*serverThread.pipe, rpc::twoparty::Side::CLIENT);
+  network.useBufferedReads(512);
+  auto rpcClient = makeRpcClient(network);
+
+  auto client = getPersistentCap(rpcClient, rpc::twoparty::Side::SERVER,
+      test::TestSturdyRefObjectId::Tag::TEST_INTERFACE).castAs<test::TestInterface>();
+
+  // Send a batch of calls so that several responses are likely to arrive in one read.
+  kj::Vector<RemotePromise<test::TestInterface::FooResults>> promises;
+  for (uint i = 0; i < 20; i++) {
+    auto request = client.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    promises.add(request.send());
+  }
+
+  auto request2 = client.bazRequest();
+  initTestMessage(request2.initS());
+  auto promise2 = request2.send();
+
+  for (auto& promise: promises) {
+    EXPECT_EQ("foo", promise.wait(ioContext.waitScope).getX());
+  }
+  promise2.wait(ioContext.waitScope);
+
+  EXPECT_EQ(21, callCount);
+}
+
+TEST(TwoPartyNetwork, PackedEncoding) {
+  auto ioContext = kj::setupAsyncIo();
+  int callCount = 0;
+  int handleCount = 0;
+
+  auto serverThread = runServer(*ioContext.provider, callCount, handleCount, true);
+  TwoPartyVatNetwork network(*serverThread.pipe, rpc::twoparty::Side::CLIENT);
+  network.usePackedEncoding();
+  network.useBufferedReads(512);
+  auto rpcClient = makeRpcClient(network);
+
+  auto client = getPersistentCap(rpcClient, rpc::twoparty::Side::SERVER,
+      test::TestSturdyRefObjectId::Tag::TEST_INTERFACE).castAs<test::TestInterface>();
+
+  auto request1 = client.fooRequest();
+  request1.setI(123);
+  request1.setJ(true);
+  auto promise1 = request1.send();
+
+  auto request2 = client.bazRequest();
+  initTestMessage(request2.initS());
+  auto promise2 = request2.send();
+
+  EXPECT_EQ("foo", promise1.wait(ioContext.waitScope).getX());
+  promise2.wait(ioContext.waitScope);
+
+  EXPECT_EQ(2, callCount);
+}
+
 TEST(TwoPartyNetwork, Pipelining) {
   auto ioContext = kj::setupAsyncIo();
   int callCount = 0;
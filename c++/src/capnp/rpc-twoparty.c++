@@ -82,10 +82,7 @@ public:
   }
 
   void send() override {
-    size_t size = 0;
-    for (auto& segment: message.getSegmentsForOutput()) {
-      size += segment.size();
-    }
+    size_t size = sizeInWords();
     KJ_REQUIRE(size < ReaderOptions().traversalLimitInWords, size,
                "Trying to send Cap'n Proto message larger than the single-message size limit. The "
                "other side probably won't accept it and would abort the connection, so I won't "
@@ -98,7 +95,11 @@ public:
       // Note that if the write fails, all further writes will be skipped due to the exception.
       // We never actually handle this exception because we assume the read end will fail as well
       // and it's cleaner to handle the failure there.
-      return writeMessage(network.stream, message);
+      if (network.packed) {
+        return writePackedMessage(network.stream, message);
+      } else {
+        return writeMessage(network.stream, message);
+      }
     }).attach(kj::addRef(*this))
       // Note that it's important that the eagerlyEvaluate() come *after* the attach() because
       // otherwise the message (and any capabilities in it) will not be released until a new
@@ -106,6 +107,14 @@ public:
       .eagerlyEvaluate(nullptr);
   }
 
+  size_t sizeInWords() override {
+    size_t size = 0;
+    for (auto& segment: message.getSegmentsForOutput()) {
+      size += segment.size();
+    }
+    return size;
+  }
+
 private:
   TwoPartyVatNetwork& network;
   MallocMessageBuilder message;
@@ -131,10 +140,36 @@ kj::Own<OutgoingRpcMessage> TwoPartyVatNetwork::newOutgoingMessage(uint firstSeg
   return kj::refcounted<OutgoingMessageImpl>(*this, firstSegmentWordSize);
 }
 
+void TwoPartyVatNetwork::useBufferedReads(uint bufferWords) {
+  readBufferWords = bufferWords;
+}
+
+void TwoPartyVatNetwork::usePackedEncoding() {
+  packed = true;
+}
+
 kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> TwoPartyVatNetwork::receiveIncomingMessage() {
   return kj::evalLater([&]() {
-    return tryReadMessage(stream, receiveOptions)
-        .then([&](kj::Maybe<kj::Own<MessageReader>>&& message)
+    kj::AsyncInputStream* input = &stream;
+    if (packed) {
+      if (packedInput == nullptr) {
+        packedInput = kj::heap<AsyncPackedInputStream>(stream);
+      }
+      input = KJ_ASSERT_NONNULL(packedInput).get();
+    }
+
+    if (readBufferWords > 0 && bufferedInput == nullptr) {
+      bufferedInput = kj::heap<BufferedMessageStream>(*input, receiveOptions, readBufferWords);
+    }
+
+    kj::Promise<kj::Maybe<kj::Own<MessageReader>>> readPromise = nullptr;
+    KJ_IF_MAYBE(buffered, bufferedInput) {
+      readPromise = (*buffered)->tryReadMessage();
+    } else {
+      readPromise = tryReadMessage(*input, receiveOptions);
+    }
+
+    return readPromise.then([&](kj::Maybe<kj::Own<MessageReader>>&& message)
               -> kj::Maybe<kj::Own<IncomingRpcMessage>> {
       KJ_IF_MAYBE(m, message) {
         return kj::Own<IncomingRpcMessage>(kj::heap<IncomingMessageImpl>(kj::mv(*m)));
@@ -28,6 +28,7 @@
 
 #include "rpc.h"
 #include "message.h"
+#include "serialize-async.h"
 #include <kj/async-io.h>
 #include <capnp/rpc-twoparty.capnp.h>
 
@@ -61,6 +62,17 @@ public:
 
   rpc::twoparty::Side getSide() { return side; }
 
+  void useBufferedReads(uint bufferWords = BufferedMessageStream::DEFAULT_BUFFER_WORDS);
+  // Receive messages through a `BufferedMessageStream`, which reads the stream in large chunks
+  // and parses small messages out of them without copying.  This saves several syscalls per
+  // message on busy connections, but each received message keeps the chunk it was read into
+  // alive until the message is released.  Must be called before any message is received.
+
+  void usePackedEncoding();
+  // Send and receive all messages in the packed format (see serialize-packed.h), which trades
+  // some CPU time for less bandwidth.  Both ends of the connection must agree on this, so it must
+  // be called on both before any message is sent or received.
+
   // implements VatNetwork -----------------------------------------------------
 
   kj::Maybe<kj::Own<TwoPartyVatNetworkBase::Connection>> connect(
@@ -77,6 +89,16 @@ private:
   ReaderOptions receiveOptions;
   bool accepted = false;
 
+  uint readBufferWords = 0;
+  // Set by useBufferedReads().
+
+  bool packed = false;
+  // Set by usePackedEncoding().
+
+  kj::Maybe<kj::Own<AsyncPackedInputStream>> packedInput;
+  kj::Maybe<kj::Own<BufferedMessageStream>> bufferedInput;
+  // Created when the first message is received, according to the options above.
+
   kj::Maybe<kj::Promise<void>> previousWrite;
   // Resolves when the previous write completes.  This effectively serves as the write queue.
   // Becomes null when shutdown() is called.
@@ -67,6 +67,34 @@ uint firstSegmentSize(kj::Maybe<MessageSize> sizeHint, uint additional) {
   }
 }
 
+kj::Maybe<MessageSizeTracker&> unhintedSizeTracker(
+    std::map<std::pair<uint64_t, uint16_t>, MessageSizeTracker>& trackers,
+    uint64_t interfaceId, uint16_t methodId, kj::Maybe<MessageSize> sizeHint) {
+  // Messages built without a size hint are sized from earlier messages for the same method.
+  if (sizeHint == nullptr) {
+    return trackers[std::make_pair(interfaceId, methodId)];
+  } else {
+    return nullptr;
+  }
+}
+
+uint firstSegmentSize(kj::Maybe<MessageSizeTracker&> sizeTracker,
+                      kj::Maybe<MessageSize> sizeHint, uint additional) {
+  KJ_IF_MAYBE(t, sizeTracker) {
+    return t->suggestFirstSegmentWords();
+  } else {
+    return firstSegmentSize(sizeHint, additional);
+  }
+}
+
+void recordSize(MessageSizeTracker& sizeTracker, OutgoingRpcMessage& message) {
+  // A size of zero means the VatNetwork doesn't know the message's size.
+  size_t words = message.sizeInWords();
+  if (words > 0) {
+    sizeTracker.record(words);
+  }
+}
+
 kj::Maybe<kj::Array<PipelineOp>> toPipelineOps(List<rpc::PromisedAnswer::Op>::Reader ops) {
   auto result = kj::heapArrayBuilder<PipelineOp>(ops.size());
   for (auto opReader: ops) {
@@ -558,6 +586,12 @@ private:
   size_t flowLimit;
   size_t callWordsInFlight = 0;
 
+  std::map<std::pair<uint64_t, uint16_t>, MessageSizeTracker> unhintedCallSizes;
+  std::map<std::pair<uint64_t, uint16_t>, MessageSizeTracker> unhintedReturnSizes;
+  // Final sizes of calls and returns that were built without a size hint, per method, used to
+  // size the next such message.  Calls and returns are tracked separately since their sizes are
+  // unrelated.
+
   kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> flowWaiter;
   // If non-null, we're currently blocking incoming messages waiting for callWordsInFlight to drop
   // below flowLimit. Fulfill this to un-block.
@@ -642,7 +676,7 @@ private:
 
       auto request = kj::heap<RpcRequest>(
           *connectionState, *connectionState->connection.get<Connected>(),
-          sizeHint, kj::addRef(*this));
+          interfaceId, methodId, sizeHint, kj::addRef(*this));
       auto callBuilder = request->getCall();
 
       callBuilder.setInterfaceId(interfaceId);
@@ -1381,12 +1415,15 @@ private:
   class RpcRequest final: public RequestHook {
   public:
     RpcRequest(RpcConnectionState& connectionState, VatNetworkBase::Connection& connection,
+               uint64_t interfaceId, uint16_t methodId,
                kj::Maybe<MessageSize> sizeHint, kj::Own<RpcClient>&& target)
         : connectionState(kj::addRef(connectionState)),
           target(kj::mv(target)),
-          message(connection.newOutgoingMessage(
-              firstSegmentSize(sizeHint, messageSizeHint<rpc::Call>() +
-                  sizeInWords<rpc::Payload>() + MESSAGE_TARGET_SIZE_HINT))),
+          sizeTracker(unhintedSizeTracker(connectionState.unhintedCallSizes,
+                                          interfaceId, methodId, sizeHint)),
+          message(connection.newOutgoingMessage(firstSegmentSize(sizeTracker, sizeHint,
+              messageSizeHint<rpc::Call>() + sizeInWords<rpc::Payload>() +
+              MESSAGE_TARGET_SIZE_HINT))),
           callBuilder(message->getBody().getAs<rpc::Message>().initCall()),
           paramsBuilder(capTable.imbue(callBuilder.getParams().getContent())) {}
 
@@ -1482,6 +1519,8 @@ private:
     kj::Own<RpcConnectionState> connectionState;
 
     kj::Own<RpcClient> target;
+    kj::Maybe<MessageSizeTracker&> sizeTracker;
+    // Records the final size if the call was built without a size hint.
     kj::Own<OutgoingRpcMessage> message;
     BuilderCapabilityTable capTable;
     rpc::Call::Builder callBuilder;
@@ -1517,6 +1556,9 @@ private:
         KJ_LOG(WARNING, *exception);
         kj::throwRecoverableException(kj::mv(*exception));
       }
+      KJ_IF_MAYBE(t, sizeTracker) {
+        recordSize(*t, *message);
+      }
 
       // Make the result promise.
       SendInternalResult result;
@@ -1670,10 +1712,12 @@ private:
   public:
     RpcServerResponseImpl(RpcConnectionState& connectionState,
                           kj::Own<OutgoingRpcMessage>&& message,
-                          rpc::Payload::Builder payload)
+                          rpc::Payload::Builder payload,
+                          kj::Maybe<MessageSizeTracker&> sizeTracker)
         : connectionState(connectionState),
           message(kj::mv(message)),
-          payload(payload) {}
+          payload(payload),
+          sizeTracker(sizeTracker) {}
 
     AnyPointer::Builder getResultsBuilder() override {
       return capTable.imbue(payload.getContent());
@@ -1699,6 +1743,9 @@ private:
       }
 
       message->send();
+      KJ_IF_MAYBE(t, sizeTracker) {
+        recordSize(*t, *message);
+      }
       if (capTable.size() == 0) {
         return nullptr;
       } else {
@@ -1711,6 +1758,8 @@ private:
     kj::Own<OutgoingRpcMessage> message;
     BuilderCapabilityTable capTable;
     rpc::Payload::Builder payload;
+    kj::Maybe<MessageSizeTracker&> sizeTracker;
+    // Records the final size if the results were built without a size hint.
   };
 
   class LocallyRedirectedRpcResponse final
@@ -1890,12 +1939,14 @@ private:
         if (redirectResults || !connectionState->connection.is<Connected>()) {
           response = kj::refcounted<LocallyRedirectedRpcResponse>(sizeHint);
         } else {
+          auto sizeTracker = unhintedSizeTracker(connectionState->unhintedReturnSizes,
+                                                 interfaceId, methodId, sizeHint);
           auto message = connectionState->connection.get<Connected>()->newOutgoingMessage(
-              firstSegmentSize(sizeHint, messageSizeHint<rpc::Return>() +
-                               sizeInWords<rpc::Payload>()));
+              firstSegmentSize(sizeTracker, sizeHint,
+                               messageSizeHint<rpc::Return>() + sizeInWords<rpc::Payload>()));
           returnMessage = message->getBody().initAs<rpc::Message>().initReturn();
           response = kj::heap<RpcServerResponseImpl>(
-              *connectionState, kj::mv(message), returnMessage.getResults());
+              *connectionState, kj::mv(message), returnMessage.getResults(), sizeTracker);
         }
 
         auto results = response->getResultsBuilder();
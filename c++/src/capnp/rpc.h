@@ -277,6 +277,13 @@ public:
   virtual void send() = 0;
   // Send the message, or at least put it in a queue to be sent later.  Note that the builder
   // returned by `getBody()` remains valid at least until the `OutgoingRpcMessage` is destroyed.
+
+  virtual size_t sizeInWords() { return 0; }
+  // Get the size of the message in words, as it will be (or was) written out, i.e. the total
+  // size of the segments returned by `MessageBuilder::getSegmentsForOutput()`.  The RPC system
+  // uses this to learn how big to make future messages.  Implementations can usually just add up
+  // their segment sizes, which is much cheaper than walking the body.  The default returns 0,
+  // meaning "unknown", in which case messages built without a size hint get a default size.
 };
 
 class IncomingRpcMessage {
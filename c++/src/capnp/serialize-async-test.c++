@@ -21,8 +21,10 @@
 
 #include "serialize-async.h"
 #include "serialize.h"
+#include "serialize-packed.h"
 #include <kj/debug.h>
 #include <kj/thread.h>
+#include <kj/vector.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -218,6 +220,37 @@ TEST(SerializeAsyncTest, ParseAsync) {
   checkTestMessage(received->getRoot<TestAllTypes>());
 }
 
+class CountingSegmentAllocator: public ReaderSegmentAllocator {
+public:
+  kj::Array<word> allocateSegment(uint size) override {
+    ++count;
+    return kj::heapArray<word>(size);
+  }
+
+  uint count = 0;
+};
+
+TEST(SerializeAsyncTest, ParseAsyncSegmentAllocator) {
+  PipeWithSmallBuffer fds;
+  auto ioContext = kj::setupAsyncIo();
+  auto input = ioContext.lowLevelProvider->wrapInputFd(fds[0]);
+  SocketOutputStream rawOutput(fds[1]);
+  FragmentingOutputStream output(rawOutput);
+
+  TestMessageBuilder message(7);
+  initTestMessage(message.getRoot<TestAllTypes>());
+
+  kj::Thread thread([&]() {
+    writeMessage(output, message);
+  });
+
+  CountingSegmentAllocator allocator;
+  auto received = readMessage(*input, ReaderOptions(), allocator).wait(ioContext.waitScope);
+
+  checkTestMessage(received->getRoot<TestAllTypes>());
+  EXPECT_EQ(7u, allocator.count);
+}
+
 TEST(SerializeAsyncTest, ParseAsyncOddSegmentCount) {
   PipeWithSmallBuffer fds;
   auto ioContext = kj::setupAsyncIo();
@@ -256,6 +289,163 @@ TEST(SerializeAsyncTest, ParseAsyncEvenSegmentCount) {
   checkTestMessage(received->getRoot<TestAllTypes>());
 }
 
+TEST(SerializeAsyncTest, BufferedMessageStream) {
+  PipeWithSmallBuffer fds;
+  auto ioContext = kj::setupAsyncIo();
+  auto input = ioContext.lowLevelProvider->wrapInputFd(fds[0]);
+  SocketOutputStream rawOutput(fds[1]);
+
+  TestMessageBuilder small(1);
+  initTestMessage(small.getRoot<TestAllTypes>());
+  TestMessageBuilder multi(7);
+  initTestMessage(multi.getRoot<TestAllTypes>());
+  MallocMessageBuilder big;
+  big.initRoot<TestAllTypes>().initDataField(20000);  // Much bigger than the buffer.
+
+  kj::Thread thread([&]() {
+    for (uint i = 0; i < 10; i++) {
+      writeMessage(rawOutput, small);
+    }
+    writeMessage(rawOutput, multi);
+    writeMessage(rawOutput, big);
+    writeMessage(rawOutput, small);
+    KJ_SOCKCALL(shutdown(fds[1], SHUT_WR));
+  });
+
+  BufferedMessageStream stream(*input, ReaderOptions(), 512);
+
+  // Hold on to some of the messages so that their chunks can't be reused.
+  kj::Vector<kj::Own<MessageReader>> held;
+  for (uint i = 0; i < 10; i++) {
+    auto received = stream.readMessage().wait(ioContext.waitScope);
+    checkTestMessage(received->getRoot<TestAllTypes>());
+    if (i % 3 == 0) {
+      held.add(kj::mv(received));
+    }
+  }
+
+  checkTestMessage(stream.readMessage().wait(ioContext.waitScope)->getRoot<TestAllTypes>());
+  EXPECT_EQ(20000u, stream.readMessage().wait(ioContext.waitScope)
+      ->getRoot<TestAllTypes>().getDataField().size());
+  checkTestMessage(stream.readMessage().wait(ioContext.waitScope)->getRoot<TestAllTypes>());
+
+  EXPECT_TRUE(stream.tryReadMessage().wait(ioContext.waitScope) == nullptr);
+
+  for (auto& message: held) {
+    checkTestMessage(message->getRoot<TestAllTypes>());
+  }
+}
+
+TEST(SerializeAsyncTest, ParsePackedAsync) {
+  PipeWithSmallBuffer fds;
+  auto ioContext = kj::setupAsyncIo();
+  auto input = ioContext.lowLevelProvider->wrapInputFd(fds[0]);
+  SocketOutputStream rawOutput(fds[1]);
+
+  TestMessageBuilder small(1);
+  initTestMessage(small.getRoot<TestAllTypes>());
+  TestMessageBuilder multi(7);
+  initTestMessage(multi.getRoot<TestAllTypes>());
+  MallocMessageBuilder runs;
+  auto data = runs.initRoot<TestAllTypes>().initDataField(5000);  // long raw and zero runs
+  for (uint i = 0; i < 2000; i++) {
+    data[i] = i * 7 + 1;
+  }
+
+  kj::Thread thread([&]() {
+    writePackedMessage(rawOutput, small);
+    writePackedMessage(rawOutput, multi);
+    writePackedMessage(rawOutput, runs);
+    writePackedMessage(rawOutput, small);
+    KJ_SOCKCALL(shutdown(fds[1], SHUT_WR));
+  });
+
+  // Use a tiny buffer so that tag groups and runs get split across reads.
+  AsyncPackedInputStream packedInput(*input, 16);
+
+  checkTestMessage(readMessage(packedInput).wait(ioContext.waitScope)->getRoot<TestAllTypes>());
+  checkTestMessage(readMessage(packedInput).wait(ioContext.waitScope)->getRoot<TestAllTypes>());
+
+  {
+    auto received = readMessage(packedInput).wait(ioContext.waitScope);
+    auto receivedData = received->getRoot<TestAllTypes>().getDataField();
+    ASSERT_EQ(5000u, receivedData.size());
+    for (uint i = 0; i < 5000; i++) {
+      EXPECT_EQ(i < 2000 ? byte(i * 7 + 1) : byte(0), receivedData[i]);
+    }
+  }
+
+  checkTestMessage(readMessage(packedInput).wait(ioContext.waitScope)->getRoot<TestAllTypes>());
+
+  EXPECT_TRUE(tryReadMessage(packedInput).wait(ioContext.waitScope) == nullptr);
+}
+
+TEST(SerializeAsyncTest, BufferedPackedStream) {
+  // BufferedMessageStream asks for more than it needs, so the packed stream sees reads that end
+  // partway through a raw run.  Deliver the bytes a few at a time to split the runs up.
+  PipeWithSmallBuffer fds;
+  auto ioContext = kj::setupAsyncIo();
+  auto input = ioContext.lowLevelProvider->wrapInputFd(fds[0]);
+  SocketOutputStream rawOutput(fds[1]);
+
+  TestMessageBuilder small(1);
+  initTestMessage(small.getRoot<TestAllTypes>());
+  MallocMessageBuilder runs;
+  auto data = runs.initRoot<TestAllTypes>().initDataField(6000);
+  for (uint i = 0; i < 4000; i++) {
+    data[i] = (i % 251) | 1;  // no zero bytes, so this packs as long raw runs
+  }
+
+  kj::VectorOutputStream packed;
+  writePackedMessage(packed, runs);
+  writePackedMessage(packed, small);
+  writePackedMessage(packed, runs);
+
+  kj::Thread thread([&]() {
+    auto bytes = packed.getArray();
+    for (size_t i = 0; i < bytes.size(); i += 5) {
+      rawOutput.write(bytes.begin() + i, kj::min(size_t(5), bytes.size() - i));
+      if (i % 100 == 0) usleep(100);
+    }
+    KJ_SOCKCALL(shutdown(fds[1], SHUT_WR));
+  });
+
+  AsyncPackedInputStream packedInput(*input);
+  BufferedMessageStream stream(packedInput);
+
+  auto checkRuns = [&](MessageReader& reader) {
+    auto receivedData = reader.getRoot<TestAllTypes>().getDataField();
+    ASSERT_EQ(6000u, receivedData.size());
+    for (uint i = 0; i < 6000; i++) {
+      ASSERT_EQ(i < 4000 ? byte((i % 251) | 1) : byte(0), receivedData[i]);
+    }
+  };
+
+  checkRuns(*stream.readMessage().wait(ioContext.waitScope));
+  checkTestMessage(stream.readMessage().wait(ioContext.waitScope)->getRoot<TestAllTypes>());
+  checkRuns(*stream.readMessage().wait(ioContext.waitScope));
+
+  EXPECT_TRUE(stream.tryReadMessage().wait(ioContext.waitScope) == nullptr);
+}
+
+TEST(SerializeAsyncTest, WritePackedAsync) {
+  PipeWithSmallBuffer fds;
+  auto ioContext = kj::setupAsyncIo();
+  auto output = ioContext.lowLevelProvider->wrapOutputFd(fds[1]);
+
+  TestMessageBuilder message(7);
+  initTestMessage(message.getRoot<TestAllTypes>());
+
+  kj::Thread thread([&]() {
+    SocketInputStream input(fds[0]);
+    kj::BufferedInputStreamWrapper buffered(input);
+    PackedMessageReader reader(buffered);
+    checkTestMessage(reader.getRoot<TestAllTypes>());
+  });
+
+  writePackedMessage(*output, message).wait(ioContext.waitScope);
+}
+
 TEST(SerializeAsyncTest, WriteAsync) {
   PipeWithSmallBuffer fds;
   auto ioContext = kj::setupAsyncIo();
@@ -331,6 +521,34 @@ TEST(SerializeAsyncTest, WriteAsyncEvenSegmentCount) {
   writeMessage(*output, message).wait(ioContext.waitScope);
 }
 
+#if !_WIN32  // kj::AsyncFile not implemented on win32 yet
+TEST(SerializeAsyncTest, File) {
+  char filename[] = "/tmp/capnproto-serialize-async-test-XXXXXX";
+  int fd;
+  KJ_SYSCALL(fd = mkstemp(filename));
+  unlink(filename);
+
+  auto ioContext = kj::setupAsyncIo();
+  auto file = ioContext.lowLevelProvider->wrapFileFd(
+      fd, kj::LowLevelAsyncIoProvider::TAKE_OWNERSHIP);
+
+  TestMessageBuilder message(7);
+  initTestMessage(message.getRoot<TestAllTypes>());
+
+  auto output = file->writeStream();
+  writeMessage(*output, message).wait(ioContext.waitScope);
+  writeMessage(*output, message).wait(ioContext.waitScope);
+  file->sync().wait(ioContext.waitScope);
+
+  auto input = file->readStream();
+  for (uint i = 0; i < 2; i++) {
+    auto received = readMessage(*input).wait(ioContext.waitScope);
+    checkTestMessage(received->getRoot<TestAllTypes>());
+  }
+  EXPECT_TRUE(tryReadMessage(*input).wait(ioContext.waitScope) == nullptr);
+}
+#endif
+
 }  // namespace
 }  // namespace _ (private)
 }  // namespace capnp
@@ -20,7 +20,9 @@
 // THE SOFTWARE.
 
 #include "serialize-async.h"
+#include "serialize-packed.h"
 #include <kj/debug.h>
+#include <kj/refcount.h>
 
 namespace capnp {
 
@@ -28,7 +30,9 @@ namespace {
 
 class AsyncMessageReader: public MessageReader {
 public:
-  inline AsyncMessageReader(ReaderOptions options): MessageReader(options) {
+  inline AsyncMessageReader(ReaderOptions options,
+                            ReaderSegmentAllocator* allocator = nullptr)
+      : MessageReader(options), allocator(allocator) {
     memset(firstWord, 0, sizeof(firstWord));
   }
   ~AsyncMessageReader() noexcept(false) {}
@@ -54,6 +58,11 @@ private:
   kj::Array<word> ownedSpace;
   // Only if scratchSpace wasn't big enough.
 
+  ReaderSegmentAllocator* allocator;
+  kj::Array<kj::Array<word>> ownedSegments;
+  kj::Array<kj::ArrayPtr<byte>> pieces;
+  // Only if an allocator was given.  `pieces` must outlive the scatter read.
+
   inline uint segmentCount() { return firstWord[0].get() + 1; }
   inline uint segment0Size() { return firstWord[1].get(); }
 
@@ -122,15 +131,30 @@ kj::Promise<void> AsyncMessageReader::readSegments(kj::AsyncInputStream& inputSt
     return kj::READY_NOW;  // exception will be propagated
   }
 
+  segmentStarts = kj::heapArray<const word*>(segmentCount());
+
+  KJ_IF_MAYBE(a, allocator) {
+    // Allocate each segment separately and fill them all with one scatter read, so that a large
+    // multi-segment message never needs one giant contiguous buffer.
+    ownedSegments = kj::heapArray<kj::Array<word>>(segmentCount());
+    pieces = kj::heapArray<kj::ArrayPtr<byte>>(segmentCount());
+
+    for (uint i = 0; i < segmentCount(); i++) {
+      uint32_t size = i == 0 ? segment0Size() : moreSizes[i - 1].get();
+      ownedSegments[i] = a->allocateSegment(size);
+      KJ_ASSERT(ownedSegments[i].size() == size, "allocator returned wrong size");
+      segmentStarts[i] = ownedSegments[i].begin();
+      pieces[i] = ownedSegments[i].asBytes();
+    }
+
+    return inputStream.read(pieces);
+  }
+
   if (scratchSpace.size() < totalWords) {
-    // TODO(perf):  Consider allocating each segment as a separate chunk to reduce memory
-    //   fragmentation.
     ownedSpace = kj::heapArray<word>(totalWords);
     scratchSpace = ownedSpace;
   }
 
-  segmentStarts = kj::heapArray<const word*>(segmentCount());
-
   segmentStarts[0] = scratchSpace.begin();
 
   if (segmentCount() > 1) {
@@ -172,6 +196,237 @@ kj::Promise<kj::Maybe<kj::Own<MessageReader>>> tryReadMessage(
   }));
 }
 
+kj::Promise<kj::Own<MessageReader>> readMessage(
+    kj::AsyncInputStream& input, ReaderOptions options, ReaderSegmentAllocator& allocator) {
+  auto reader = kj::heap<AsyncMessageReader>(options, &allocator);
+  auto promise = reader->read(input, nullptr);
+  return promise.then(kj::mvCapture(reader, [](kj::Own<MessageReader>&& reader, bool success) {
+    KJ_REQUIRE(success, "Premature EOF.") { break; }
+    return kj::mv(reader);
+  }));
+}
+
+kj::Promise<kj::Maybe<kj::Own<MessageReader>>> tryReadMessage(
+    kj::AsyncInputStream& input, ReaderOptions options, ReaderSegmentAllocator& allocator) {
+  auto reader = kj::heap<AsyncMessageReader>(options, &allocator);
+  auto promise = reader->read(input, nullptr);
+  return promise.then(kj::mvCapture(reader,
+        [](kj::Own<MessageReader>&& reader, bool success) -> kj::Maybe<kj::Own<MessageReader>> {
+    if (success) {
+      return kj::mv(reader);
+    } else {
+      return nullptr;
+    }
+  }));
+}
+
+// =======================================================================================
+
+class BufferedMessageStream::Chunk: public kj::Refcounted {
+public:
+  explicit Chunk(uint words): space(kj::heapArray<word>(words)) {}
+
+  inline byte* bytes() { return space.asBytes().begin(); }
+  inline size_t capacity() { return space.size() * sizeof(word); }
+
+private:
+  kj::Array<word> space;
+};
+
+class BufferedMessageStream::Reader final: public MessageReader {
+  // A message whose segments live either in a chunk (zero-copy) or in their own space.
+
+public:
+  Reader(ReaderOptions options, uint segmentCount, const _::WireValue<uint32_t>* sizes,
+         const word* start, kj::Own<Chunk> chunk, kj::Array<word> ownedSpace)
+      : MessageReader(options), chunk(kj::mv(chunk)), ownedSpace(kj::mv(ownedSpace)) {
+    segment0 = kj::arrayPtr(start, sizes[0].get());
+    start += sizes[0].get();
+
+    if (segmentCount > 1) {
+      moreSegments = kj::heapArray<kj::ArrayPtr<const word>>(segmentCount - 1);
+      for (uint i = 1; i < segmentCount; i++) {
+        moreSegments[i - 1] = kj::arrayPtr(start, sizes[i].get());
+        start += sizes[i].get();
+      }
+    }
+  }
+
+  kj::ArrayPtr<const word> getSegment(uint id) override {
+    if (id == 0) {
+      return segment0;
+    } else if (id <= moreSegments.size()) {
+      return moreSegments[id - 1];
+    } else {
+      return nullptr;
+    }
+  }
+
+private:
+  // Optimize for single-segment case.
+  kj::ArrayPtr<const word> segment0;
+  kj::Array<kj::ArrayPtr<const word>> moreSegments;
+
+  kj::Own<Chunk> chunk;
+  kj::Array<word> ownedSpace;
+  // Exactly one of these is non-null.
+};
+
+namespace {
+
+typedef kj::Maybe<kj::Own<MessageReader>> MaybeReader;
+
+inline size_t headerBytes(uint segmentCount) {
+  return (segmentCount / 2 + 1) * sizeof(word);
+}
+
+}  // namespace
+
+constexpr uint BufferedMessageStream::DEFAULT_BUFFER_WORDS;
+
+BufferedMessageStream::BufferedMessageStream(
+    kj::AsyncInputStream& input, ReaderOptions options, uint bufferWords)
+    : input(input), options(options),
+      // The largest segment table we accept (511 segments) takes 256 words.
+      bufferWords(kj::max(bufferWords, 512u)),
+      chunk(kj::refcounted<Chunk>(this->bufferWords)) {}
+
+BufferedMessageStream::~BufferedMessageStream() noexcept(false) {}
+
+kj::Promise<bool> BufferedMessageStream::fill(size_t bytes) {
+  // Make sure at least `bytes` unconsumed bytes are buffered, reading as much as is available
+  // beyond that.  Returns false on EOF.
+
+  size_t available = endPos - readPos;
+  if (available >= bytes) {
+    return true;
+  }
+
+  if (readPos + bytes > chunk->capacity()) {
+    // Not enough room left in this chunk.  Move the unconsumed bytes to the start of a chunk,
+    // reusing this one if no message still points into it.
+    KJ_ASSERT(bytes <= chunk->capacity());
+    if (chunk->isShared()) {
+      auto newChunk = kj::refcounted<Chunk>(bufferWords);
+      memcpy(newChunk->bytes(), chunk->bytes() + readPos, available);
+      chunk = kj::mv(newChunk);
+    } else {
+      memmove(chunk->bytes(), chunk->bytes() + readPos, available);
+    }
+    readPos = 0;
+    endPos = available;
+  }
+
+  return input.tryRead(chunk->bytes() + endPos, bytes - available, chunk->capacity() - endPos)
+      .then([this,bytes](size_t n) {
+    endPos += n;
+    return endPos - readPos >= bytes;
+  });
+}
+
+kj::Promise<kj::Maybe<kj::Own<MessageReader>>> BufferedMessageStream::tryReadMessage() {
+  if (readPos == endPos && !chunk->isShared()) {
+    // Nothing buffered, so start over at the beginning of the chunk to make room for a big read.
+    readPos = endPos = 0;
+  }
+
+  return fill(sizeof(word)).then([this](bool ok) -> kj::Promise<MaybeReader> {
+    if (!ok) {
+      if (readPos == endPos) {
+        return MaybeReader(nullptr);
+      }
+      KJ_FAIL_REQUIRE("Premature EOF.") {
+        return MaybeReader(nullptr);
+      }
+    }
+
+    auto firstWord = reinterpret_cast<const _::WireValue<uint32_t>*>(chunk->bytes() + readPos);
+    uint segmentCount = firstWord[0].get() + 1;
+
+    // Reject messages with too many segments for security reasons.  (A count that wrapped to
+    // zero means 2^32 segments.)
+    KJ_REQUIRE(segmentCount != 0 && segmentCount < 512, "Message has too many segments.") {
+      return MaybeReader(nullptr);
+    }
+
+    return fill(headerBytes(segmentCount)).then([this,segmentCount](bool ok) {
+      KJ_REQUIRE(ok, "Premature EOF.") {
+        return kj::Promise<MaybeReader>(MaybeReader(nullptr));
+      }
+      return readAfterHeader(segmentCount);
+    });
+  });
+}
+
+kj::Promise<kj::Maybe<kj::Own<MessageReader>>> BufferedMessageStream::readAfterHeader(
+    uint segmentCount) {
+  auto sizes = reinterpret_cast<const _::WireValue<uint32_t>*>(chunk->bytes() + readPos) + 1;
+
+  size_t totalWords = 0;
+  for (uint i = 0; i < segmentCount; i++) {
+    totalWords += sizes[i].get();
+  }
+
+  // Don't accept a message which the receiver couldn't possibly traverse without hitting the
+  // traversal limit.  Without this check, a malicious client could transmit a very large segment
+  // size to make the receiver allocate excessive space and possibly crash.
+  KJ_REQUIRE(totalWords <= options.traversalLimitInWords,
+             "Message is too large.  To increase the limit on the receiving end, see "
+             "capnp::ReaderOptions.") {
+    return MaybeReader(nullptr);
+  }
+
+  size_t tableBytes = headerBytes(segmentCount);
+  size_t messageBytes = tableBytes + totalWords * sizeof(word);
+
+  if (messageBytes <= chunk->capacity()) {
+    // The message fits in a chunk, so read it into the buffer (if it isn't there already) and
+    // point the reader directly at it.  fill() may move the buffered bytes, so look up the
+    // segment table again afterwards.
+    return fill(messageBytes).then([this,segmentCount,tableBytes,messageBytes](bool ok) {
+      KJ_REQUIRE(ok, "Premature EOF.") {
+        return MaybeReader(nullptr);
+      }
+
+      const byte* start = chunk->bytes() + readPos;
+      auto reader = kj::heap<Reader>(
+          options, segmentCount, reinterpret_cast<const _::WireValue<uint32_t>*>(start) + 1,
+          reinterpret_cast<const word*>(start + tableBytes), kj::addRef(*chunk), nullptr);
+      readPos += messageBytes;
+      return MaybeReader(kj::mv(reader));
+    });
+  } else {
+    // Too big for a chunk.  Give the message its own space, copy over whatever part of it is
+    // already buffered, then read the rest directly into place.
+    auto space = kj::heapArray<word>(totalWords);
+    byte* target = space.asBytes().begin();
+
+    size_t bufferedBytes = endPos - readPos - tableBytes;
+    memcpy(target, chunk->bytes() + readPos + tableBytes, bufferedBytes);
+    readPos = endPos;
+
+    word* start = space.begin();
+    kj::Own<MessageReader> reader = kj::heap<Reader>(
+        options, segmentCount, sizes, start, kj::Own<Chunk>(), kj::mv(space));
+
+    auto promise = input.read(target + bufferedBytes, totalWords * sizeof(word) - bufferedBytes);
+    return promise.then(kj::mvCapture(reader, [](kj::Own<MessageReader>&& reader) {
+      return MaybeReader(kj::mv(reader));
+    }));
+  }
+}
+
+kj::Promise<kj::Own<MessageReader>> BufferedMessageStream::readMessage() {
+  return tryReadMessage().then([](MaybeReader&& maybeReader) -> kj::Own<MessageReader> {
+    KJ_IF_MAYBE(reader, maybeReader) {
+      return kj::mv(*reader);
+    }
+    KJ_FAIL_REQUIRE("Premature EOF.") {
+      return kj::Own<MessageReader>();
+    }
+  });
+}
+
 // =======================================================================================
 
 namespace {
@@ -217,4 +472,128 @@ kj::Promise<void> writeMessage(kj::AsyncOutputStream& output,
   return promise.then(kj::mvCapture(arrays, [](WriteArrays&&) {}));
 }
 
+// =======================================================================================
+
+constexpr uint AsyncPackedInputStream::DEFAULT_BUFFER_BYTES;
+
+AsyncPackedInputStream::AsyncPackedInputStream(kj::AsyncInputStream& inner, uint bufferBytes)
+    // A tag group is at most ten bytes: the tag, eight data bytes, and a run length.
+    : inner(inner), buffer(kj::heapArray<byte>(kj::max(bufferBytes, 64u))) {}
+
+AsyncPackedInputStream::~AsyncPackedInputStream() noexcept(false) {}
+
+namespace {
+
+inline size_t tagGroupSize(uint tag) {
+  size_t result = 1;
+  for (uint i = 0; i < 8; i++) {
+    result += (tag >> i) & 1;
+  }
+  if (tag == 0 || tag == 0xff) {
+    ++result;  // run length
+  }
+  return result;
+}
+
+}  // namespace
+
+byte* AsyncPackedInputStream::unpack(byte* out, byte* outEnd) {
+  // Unpack as much of the buffered input into [out, outEnd) as possible, returning the new output
+  // position.  Stops early only when a tag group or run has not fully arrived yet.
+
+  const byte* in = buffer.begin() + readPos;
+  const byte* inEnd = buffer.begin() + endPos;
+
+  while (out < outEnd) {
+    if (zeroBytesPending > 0) {
+      size_t n = kj::min(zeroBytesPending, size_t(outEnd - out));
+      memset(out, 0, n);
+      out += n;
+      zeroBytesPending -= n;
+    } else if (rawBytesPending > 0) {
+      size_t n = kj::min(rawBytesPending, kj::min(size_t(outEnd - out), size_t(inEnd - in)));
+      n -= n % sizeof(word);  // don't hand back a partial word; wait for the rest of it
+      if (n == 0) break;
+      memcpy(out, in, n);
+      out += n;
+      in += n;
+      rawBytesPending -= n;
+    } else {
+      if (in == inEnd) break;
+      uint tag = *in;
+      if (size_t(inEnd - in) < tagGroupSize(tag)) break;
+      ++in;
+
+      for (uint i = 0; i < 8; i++) {
+        out[i] = (tag >> i) & 1 ? *in++ : 0;
+      }
+      out += sizeof(word);
+
+      if (tag == 0) {
+        zeroBytesPending = *in++ * sizeof(word);
+      } else if (tag == 0xff) {
+        rawBytesPending = *in++ * sizeof(word);
+      }
+    }
+  }
+
+  readPos = in - buffer.begin();
+  return out;
+}
+
+kj::Promise<size_t> AsyncPackedInputStream::tryRead(
+    void* buffer, size_t minBytes, size_t maxBytes) {
+  KJ_REQUIRE(minBytes % sizeof(word) == 0 && maxBytes % sizeof(word) == 0,
+             "AsyncPackedInputStream reads must be word-aligned.");
+
+  return tryReadInternal(reinterpret_cast<byte*>(buffer), minBytes, maxBytes, 0);
+}
+
+kj::Promise<size_t> AsyncPackedInputStream::tryReadInternal(
+    byte* out, size_t minBytes, size_t maxBytes, size_t alreadyRead) {
+  size_t n = unpack(out, out + maxBytes) - out;
+  if (n >= minBytes || atEof) {
+    return alreadyRead + n;
+  }
+
+  out += n;
+  minBytes -= n;
+  maxBytes -= n;
+  alreadyRead += n;
+
+  // We ran out of input.  At most a partial tag group is left over; move it to the front and
+  // read as much more as is available.
+  size_t remaining = endPos - readPos;
+  memmove(buffer.begin(), buffer.begin() + readPos, remaining);
+  readPos = 0;
+  endPos = remaining;
+
+  return inner.tryRead(buffer.begin() + endPos, 1, buffer.size() - endPos)
+      .then([this,out,minBytes,maxBytes,alreadyRead](size_t amount) {
+    if (amount == 0) {
+      atEof = true;
+    }
+    endPos += amount;
+    return tryReadInternal(out, minBytes, maxBytes, alreadyRead);
+  });
+}
+
+kj::Promise<void> writePackedMessage(kj::AsyncOutputStream& output,
+                                     kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  size_t totalBytes = (segments.size() / 2 + 1) * sizeof(word);
+  for (auto& segment: segments) {
+    totalBytes += segment.asBytes().size();
+  }
+
+  // Packing rarely makes a message bigger, so the unpacked size is a good initial capacity.
+  auto packed = kj::heap<kj::VectorOutputStream>(totalBytes);
+  writePackedMessage(*packed, segments);
+
+  auto bytes = packed->getArray();
+  auto promise = output.write(bytes.begin(), bytes.size());
+
+  // Make sure the packed bytes aren't freed until the write completes.
+  return promise.then(kj::mvCapture(packed, [](kj::Own<kj::VectorOutputStream>&&) {}));
+}
+
 }  // namespace capnp
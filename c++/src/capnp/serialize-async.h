@@ -45,6 +45,63 @@ kj::Promise<kj::Maybe<kj::Own<MessageReader>>> tryReadMessage(
     kj::ArrayPtr<word> scratchSpace = nullptr);
 // Like `readMessage` but returns null on EOF.
 
+kj::Promise<kj::Own<MessageReader>> readMessage(
+    kj::AsyncInputStream& input, ReaderOptions options, ReaderSegmentAllocator& allocator);
+kj::Promise<kj::Maybe<kj::Own<MessageReader>>> tryReadMessage(
+    kj::AsyncInputStream& input, ReaderOptions options, ReaderSegmentAllocator& allocator);
+// Like the above, but read each segment into a separate array obtained from `allocator`, using
+// a single scatter read (see `kj::AsyncInputStream::read(pieces)`) rather than one contiguous
+// buffer.  `allocator` must remain valid until the returned promise resolves.
+
+class BufferedMessageStream {
+  // Reads a sequence of messages from an AsyncInputStream, pulling data in large chunks into a
+  // buffer and parsing as many complete messages out of each chunk as it contains.  Compared to
+  // calling `readMessage()` repeatedly, which issues separate reads for the first word, the
+  // segment table, and the message body, this typically needs only one read() -- and one turn of
+  // the event loop -- per chunk rather than three per message.
+  //
+  // Messages that lie entirely within a chunk are not copied: the returned MessageReader points
+  // directly into the chunk and holds a reference to it.  A chunk is reused once every message
+  // read from it has been destroyed; otherwise a fresh one is allocated.  Note that this means a
+  // long-lived MessageReader keeps its whole chunk alive.  A message that straddles the end of a
+  // chunk has its partial beginning moved to the start of the next chunk, and a message too large
+  // for a chunk is read (after copying any part already buffered) into its own space.
+
+public:
+  static constexpr uint DEFAULT_BUFFER_WORDS = 8192;
+
+  explicit BufferedMessageStream(kj::AsyncInputStream& input,
+                                 ReaderOptions options = ReaderOptions(),
+                                 uint bufferWords = DEFAULT_BUFFER_WORDS);
+  // `input` must outlive the BufferedMessageStream.  `bufferWords` is the chunk size; it is
+  // rounded up if too small to hold the largest possible segment table.
+  KJ_DISALLOW_COPY(BufferedMessageStream);
+  ~BufferedMessageStream() noexcept(false);
+
+  kj::Promise<kj::Maybe<kj::Own<MessageReader>>> tryReadMessage();
+  // Read the next message, or return null on a clean EOF.  Only one read may be outstanding at a
+  // time.  The returned MessageReader may outlive the BufferedMessageStream.
+
+  kj::Promise<kj::Own<MessageReader>> readMessage();
+  // Like `tryReadMessage()` but throws on EOF.
+
+private:
+  class Chunk;
+  class Reader;
+
+  kj::AsyncInputStream& input;
+  ReaderOptions options;
+  uint bufferWords;
+
+  kj::Own<Chunk> chunk;
+  size_t readPos = 0;
+  size_t endPos = 0;
+  // Unconsumed bytes are chunk[readPos, endPos).
+
+  kj::Promise<bool> fill(size_t bytes);
+  kj::Promise<kj::Maybe<kj::Own<MessageReader>>> readAfterHeader(uint segmentCount);
+};
+
 kj::Promise<void> writeMessage(kj::AsyncOutputStream& output,
                                kj::ArrayPtr<const kj::ArrayPtr<const word>> segments)
     KJ_WARN_UNUSED_RESULT;
@@ -52,6 +109,59 @@ kj::Promise<void> writeMessage(kj::AsyncOutputStream& output, MessageBuilder& bu
     KJ_WARN_UNUSED_RESULT;
 // Write asynchronously.  The parameters must remain valid until the returned promise resolves.
 
+// =======================================================================================
+// Packed format
+
+class AsyncPackedInputStream final: public kj::AsyncInputStream {
+  // An AsyncInputStream which unpacks packed data (see serialize-packed.h) read from `inner`.
+  // Bytes are unpacked incrementally as they arrive, so a packed message is never buffered as a
+  // whole.  Read messages from it with the regular `readMessage()` / `tryReadMessage()` above (or
+  // a `BufferedMessageStream`).
+  //
+  // Like `PackedInputStream`, reads must be a multiple of the word size, and each read returns a
+  // whole number of words.  This stream reads ahead from `inner`, so use the same object for every
+  // message on a connection.
+
+public:
+  static constexpr uint DEFAULT_BUFFER_BYTES = 8192;
+
+  explicit AsyncPackedInputStream(kj::AsyncInputStream& inner,
+                                  uint bufferBytes = DEFAULT_BUFFER_BYTES);
+  KJ_DISALLOW_COPY(AsyncPackedInputStream);
+  ~AsyncPackedInputStream() noexcept(false);
+
+  // implements AsyncInputStream -------------------------------------
+  kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override;
+
+private:
+  kj::AsyncInputStream& inner;
+
+  kj::Array<byte> buffer;
+  size_t readPos = 0;
+  size_t endPos = 0;
+  // Packed bytes not yet unpacked are buffer[readPos, endPos).
+
+  size_t zeroBytesPending = 0;
+  // Bytes of zeros still to be emitted for the current run of zero words.
+
+  size_t rawBytesPending = 0;
+  // Bytes still to be copied verbatim for the current run of uncompressed words.
+
+  bool atEof = false;
+
+  byte* unpack(byte* out, byte* outEnd);
+  kj::Promise<size_t> tryReadInternal(byte* buffer, size_t minBytes, size_t maxBytes,
+                                      size_t alreadyRead);
+};
+
+kj::Promise<void> writePackedMessage(kj::AsyncOutputStream& output,
+                                     kj::ArrayPtr<const kj::ArrayPtr<const word>> segments)
+    KJ_WARN_UNUSED_RESULT;
+kj::Promise<void> writePackedMessage(kj::AsyncOutputStream& output, MessageBuilder& builder)
+    KJ_WARN_UNUSED_RESULT;
+// Write a message in packed format.  The message is packed into memory up front and then written
+// with a single write, so only `output` must remain valid until the returned promise resolves.
+
 // =======================================================================================
 // inline implementation details
 
@@ -59,6 +169,11 @@ inline kj::Promise<void> writeMessage(kj::AsyncOutputStream& output, MessageBuil
   return writeMessage(output, builder.getSegmentsForOutput());
 }
 
+inline kj::Promise<void> writePackedMessage(kj::AsyncOutputStream& output,
+                                            MessageBuilder& builder) {
+  return writePackedMessage(output, builder.getSegmentsForOutput());
+}
+
 }  // namespace capnp
 
 #endif  // CAPNP_SERIALIZE_ASYNC_H_
@@ -0,0 +1,233 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "serialize-log.h"
+#include <kj/debug.h>
+#include <kj/compat/gtest.h>
+#include <kj/miniposix.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "test-util.h"
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+class TempFile {
+public:
+  TempFile() {
+#if _WIN32 || __ANDROID__
+    char filename[] = "capnproto-serialize-log-test-XXXXXX";
+#else
+    char filename[] = "/tmp/capnproto-serialize-log-test-XXXXXX";
+#endif
+    fd = kj::AutoCloseFd(mkstemp(filename));
+    KJ_ASSERT(fd.get() >= 0);
+#if !_WIN32
+    KJ_ASSERT(unlink(filename) == 0);
+#endif
+  }
+
+  int get() { return fd.get(); }
+
+  size_t size() {
+    struct stat stats;
+    KJ_SYSCALL(fstat(fd.get(), &stats));
+    return stats.st_size;
+  }
+
+private:
+  kj::AutoCloseFd fd;
+};
+
+void writeNumbered(MessageLogWriter& writer, uint begin, uint end) {
+  for (uint i = begin; i < end; i++) {
+    // Vary the message sizes so that offsets aren't predictable.
+    MallocMessageBuilder builder;
+    auto root = builder.initRoot<TestAllTypes>();
+    root.setUInt32Field(i);
+    root.initInt64List(i % 7);
+    writer.write(builder);
+  }
+}
+
+void checkNumbered(const MessageLogReader& reader, uint count) {
+  ASSERT_EQ(count, reader.size());
+
+  // Random access.
+  for (uint i: {0u, count / 2, count - 1, count / 3, 1u}) {
+    FlatArrayMessageReader message(reader[i]);
+    EXPECT_EQ(i, message.getRoot<TestAllTypes>().getUInt32Field());
+    EXPECT_EQ(i % 7, message.getRoot<TestAllTypes>().getInt64List().size());
+  }
+
+  // Forwards.
+  uint expected = 0;
+  for (auto words: reader) {
+    FlatArrayMessageReader message(words);
+    EXPECT_EQ(expected++, message.getRoot<TestAllTypes>().getUInt32Field());
+  }
+  EXPECT_EQ(count, expected);
+
+  // Backwards.
+  auto iter = reader.end();
+  while (iter != reader.begin()) {
+    --iter;
+    FlatArrayMessageReader message(*iter);
+    EXPECT_EQ(--expected, message.getRoot<TestAllTypes>().getUInt32Field());
+  }
+  EXPECT_EQ(0u, expected);
+}
+
+TEST(SerializeLog, WriteAndRead) {
+  TempFile file;
+
+  {
+    MessageLogReader reader(file.get());
+    EXPECT_EQ(0u, reader.size());
+    EXPECT_FALSE(reader.wasRecovered());
+  }
+
+  {
+    MessageLogWriter writer(file.get(), 16);
+    writeNumbered(writer, 0, 100);
+    EXPECT_EQ(100u, writer.size());
+  }
+
+  MessageLogReader reader(file.get());
+  EXPECT_FALSE(reader.wasRecovered());
+  checkNumbered(reader, 100);
+
+  KJ_EXPECT_THROW_MESSAGE("out of range", reader[100]);
+
+  {
+    // The index blocks and footer are themselves messages, so the file is still a valid stream.
+    MmapMessageFile stream(file.get());
+    uint count = 0;
+    for (auto words: stream) {
+      FlatArrayMessageReader message(words);
+      message.getRoot<AnyPointer>();
+      ++count;
+    }
+    EXPECT_EQ(100u + 100 / 16 + 1, count);
+  }
+}
+
+TEST(SerializeLog, Append) {
+  TempFile file;
+
+  {
+    MessageLogWriter writer(file.get(), 16);
+    writeNumbered(writer, 0, 40);
+  }
+
+  {
+    MessageLogWriter writer(file.get(), 1000);
+    EXPECT_FALSE(writer.wasRecovered());
+    EXPECT_EQ(40u, writer.size());
+    writeNumbered(writer, 40, 70);
+
+    // finish() is idempotent, and writing after it is allowed.
+    writer.finish();
+    writer.finish();
+    writeNumbered(writer, 70, 75);
+  }
+
+  MessageLogReader reader(file.get());
+  EXPECT_FALSE(reader.wasRecovered());
+  checkNumbered(reader, 75);
+}
+
+TEST(SerializeLog, TornTail) {
+  TempFile file;
+
+  {
+    MessageLogWriter writer(file.get(), 16);
+    writeNumbered(writer, 0, 50);
+  }
+
+  // Simulate a writer which died part-way through appending a message:  cut off the footer and
+  // append half a message plus a partial word.
+  {
+    MessageLogReader reader(file.get());
+    size_t end = (reader[49].end() - reader[0].begin()) * sizeof(word);
+    KJ_SYSCALL(ftruncate(file.get(), end));
+
+    MallocMessageBuilder builder;
+    builder.initRoot<TestAllTypes>().setTextField("torn");
+    kj::Array<word> words = messageToFlatArray(builder);
+    KJ_SYSCALL(lseek(file.get(), 0, SEEK_END));
+    kj::FdOutputStream(file.get()).write(words.begin(), words.asBytes().size() / 2 + 3);
+  }
+
+  {
+    MessageLogReader reader(file.get());
+    EXPECT_TRUE(reader.wasRecovered());
+    checkNumbered(reader, 50);
+  }
+
+  size_t tornSize = file.size();
+
+  {
+    MessageLogWriter writer(file.get(), 16);
+    EXPECT_TRUE(writer.wasRecovered());
+    EXPECT_EQ(50u, writer.size());
+    EXPECT_LT(file.size(), tornSize);
+    writeNumbered(writer, 50, 60);
+  }
+
+  MessageLogReader reader(file.get());
+  EXPECT_FALSE(reader.wasRecovered());
+  checkNumbered(reader, 60);
+}
+
+TEST(SerializeLog, IndexPlainStream) {
+  TempFile file;
+
+  for (uint i = 0; i < 40; i++) {
+    MallocMessageBuilder builder;
+    auto root = builder.initRoot<TestAllTypes>();
+    root.setUInt32Field(i);
+    root.initInt64List(i % 7);
+    writeMessageToFd(file.get(), builder);
+  }
+
+  {
+    MessageLogReader reader(file.get());
+    EXPECT_TRUE(reader.wasRecovered());
+    checkNumbered(reader, 40);
+  }
+
+  {
+    MessageLogWriter writer(file.get(), 16);
+    EXPECT_TRUE(writer.wasRecovered());
+    writer.finish();
+  }
+
+  MessageLogReader reader(file.get());
+  EXPECT_FALSE(reader.wasRecovered());
+  checkNumbered(reader, 40);
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
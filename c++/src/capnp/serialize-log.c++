@@ -0,0 +1,347 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "serialize-log.h"
+#include <kj/debug.h>
+#include <kj/io.h>
+#include <kj/miniposix.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if _WIN32
+#include <io.h>
+#endif
+
+namespace capnp {
+
+namespace {
+
+constexpr uint64_t INDEX_BLOCK_MAGIC = 0xb3cd5e0a1e6f4c1dull;
+constexpr uint64_t FOOTER_MAGIC = 0x9e7f2d41c8a0b65full;
+// First element of the root list of an index block or footer, respectively.  These were chosen
+// randomly; an application message whose root happens to be a List(UInt64) starting with one
+// of these values would confuse the reader.
+
+typedef _::WireValue<uint64_t> WireOffset;
+
+kj::Maybe<kj::ArrayPtr<const WireOffset>> parseIndexList(
+    kj::ArrayPtr<const word> words, uint64_t offset, uint64_t magic) {
+  // If a framed single-segment message whose root is a List(UInt64) starting with `magic` begins
+  // at `offset`, return the rest of the list.
+
+  if (offset >= words.size() || words.size() - offset < 3) return nullptr;
+  const word* start = words.begin() + offset;
+  size_t remaining = words.size() - offset;
+
+  auto table = reinterpret_cast<const _::WireValue<uint32_t>*>(start);
+  uint32_t segmentSize = table[1].get();
+  if (table[0].get() != 0 || segmentSize < 2 || segmentSize > remaining - 1) return nullptr;
+
+  // The root pointer must be a list pointer with offset zero and 8-byte elements filling the rest
+  // of the segment.
+  uint32_t elementCount = segmentSize - 1;
+  auto pointer = reinterpret_cast<const _::WireValue<uint32_t>*>(start + 1);
+  if (pointer[0].get() != 1 || pointer[1].get() != ((elementCount << 3) | 5)) return nullptr;
+
+  auto elements = kj::arrayPtr(reinterpret_cast<const WireOffset*>(start + 2), elementCount);
+  if (elements[0].get() != magic) return nullptr;
+  return elements.slice(1, elements.size());
+}
+
+kj::Array<word> makeIndexList(uint64_t magic, kj::ArrayPtr<const uint64_t> values) {
+  // Build the framed message that parseIndexList() expects.
+
+  size_t elementCount = values.size() + 1;
+  KJ_REQUIRE(elementCount < (1u << 29), "message log index is too large");
+
+  kj::Array<word> result = kj::heapArray<word>(elementCount + 2);
+  auto table = reinterpret_cast<_::WireValue<uint32_t>*>(result.begin());
+  table[0].set(0);
+  table[1].set(elementCount + 1);
+
+  auto pointer = reinterpret_cast<_::WireValue<uint32_t>*>(result.begin() + 1);
+  pointer[0].set(1);
+  pointer[1].set((elementCount << 3) | 5);
+
+  auto elements = reinterpret_cast<WireOffset*>(result.begin() + 2);
+  elements[0].set(magic);
+  for (size_t i = 0; i < values.size(); i++) {
+    elements[i + 1].set(values[i]);
+  }
+
+  return result;
+}
+
+struct LogState {
+  uint indexInterval = 0;
+  uint64_t messageCount = 0;
+  kj::Vector<uint64_t> indexBlocks;
+  kj::Vector<uint64_t> unindexed;
+
+  uint64_t endOffset = 0;
+  // End of the last complete message or index block, i.e. where the footer is or should go.
+
+  kj::Maybe<uint64_t> footerOffset;
+  bool recovered = false;
+};
+
+bool loadFooter(kj::ArrayPtr<const word> words, LogState& state) {
+  uint64_t footerOffset = reinterpret_cast<const WireOffset*>(words.end() - 1)->get();
+
+  kj::ArrayPtr<const WireOffset> footer;
+  KJ_IF_MAYBE(f, parseIndexList(words, footerOffset, FOOTER_MAGIC)) {
+    footer = *f;
+  } else {
+    return false;
+  }
+
+  // Layout:  message count, index interval, index block count, index block offsets, unindexed
+  //   message offsets, footer offset.
+  if (footer.size() < 4 || footer.end() != reinterpret_cast<const WireOffset*>(words.end()) ||
+      footer.back().get() != footerOffset) {
+    return false;
+  }
+
+  uint64_t messageCount = footer[0].get();
+  uint64_t interval = footer[1].get();
+  uint64_t blockCount = footer[2].get();
+  if (interval == 0 || interval > uint(kj::maxValue) || blockCount > footer.size() - 4 ||
+      messageCount / interval < blockCount ||
+      messageCount - blockCount * interval != footer.size() - 4 - blockCount) {
+    return false;
+  }
+
+  state.indexInterval = interval;
+  state.messageCount = messageCount;
+  for (auto& offset: footer.slice(3, 3 + blockCount)) {
+    state.indexBlocks.add(offset.get());
+  }
+  for (auto& offset: footer.slice(3 + blockCount, footer.size() - 1)) {
+    state.unindexed.add(offset.get());
+  }
+  state.endOffset = footerOffset;
+  state.footerOffset = footerOffset;
+  return true;
+}
+
+void scanLog(kj::ArrayPtr<const word> words, LogState& state) {
+  // No usable footer, so walk the segment tables from the start, stopping at the first message
+  // that runs past the end of the file.  Index blocks found along the way are kept as long as
+  // they agree with what we scanned.
+
+  kj::Vector<uint64_t> offsets;
+  size_t indexed = 0;
+
+  size_t pos = 0;
+  while (pos < words.size()) {
+    size_t remaining = words.size() - pos;
+    size_t size = expectedSizeInWordsFromPrefix(words.slice(pos, words.size()));
+    if (size > remaining) break;
+
+    KJ_IF_MAYBE(block, parseIndexList(words, pos, INDEX_BLOCK_MAGIC)) {
+      size_t count = block->size() - 1;
+      if (state.indexInterval == 0 && state.indexBlocks.size() == 0) {
+        state.indexInterval = count;
+      }
+
+      bool matches = count > 0 && count == state.indexInterval &&
+          (*block)[0].get() == indexed && offsets.size() - indexed >= count;
+      for (size_t i = 0; matches && i < count; i++) {
+        matches = (*block)[i + 1].get() == offsets[indexed + i];
+      }
+
+      if (matches) {
+        state.indexBlocks.add(pos);
+        indexed += count;
+      }
+    } else if (parseIndexList(words, pos, FOOTER_MAGIC) == nullptr) {
+      offsets.add(pos);
+    }
+
+    pos += size;
+  }
+
+  state.messageCount = offsets.size();
+  state.unindexed.addAll(offsets.asPtr().slice(indexed, offsets.size()));
+  state.endOffset = pos;
+  state.recovered = true;
+}
+
+LogState loadLog(kj::ArrayPtr<const word> words) {
+  LogState state;
+  if (words.size() > 0 && !loadFooter(words, state)) {
+    state = LogState();
+    scanLog(words, state);
+  }
+  return state;
+}
+
+}  // namespace
+
+// =======================================================================================
+
+MessageLogWriter::MessageLogWriter(int fd, uint indexInterval)
+    : fd(fd), indexInterval(indexInterval) {
+  KJ_REQUIRE(indexInterval > 0, "index interval must be positive");
+
+  struct stat stats;
+  KJ_SYSCALL(fstat(fd, &stats));
+
+  if (stats.st_size > 0) {
+    LogState state;
+    {
+      MmapMessageFile file(fd);
+      state = loadLog(file.getWords());
+    }
+
+    if (state.indexInterval > 0) this->indexInterval = state.indexInterval;
+    messageCount = state.messageCount;
+    indexBlocks = kj::mv(state.indexBlocks);
+    unindexed = kj::mv(state.unindexed);
+    endOffset = state.endOffset;
+    footerOffset = state.footerOffset;
+    recovered = state.recovered;
+
+    if (footerOffset == nullptr && uint64_t(stats.st_size) != endOffset * sizeof(word)) {
+      // Drop the torn tail.
+      truncate(endOffset);
+    }
+  }
+
+  uint64_t position = footerOffset.orDefault(endOffset) * sizeof(word);
+#if _WIN32
+  KJ_REQUIRE(_lseeki64(fd, position, SEEK_SET) >= 0, "lseek() failed on message log");
+#else
+  KJ_SYSCALL(lseek(fd, position, SEEK_SET));
+#endif
+}
+
+MessageLogWriter::~MessageLogWriter() noexcept(false) {
+  unwindDetector.catchExceptionsIfUnwinding([&]() {
+    finish();
+  });
+}
+
+void MessageLogWriter::write(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  KJ_IF_MAYBE(f, footerOffset) {
+    truncate(*f);
+    footerOffset = nullptr;
+  }
+
+  writeMessageToFd(fd, segments);
+  unindexed.add(endOffset);
+  endOffset += computeSerializedSizeInWords(segments);
+  ++messageCount;
+
+  flushIndexBlocks();
+}
+
+void MessageLogWriter::finish() {
+  if (footerOffset != nullptr) return;
+
+  flushIndexBlocks();
+
+  kj::Vector<uint64_t> values(indexBlocks.size() + unindexed.size() + 4);
+  values.add(messageCount);
+  values.add(indexInterval);
+  values.add(indexBlocks.size());
+  values.addAll(indexBlocks);
+  values.addAll(unindexed);
+  values.add(endOffset);
+
+  kj::Array<word> footer = makeIndexList(FOOTER_MAGIC, values);
+  kj::FdOutputStream(fd).write(footer.begin(), footer.asBytes().size());
+  footerOffset = endOffset;
+}
+
+void MessageLogWriter::flushIndexBlocks() {
+  size_t pos = 0;
+  while (unindexed.size() - pos >= indexInterval) {
+    kj::Vector<uint64_t> values(indexInterval + 1);
+    values.add(indexBlocks.size() * uint64_t(indexInterval));
+    values.addAll(unindexed.asPtr().slice(pos, pos + indexInterval));
+
+    kj::Array<word> block = makeIndexList(INDEX_BLOCK_MAGIC, values);
+    kj::FdOutputStream(fd).write(block.begin(), block.asBytes().size());
+    indexBlocks.add(endOffset);
+    endOffset += block.size();
+    pos += indexInterval;
+  }
+
+  if (pos > 0) {
+    kj::Vector<uint64_t> rest(unindexed.size() - pos);
+    rest.addAll(unindexed.asPtr().slice(pos, unindexed.size()));
+    unindexed = kj::mv(rest);
+  }
+}
+
+void MessageLogWriter::truncate(uint64_t offset) {
+  uint64_t size = offset * sizeof(word);
+#if _WIN32
+  KJ_REQUIRE(_chsize_s(fd, size) == 0, "couldn't truncate message log");
+  KJ_REQUIRE(_lseeki64(fd, size, SEEK_SET) >= 0, "lseek() failed on message log");
+#else
+  KJ_SYSCALL(ftruncate(fd, size));
+  KJ_SYSCALL(lseek(fd, size, SEEK_SET));
+#endif
+}
+
+// =======================================================================================
+
+MessageLogReader::MessageLogReader(int fd): file(fd) {
+  LogState state = loadLog(file.getWords());
+  messageCount = state.messageCount;
+  indexInterval = state.indexInterval;
+  indexBlocks = state.indexBlocks.releaseAsArray();
+  unindexed = state.unindexed.releaseAsArray();
+  recovered = state.recovered;
+}
+
+MessageLogReader::~MessageLogReader() noexcept(false) {}
+
+kj::ArrayPtr<const word> MessageLogReader::operator[](size_t index) const {
+  KJ_REQUIRE(index < messageCount, "message index out of range", index, messageCount);
+
+  kj::ArrayPtr<const word> words = file.getWords();
+
+  uint64_t offset;
+  uint64_t indexedCount = indexBlocks.size() * uint64_t(indexInterval);
+  if (index < indexedCount) {
+    uint64_t blockOffset = indexBlocks[index / indexInterval];
+    auto block = KJ_REQUIRE_NONNULL(parseIndexList(words, blockOffset, INDEX_BLOCK_MAGIC),
+        "message log index block is corrupt", blockOffset);
+    KJ_REQUIRE(block.size() == indexInterval + 1 &&
+               block[0].get() == index - index % indexInterval,
+               "message log index block is corrupt", blockOffset);
+    offset = block[index % indexInterval + 1].get();
+  } else {
+    offset = unindexed[index - indexedCount];
+  }
+
+  KJ_REQUIRE(offset < words.size(), "message log index points past end of file", index, offset);
+  size_t remaining = words.size() - offset;
+  size_t size = expectedSizeInWordsFromPrefix(words.slice(offset, words.size()));
+  KJ_REQUIRE(size <= remaining, "message log index points at a truncated message", index, offset);
+
+  return words.slice(offset, offset + size);
+}
+
+}  // namespace capnp
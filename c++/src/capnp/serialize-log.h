@@ -0,0 +1,182 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef CAPNP_SERIALIZE_LOG_H_
+#define CAPNP_SERIALIZE_LOG_H_
+
+#if defined(__GNUC__) && !defined(CAPNP_HEADER_WARNINGS)
+#pragma GCC system_header
+#endif
+
+#include "serialize.h"
+#include <kj/vector.h>
+
+namespace capnp {
+
+// =======================================================================================
+// Indexed message logs
+//
+// A message log is a file of messages in the standard serialization format, one after another,
+// exactly as written by repeated calls to writeMessageToFd(), except that every so often the
+// writer also appends an *index block* listing the file offsets of the preceding messages, and
+// when the writer finishes it appends a *footer* listing the offsets of all index blocks plus
+// the messages not yet covered by one.  With these, a reader can find message N in O(1) without
+// scanning the file, and can iterate in either direction.
+//
+// Index blocks and the footer are themselves framed single-segment messages whose root is a
+// List(UInt64) starting with a magic number, so the file remains a valid message stream:  tools
+// which don't know about the index see them as extra messages and can skip them by checking the
+// magic number.  The last word of the footer is the footer's own offset, so the footer can be
+// located from the end of the file.
+//
+// If the writer dies part-way through, the file may end in a torn message and/or lack a footer.
+// Both the reader and the writer detect this and recover by scanning the segment tables of the
+// messages (which doesn't touch message content), discarding the torn tail.  This is also how an
+// index gets built for a plain message stream that was written without one:  open it with a
+// MessageLogWriter and finish().
+
+class MessageLogWriter {
+  // Appends messages to a log file.
+
+public:
+  explicit MessageLogWriter(int fd, uint indexInterval = 1024);
+  // `fd` must be open for both reading and writing and is not owned.  If the file is non-empty,
+  // it is opened for append:  an existing footer is removed (it will be rewritten by finish()),
+  // and if the file has no valid footer, any torn message at the end is truncated away.
+  //
+  // An index block is written after every `indexInterval` messages.  If the file already has
+  // index blocks, the interval they use is kept instead.
+
+  KJ_DISALLOW_COPY(MessageLogWriter);
+  ~MessageLogWriter() noexcept(false);
+  // Calls finish() unless it has already been called since the last write.
+
+  void write(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
+  void write(MessageBuilder& builder);
+  // Append one message.
+
+  void finish();
+  // Write out any full index blocks that are due, followed by the footer.  Writing more messages
+  // afterwards is allowed; the footer is then removed and rewritten by the next finish().
+
+  inline uint64_t size() const { return messageCount; }
+  // Number of messages in the log.
+
+  inline bool wasRecovered() const { return recovered; }
+  // True if the file was non-empty but had no valid footer when the writer was constructed, so
+  // it had to be scanned.
+
+private:
+  int fd;
+  uint indexInterval;
+  uint64_t messageCount = 0;
+  uint64_t endOffset = 0;   // in words
+  kj::Vector<uint64_t> indexBlocks;
+  kj::Vector<uint64_t> unindexed;
+  // Offsets, in words, of the index blocks written so far and of the messages after the last
+  // message covered by an index block.
+
+  kj::Maybe<uint64_t> footerOffset;
+  bool recovered = false;
+  kj::UnwindDetector unwindDetector;
+
+  void flushIndexBlocks();
+  void truncate(uint64_t offset);
+};
+
+class MessageLogReader {
+  // Provides random access to the messages in a log file, which is mapped read-only into memory
+  // (see MmapMessageFile).  Each message is returned as its words including the segment table,
+  // which can be passed to FlatArrayMessageReader.  A file written without an index is also
+  // accepted; it is simply scanned up-front.
+
+public:
+  explicit MessageLogReader(int fd);
+  // Map the file.  The descriptor is not retained.
+
+  KJ_DISALLOW_COPY(MessageLogReader);
+  ~MessageLogReader() noexcept(false);
+
+  inline size_t size() const { return messageCount; }
+
+  kj::ArrayPtr<const word> operator[](size_t index) const;
+  // Get message number `index`.  O(1).
+
+  inline bool wasRecovered() const { return recovered; }
+  // True if the file had no valid footer (e.g. the writer died or the file was written without
+  // an index) and so had to be scanned.
+
+  class Iterator;
+  Iterator begin() const;
+  Iterator end() const;
+  // Iterates in order.  The iterator also supports `--`, so the messages can be visited in
+  // reverse by starting from end().
+
+private:
+  MmapMessageFile file;
+  size_t messageCount = 0;
+  uint indexInterval = 0;
+  kj::Array<uint64_t> indexBlocks;
+  kj::Array<uint64_t> unindexed;
+  bool recovered = false;
+};
+
+class MessageLogReader::Iterator {
+public:
+  Iterator() = default;
+
+  inline kj::ArrayPtr<const word> operator*() const { return (*log)[index]; }
+  inline Iterator& operator++() { ++index; return *this; }
+  inline Iterator operator++(int) { Iterator result = *this; ++index; return result; }
+  inline Iterator& operator--() { --index; return *this; }
+  inline Iterator operator--(int) { Iterator result = *this; --index; return result; }
+
+  inline bool operator==(const Iterator& other) const { return index == other.index; }
+  inline bool operator!=(const Iterator& other) const { return index != other.index; }
+
+  inline size_t getIndex() const { return index; }
+
+private:
+  const MessageLogReader* log = nullptr;
+  size_t index = 0;
+
+  Iterator(const MessageLogReader* log, size_t index): log(log), index(index) {}
+  friend class MessageLogReader;
+};
+
+// =======================================================================================
+// inline stuff
+
+inline void MessageLogWriter::write(MessageBuilder& builder) {
+  write(builder.getSegmentsForOutput());
+}
+
+inline MessageLogReader::Iterator MessageLogReader::begin() const {
+  return Iterator(this, 0);
+}
+
+inline MessageLogReader::Iterator MessageLogReader::end() const {
+  return Iterator(this, messageCount);
+}
+
+}  // namespace capnp
+
+#endif  // CAPNP_SERIALIZE_LOG_H_
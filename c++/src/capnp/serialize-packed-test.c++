@@ -86,7 +86,8 @@ private:
   std::string::size_type readPos;
 };
 
-void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> packed) {
+void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> packed,
+                   PackingKernel kernel) {
   TestPipe pipe;
 
   EXPECT_EQ(unpacked.size(), computeUnpackedSizeInWords(packed) * sizeof(word));
@@ -96,7 +97,7 @@ void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> p
 
   {
     kj::BufferedOutputStreamWrapper bufferedOut(pipe);
-    PackedOutputStream packedOut(bufferedOut);
+    PackedOutputStream packedOut(bufferedOut, kernel);
     packedOut.write(unpacked.begin(), unpacked.size());
   }
 
@@ -112,7 +113,7 @@ void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> p
   kj::Array<byte> roundTrip = kj::heapArray<byte>(unpacked.size());
 
   {
-    PackedInputStream packedIn(pipe);
+    PackedInputStream packedIn(pipe, kernel);
     packedIn.InputStream::read(roundTrip.begin(), roundTrip.size());
     EXPECT_TRUE(pipe.allRead());
   }
@@ -127,7 +128,7 @@ void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> p
     pipe.resetRead(blockSize);
 
     {
-      PackedInputStream packedIn(pipe);
+      PackedInputStream packedIn(pipe, kernel);
       packedIn.InputStream::read(roundTrip.begin(), roundTrip.size());
       EXPECT_TRUE(pipe.allRead());
     }
@@ -144,7 +145,7 @@ void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> p
   pipe.resetRead();
 
   {
-    PackedInputStream packedIn(pipe);
+    PackedInputStream packedIn(pipe, kernel);
     packedIn.skip(unpacked.size());
     EXPECT_TRUE(pipe.allRead());
   }
@@ -153,7 +154,7 @@ void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> p
     pipe.resetRead(blockSize);
 
     {
-      PackedInputStream packedIn(pipe);
+      PackedInputStream packedIn(pipe, kernel);
       packedIn.skip(unpacked.size());
       EXPECT_TRUE(pipe.allRead());
     }
@@ -166,14 +167,14 @@ void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> p
 
   {
     kj::BufferedOutputStreamWrapper bufferedOut(pipe);
-    PackedOutputStream packedOut(bufferedOut);
+    PackedOutputStream packedOut(bufferedOut, kernel);
     for (uint i = 0; i < 5; i++) {
       packedOut.write(unpacked.begin(), unpacked.size());
     }
   }
 
   for (uint i = 0; i < 5; i++) {
-    PackedInputStream packedIn(pipe);
+    PackedInputStream packedIn(pipe, kernel);
     packedIn.InputStream::read(&*roundTrip.begin(), roundTrip.size());
 
     if (memcmp(roundTrip.begin(), unpacked.begin(), unpacked.size()) != 0) {
@@ -185,6 +186,13 @@ void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> p
   EXPECT_TRUE(pipe.allRead());
 }
 
+void expectPacksTo(kj::ArrayPtr<const byte> unpacked, kj::ArrayPtr<const byte> packed) {
+  expectPacksTo(unpacked, packed, PackingKernel::SCALAR);
+  if (isPackingKernelSupported(PackingKernel::SSE42)) {
+    expectPacksTo(unpacked, packed, PackingKernel::SSE42);
+  }
+}
+
 #ifdef __CDT_PARSER__
 // CDT doesn't seem to understand these initializer lists.
 #define expectPacksTo(...)
@@ -211,6 +219,35 @@ TEST(Packed, SimplePacking) {
       {0xed,8,100,6,1,1,2, 0,2, 0xd4,1,2,3,1});
 }
 
+TEST(Packed, KernelsAgree) {
+  // Pack random data with a mix of zero and nonzero bytes using the scalar kernel, then check that
+  // every other supported kernel produces exactly the same bytes and unpacks them correctly,
+  // including across buffer boundaries.
+
+  if (!isPackingKernelSupported(PackingKernel::SSE42)) {
+    return;
+  }
+
+  srand(123);
+  for (uint density: {0, 2, 6, 8}) {
+    // `density` out of 8 bytes are nonzero, on average.  Runs of all-zero and all-nonzero words
+    // are common at the extremes.
+    kj::Array<byte> unpacked = kj::heapArray<byte>(8 * 1000);
+    for (auto& b: unpacked) {
+      b = (uint)rand() % 8 < density ? (rand() % 255) + 1 : 0;
+    }
+
+    TestPipe scalarPipe;
+    {
+      kj::BufferedOutputStreamWrapper bufferedOut(scalarPipe);
+      PackedOutputStream packedOut(bufferedOut, PackingKernel::SCALAR);
+      packedOut.write(unpacked.begin(), unpacked.size());
+    }
+
+    expectPacksTo(unpacked, scalarPipe.getArray(), PackingKernel::SSE42);
+  }
+}
+
 // =======================================================================================
 
 class TestMessageBuilder: public MallocMessageBuilder {
@@ -24,11 +24,194 @@
 #include "layout.h"
 #include <vector>
 
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && \
+    !defined(CAPNP_DISABLE_SIMD_PACKING)
+// We compile the vectorized kernels with per-function target attributes and choose between them
+// at runtime, so that the library as a whole can still be built for baseline x86.
+#define CAPNP_SIMD_PACKING 1
+#include <nmmintrin.h>
+#else
+#define CAPNP_SIMD_PACKING 0
+#endif
+
 namespace capnp {
 
 namespace _ {  // private
 
-PackedInputStream::PackedInputStream(kj::BufferedInputStream& inner): inner(inner) {}
+bool isPackingKernelSupported(PackingKernel kernel) {
+  switch (kernel) {
+    case PackingKernel::AUTO:
+    case PackingKernel::SCALAR:
+      return true;
+    case PackingKernel::SSE42:
+#if CAPNP_SIMD_PACKING
+      return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+#else
+      return false;
+#endif
+  }
+  KJ_UNREACHABLE;
+}
+
+namespace {
+
+PackingKernel resolveKernel(PackingKernel kernel) {
+  KJ_REQUIRE(isPackingKernelSupported(kernel), "Packing kernel not supported on this CPU.") {
+    return PackingKernel::SCALAR;
+  }
+
+  if (kernel == PackingKernel::AUTO) {
+    return isPackingKernelSupported(PackingKernel::SSE42) ?
+        PackingKernel::SSE42 : PackingKernel::SCALAR;
+  } else {
+    return kernel;
+  }
+}
+
+#if CAPNP_SIMD_PACKING
+
+struct ShuffleTables {
+  // For each possible tag byte, the PSHUFB control masks which move the nonzero bytes of a word
+  // to the front (`pack`) or back out to their original positions (`unpack`).  A control byte
+  // with the high bit set produces a zero.
+
+  uint8_t pack[256][8];
+  uint8_t unpack[256][8];
+
+  ShuffleTables() {
+    for (uint tag = 0; tag < 256; tag++) {
+      uint n = 0;
+      for (uint i = 0; i < 8; i++) {
+        if (tag & (1u << i)) {
+          pack[tag][n] = i;
+          unpack[tag][i] = n++;
+        } else {
+          unpack[tag][i] = 0x80;
+        }
+      }
+      for (uint i = n; i < 8; i++) {
+        pack[tag][i] = 0x80;
+      }
+    }
+  }
+};
+
+const ShuffleTables& getShuffleTables() {
+  static const ShuffleTables tables;
+  return tables;
+}
+
+__attribute__((target("sse4.2,popcnt")))
+void unpackWordsSse42(const uint8_t* __restrict__& in, const uint8_t* inEnd,
+                      uint8_t* __restrict__& out, uint8_t* outEnd) {
+  // Unpacks whole words for as long as at least 10 bytes of input remain, which is enough for any
+  // tag, its data bytes, and a run count.  Stops before any word whose run would overflow the
+  // output or extend past the end of the input buffer, leaving it to the scalar loop to refill the
+  // buffer or report the error.
+
+  const ShuffleTables& tables = getShuffleTables();
+
+  while (inEnd - in >= 10 && out < outEnd) {
+    uint tag = in[0];
+
+    if (tag == 0) {
+      // No data bytes, so the run count immediately follows the tag.
+      size_t runLength = in[1] * sizeof(word);
+      if (runLength > (size_t)(outEnd - out) - sizeof(word)) break;
+      memset(out, 0, sizeof(word) + runLength);
+      out += sizeof(word) + runLength;
+      in += 2;
+    } else if (tag == 0xffu) {
+      // The uncompressed run immediately follows the count, so the whole thing is one copy.
+      size_t runLength = in[9] * sizeof(word);
+      if (runLength > (size_t)(outEnd - out) - sizeof(word)) break;
+      if (runLength > (size_t)(inEnd - in) - 10) break;
+      memcpy(out, in + 1, sizeof(word));
+      memcpy(out + sizeof(word), in + 10, runLength);
+      out += sizeof(word) + runLength;
+      in += 10 + runLength;
+    } else {
+      __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + 1));
+      __m128i control = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tables.unpack[tag]));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(packed, control));
+      out += sizeof(word);
+      in += 1 + _mm_popcnt_u32(tag);
+    }
+  }
+}
+
+__attribute__((target("sse4.2,popcnt")))
+void packWordsSse42(const uint8_t* __restrict__& in, const uint8_t* inEnd,
+                    uint8_t* __restrict__& out, uint8_t* outEnd) {
+  // Packs whole words for as long as at least 10 bytes of output space remain, which is enough
+  // for any word plus its run count.  Stops before any word whose uncompressed run does not fit
+  // in the remaining space, leaving it to the scalar loop to hand the run to the underlying
+  // stream directly.  The encoding decisions are exactly those of the scalar loop.
+
+  const ShuffleTables& tables = getShuffleTables();
+  const __m128i zero = _mm_setzero_si128();
+
+  while (in < inEnd && outEnd - out >= 10) {
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+    uint tag = ~_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)) & 0xffu;
+
+    if (tag == 0xffu) {
+      // Find the run of following words which have no more than one zero byte each.
+      const uint8_t* runStart = in + sizeof(word);
+      const uint8_t* limit = inEnd;
+      if ((size_t)(limit - runStart) > 255 * sizeof(word)) {
+        limit = runStart + 255 * sizeof(word);
+      }
+
+      const uint8_t* runEnd = runStart;
+      while (runEnd < limit) {
+        __m128i next = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(runEnd));
+        uint zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(next, zero)) & 0xffu;
+        if (_mm_popcnt_u32(zeros) >= 2) break;
+        runEnd += sizeof(word);
+      }
+
+      size_t count = runEnd - runStart;
+      if (count > (size_t)(outEnd - out) - 10) break;
+
+      out[0] = 0xffu;
+      memcpy(out + 1, in, sizeof(word));
+      out[9] = count / sizeof(word);
+      memcpy(out + 10, runStart, count);
+      out += 10 + count;
+      in = runEnd;
+    } else {
+      __m128i control = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tables.pack[tag]));
+      *out++ = tag;
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(bytes, control));
+      out += _mm_popcnt_u32(tag);
+      in += sizeof(word);
+
+      if (tag == 0) {
+        const uint64_t* inWord = reinterpret_cast<const uint64_t*>(in);
+        const uint64_t* limit = reinterpret_cast<const uint64_t*>(inEnd);
+        if (limit - inWord > 255) {
+          limit = inWord + 255;
+        }
+
+        while (inWord < limit && *inWord == 0) {
+          ++inWord;
+        }
+
+        *out++ = inWord - reinterpret_cast<const uint64_t*>(in);
+        in = reinterpret_cast<const uint8_t*>(inWord);
+      }
+    }
+  }
+}
+
+#endif  // CAPNP_SIMD_PACKING
+
+}  // namespace
+
+PackedInputStream::PackedInputStream(kj::BufferedInputStream& inner, PackingKernel kernel)
+    : inner(inner), kernel(resolveKernel(kernel)) {}
 PackedInputStream::~PackedInputStream() noexcept(false) {}
 
 size_t PackedInputStream::tryRead(void* dst, size_t minBytes, size_t maxBytes) {
@@ -66,6 +249,18 @@ size_t PackedInputStream::tryRead(void* dst, size_t minBytes, size_t maxBytes) {
     KJ_DASSERT((out - reinterpret_cast<uint8_t*>(dst)) % sizeof(word) == 0,
            "Output pointer should always be aligned here.");
 
+#if CAPNP_SIMD_PACKING
+    if (kernel == PackingKernel::SSE42) {
+      // Handle the bulk of the buffer in vectorized code, then fall through to the scalar code to
+      // deal with whatever word it stopped on.
+      unpackWordsSse42(in, BUFFER_END, out, outEnd);
+      if (out == outEnd) {
+        inner.skip(in - reinterpret_cast<const uint8_t*>(buffer.begin()));
+        return maxBytes;
+      }
+    }
+#endif
+
     if (BUFFER_REMAINING < 10) {
       if (out >= outMin) {
         // We read at least the minimum amount, so go ahead and return.
@@ -298,8 +493,8 @@ void PackedInputStream::skip(size_t bytes) {
 
 // -------------------------------------------------------------------
 
-PackedOutputStream::PackedOutputStream(kj::BufferedOutputStream& inner)
-    : inner(inner) {}
+PackedOutputStream::PackedOutputStream(kj::BufferedOutputStream& inner, PackingKernel kernel)
+    : inner(inner), kernel(resolveKernel(kernel)) {}
 PackedOutputStream::~PackedOutputStream() noexcept(false) {}
 
 void PackedOutputStream::write(const void* src, size_t size) {
@@ -325,6 +520,16 @@ void PackedOutputStream::write(const void* src, size_t size) {
       out = reinterpret_cast<uint8_t*>(buffer.begin());
     }
 
+#if CAPNP_SIMD_PACKING
+    if (kernel == PackingKernel::SSE42) {
+      // Handle as much as we can in vectorized code.  It stops either when the output buffer is
+      // nearly full or on a run too long for the buffer, which the scalar code below handles.
+      packWordsSse42(in, inEnd, out, reinterpret_cast<uint8_t*>(buffer.end()));
+      if (in == inEnd) break;
+      if (reinterpret_cast<uint8_t*>(buffer.end()) - out < 10) continue;
+    }
+#endif
+
     uint8_t* tagPos = out++;
 
 #define HANDLE_BYTE(n) \
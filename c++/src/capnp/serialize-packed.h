@@ -32,12 +32,33 @@ namespace capnp {
 
 namespace _ {  // private
 
+enum class PackingKernel {
+  // Selects the implementation used by PackedInputStream and PackedOutputStream to transform each
+  // word.  All kernels produce byte-for-byte identical output; they differ only in speed.
+
+  AUTO,
+  // Use the fastest kernel supported by the CPU we're running on.
+
+  SCALAR,
+  // Portable implementation which handles one byte at a time.
+
+  SSE42
+  // x86 implementation which computes tag bytes with a vector compare and moves bytes into or out
+  // of place with a shuffle lookup table.  Only available when compiled with GCC or Clang for x86
+  // and running on a CPU supporting SSE4.2.
+};
+
+bool isPackingKernelSupported(PackingKernel kernel);
+// Returns true if the given kernel can be used on this machine.  AUTO and SCALAR are always
+// supported.
+
 class PackedInputStream: public kj::InputStream {
   // An input stream that unpacks packed data with a picky constraint:  The caller must read data
   // in the exact same size and sequence as the data was written to PackedOutputStream.
 
 public:
-  explicit PackedInputStream(kj::BufferedInputStream& inner);
+  explicit PackedInputStream(kj::BufferedInputStream& inner,
+                             PackingKernel kernel = PackingKernel::AUTO);
   KJ_DISALLOW_COPY(PackedInputStream);
   ~PackedInputStream() noexcept(false);
 
@@ -47,11 +68,13 @@ public:
 
 private:
   kj::BufferedInputStream& inner;
+  PackingKernel kernel;
 };
 
 class PackedOutputStream: public kj::OutputStream {
 public:
-  explicit PackedOutputStream(kj::BufferedOutputStream& inner);
+  explicit PackedOutputStream(kj::BufferedOutputStream& inner,
+                              PackingKernel kernel = PackingKernel::AUTO);
   KJ_DISALLOW_COPY(PackedOutputStream);
   ~PackedOutputStream() noexcept(false);
 
@@ -60,6 +83,7 @@ public:
 
 private:
   kj::BufferedOutputStream& inner;
+  PackingKernel kernel;
 };
 
 }  // namespace _ (private)
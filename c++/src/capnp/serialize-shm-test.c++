@@ -0,0 +1,237 @@
+// Copyright (c) 2017 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#if __linux__
+
+#include "serialize-shm.h"
+#include <kj/debug.h>
+#include <kj/compat/gtest.h>
+#include <kj/thread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "test-util.h"
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+TEST(SharedRing, RoundTrip) {
+  SharedMessageRing ring(4096);
+  EXPECT_FALSE(ring.hasMessage());
+
+  {
+    SharedRingMessageBuilder builder(ring);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    builder.send();
+  }
+  EXPECT_TRUE(ring.hasMessage());
+
+  {
+    SharedRingMessageReader reader(ring);
+    checkTestMessage(reader.getRoot<TestAllTypes>());
+  }
+  EXPECT_FALSE(ring.hasMessage());
+}
+
+TEST(SharedRing, MultipleSegments) {
+  SharedMessageRing ring(4096);
+
+  {
+    SharedRingMessageBuilder builder(ring, 8);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    EXPECT_GT(builder.getSegmentsForOutput().size(), 1u);
+    builder.send();
+  }
+
+  SharedRingMessageReader reader(ring);
+  checkTestMessage(reader.getRoot<TestAllTypes>());
+}
+
+TEST(SharedRing, CopyOut) {
+  SharedMessageRing ring(4096);
+
+  for (uint i = 0; i < 2; i++) {
+    SharedRingMessageBuilder builder(ring, 8);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    builder.send();
+  }
+
+  // A copied-out message gives its space back right away, so both may be held at once.
+  SharedRingMessageReader first(ring, ReaderOptions(), true);
+  EXPECT_TRUE(ring.hasMessage());
+  SharedRingMessageReader second(ring, ReaderOptions(), true);
+  EXPECT_FALSE(ring.hasMessage());
+
+  // Later writes to the ring don't affect the copies.
+  {
+    SharedRingMessageBuilder builder(ring);
+    builder.initRoot<TestAllTypes>().setTextField("overwritten");
+    builder.send();
+  }
+
+  checkTestMessage(first.getRoot<TestAllTypes>());
+  checkTestMessage(second.getRoot<TestAllTypes>());
+}
+
+TEST(SharedRing, WrapAround) {
+  // Messages of varying size through a small ring, so that segments regularly wrap.
+  SharedMessageRing ring(256);
+
+  for (uint i = 0; i < 200; i++) {
+    {
+      SharedRingMessageBuilder builder(ring, 4);
+      auto root = builder.initRoot<TestAllTypes>();
+      root.setUInt32Field(i);
+      auto list = root.initUInt32List(i % 37);
+      for (uint j = 0; j < list.size(); j++) list.set(j, j);
+      builder.send();
+    }
+
+    SharedRingMessageReader reader(ring);
+    auto root = reader.getRoot<TestAllTypes>();
+    ASSERT_EQ(i, root.getUInt32Field());
+    ASSERT_EQ(i % 37, root.getUInt32List().size());
+  }
+}
+
+TEST(SharedRing, DiscardedBuilder) {
+  SharedMessageRing ring(256);
+
+  {
+    SharedRingMessageBuilder builder(ring);
+    builder.initRoot<TestAllTypes>().setTextField("discarded");
+  }
+  EXPECT_FALSE(ring.hasMessage());
+
+  {
+    SharedRingMessageBuilder builder(ring);
+    builder.initRoot<TestAllTypes>().setTextField("sent");
+    builder.send();
+  }
+
+  SharedRingMessageReader reader(ring);
+  EXPECT_EQ("sent", reader.getRoot<TestAllTypes>().getTextField());
+}
+
+TEST(SharedRing, SendUninitialized) {
+  SharedMessageRing ring(256);
+  SharedRingMessageBuilder builder(ring);
+  EXPECT_ANY_THROW(builder.send());
+  EXPECT_FALSE(ring.hasMessage());
+}
+
+TEST(SharedRing, SkipsCorruptMessage) {
+  SharedMessageRing ring(256);
+  for (auto text: {"corrupt", "fine"}) {
+    SharedRingMessageBuilder builder(ring);
+    builder.initRoot<TestAllTypes>().setTextField(text);
+    builder.send();
+  }
+
+  // Claim an absurd segment count in the first message's header, as a misbehaving peer might.
+  struct stat stats;
+  KJ_SYSCALL(fstat(ring.getFd(), &stats));
+  void* ptr = mmap(nullptr, stats.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring.getFd(), 0);
+  ASSERT_NE(MAP_FAILED, ptr);
+  auto data = reinterpret_cast<uint32_t*>(
+      reinterpret_cast<byte*>(ptr) + stats.st_size - ring.getCapacity() * sizeof(word));
+  data[0] = 100000;
+  munmap(ptr, stats.st_size);
+
+  EXPECT_ANY_THROW(SharedRingMessageReader reader(ring));
+
+  SharedRingMessageReader reader(ring);
+  EXPECT_EQ("fine", reader.getRoot<TestAllTypes>().getTextField());
+}
+
+TEST(SharedRing, MessageTooLarge) {
+  SharedMessageRing ring(64);
+  SharedRingMessageBuilder builder(ring);
+  auto root = builder.initRoot<TestAllTypes>();
+  EXPECT_ANY_THROW(root.initDataField(1024));
+}
+
+TEST(SharedRing, AcrossMappings) {
+  // The producer and consumer map the ring separately, as two processes would, and the ring is
+  // small enough that both sides regularly have to wait for each other.
+  SharedMessageRing producerRing(128);
+  SharedMessageRing consumerRing(kj::AutoCloseFd(dup(producerRing.getFd())));
+  EXPECT_EQ(128u, consumerRing.getCapacity());
+
+  constexpr uint COUNT = 10000;
+
+  kj::Thread thread([&]() {
+    for (uint i = 0; i < COUNT; i++) {
+      SharedRingMessageBuilder builder(producerRing, 16);
+      auto root = builder.initRoot<TestAllTypes>();
+      root.setUInt64Field(i);
+      root.setTextField(kj::str(i));
+      builder.send();
+    }
+  });
+
+  for (uint i = 0; i < COUNT; i++) {
+    SharedRingMessageReader reader(consumerRing);
+    auto root = reader.getRoot<TestAllTypes>();
+    ASSERT_EQ(i, root.getUInt64Field());
+    ASSERT_EQ(kj::str(i), root.getTextField());
+  }
+}
+
+TEST(SharedRing, RejectsNonRing) {
+  int fds[2];
+  KJ_SYSCALL(pipe(fds));
+  kj::AutoCloseFd out(fds[1]);
+  EXPECT_ANY_THROW(SharedMessageRing(kj::AutoCloseFd(fds[0])));
+}
+
+TEST(SharedRing, Sealed) {
+  SharedMessageRing ring(128);
+
+  // The peer can't resize the ring.
+  struct stat stats;
+  KJ_SYSCALL(fstat(ring.getFd(), &stats));
+  EXPECT_EQ(-1, ftruncate(ring.getFd(), 0));
+  EXPECT_EQ(EPERM, errno);
+  EXPECT_EQ(-1, ftruncate(ring.getFd(), stats.st_size * 2));
+  EXPECT_EQ(EPERM, errno);
+
+  // An identical copy of the ring that isn't sealed is rejected.
+  int rawFd;
+  KJ_SYSCALL(rawFd = memfd_create("capnp-ring-test", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+  kj::AutoCloseFd copy(rawFd);
+  auto content = kj::heapArray<byte>(stats.st_size);
+  KJ_SYSCALL(pread(ring.getFd(), content.begin(), content.size(), 0));
+  KJ_SYSCALL(pwrite(copy, content.begin(), content.size(), 0));
+  EXPECT_ANY_THROW(SharedMessageRing(kj::AutoCloseFd(dup(copy))));
+
+  KJ_SYSCALL(fcntl(copy, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL));
+  SharedMessageRing sealedCopy(kj::mv(copy));
+  EXPECT_EQ(128u, sealedCopy.getCapacity());
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
+
+#endif  // __linux__
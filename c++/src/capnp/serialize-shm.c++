@@ -0,0 +1,418 @@
+// Copyright (c) 2017 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#if __linux__
+
+#include "serialize-shm.h"
+#include <kj/debug.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#ifndef SYS_futex
+// Missing on Android/Bionic.
+#define SYS_futex __NR_futex
+#endif
+
+namespace capnp {
+
+namespace {
+
+// The ring's data area is a sequence of records, each starting with a one-word header.  A
+// message consists of a message header followed by the message's segments, each with its own
+// segment header.  Positions are counted in words since the ring was created and never wrap;
+// the offset within the data area is the position modulo the capacity.
+
+constexpr uint64_t RING_MAGIC = 0x676e6972706e6163ull;  // "capnring"
+
+constexpr uint32_t WRAP_MARKER = 1;
+// Value for the upper half of a segment header meaning that the rest of the data area is unused
+// and the segment actually starts at offset zero.
+
+inline uint64_t makeRecordHeader(uint32_t lower, uint32_t upper) {
+  return uint64_t(lower) | (uint64_t(upper) << 32);
+}
+
+void futexWait(uint32_t* futex, uint32_t expected) {
+  // Not FUTEX_WAIT_PRIVATE:  the futex is shared with another process.
+  syscall(SYS_futex, futex, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+void futexWake(uint32_t* futex) {
+  syscall(SYS_futex, futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+class MunmapDisposer: public kj::ArrayDisposer {
+protected:
+  void disposeImpl(void* firstElement, size_t elementSize, size_t elementCount,
+                   size_t capacity, void (*destroyElement)(void*)) const {
+    munmap(firstElement, elementSize * elementCount);
+  }
+};
+
+constexpr MunmapDisposer munmapDisposer = MunmapDisposer();
+
+}  // namespace
+
+struct SharedMessageRing::Header {
+  // Lives at the start of the shared region.  The producer's and consumer's fields are kept on
+  // separate cache lines so that the two sides don't contend on every update.
+
+  uint64_t magic;
+  uint64_t capacity;
+
+  alignas(64) uint64_t head;
+  // Position up to which messages have been published.  Written only by the producer.
+
+  uint32_t messageSeq;
+  // Incremented after each publish; the consumer waits on this futex when the ring is empty.
+
+  uint32_t producerWaiting;
+
+  alignas(64) uint64_t tail;
+  // Position up to which messages have been released.  Written only by the consumer.
+
+  uint32_t spaceSeq;
+  // Incremented after each release; the producer waits on this futex when the ring is full.
+
+  uint32_t consumerWaiting;
+};
+
+static constexpr int REQUIRED_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+// Fixes the ring's size for good, so that neither side can pull pages out from under the other's
+// mapping.
+
+SharedMessageRing::SharedMessageRing(uint capacityInWords)
+    : capacity(capacityInWords) {
+  KJ_REQUIRE(capacityInWords >= 2 && capacityInWords < (1u << 31),
+             "Invalid shared ring capacity.", capacityInWords);
+
+  int rawFd;
+  KJ_SYSCALL(rawFd = memfd_create("capnp-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+  fd = kj::AutoCloseFd(rawFd);
+  KJ_SYSCALL(ftruncate(fd, sizeof(Header) + capacityInWords * sizeof(word)));
+  KJ_SYSCALL(fcntl(fd, F_ADD_SEALS, REQUIRED_SEALS));
+  init();
+
+  // The new file is zero-filled, so only the immutable fields need setting.
+  header->capacity = capacityInWords;
+  __atomic_store_n(&header->magic, RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+SharedMessageRing::SharedMessageRing(kj::AutoCloseFd fdParam)
+    : fd(kj::mv(fdParam)) {
+  // Without the seals, the peer could shrink the file after we map it, and our next access to the
+  // missing pages would raise SIGBUS.
+  int seals = fcntl(fd, F_GET_SEALS);
+  KJ_REQUIRE(seals >= 0 && (seals & REQUIRED_SEALS) == REQUIRED_SEALS,
+             "File descriptor is not a sealed shared message ring.");
+  init();
+
+  KJ_REQUIRE(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == RING_MAGIC,
+             "File descriptor is not a shared message ring.");
+  uint64_t claimedCapacity = header->capacity;
+  KJ_REQUIRE(claimedCapacity >= 2 &&
+             claimedCapacity <= (mapping.size() - sizeof(Header)) / sizeof(word),
+             "Shared ring header claims more capacity than the file has.");
+  capacity = claimedCapacity;
+}
+
+void SharedMessageRing::init() {
+  static_assert(sizeof(Header) % sizeof(word) == 0, "Ring data must be word-aligned.");
+
+  struct stat stats;
+  KJ_SYSCALL(fstat(fd, &stats));
+  KJ_REQUIRE(size_t(stats.st_size) >= sizeof(Header) + 2 * sizeof(word),
+             "File descriptor is too small to be a shared message ring.");
+
+  void* ptr = mmap(nullptr, stats.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED) {
+    KJ_FAIL_SYSCALL("mmap", errno);
+  }
+  mapping = kj::Array<byte>(reinterpret_cast<byte*>(ptr), stats.st_size, munmapDisposer);
+
+  header = reinterpret_cast<Header*>(mapping.begin());
+  data = reinterpret_cast<word*>(mapping.begin() + sizeof(Header));
+}
+
+SharedMessageRing::~SharedMessageRing() noexcept(false) {
+  KJ_ASSERT(!writing && !reading,
+            "SharedMessageRing destroyed while a builder or reader still uses it.") {
+    break;
+  }
+}
+
+uint64_t SharedMessageRing::loadHead() {
+  return __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+}
+
+uint64_t SharedMessageRing::loadTail() {
+  return __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+}
+
+bool SharedMessageRing::hasMessage() {
+  return loadHead() != loadTail();
+}
+
+void SharedMessageRing::waitForSpace(uint64_t end) {
+  // Wait until the consumer has released everything before `end - capacity`.
+
+  for (;;) {
+    uint32_t seq = __atomic_load_n(&header->spaceSeq, __ATOMIC_ACQUIRE);
+    uint64_t tail = loadTail();
+    KJ_REQUIRE(tail <= writePos, "Shared ring corrupted by peer.");
+    if (end - tail <= capacity) return;
+
+    // Announce that we're about to sleep, then check again, so that a release racing with us
+    // either sees the flag or is seen by us.
+    __atomic_store_n(&header->producerWaiting, 1, __ATOMIC_SEQ_CST);
+    if (end - __atomic_load_n(&header->tail, __ATOMIC_SEQ_CST) > capacity) {
+      futexWait(&header->spaceSeq, seq);
+    }
+    __atomic_store_n(&header->producerWaiting, 0, __ATOMIC_RELAXED);
+  }
+}
+
+void SharedMessageRing::waitForMessage() {
+  uint64_t tail = loadTail();
+  for (;;) {
+    uint32_t seq = __atomic_load_n(&header->messageSeq, __ATOMIC_ACQUIRE);
+    if (loadHead() != tail) return;
+
+    __atomic_store_n(&header->consumerWaiting, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->head, __ATOMIC_SEQ_CST) == tail) {
+      futexWait(&header->messageSeq, seq);
+    }
+    __atomic_store_n(&header->consumerWaiting, 0, __ATOMIC_RELAXED);
+  }
+}
+
+uint64_t SharedMessageRing::reserve(uint64_t amount, uint64_t messageStart) {
+  // Reserve `amount` contiguous words for the message starting at `messageStart`, and return
+  // the offset of the first one in the data area.
+
+  uint64_t offset = writePos % capacity;
+  uint64_t skip = offset + amount > capacity ? capacity - offset : 0;
+
+  KJ_REQUIRE(writePos + skip + amount - messageStart <= capacity,
+             "Message is too large for the shared ring.", capacity);
+
+  waitForSpace(writePos + skip + amount);
+
+  if (skip > 0) {
+    *reinterpret_cast<uint64_t*>(data + offset) = makeRecordHeader(0, WRAP_MARKER);
+    writePos += skip;
+    offset = 0;
+  }
+
+  writePos += amount;
+  return offset;
+}
+
+void SharedMessageRing::publish(uint64_t end) {
+  __atomic_store_n(&header->head, end, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&header->messageSeq, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&header->consumerWaiting, __ATOMIC_SEQ_CST)) {
+    futexWake(&header->messageSeq);
+  }
+}
+
+void SharedMessageRing::release(uint64_t end) {
+  __atomic_store_n(&header->tail, end, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&header->spaceSeq, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&header->producerWaiting, __ATOMIC_SEQ_CST)) {
+    futexWake(&header->spaceSeq);
+  }
+}
+
+// -------------------------------------------------------------------
+
+SharedRingMessageBuilder::SharedRingMessageBuilder(
+    SharedMessageRing& ring, uint firstSegmentWords)
+    : ring(ring), nextSize(kj::max(firstSegmentWords, 1u)) {
+  KJ_REQUIRE(!ring.writing, "Only one SharedRingMessageBuilder may exist per ring at a time.");
+
+  messageStart = ring.writePos = ring.loadHead();
+  ring.reserve(1, messageStart);  // message header, filled in by send()
+  ring.writing = true;
+}
+
+SharedRingMessageBuilder::~SharedRingMessageBuilder() noexcept(false) {
+  if (!sent) {
+    // Nothing was published, so just forget the reservation.
+    ring.writePos = messageStart;
+  }
+  ring.writing = false;
+}
+
+kj::ArrayPtr<word> SharedRingMessageBuilder::allocateSegment(uint minimumSize) {
+  KJ_REQUIRE(!sent, "SharedRingMessageBuilder used after send().");
+
+  // Grow geometrically like MallocMessageBuilder, but never ask for more than the ring could
+  // hold unless the caller needs it.
+  uint size = kj::max(minimumSize, kj::min(nextSize, ring.capacity / 2));
+  nextSize = kj::max(nextSize, size) * 2;
+
+  uint64_t offset = ring.reserve(size + 1, messageStart);
+  lastSegmentStart = ring.writePos - (size + 1);
+
+  word* segmentHeader = ring.data + offset;
+  *reinterpret_cast<uint64_t*>(segmentHeader) = makeRecordHeader(size, 0);
+  memset(segmentHeader + 1, 0, size * sizeof(word));
+  ++segmentCount;
+  return kj::arrayPtr(segmentHeader + 1, size);
+}
+
+void SharedRingMessageBuilder::send() {
+  KJ_REQUIRE(!sent, "SharedRingMessageBuilder::send() called twice.");
+
+  auto segments = getSegmentsForOutput();
+  KJ_REQUIRE(segments.size() > 0, "Tried to send uninitialized message.");
+  KJ_ASSERT(segments.size() == segmentCount);
+
+  // Give back the unused tail of the last segment.
+  auto lastUsed = segments.back().size();
+  uint64_t lastOffset = lastSegmentStart % ring.capacity;
+  *reinterpret_cast<uint64_t*>(ring.data + lastOffset) = makeRecordHeader(lastUsed, 0);
+  ring.writePos = lastSegmentStart + 1 + lastUsed;
+
+  *reinterpret_cast<uint64_t*>(ring.data + messageStart % ring.capacity) =
+      makeRecordHeader(segmentCount, ring.writePos - messageStart);
+
+  sent = true;
+  ring.publish(ring.writePos);
+}
+
+// -------------------------------------------------------------------
+
+SharedRingMessageReader::SharedRingMessageReader(
+    SharedMessageRing& ring, ReaderOptions options, bool copyOut)
+    : MessageReader(options), ring(ring) {
+  KJ_REQUIRE(!ring.reading, "Only one SharedRingMessageReader may exist per ring at a time.");
+
+  ring.waitForMessage();
+
+  // Everything below is read from memory the peer can write, so read each header word exactly
+  // once and check it before use.
+  uint64_t capacity = ring.capacity;
+  uint64_t start = ring.loadTail();
+  uint64_t head = ring.loadHead();
+
+  // If the message turns out to be unreadable, drop it anyway so the ring doesn't stay stuck on
+  // it.  Until the header has been checked we don't know where it ends, so drop everything.
+  uint64_t skipTo = head;
+  KJ_ON_SCOPE_FAILURE(ring.release(skipTo));
+
+  KJ_REQUIRE(head - start <= capacity, "Shared ring corrupted by peer.");
+
+  uint64_t messageHeader = __atomic_load_n(
+      reinterpret_cast<uint64_t*>(ring.data + start % capacity), __ATOMIC_RELAXED);
+  uint segmentCount = messageHeader & 0xffffffffu;
+  end = start + (messageHeader >> 32);
+  KJ_REQUIRE(segmentCount > 0 && end > start && end <= head,
+             "Shared ring message header is invalid.");
+  skipTo = end;
+  KJ_REQUIRE(segmentCount <= 512, "Message has too many segments.");
+
+  if (segmentCount > 1) {
+    moreSegments = kj::heapArray<kj::ArrayPtr<const word>>(segmentCount - 1);
+  }
+
+  uint64_t pos = start + 1;
+  for (uint i = 0; i < segmentCount; i++) {
+    KJ_REQUIRE(pos < end, "Shared ring message header is invalid.");
+    uint64_t offset = pos % capacity;
+    uint64_t segmentHeader = __atomic_load_n(
+        reinterpret_cast<uint64_t*>(ring.data + offset), __ATOMIC_RELAXED);
+    if ((segmentHeader >> 32) == WRAP_MARKER) {
+      pos += capacity - offset;
+      offset = 0;
+      KJ_REQUIRE(pos < end, "Shared ring message header is invalid.");
+      segmentHeader = __atomic_load_n(
+          reinterpret_cast<uint64_t*>(ring.data), __ATOMIC_RELAXED);
+    }
+    KJ_REQUIRE((segmentHeader >> 32) == 0, "Shared ring message header is invalid.");
+
+    uint64_t size = segmentHeader & 0xffffffffu;
+    KJ_REQUIRE(offset + 1 + size <= capacity && pos + 1 + size <= end,
+               "Shared ring message header is invalid.");
+
+    auto segment = kj::arrayPtr(ring.data + offset + 1, size);
+    if (i == 0) {
+      segment0 = segment;
+    } else {
+      moreSegments[i - 1] = segment;
+    }
+    pos += 1 + size;
+  }
+
+  if (copyOut) {
+    // The segment bounds are fixed now, so copying is safe no matter what the peer writes.
+    size_t total = segment0.size();
+    for (auto& segment: moreSegments) {
+      total += segment.size();
+    }
+    ownedSpace = kj::heapArray<word>(total);
+
+    word* dst = ownedSpace.begin();
+    auto copySegment = [&](kj::ArrayPtr<const word>& segment) {
+      memcpy(dst, segment.begin(), segment.size() * sizeof(word));
+      segment = kj::arrayPtr(dst, segment.size());
+      dst += segment.size();
+    };
+    copySegment(segment0);
+    for (auto& segment: moreSegments) {
+      copySegment(segment);
+    }
+
+    ring.release(end);
+    inRing = false;
+  } else {
+    ring.reading = true;
+  }
+}
+
+SharedRingMessageReader::~SharedRingMessageReader() noexcept(false) {
+  if (inRing) {
+    ring.release(end);
+    ring.reading = false;
+  }
+}
+
+kj::ArrayPtr<const word> SharedRingMessageReader::getSegment(uint id) {
+  if (id == 0) {
+    return segment0;
+  } else if (id <= moreSegments.size()) {
+    return moreSegments[id - 1];
+  } else {
+    return nullptr;
+  }
+}
+
+}  // namespace capnp
+
+#endif  // __linux__
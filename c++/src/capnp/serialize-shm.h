@@ -0,0 +1,178 @@
+// Copyright (c) 2017 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef CAPNP_SERIALIZE_SHM_H_
+#define CAPNP_SERIALIZE_SHM_H_
+
+#if defined(__GNUC__) && !defined(CAPNP_HEADER_WARNINGS)
+#pragma GCC system_header
+#endif
+
+#if !__linux__
+#error "serialize-shm.h requires Linux (memfd and futex)."
+#endif
+
+#include "message.h"
+#include <kj/io.h>
+
+namespace capnp {
+
+// =======================================================================================
+// Shared-memory message rings
+//
+// A SharedMessageRing is a single-producer, single-consumer queue of messages living in a
+// memfd-backed shared memory region, for passing messages between processes on the same host
+// without copying them through the kernel.  The producer builds each message directly inside the
+// ring using a SharedRingMessageBuilder; the consumer reads it in place with a
+// SharedRingMessageReader, whose segments point straight into the shared region.  Space is
+// returned to the producer when the reader is destroyed.
+//
+// In the steady state no system calls are made at all:  the two sides coordinate through atomic
+// positions in the ring's header, and fall back to a futex only when one side has to wait for
+// the other (the consumer because the ring is empty, or the producer because it is full).
+//
+// One process creates the ring and passes `getFd()` to the other (e.g. over a Unix socket with
+// SCM_RIGHTS, or by inheritance across fork()), which maps it with the fd constructor.  Either
+// side may be the producer.  A reader validates the segment table it finds in the ring before
+// using it, so a misbehaving peer can't make it read outside the ring.  However, by default the
+// message itself is read in place, from memory the peer can still modify while it is being
+// read, and Cap'n Proto's readers assume that a message doesn't change underneath them.  So
+// reading in place is memory-safe only if the peer is trusted.  When it isn't, construct the
+// SharedRingMessageReader with `copyOut = true`, which copies the message into private memory
+// (and releases its space in the ring) before anything in it is read.
+//
+// Messages must be fully produced and consumed in order.  At most one SharedRingMessageBuilder
+// and one SharedRingMessageReader may exist per ring at a time, and a message may be at most
+// about half the ring's capacity (a message which wraps around the end of the ring loses the
+// space between its last segment and the end).
+
+class SharedMessageRing {
+public:
+  explicit SharedMessageRing(uint capacityInWords);
+  // Create a new ring in an anonymous memfd with room for `capacityInWords` words of messages
+  // (plus a small header).  The memfd is sealed against resizing.
+
+  explicit SharedMessageRing(kj::AutoCloseFd fd);
+  // Map a ring created by another process, given its memfd.  Throws unless the memfd is sealed
+  // against resizing, since a peer that shrank it could otherwise crash this process with SIGBUS.
+
+  KJ_DISALLOW_COPY(SharedMessageRing);
+  ~SharedMessageRing() noexcept(false);
+
+  inline int getFd() const { return fd; }
+  // The memfd backing the ring, to be passed to the peer process.
+
+  inline uint getCapacity() const { return capacity; }
+  // Capacity of the ring in words.
+
+  bool hasMessage();
+  // Returns true if a message is waiting to be read, i.e. constructing a SharedRingMessageReader
+  // would not block.
+
+private:
+  struct Header;
+
+  kj::AutoCloseFd fd;
+  kj::Array<byte> mapping;
+  Header* header;
+  word* data;
+  uint capacity;
+
+  // Producer-side state.
+  bool writing = false;
+  uint64_t writePos = 0;
+
+  // Consumer-side state.
+  bool reading = false;
+
+  void init();
+  uint64_t loadHead();
+  uint64_t loadTail();
+  void waitForSpace(uint64_t end);
+  void waitForMessage();
+  uint64_t reserve(uint64_t amount, uint64_t messageStart);
+  void publish(uint64_t end);
+  void release(uint64_t end);
+
+  friend class SharedRingMessageBuilder;
+  friend class SharedRingMessageReader;
+};
+
+class SharedRingMessageBuilder: public MessageBuilder {
+  // Builds a message directly inside a SharedMessageRing.  Segments are allocated from the
+  // ring's free space as the message grows, blocking if necessary until the consumer frees
+  // enough space.  Call send() when done to make the message visible to the consumer.
+
+public:
+  explicit SharedRingMessageBuilder(SharedMessageRing& ring,
+                                    uint firstSegmentWords = SUGGESTED_FIRST_SEGMENT_WORDS);
+  KJ_DISALLOW_COPY(SharedRingMessageBuilder);
+  ~SharedRingMessageBuilder() noexcept(false);
+  // If send() was not called, the message is discarded and its space is reused by the next
+  // builder.
+
+  void send();
+  // Publish the message to the consumer.  Unused space at the end of the last segment is given
+  // back to the ring first.  After this the consumer may read and release the message at any
+  // time, so the builder must not be used again except to destroy it.
+
+  virtual kj::ArrayPtr<word> allocateSegment(uint minimumSize) override;
+
+private:
+  SharedMessageRing& ring;
+  uint64_t messageStart;
+  uint64_t lastSegmentStart = 0;
+  uint segmentCount = 0;
+  uint nextSize;
+  bool sent = false;
+};
+
+class SharedRingMessageReader: public MessageReader {
+  // Reads the next message from a SharedMessageRing, blocking until one is available.  The
+  // segments point directly into the ring; the message's space is released back to the producer
+  // when the reader is destroyed.
+  //
+  // If `copyOut` is true, the segments are instead copied into a private buffer and the ring
+  // space is released immediately, so the next message may be read while this one is still in
+  // use.  Use this whenever the peer is not trusted; see the comments at the top of the file.
+
+public:
+  explicit SharedRingMessageReader(SharedMessageRing& ring,
+                                   ReaderOptions options = ReaderOptions(),
+                                   bool copyOut = false);
+  KJ_DISALLOW_COPY(SharedRingMessageReader);
+  ~SharedRingMessageReader() noexcept(false);
+
+  virtual kj::ArrayPtr<const word> getSegment(uint id) override;
+
+private:
+  SharedMessageRing& ring;
+  uint64_t end;
+  bool inRing = true;  // false if the message was copied out and its space already released
+
+  kj::ArrayPtr<const word> segment0;
+  kj::Array<kj::ArrayPtr<const word>> moreSegments;
+  kj::Array<word> ownedSpace;
+};
+
+}  // namespace capnp
+
+#endif  // CAPNP_SERIALIZE_SHM_H_
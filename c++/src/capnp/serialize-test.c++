@@ -23,6 +23,7 @@
 #include <kj/debug.h>
 #include <kj/compat/gtest.h>
 #include <kj/miniposix.h>
+#include <kj/thread.h>
 #include <string>
 #include <stdlib.h>
 #include <fcntl.h>
@@ -195,6 +196,62 @@ TEST(Serialize, FlatArrayEvenSegmentCount) {
   }
 }
 
+TEST(Serialize, FlatArrayConcurrentReaders) {
+  // Many threads share one reader of a message with many segments, so that they race to create
+  // the same segments.
+  MallocMessageBuilder builder(0, AllocationStrategy::FIXED_SIZE);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  EXPECT_LT(16u, builder.getSegmentsForOutput().size());
+
+  kj::Array<word> serialized = messageToFlatArray(builder);
+
+  for (uint round = 0; round < 8; round++) {
+    ReaderOptions options;
+    options.traversalLimitInWords = kj::maxValue;
+    FlatArrayMessageReader reader(serialized.asPtr(), options);
+    auto root = reader.getRoot<TestAllTypes>();
+
+    kj::Vector<kj::Own<kj::Thread>> threads;
+    for (uint i = 0; i < 4; i++) {
+      threads.add(kj::heap<kj::Thread>([&]() {
+        for (uint j = 0; j < 16; j++) {
+          checkTestMessage(root);
+        }
+      }));
+    }
+  }
+}
+
+TEST(Serialize, CompactMessageToFlatArray) {
+  MallocMessageBuilder builder(1, AllocationStrategy::FIXED_SIZE);
+  auto root = builder.initRoot<TestAllTypes>();
+  initTestMessage(root);
+  root.setTextField("this text will be overwritten");
+  root.setTextField("foo");
+  root.setTextField("baz");
+
+  kj::Array<word> serialized = messageToFlatArray(builder);
+  FlatArrayMessageReader reader(serialized.asPtr());
+  EXPECT_LT(1u, reader.getSegment(1).size());
+
+  kj::Array<word> compacted = compactMessageToFlatArray(reader);
+  size_t size = reader.getRoot<TestAllTypes>().totalSize().wordCount + 1;
+  EXPECT_EQ(size + 1, compacted.size());
+  EXPECT_LT(compacted.size(), serialized.size());
+
+  FlatArrayMessageReader compactedReader(compacted.asPtr());
+  EXPECT_EQ(size, compactedReader.getSegment(0).size());
+  EXPECT_EQ(0u, compactedReader.getSegment(1).size());
+  auto compactedRoot = compactedReader.getRoot<TestAllTypes>();
+  EXPECT_EQ("baz", compactedRoot.getTextField());
+  EXPECT_EQ(-12345678, compactedRoot.getInt32Field());
+
+  // Already-compact input is copied verbatim.
+  kj::Array<word> again = compactMessageToFlatArray(compactedReader);
+  ASSERT_EQ(compacted.size(), again.size());
+  EXPECT_EQ(0, memcmp(compacted.begin(), again.begin(), compacted.asBytes().size()));
+}
+
 class TestInputStream: public kj::InputStream {
 public:
   TestInputStream(kj::ArrayPtr<const word> data, bool lazy)
@@ -316,6 +373,42 @@ TEST(Serialize, InputStreamToBuilder) {
   checkTestMessage(builder2.getRoot<TestAllTypes>());
 }
 
+class CountingSegmentAllocator: public ReaderSegmentAllocator {
+public:
+  kj::Array<word> allocateSegment(uint size) override {
+    ++count;
+    totalWords += size;
+    return kj::heapArray<word>(size);
+  }
+
+  uint count = 0;
+  size_t totalWords = 0;
+};
+
+TEST(Serialize, InputStreamSegmentAllocator) {
+  TestMessageBuilder builder(7);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+
+  kj::Array<word> serialized = messageToFlatArray(builder);
+
+  CountingSegmentAllocator allocator;
+  TestInputStream stream(serialized.asPtr(), false);
+  InputStreamMessageReader reader(stream, ReaderOptions(), allocator);
+
+  checkTestMessage(reader.getRoot<TestAllTypes>());
+
+  auto segments = builder.getSegmentsForOutput();
+  EXPECT_EQ(segments.size(), allocator.count);
+  size_t totalWords = 0;
+  for (auto segment: segments) {
+    totalWords += segment.size();
+  }
+  EXPECT_EQ(totalWords, allocator.totalWords);
+  for (uint i = 0; i < segments.size(); i++) {
+    EXPECT_EQ(segments[i].size(), reader.getSegment(i).size());
+  }
+}
+
 class TestOutputStream: public kj::OutputStream {
 public:
   TestOutputStream() {}
@@ -434,6 +527,117 @@ TEST(Serialize, FileDescriptors) {
   }
 }
 
+TEST(Serialize, FileDescriptorsSegmentAllocator) {
+#if _WIN32 || __ANDROID__
+  char filename[] = "capnproto-serialize-test-XXXXXX";
+#else
+  char filename[] = "/tmp/capnproto-serialize-test-XXXXXX";
+#endif
+  kj::AutoCloseFd tmpfile(mkstemp(filename));
+  ASSERT_GE(tmpfile.get(), 0);
+
+#if !_WIN32
+  EXPECT_EQ(0, unlink(filename));
+#endif
+
+  {
+    TestMessageBuilder builder(7);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    writeMessageToFd(tmpfile.get(), builder);
+  }
+
+  {
+    TestMessageBuilder builder(1);
+    builder.initRoot<TestAllTypes>().setTextField("second message in file");
+    writeMessageToFd(tmpfile.get(), builder);
+  }
+
+  lseek(tmpfile, 0, SEEK_SET);
+
+  CountingSegmentAllocator allocator;
+
+  {
+    StreamFdMessageReader reader(tmpfile.get(), ReaderOptions(), allocator);
+    checkTestMessage(reader.getRoot<TestAllTypes>());
+  }
+  EXPECT_EQ(7u, allocator.count);
+
+  {
+    StreamFdMessageReader reader(tmpfile.get(), ReaderOptions(), allocator);
+    EXPECT_EQ("second message in file", reader.getRoot<TestAllTypes>().getTextField());
+  }
+  EXPECT_EQ(8u, allocator.count);
+}
+
+TEST(Serialize, MmapFile) {
+#if _WIN32 || __ANDROID__
+  char filename[] = "capnproto-serialize-test-XXXXXX";
+#else
+  char filename[] = "/tmp/capnproto-serialize-test-XXXXXX";
+#endif
+  kj::AutoCloseFd tmpfile(mkstemp(filename));
+  ASSERT_GE(tmpfile.get(), 0);
+
+#if !_WIN32
+  EXPECT_EQ(0, unlink(filename));
+#endif
+
+  {
+    MmapMessageFile file(tmpfile.get());
+    EXPECT_TRUE(file.begin() == file.end());
+  }
+
+  {
+    TestMessageBuilder builder(7);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    writeMessageToFd(tmpfile.get(), builder);
+  }
+
+  {
+    TestMessageBuilder builder(1);
+    builder.initRoot<TestAllTypes>().setTextField("second message in file");
+    writeMessageToFd(tmpfile.get(), builder);
+  }
+
+  {
+    MmapMessageReader reader(tmpfile.get());
+    checkTestMessage(reader.getRoot<TestAllTypes>());
+  }
+
+  {
+    MmapMessageFile file(tmpfile.get());
+    uint count = 0;
+    for (auto message: file) {
+      FlatArrayMessageReader reader(message);
+      if (count == 0) {
+        checkTestMessage(reader.getRoot<TestAllTypes>());
+      } else {
+        EXPECT_EQ("second message in file", reader.getRoot<TestAllTypes>().getTextField());
+      }
+      EXPECT_EQ(message.end(), reader.getEnd());
+      ++count;
+    }
+    EXPECT_EQ(2u, count);
+  }
+
+  {
+    // Simulate a writer which died part-way through a third message.
+    TestMessageBuilder builder(1);
+    builder.initRoot<TestAllTypes>().setTextField("torn");
+    kj::Array<word> words = messageToFlatArray(builder);
+    kj::FdOutputStream(tmpfile.get()).write(words.begin(), (words.size() - 1) * sizeof(word));
+  }
+
+  {
+    MmapMessageFile file(tmpfile.get());
+    auto iter = file.begin();
+    ++iter;
+    ++iter;
+    EXPECT_TRUE(iter != file.end());
+    KJ_EXPECT_THROW_MESSAGE("truncated", *iter);
+  }
+}
+
 TEST(Serialize, RejectTooManySegments) {
   kj::Array<word> data = kj::heapArray<word>(8192);
   WireValue<uint32_t>* table = reinterpret_cast<WireValue<uint32_t>*>(data.begin());
@@ -22,7 +22,16 @@
 #include "serialize.h"
 #include "layout.h"
 #include <kj/debug.h>
+#include <kj/miniposix.h>
 #include <exception>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 namespace capnp {
 
@@ -147,6 +156,30 @@ kj::Array<word> messageToFlatArray(kj::ArrayPtr<const kj::ArrayPtr<const word>>
   return kj::mv(result);
 }
 
+kj::Array<word> compactMessageToFlatArray(MessageReader& message) {
+  auto root = message.getRoot<AnyPointer>();
+  size_t size = root.targetSize().wordCount + POINTER_SIZE_IN_WORDS / WORDS;
+
+  kj::ArrayPtr<const word> segment0 = message.getSegment(0);
+  if (segment0.size() == size && message.getSegment(1) == nullptr) {
+    // Every word in the one segment is reachable, so the message is already compact.
+    return messageToFlatArray(kj::arrayPtr(&segment0, 1));
+  }
+
+  // One segment, so the table is the segment count and the segment size in one word.
+  kj::Array<word> result = kj::heapArray<word>(size + 1);
+  memset(result.asBytes().begin(), 0, result.asBytes().size());
+
+  _::WireValue<uint32_t>* table =
+      reinterpret_cast<_::WireValue<uint32_t>*>(result.begin());
+  table[0].set(0);
+  table[1].set(size);
+
+  copyToUnchecked(root, result.slice(1, result.size()));
+
+  return kj::mv(result);
+}
+
 size_t computeSerializedSizeInWords(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
   KJ_REQUIRE(segments.size() > 0, "Tried to serialize uninitialized message.");
 
@@ -164,6 +197,18 @@ size_t computeSerializedSizeInWords(kj::ArrayPtr<const kj::ArrayPtr<const word>>
 InputStreamMessageReader::InputStreamMessageReader(
     kj::InputStream& inputStream, ReaderOptions options, kj::ArrayPtr<word> scratchSpace)
     : MessageReader(options), inputStream(inputStream), readPos(nullptr) {
+  init(scratchSpace, nullptr);
+}
+
+InputStreamMessageReader::InputStreamMessageReader(
+    kj::InputStream& inputStream, ReaderOptions options, ReaderSegmentAllocator& allocator)
+    : MessageReader(options), inputStream(inputStream), readPos(nullptr) {
+  init(nullptr, &allocator);
+}
+
+void InputStreamMessageReader::init(
+    kj::ArrayPtr<word> scratchSpace, ReaderSegmentAllocator* allocator) {
+  ReaderOptions options = getOptions();
   _::WireValue<uint32_t> firstWord[2];
 
   inputStream.read(firstWord, sizeof(firstWord));
@@ -201,9 +246,33 @@ InputStreamMessageReader::InputStreamMessageReader(
     break;
   }
 
+  KJ_IF_MAYBE(a, allocator) {
+    // Allocate each segment separately and fill them all with one scatter read, so that a large
+    // multi-segment message never needs one giant contiguous buffer.
+    ownedSegments = kj::heapArray<kj::Array<word>>(segmentCount);
+    KJ_STACK_ARRAY(kj::ArrayPtr<byte>, pieces, segmentCount, 16, 64);
+
+    ownedSegments[0] = a->allocateSegment(segment0Size);
+    KJ_ASSERT(ownedSegments[0].size() == segment0Size, "allocator returned wrong size");
+    segment0 = ownedSegments[0];
+    pieces[0] = ownedSegments[0].asBytes();
+
+    if (segmentCount > 1) {
+      moreSegments = kj::heapArray<kj::ArrayPtr<const word>>(segmentCount - 1);
+      for (uint i = 1; i < segmentCount; i++) {
+        uint segmentSize = moreSizes[i - 1].get();
+        ownedSegments[i] = a->allocateSegment(segmentSize);
+        KJ_ASSERT(ownedSegments[i].size() == segmentSize, "allocator returned wrong size");
+        moreSegments[i - 1] = ownedSegments[i];
+        pieces[i] = ownedSegments[i].asBytes();
+      }
+    }
+
+    inputStream.read(pieces);
+    return;
+  }
+
   if (scratchSpace.size() < totalWords) {
-    // TODO(perf):  Consider allocating each segment as a separate chunk to reduce memory
-    //   fragmentation.
     ownedSpace = kj::heapArray<word>(totalWords);
     scratchSpace = ownedSpace;
   }
@@ -311,4 +380,93 @@ void readMessageCopyFromFd(int fd, MessageBuilder& target,
   readMessageCopy(stream, target, options, scratchSpace);
 }
 
+// =======================================================================================
+
+namespace {
+
+class MmapDisposer: public kj::ArrayDisposer {
+protected:
+  void disposeImpl(void* firstElement, size_t elementSize, size_t elementCount,
+                   size_t capacity, void (*destroyElement)(void*)) const {
+#if _WIN32
+    KJ_ASSERT(UnmapViewOfFile(firstElement));
+#else
+    munmap(firstElement, elementSize * elementCount);
+#endif
+  }
+};
+
+constexpr MmapDisposer mmapDisposer = MmapDisposer();
+
+kj::Array<const word> mmapWholeFile(int fd) {
+  struct stat stats;
+  KJ_SYSCALL(fstat(fd, &stats));
+
+  KJ_REQUIRE(S_ISREG(stats.st_mode), "Can only memory-map regular files.");
+  KJ_REQUIRE(uint64_t(stats.st_size) <= size_t(kj::maxValue),
+             "File too large to map into memory.");
+
+  // A trailing partial word can only be part of a torn message, so ignore it.
+  size_t wordCount = stats.st_size / sizeof(word);
+
+  if (wordCount == 0) {
+    // mmap()ing zero bytes will fail.
+    return nullptr;
+  }
+
+#if _WIN32
+  HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+  KJ_ASSERT(handle != INVALID_HANDLE_VALUE);
+  HANDLE mappingHandle = CreateFileMapping(
+      handle, NULL, PAGE_READONLY, 0, stats.st_size, NULL);
+  KJ_ASSERT(mappingHandle != INVALID_HANDLE_VALUE);
+  KJ_DEFER(KJ_ASSERT(CloseHandle(mappingHandle)));
+  const void* mapping = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, stats.st_size);
+  KJ_ASSERT(mapping != nullptr);
+#else  // _WIN32
+  const void* mapping = mmap(NULL, stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    KJ_FAIL_SYSCALL("mmap", errno);
+  }
+#endif  // !_WIN32
+
+  return kj::Array<const word>(reinterpret_cast<const word*>(mapping), wordCount, mmapDisposer);
+}
+
+}  // namespace
+
+MmapMessageFile::MmapMessageFile(int fd): mapping(mmapWholeFile(fd)) {}
+MmapMessageFile::~MmapMessageFile() noexcept(false) {}
+
+size_t MmapMessageFile::Iterator::messageSize() const {
+  size_t remaining = limit - pos;
+  size_t size = expectedSizeInWordsFromPrefix(kj::arrayPtr(pos, remaining));
+  KJ_REQUIRE(size <= remaining, "Message file ends prematurely; last message is truncated.") {
+    // Treat the rest of the file as the last message so that iteration terminates.
+    return remaining;
+  }
+  return size;
+}
+
+kj::ArrayPtr<const word> MmapMessageFile::Iterator::operator*() const {
+  return kj::arrayPtr(pos, messageSize());
+}
+
+MmapMessageFile::Iterator& MmapMessageFile::Iterator::operator++() {
+  pos += messageSize();
+  return *this;
+}
+
+MmapMessageFile::Iterator MmapMessageFile::Iterator::operator++(int) {
+  Iterator result = *this;
+  ++*this;
+  return result;
+}
+
+MmapMessageReader::MmapMessageReader(int fd, ReaderOptions options)
+    : MmapMessageFile(fd),
+      FlatArrayMessageReader(static_cast<MmapMessageFile&>(*this).getWords(), options) {}
+
+MmapMessageReader::~MmapMessageReader() noexcept(false) {}
+
 }  // namespace capnp
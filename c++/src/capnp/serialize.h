@@ -102,6 +102,13 @@ kj::Array<word> messageToFlatArray(MessageBuilder& builder);
 kj::Array<word> messageToFlatArray(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
 // Version of messageToFlatArray that takes a raw segment array.
 
+kj::Array<word> compactMessageToFlatArray(MessageReader& message);
+// Like messageToFlatArray(), but the output contains only the objects reachable from the root,
+// laid out contiguously in a single segment.  Unreachable space and far pointers in the input are
+// dropped.  If the input already consists of a single segment with no unreachable words, it is
+// copied as-is without traversing it.  See also compactMessage() in message.h, which compacts a
+// MessageBuilder in place.
+
 size_t computeSerializedSizeInWords(MessageBuilder& builder);
 // Returns the size, in words, that will be needed to serialize the message, including the header.
 
@@ -132,6 +139,11 @@ public:
   InputStreamMessageReader(kj::InputStream& inputStream,
                            ReaderOptions options = ReaderOptions(),
                            kj::ArrayPtr<word> scratchSpace = nullptr);
+  InputStreamMessageReader(kj::InputStream& inputStream, ReaderOptions options,
+                           ReaderSegmentAllocator& allocator);
+  // Read each segment into a separate array obtained from `allocator`, filling all of them with a
+  // single scatter read (see `kj::InputStream::read(pieces)`).  Unlike the scratch-space
+  // constructor, the whole message is read before the constructor returns.
   ~InputStreamMessageReader() noexcept(false);
 
   // implements MessageReader ----------------------------------------
@@ -148,7 +160,12 @@ private:
   kj::Array<word> ownedSpace;
   // Only if scratchSpace wasn't big enough.
 
+  kj::Array<kj::Array<word>> ownedSegments;
+  // Only if constructed with a ReaderSegmentAllocator.
+
   kj::UnwindDetector unwindDetector;
+
+  void init(kj::ArrayPtr<word> scratchSpace, ReaderSegmentAllocator* allocator);
 };
 
 void readMessageCopy(kj::InputStream& input, MessageBuilder& target,
@@ -185,6 +202,13 @@ public:
       : FdInputStream(kj::mv(fd)), InputStreamMessageReader(*this, options, scratchSpace) {}
   // Read a message from a file descriptor, taking ownership of the descriptor.
 
+  StreamFdMessageReader(int fd, ReaderOptions options, ReaderSegmentAllocator& allocator)
+      : FdInputStream(fd), InputStreamMessageReader(*this, options, allocator) {}
+  StreamFdMessageReader(kj::AutoCloseFd fd, ReaderOptions options,
+                        ReaderSegmentAllocator& allocator)
+      : FdInputStream(kj::mv(fd)), InputStreamMessageReader(*this, options, allocator) {}
+  // Like the above, but read each segment into space obtained from `allocator`, using readv().
+
   ~StreamFdMessageReader() noexcept(false);
 };
 
@@ -213,6 +237,76 @@ void writeMessageToFd(int fd, kj::ArrayPtr<const kj::ArrayPtr<const word>> segme
 // you catch this exception at the call site.  If throwing an exception is not acceptable, you
 // can implement your own OutputStream with arbitrary error handling and then use writeMessage().
 
+// =======================================================================================
+// Memory-mapped files.
+
+class MmapMessageFile {
+  // A file containing zero or more messages in the standard serialization format, one after
+  // another (e.g. as written by repeated calls to writeMessageToFd()), mapped read-only into
+  // memory.  Iterating over the file yields the words of each message, which can be passed
+  // straight to FlatArrayMessageReader to read the message in place.  Only the pages actually
+  // touched -- the segment tables visited while iterating plus whatever objects the application
+  // reads -- are ever faulted in, so opening a huge file to read a few fields is cheap.
+  //
+  // The file must not be truncated or modified while it is mapped.
+
+public:
+  explicit MmapMessageFile(int fd);
+  // Map the whole file.  The descriptor is not retained; the caller may close it immediately.
+
+  KJ_DISALLOW_COPY(MmapMessageFile);
+  MmapMessageFile(MmapMessageFile&&) = default;
+  ~MmapMessageFile() noexcept(false);
+
+  kj::ArrayPtr<const word> getWords() const { return mapping; }
+  // Get the entire content of the file.  If the file size is not a multiple of the word size,
+  // trailing bytes are ignored.
+
+  class Iterator;
+  Iterator begin() const;
+  Iterator end() const;
+
+private:
+  kj::Array<const word> mapping;
+};
+
+class MmapMessageFile::Iterator {
+public:
+  Iterator() = default;
+
+  kj::ArrayPtr<const word> operator*() const;
+  // Get the words of the current message, including its segment table.  Throws if the segment
+  // table claims that the message extends past the end of the file, as happens if the writer
+  // was interrupted part-way through the last message.
+
+  Iterator& operator++();
+  Iterator operator++(int);
+
+  inline bool operator==(const Iterator& other) const { return pos == other.pos; }
+  inline bool operator!=(const Iterator& other) const { return pos != other.pos; }
+
+private:
+  const word* pos = nullptr;
+  const word* limit = nullptr;
+
+  Iterator(const word* pos, const word* limit): pos(pos), limit(limit) {}
+  size_t messageSize() const;
+
+  friend class MmapMessageFile;
+};
+
+class MmapMessageReader: private MmapMessageFile, public FlatArrayMessageReader {
+  // Reads the first message in a file by mapping the file into memory.  Segments point directly
+  // into the mapping, so nothing is read or copied up-front beyond the segment table.  Use
+  // MmapMessageFile directly to read files containing multiple messages.
+
+public:
+  explicit MmapMessageReader(int fd, ReaderOptions options = ReaderOptions());
+  // Map the file and parse its first message.  The descriptor is not retained.
+
+  ~MmapMessageReader() noexcept(false);
+};
+
 // =======================================================================================
 // inline stuff
 
@@ -232,6 +326,14 @@ inline void writeMessageToFd(int fd, MessageBuilder& builder) {
   writeMessageToFd(fd, builder.getSegmentsForOutput());
 }
 
+inline MmapMessageFile::Iterator MmapMessageFile::begin() const {
+  return Iterator(mapping.begin(), mapping.end());
+}
+
+inline MmapMessageFile::Iterator MmapMessageFile::end() const {
+  return Iterator(mapping.end(), mapping.end());
+}
+
 }  // namespace capnp
 
 #endif  // SERIALIZE_H_
@@ -79,6 +79,43 @@ public:
   Maybe<T> value;
 };
 
+// -------------------------------------------------------------------
+// Promise node allocation
+
+void* allocPromiseStorage(size_t size);
+void freePromiseStorage(void* storage, size_t size) noexcept;
+// Allocate and free memory for promise nodes and events.  While an EventLoop is current, blocks
+// come from a freelist kept by the loop, binned by size, so that after warming up, building and
+// tearing down promise chains doesn't touch malloc at all.  A block remembers where it came from,
+// so it may be freed while another loop (or none) is current -- but, as with everything else
+// about promises, only on the thread that allocated it.
+
+template <typename T>
+class PooledDisposer final: public Disposer {
+public:
+  void disposeImpl(void* pointer) const override {
+    KJ_DEFER(freePromiseStorage(pointer, sizeof(T)));
+    kj::dtor(*reinterpret_cast<T*>(pointer));
+  }
+
+  static const PooledDisposer instance;
+};
+
+template <typename T>
+const PooledDisposer<T> PooledDisposer<T>::instance = PooledDisposer<T>();
+
+template <typename T, typename... Params>
+Own<T> allocPromise(Params&&... params) {
+  // Like heap<T>(...), but uses allocPromiseStorage().  Use for promise nodes and events.
+
+  static_assert(alignof(T) <= 16, "allocPromiseStorage() only guarantees 16-byte alignment");
+  void* storage = allocPromiseStorage(sizeof(T));
+  KJ_ON_SCOPE_FAILURE(freePromiseStorage(storage, sizeof(T)));
+  T* object = reinterpret_cast<T*>(storage);
+  kj::ctor(*object, kj::fwd<Params>(params)...);
+  return Own<T>(object, PooledDisposer<T>::instance);
+}
+
 class Event {
   // An event waiting to be executed.  Not for direct use by applications -- promises use this
   // internally.
@@ -499,7 +536,7 @@ public:
   ForkHub(Own<PromiseNode>&& inner): ForkHubBase(kj::mv(inner), result) {}
 
   Promise<_::UnfixVoid<T>> addBranch() {
-    return Promise<_::UnfixVoid<T>>(false, kj::heap<ForkBranch<T>>(addRef(*this)));
+    return Promise<_::UnfixVoid<T>>(false, allocPromise<ForkBranch<T>>(addRef(*this)));
   }
 
   _::SplitTuplePromise<T> split() {
@@ -517,7 +554,7 @@ private:
   template <size_t index>
   Promise<JoinPromises<typename SplitBranch<T, index>::Element>> addSplit() {
     return Promise<JoinPromises<typename SplitBranch<T, index>::Element>>(
-        false, maybeChain(kj::heap<SplitBranch<T, index>>(addRef(*this)),
+        false, maybeChain(allocPromise<SplitBranch<T, index>>(addRef(*this)),
                           implicitCast<typename SplitBranch<T, index>::Element*>(nullptr)));
   }
 };
@@ -563,7 +600,7 @@ private:
 
 template <typename T>
 Own<PromiseNode> maybeChain(Own<PromiseNode>&& node, Promise<T>*) {
-  return heap<ChainPromiseNode>(kj::mv(node));
+  return allocPromise<ChainPromiseNode>(kj::mv(node));
 }
 
 template <typename T>
@@ -721,7 +758,7 @@ template <typename T>
 Own<PromiseNode> spark(Own<PromiseNode>&& node) {
   // Forces evaluation of the given node to begin as soon as possible, even if no one is waiting
   // on it.
-  return heap<EagerPromiseNode<T>>(kj::mv(node));
+  return allocPromise<EagerPromiseNode<T>>(kj::mv(node));
 }
 
 // -------------------------------------------------------------------
@@ -780,17 +817,121 @@ private:
   }
 };
 
+// -------------------------------------------------------------------
+
+class XThreadEvent: public PromiseNode, private Disposer {
+  // A request made with Executor::executeAsync().  Lives on the requesting thread as the node of
+  // the returned promise, and visits the target thread to run.  See async.c++ for the protocol.
+
+public:
+  XThreadEvent(ExceptionOrValue& result, const Executor& targetExecutor);
+  virtual ~XThreadEvent() noexcept(false);
+
+  void onReady(Event& event) noexcept override;
+
+protected:
+  template <typename T>
+  Promise<T> send() {
+    // Queue this request on the target executor and return a promise owning it.
+    targetExecutor.send(*this);
+    return Promise<T>(false, Own<PromiseNode>(this, *this));
+  }
+
+  template <typename T>
+  static Own<PromiseNode> getNode(Promise<T>&& promise) { return kj::mv(promise.node); }
+
+  virtual Own<PromiseNode> execute() = 0;
+  // Calls the function, on the target thread.  Must not throw.
+
+private:
+  class TargetEvent;
+
+  ExceptionOrValue& result;
+  const Executor& targetExecutor;
+  const Executor& replyExecutor;
+
+  uint state;
+  // A State, accessed atomically since both threads change it.
+  enum State: uint {
+    QUEUED,     // in the target's queue, not yet seen
+    EXECUTING,  // function has started on the target thread
+    CANCELED,   // requester gave up; the target frees the request
+    DONE        // result has been (or is being) sent back to the requester
+  };
+
+  XThreadEvent* next = nullptr;
+  // Link in an executor's queue.
+
+  bool replySent = false;
+  // Set by the target thread after pushing the reply (even if waking the requester failed), the
+  // last time it touches the request.
+
+  // Only touched on the target thread:
+  Own<TargetEvent> targetEvent;
+  XThreadEvent* nextExecuting = nullptr;
+  XThreadEvent** prevExecuting = nullptr;
+
+  // Only touched on the requesting thread:
+  OnReadyEvent onReadyEvent;
+  bool delivered = false;
+  bool disposed = false;
+
+  void start();
+  void finish();
+  void unlinkExecuting();
+  void deliver();
+  void disposeImpl(void* pointer) const override;
+
+  friend class kj::Executor;
+};
+
+template <typename Func>
+class XThreadEventImpl final: public XThreadEvent {
+public:
+  typedef FixVoid<JoinPromises<ReturnType<Func, void>>> ResultType;
+
+  template <typename F>
+  XThreadEventImpl(F&& func, const Executor& targetExecutor)
+      : XThreadEvent(result, targetExecutor), func(kj::fwd<F>(func)) {}
+
+  Promise<UnfixVoid<ResultType>> send() {
+    return XThreadEvent::template send<UnfixVoid<ResultType>>();
+  }
+
+  void get(ExceptionOrValue& output) noexcept override {
+    output.as<ResultType>() = kj::mv(result);
+  }
+
+protected:
+  Own<PromiseNode> execute() override {
+    Promise<UnfixVoid<ResultType>> promise = nullptr;
+    KJ_IF_MAYBE(f, func) {
+      KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+        promise = MaybeVoidCaller<Void, FixVoid<ReturnType<Func, void>>>::apply(*f, Void());
+      })) {
+        promise = kj::mv(*exception);
+      }
+    }
+    func = nullptr;
+    return getNode(kj::mv(promise));
+  }
+
+private:
+  Maybe<Func> func;
+  ExceptionOr<ResultType> result;
+};
+
 }  // namespace _ (private)
 
 // =======================================================================================
 
 template <typename T>
 Promise<T>::Promise(_::FixVoid<T> value)
-    : PromiseBase(heap<_::ImmediatePromiseNode<_::FixVoid<T>>>(kj::mv(value))) {}
+    : PromiseBase(_::allocPromise<_::ImmediatePromiseNode<_::FixVoid<T>>>(kj::mv(value))) {}
 
 template <typename T>
 Promise<T>::Promise(kj::Exception&& exception)
-    : PromiseBase(heap<_::ImmediateBrokenPromiseNode>(kj::mv(exception))) {}
+    : PromiseBase(_::allocPromise<_::ImmediateBrokenPromiseNode>(kj::mv(exception))) {}
 
 template <typename T>
 template <typename Func, typename ErrorFunc>
@@ -798,7 +939,7 @@ PromiseForResult<Func, T> Promise<T>::then(Func&& func, ErrorFunc&& errorHandler
   typedef _::FixVoid<_::ReturnType<Func, T>> ResultT;
 
   Own<_::PromiseNode> intermediate =
-      heap<_::TransformPromiseNode<ResultT, _::FixVoid<T>, Func, ErrorFunc>>(
+      _::allocPromise<_::TransformPromiseNode<ResultT, _::FixVoid<T>, Func, ErrorFunc>>(
           kj::mv(node), kj::fwd<Func>(func), kj::fwd<ErrorFunc>(errorHandler));
   return PromiseForResult<Func, T>(false,
       _::maybeChain(kj::mv(intermediate), implicitCast<ResultT*>(nullptr)));
@@ -879,13 +1020,14 @@ _::SplitTuplePromise<T> Promise<T>::split() {
 
 template <typename T>
 Promise<T> Promise<T>::exclusiveJoin(Promise<T>&& other) {
-  return Promise(false, heap<_::ExclusiveJoinPromiseNode>(kj::mv(node), kj::mv(other.node)));
+  return Promise(false,
+      _::allocPromise<_::ExclusiveJoinPromiseNode>(kj::mv(node), kj::mv(other.node)));
 }
 
 template <typename T>
 template <typename... Attachments>
 Promise<T> Promise<T>::attach(Attachments&&... attachments) {
-  return Promise(false, kj::heap<_::AttachmentPromiseNode<Tuple<Attachments...>>>(
+  return Promise(false, _::allocPromise<_::AttachmentPromiseNode<Tuple<Attachments...>>>(
       kj::mv(node), kj::tuple(kj::fwd<Attachments>(attachments)...)));
 }
 
@@ -938,7 +1080,7 @@ void Promise<void>::detach(ErrorFunc&& errorHandler) {
 
 template <typename T>
 Promise<Array<T>> joinPromises(Array<Promise<T>>&& promises) {
-  return Promise<Array<T>>(false, kj::heap<_::ArrayJoinPromiseNode<T>>(
+  return Promise<Array<T>>(false, _::allocPromise<_::ArrayJoinPromiseNode<T>>(
       KJ_MAP(p, promises) { return kj::mv(p.node); },
       heapArray<_::ExceptionOr<T>>(promises.size())));
 }
@@ -1064,7 +1206,7 @@ bool PromiseFulfiller<void>::rejectIfThrows(Func&& func) {
 
 template <typename T, typename Adapter, typename... Params>
 Promise<T> newAdaptedPromise(Params&&... adapterConstructorParams) {
-  return Promise<T>(false, heap<_::AdapterPromiseNode<_::FixVoid<T>, Adapter>>(
+  return Promise<T>(false, _::allocPromise<_::AdapterPromiseNode<_::FixVoid<T>, Adapter>>(
       kj::fwd<Params>(adapterConstructorParams)...));
 }
 
@@ -1073,13 +1215,20 @@ PromiseFulfillerPair<T> newPromiseAndFulfiller() {
   auto wrapper = _::WeakFulfiller<T>::make();
 
   Own<_::PromiseNode> intermediate(
-      heap<_::AdapterPromiseNode<_::FixVoid<T>, _::PromiseAndFulfillerAdapter<T>>>(*wrapper));
+      _::allocPromise<_::AdapterPromiseNode<_::FixVoid<T>, _::PromiseAndFulfillerAdapter<T>>>(
+          *wrapper));
   Promise<_::JoinPromises<T>> promise(false,
       _::maybeChain(kj::mv(intermediate), implicitCast<T*>(nullptr)));
 
   return PromiseFulfillerPair<T> { kj::mv(promise), kj::mv(wrapper) };
 }
 
+template <typename Func>
+PromiseForResult<Func, void> Executor::executeAsync(Func&& func) const {
+  // The request owns itself until send() hands it to the returned promise.
+  return (new _::XThreadEventImpl<Decay<Func>>(kj::fwd<Func>(func), *this))->send();
+}
+
 }  // namespace kj
 
 #endif  // KJ_ASYNC_INL_H_
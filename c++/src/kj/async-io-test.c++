@@ -21,13 +21,17 @@
 
 #include "async-io.h"
 #include "debug.h"
+#include "thread-pool.h"
 #include <kj/compat/gtest.h>
 #include <sys/types.h>
 #if _WIN32
 #include <ws2tcpip.h>
 #include "windows-sanity.h"
 #else
+#include "async-unix.h"
 #include <netdb.h>
+#include <stdlib.h>
+#include <unistd.h>
 #endif
 
 namespace kj {
@@ -124,6 +128,85 @@ TEST(AsyncIo, AddressParsing) {
   // connect to "localhost" in a different test, though.
 }
 
+#if !_WIN32
+TEST(AsyncIo, LookupCache) {
+  auto ioContext = setupAsyncIo();
+  auto& w = ioContext.waitScope;
+  NameLookupOptions options;
+  options.cacheTtl = 30 * SECONDS;
+  auto provider = newAsyncIoProvider(*ioContext.lowLevelProvider, options);
+  auto& network = provider->getNetwork();
+
+  auto expectStats = [&](uint64_t cacheHits, uint64_t coalescedLookups, uint inFlightLookups) {
+    auto stats = network.getLookupStats();
+    EXPECT_EQ(cacheHits, stats.cacheHits);
+    EXPECT_EQ(coalescedLookups, stats.coalescedLookups);
+    EXPECT_EQ(inFlightLookups, stats.inFlightLookups);
+  };
+
+  // Numeric addresses don't need a lookup.
+  tryParse(w, network, "1.2.3.4", 5678);
+  expectStats(0, 0, 0);
+
+  // "localhost" comes from /etc/hosts.  Two lookups started in the same turn share one
+  // getaddrinfo() call.
+  auto promise1 = network.parseAddress("localhost", 5678);
+  auto promise2 = network.parseAddress("localhost", 5678);
+  evalLater([]() {}).wait(w);
+  expectStats(0, 1, 1);
+
+  auto addr1 = promise1.wait(w)->toString();
+  auto addr2 = promise2.wait(w)->toString();
+  EXPECT_EQ(addr1, addr2);
+  EXPECT_TRUE(addr1.endsWith(":5678"));
+  expectStats(0, 1, 0);
+
+  // Now the result is cached.
+  EXPECT_EQ(addr1, tryParse(w, network, "localhost", 5678));
+  expectStats(1, 1, 0);
+
+  // A different port hint is a different lookup.
+  EXPECT_TRUE(tryParse(w, network, "localhost", 1234).endsWith(":1234"));
+  expectStats(1, 1, 0);
+  EXPECT_TRUE(tryParse(w, network, "localhost", 1234).endsWith(":1234"));
+  expectStats(2, 1, 0);
+}
+
+TEST(AsyncIo, LookupCacheDisabledByDefault) {
+  auto ioContext = setupAsyncIo();
+  auto& w = ioContext.waitScope;
+  auto& network = ioContext.provider->getNetwork();
+
+  // Concurrent lookups are still shared, but finished ones aren't remembered.
+  auto promise1 = network.parseAddress("localhost", 5678);
+  auto promise2 = network.parseAddress("localhost", 5678);
+  EXPECT_EQ(promise1.wait(w)->toString(), promise2.wait(w)->toString());
+  tryParse(w, network, "localhost", 5678);
+  tryParse(w, network, "localhost", 5678);
+
+  auto stats = network.getLookupStats();
+  EXPECT_EQ(0u, stats.cacheHits);
+  EXPECT_EQ(1u, stats.coalescedLookups);
+}
+
+TEST(AsyncIo, LookupThreadPool) {
+  ThreadPool pool(1);
+  NameLookupOptions options;
+  options.cacheTtl = 30 * SECONDS;
+  options.threadPool = pool;
+
+  auto ioContext = setupAsyncIo(options);
+  auto& w = ioContext.waitScope;
+  auto& network = ioContext.provider->getNetwork();
+
+  // The lookup runs on our pool, and the options reach the network.
+  tryParse(w, network, "localhost", 5678);
+  tryParse(w, network, "localhost", 5678);
+  EXPECT_EQ(1u, pool.getStats().completed);
+  EXPECT_EQ(1u, network.getLookupStats().cacheHits);
+}
+#endif
+
 TEST(AsyncIo, OneWayPipe) {
   auto ioContext = setupAsyncIo();
 
@@ -142,6 +225,34 @@ TEST(AsyncIo, OneWayPipe) {
   EXPECT_EQ("foo", result);
 }
 
+TEST(AsyncIo, OneWayPipeReadVec) {
+  auto ioContext = setupAsyncIo();
+
+  auto pipe = ioContext.provider->newOneWayPipe();
+  char receiveBuffer[10];
+  memset(receiveBuffer, 0, sizeof(receiveBuffer));
+
+  ArrayPtr<byte> pieces[4] = {
+    arrayPtr(reinterpret_cast<byte*>(receiveBuffer), 3),
+    arrayPtr(implicitCast<byte*>(nullptr), 0),
+    arrayPtr(reinterpret_cast<byte*>(receiveBuffer + 3), 4),
+    arrayPtr(reinterpret_cast<byte*>(receiveBuffer + 7), 2)
+  };
+
+  auto promise = pipe.in->read(pieces);
+
+  // Deliver the data in two writes so that the first readv() can only fill part of the pieces.
+  pipe.out->write("foob", 4).then([&]() {
+    return pipe.out->write("arbaz", 5);
+  }).detach([](kj::Exception&& exception) {
+    KJ_FAIL_EXPECT(exception);
+  });
+
+  promise.wait(ioContext.waitScope);
+
+  EXPECT_STREQ("foobarbaz", receiveBuffer);
+}
+
 TEST(AsyncIo, TwoWayPipe) {
   auto ioContext = setupAsyncIo();
 
@@ -375,5 +486,111 @@ TEST(AsyncIo, Udp) {
 
 #endif  // !_WIN32
 
+#if !_WIN32  // files not implemented on win32 yet
+
+void testAsyncFile(AsyncIoContext& io) {
+  char filename[] = "/tmp/kj-async-io-test-XXXXXX";
+  int fd;
+  KJ_SYSCALL(fd = mkstemp(filename));
+  unlink(filename);
+  auto file = io.lowLevelProvider->wrapFileFd(fd, LowLevelAsyncIoProvider::TAKE_OWNERSHIP);
+
+  file->write(0, StringPtr("foobar").asBytes()).wait(io.waitScope);
+  ArrayPtr<const byte> pieces[] = { StringPtr("baz").asBytes(), StringPtr("qux").asBytes() };
+  file->write(6, pieces).wait(io.waitScope);
+  file->sync().wait(io.waitScope);
+
+  // Reads come up short only at EOF.
+  char buffer[16];
+  EXPECT_EQ(12u, file->read(0, arrayPtr(buffer, sizeof(buffer)).asBytes()).wait(io.waitScope));
+  EXPECT_EQ("foobarbazqux", heapString(buffer, 12));
+  EXPECT_EQ(0u, file->read(100, arrayPtr(buffer, sizeof(buffer)).asBytes()).wait(io.waitScope));
+
+  char a[4], b[4];
+  ArrayPtr<byte> readPieces[] = { arrayPtr(a, 4).asBytes(), arrayPtr(b, 4).asBytes() };
+  EXPECT_EQ(8u, file->read(2, readPieces).wait(io.waitScope));
+  EXPECT_EQ("obar", heapString(a, 4));
+  EXPECT_EQ("bazq", heapString(b, 4));
+
+  // Many calls in flight at once.
+  char each[12];
+  Vector<Promise<size_t>> promises;
+  for (uint i = 0; i < sizeof(each); i++) {
+    promises.add(file->read(i, arrayPtr(each + i, 1).asBytes()));
+  }
+  for (auto n: joinPromises(promises.releaseAsArray()).wait(io.waitScope)) {
+    EXPECT_EQ(1u, n);
+  }
+  EXPECT_EQ("foobarbazqux", heapString(each, sizeof(each)));
+
+  // Streams, as used by capnp::readMessage() and capnp::writeMessage().
+  auto out = file->writeStream(12);
+  out->write("hello", 5).wait(io.waitScope);
+  out->write(pieces).wait(io.waitScope);
+
+  auto in = file->readStream(9);
+  EXPECT_EQ(11u, in->tryRead(buffer, 1, 11).wait(io.waitScope));
+  EXPECT_EQ("quxhellobaz", heapString(buffer, 11));
+  EXPECT_EQ(3u, in->tryRead(buffer, 1, sizeof(buffer)).wait(io.waitScope));
+  EXPECT_EQ("qux", heapString(buffer, 3));
+  EXPECT_EQ(0u, in->tryRead(buffer, 1, sizeof(buffer)).wait(io.waitScope));
+
+  // Handing over the buffer.  The result is cut down at EOF.
+  auto owned = file->read(3, heapArray<byte>(6)).wait(io.waitScope);
+  EXPECT_EQ("barbaz", heapString(owned.asChars()));
+  owned = file->read(20, kj::mv(owned)).wait(io.waitScope);
+  EXPECT_EQ("qux", heapString(owned.asChars()));
+  file->write(0, heapArray(StringPtr("FOO").asBytes())).wait(io.waitScope);
+  EXPECT_EQ(3u, file->read(0, arrayPtr(buffer, 3).asBytes()).wait(io.waitScope));
+  EXPECT_EQ("FOO", heapString(buffer, 3));
+
+  // Calls on the caller's buffers bigger than the copy buffer go a chunk at a time.
+  auto big = heapArray<byte>((3 << 20) + 123);
+  for (uint i = 0; i < big.size(); i++) {
+    big[i] = i * 7 + i / 1000;
+  }
+  ArrayPtr<const byte> bigPieces[] = { big.slice(0, 5), big.slice(5, big.size()) };
+  file->write(1000, bigPieces).wait(io.waitScope);
+  auto readBack = heapArray<byte>(big.size() + 10);
+  ArrayPtr<byte> readBackPieces[] = {
+    readBack.slice(0, 1 << 20), readBack.slice(1 << 20, readBack.size())
+  };
+  EXPECT_EQ(big.size(), file->read(1000, readBackPieces).wait(io.waitScope));
+  EXPECT_EQ(0, memcmp(big.begin(), readBack.begin(), big.size()));
+
+  // Dropping a call, then the file, while the call may still be in progress.
+  { auto canceled = file->read(0, arrayPtr(buffer, sizeof(buffer)).asBytes()); }
+  { auto canceled = file->write(0, StringPtr("xyz").asBytes()); }
+  file = nullptr;
+  io.provider->getTimer().afterDelay(10 * MILLISECONDS).wait(io.waitScope);
+}
+
+TEST(AsyncIo, File) {
+  auto io = setupAsyncIo();
+  testAsyncFile(io);
+}
+
+TEST(AsyncIo, FileRejectsPipe) {
+  auto io = setupAsyncIo();
+  int fds[2];
+  KJ_SYSCALL(pipe(fds));
+  KJ_DEFER(close(fds[1]));
+  KJ_EXPECT_THROW_MESSAGE("regular file",
+      io.lowLevelProvider->wrapFileFd(fds[0], LowLevelAsyncIoProvider::TAKE_OWNERSHIP));
+}
+
+#if KJ_USE_EPOLL
+TEST(AsyncIo, FileThreadPool) {
+  UnixEventPort::setIoUringEnabled(false);
+  KJ_DEFER(UnixEventPort::setIoUringEnabled(true));
+
+  auto io = setupAsyncIo();
+  EXPECT_FALSE(io.unixEventPort.isUsingIoUring());
+  testAsyncFile(io);
+}
+#endif
+
+#endif  // !_WIN32
+
 }  // namespace
 }  // namespace kj
@@ -1109,11 +1109,71 @@ private:
   SocketNetwork network;
 };
 
+// =======================================================================================
+
+class AsyncFileInputStream final: public AsyncInputStream {
+public:
+  AsyncFileInputStream(AsyncFile& file, uint64_t offset): file(file), offset(offset) {}
+
+  Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+    // A file read only comes up short at EOF, so there's no point reading less than `maxBytes`.
+    return file.read(offset, arrayPtr(reinterpret_cast<byte*>(buffer), maxBytes))
+        .then([this](size_t n) {
+      offset += n;
+      return n;
+    });
+  }
+
+private:
+  AsyncFile& file;
+  uint64_t offset;
+};
+
+class AsyncFileOutputStream final: public AsyncOutputStream {
+public:
+  AsyncFileOutputStream(AsyncFile& file, uint64_t offset): file(file), offset(offset) {}
+
+  Promise<void> write(const void* buffer, size_t size) override {
+    auto promise = file.write(offset, arrayPtr(reinterpret_cast<const byte*>(buffer), size));
+    offset += size;
+    return promise;
+  }
+
+  Promise<void> write(ArrayPtr<const ArrayPtr<const byte>> pieces) override {
+    auto promise = file.write(offset, pieces);
+    for (auto& piece: pieces) {
+      offset += piece.size();
+    }
+    return promise;
+  }
+
+private:
+  AsyncFile& file;
+  uint64_t offset;
+};
+
 }  // namespace
 
 Promise<void> AsyncInputStream::read(void* buffer, size_t bytes) {
   return read(buffer, bytes, bytes).then([](size_t) {});
 }
+Promise<void> AsyncInputStream::read(ArrayPtr<ArrayPtr<byte>> pieces) {
+  if (pieces.size() == 0) {
+    return READY_NOW;
+  }
+  auto first = pieces[0];
+  auto rest = pieces.slice(1, pieces.size());
+  return read(first.begin(), first.size()).then([this,rest]() mutable {
+    return read(rest);
+  });
+}
+
+Own<AsyncInputStream> AsyncFile::readStream(uint64_t offset) {
+  return heap<AsyncFileInputStream>(*this, offset);
+}
+Own<AsyncOutputStream> AsyncFile::writeStream(uint64_t offset) {
+  return heap<AsyncFileOutputStream>(*this, offset);
+}
 
 void AsyncIoStream::getsockopt(int level, int option, void* value, uint* length) {
   KJ_UNIMPLEMENTED("Not a socket.");
@@ -1142,15 +1202,32 @@ void DatagramPort::setsockopt(int level, int option, const void* value, uint len
 Own<DatagramPort> NetworkAddress::bindDatagramPort() {
   KJ_UNIMPLEMENTED("Datagram sockets not implemented.");
 }
+Network::LookupStats Network::getLookupStats() {
+  return { 0, 0, 0 };
+}
 Own<DatagramPort> LowLevelAsyncIoProvider::wrapDatagramSocketFd(SOCKET fd, uint flags) {
   KJ_UNIMPLEMENTED("Datagram sockets not implemented.");
 }
+Own<AsyncFile> LowLevelAsyncIoProvider::wrapFileFd(SOCKET fd, uint flags) {
+  KJ_UNIMPLEMENTED("Asynchronous file I/O not implemented.");
+}
 
 Own<AsyncIoProvider> newAsyncIoProvider(LowLevelAsyncIoProvider& lowLevel) {
   return kj::heap<AsyncIoProviderImpl>(lowLevel);
 }
 
+Own<AsyncIoProvider> newAsyncIoProvider(LowLevelAsyncIoProvider& lowLevel,
+                                        NameLookupOptions nameLookupOptions) {
+  // Name lookups aren't cached on Windows yet.
+  return kj::heap<AsyncIoProviderImpl>(lowLevel);
+}
+
 AsyncIoContext setupAsyncIo() {
+  return setupAsyncIo(NameLookupOptions());
+}
+
+AsyncIoContext setupAsyncIo(NameLookupOptions nameLookupOptions) {
+  // Name lookups aren't cached on Windows yet, so the options are unused.
   WSADATA dontcare;
   int result = WSAStartup(MAKEWORD(2, 2), &dontcare);
   if (result != 0) {
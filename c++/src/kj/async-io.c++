@@ -26,6 +26,7 @@
 #include "async-unix.h"
 #include "debug.h"
 #include "thread.h"
+#include "thread-pool.h"
 #include "io.h"
 #include "miniposix.h"
 #include <unistd.h>
@@ -33,6 +34,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <netinet/in.h>
@@ -42,6 +44,7 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <set>
+#include <map>
 #include <poll.h>
 #include <limits.h>
 
@@ -118,10 +121,20 @@ public:
         observer(eventPort, fd, UnixEventPort::FdObserver::OBSERVE_READ_WRITE) {}
   virtual ~AsyncStreamFd() noexcept(false) {}
 
+  using AsyncIoStream::read;
+
   Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
     return tryReadInternal(buffer, minBytes, maxBytes, 0);
   }
 
+  Promise<void> read(ArrayPtr<ArrayPtr<byte>> pieces) override {
+    if (pieces.size() == 0) {
+      return READY_NOW;
+    } else {
+      return readPiecesInternal(pieces[0], pieces.slice(1, pieces.size()));
+    }
+  }
+
   Promise<void> write(const void* buffer, size_t size) override {
     ssize_t writeResult;
     KJ_NONBLOCKING_SYSCALL(writeResult = ::write(fd, buffer, size)) {
@@ -289,6 +302,80 @@ private:
     }
   }
 
+  Promise<void> readPiecesInternal(ArrayPtr<byte> firstPiece,
+                                   ArrayPtr<ArrayPtr<byte>> morePieces) {
+    // Skip over empty pieces so that we never issue a zero-length readv(), which would be
+    // indistinguishable from EOF.
+    while (firstPiece.size() == 0) {
+      if (morePieces.size() == 0) return READY_NOW;
+      firstPiece = morePieces[0];
+      morePieces = morePieces.slice(1, morePieces.size());
+    }
+
+    const size_t iovmax = kj::miniposix::iovMax(1 + morePieces.size());
+    // If there are more than IOV_MAX pieces, we'll only read into the first IOV_MAX for now, and
+    // then we'll loop later.
+    KJ_STACK_ARRAY(struct iovec, iov, kj::min(1 + morePieces.size(), iovmax), 16, 128);
+
+    iov[0].iov_base = firstPiece.begin();
+    iov[0].iov_len = firstPiece.size();
+    for (uint i = 1; i < iov.size(); i++) {
+      iov[i].iov_base = morePieces[i - 1].begin();
+      iov[i].iov_len = morePieces[i - 1].size();
+    }
+
+    ssize_t readResult;
+    KJ_NONBLOCKING_SYSCALL(readResult = ::readv(fd, iov.begin(), iov.size())) {
+      // Error.
+
+      // We can't "return kj::READY_NOW;" inside this block because it causes a memory leak due to
+      // a bug that exists in both Clang and GCC:
+      //   http://gcc.gnu.org/bugzilla/show_bug.cgi?id=33799
+      //   http://llvm.org/bugs/show_bug.cgi?id=12286
+      goto error;
+    }
+    if (false) {
+    error:
+      return kj::READY_NOW;
+    }
+
+    if (readResult < 0) {
+      // Read would block.
+      return observer.whenBecomesReadable().then([=]() mutable {
+        return readPiecesInternal(firstPiece, morePieces);
+      });
+    } else if (readResult == 0) {
+      KJ_FAIL_REQUIRE("Premature EOF") {
+        // Pretend we read zeros from the input.
+        memset(firstPiece.begin(), 0, firstPiece.size());
+        for (auto piece: morePieces) {
+          memset(piece.begin(), 0, piece.size());
+        }
+        return READY_NOW;
+      }
+    }
+
+    // Discard all pieces that were filled, then issue a new read for what's left (if any).
+    size_t n = readResult;
+    for (;;) {
+      if (n < firstPiece.size()) {
+        // Only part of the first piece was filled.  Read again; the next attempt will wait for
+        // more input if none is available yet.
+        firstPiece = firstPiece.slice(n, firstPiece.size());
+        return readPiecesInternal(firstPiece, morePieces);
+      } else if (morePieces.size() == 0) {
+        // First piece was fully-filled and there are no more pieces, so we're done.
+        KJ_DASSERT(n == firstPiece.size(), n);
+        return READY_NOW;
+      } else {
+        // First piece was fully filled, so move on to the next piece.
+        n -= firstPiece.size();
+        firstPiece = morePieces[0];
+        morePieces = morePieces.slice(1, morePieces.size());
+      }
+    }
+  }
+
   Promise<void> writeInternal(ArrayPtr<const byte> firstPiece,
                               ArrayPtr<const ArrayPtr<const byte>> morePieces) {
     const size_t iovmax = kj::miniposix::iovMax(1 + morePieces.size());
@@ -357,6 +444,13 @@ private:
 
 // =======================================================================================
 
+class HostResolver;
+class SocketAddress;
+
+Promise<Array<SocketAddress>> lookupHost(
+    HostResolver& resolver, String host, String service, uint portHint);
+// Perform a DNS lookup.
+
 class SocketAddress {
 public:
   SocketAddress(const void* sockaddr, uint len): addrlen(len) {
@@ -456,12 +550,14 @@ public:
     }
   }
 
-  static Promise<Array<SocketAddress>> lookupHost(
-      LowLevelAsyncIoProvider& lowLevel, kj::String host, kj::String service, uint portHint);
-  // Perform a DNS lookup.
+  struct LookupParams;
+
+  static Array<SocketAddress> lookupHostBlocking(LookupParams&& params);
+  // Perform a DNS lookup with getaddrinfo(), blocking until it completes.  Called on one of a
+  // `HostResolver`'s threads.
 
   static Promise<Array<SocketAddress>> parse(
-      LowLevelAsyncIoProvider& lowLevel, StringPtr str, uint portHint) {
+      HostResolver& resolver, StringPtr str, uint portHint) {
     // TODO(someday):  Allow commas in `str`.
 
     SocketAddress result;
@@ -525,7 +621,7 @@ public:
       port = strtoul(portText->cStr(), &endptr, 0);
       if (portText->size() == 0 || *endptr != '\0') {
         // Not a number.  Maybe it's a service name.  Fall back to DNS.
-        return lookupHost(lowLevel, kj::heapString(addrPart), kj::heapString(*portText), portHint);
+        return lookupHost(resolver, kj::heapString(addrPart), kj::heapString(*portText), portHint);
       }
       KJ_REQUIRE(port < 65536, "Port number too large.");
     } else {
@@ -581,7 +677,7 @@ public:
       }
       case 0:
         // It's apparently not a simple address...  fall back to DNS.
-        return lookupHost(lowLevel, kj::heapString(addrPart), nullptr, port);
+        return lookupHost(resolver, kj::heapString(addrPart), nullptr, port);
       default:
         KJ_FAIL_SYSCALL("inet_pton", errno, af, addrPart);
     }
@@ -608,152 +704,648 @@ private:
     struct sockaddr_un unixDomain;
     struct sockaddr_storage storage;
   } addr;
+};
 
-  struct LookupParams;
-  class LookupReader;
+struct SocketAddress::LookupParams {
+  kj::String host;
+  kj::String service;
+  uint portHint;
 };
 
-class SocketAddress::LookupReader {
-  // Reads SocketAddresses off of a pipe coming from another thread that is performing
-  // getaddrinfo.
+Array<SocketAddress> SocketAddress::lookupHostBlocking(LookupParams&& params) {
+  // Unfortunately, getaddrinfo() is the only cross-platform DNS API and it is blocking, which is
+  // why HostResolver keeps threads around to call it.
+  //
+  // TODO(perf):  Maybe use the various platform-specific asynchronous DNS libraries?  Please do
+  //   not implement a custom DNS resolver...
+
+  struct addrinfo* list;
+  int status = getaddrinfo(
+      params.host == "*" ? nullptr : params.host.cStr(),
+      params.service == nullptr ? nullptr : params.service.cStr(),
+      nullptr, &list);
+  if (status == 0) {
+    KJ_DEFER(freeaddrinfo(list));
+
+    kj::Vector<SocketAddress> addresses;
+    std::set<SocketAddress> alreadySeen;
+
+    struct addrinfo* cur = list;
+    while (cur != nullptr) {
+      if (params.service == nullptr) {
+        switch (cur->ai_addr->sa_family) {
+          case AF_INET:
+            ((struct sockaddr_in*)cur->ai_addr)->sin_port = htons(params.portHint);
+            break;
+          case AF_INET6:
+            ((struct sockaddr_in6*)cur->ai_addr)->sin6_port = htons(params.portHint);
+            break;
+          default:
+            break;
+        }
+      }
+
+      SocketAddress addr;
+      memset(&addr, 0, sizeof(addr));  // mollify valgrind
+      if (params.host == "*") {
+        // Set up a wildcard SocketAddress.  Only use the port number returned by getaddrinfo().
+        addr.wildcard = true;
+        addr.addrlen = sizeof(addr.addr.inet6);
+        addr.addr.inet6.sin6_family = AF_INET6;
+        switch (cur->ai_addr->sa_family) {
+          case AF_INET:
+            addr.addr.inet6.sin6_port = ((struct sockaddr_in*)cur->ai_addr)->sin_port;
+            break;
+          case AF_INET6:
+            addr.addr.inet6.sin6_port = ((struct sockaddr_in6*)cur->ai_addr)->sin6_port;
+            break;
+          default:
+            addr.addr.inet6.sin6_port = params.portHint;
+            break;
+        }
+      } else {
+        addr.addrlen = cur->ai_addrlen;
+        memcpy(&addr.addr.generic, cur->ai_addr, cur->ai_addrlen);
+      }
+
+      // getaddrinfo() can return multiple copies of the same address for several reasons.
+      // A major one is that we don't give it a socket type (SOCK_STREAM vs. SOCK_DGRAM), so
+      // it may return two copies of the same address, one for each type, unless it explicitly
+      // knows that the service name given is specific to one type.  But we can't tell it a type,
+      // because we don't actually know which one the user wants, and if we specify SOCK_STREAM
+      // while the user specified a UDP service name then they'll get a resolution error which
+      // is lame.  (At least, I think that's how it works.)
+      //
+      // So we instead resort to de-duping results.
+      if (alreadySeen.insert(addr).second) {
+        addresses.add(addr);
+      }
+      cur = cur->ai_next;
+    }
+
+    // getaddrinfo()'s docs seem to say it will never return an empty list, but let's check
+    // anyway.
+    KJ_REQUIRE(addresses.size() > 0, "DNS lookup returned no addresses.") { break; }
+    return addresses.releaseAsArray();
+  } else if (status == EAI_SYSTEM) {
+    KJ_FAIL_SYSCALL("getaddrinfo", errno, params.host, params.service) {
+      return nullptr;
+    }
+  } else {
+    KJ_FAIL_REQUIRE("DNS lookup failed.",
+                    params.host, params.service, gai_strerror(status)) {
+      return nullptr;
+    }
+  }
+}
+
+// =======================================================================================
+
+constexpr uint DNS_THREAD_COUNT = 4;
+
+ThreadPool& getDefaultDnsPool() {
+  // Shared by every resolver in the process that isn't given a pool, so that many event loops
+  // don't each keep their own idle lookup threads.  Never destroyed:  resolvers on other threads
+  // may still be using it at exit, and destroying it would wait out any lookups in progress.
+  static ThreadPool* pool = new ThreadPool(DNS_THREAD_COUNT);
+  return *pool;
+}
+
+class HostResolver {
+  // Performs the DNS lookups for a SocketNetwork.
+  //
+  // Lookups run on the pool given in `options`, or else the process-wide default pool.  Concurrent
+  // lookups of the same name share a single getaddrinfo() call, and successful results are
+  // remembered as `options` says.
 
 public:
-  LookupReader(kj::Own<Thread>&& thread, kj::Own<AsyncInputStream>&& input)
-      : thread(kj::mv(thread)), input(kj::mv(input)) {}
-
-  ~LookupReader() {
-    if (thread) thread->detach();
-  }
-
-  Promise<Array<SocketAddress>> read() {
-    return input->tryRead(&current, sizeof(current), sizeof(current)).then(
-        [this](size_t n) -> Promise<Array<SocketAddress>> {
-      if (n < sizeof(current)) {
-        thread = nullptr;
-        // getaddrinfo()'s docs seem to say it will never return an empty list, but let's check
-        // anyway.
-        KJ_REQUIRE(addresses.size() > 0, "DNS lookup returned no addresses.") { break; }
-        return addresses.releaseAsArray();
+  HostResolver(Timer& timer, NameLookupOptions options)
+      : timer(timer), options(options) {}
+
+  ~HostResolver() noexcept(false) {
+    // Lookups whose callers are still waiting will complete, but must no longer report back to
+    // us.
+    for (auto& entry: cache) {
+      entry.second->resolver = nullptr;
+    }
+    cache.clear();
+  }
+
+  KJ_DISALLOW_COPY(HostResolver);
+
+  Promise<Array<SocketAddress>> lookup(String host, String service, uint portHint) {
+    String key = service == nullptr ? str(host, '\0', portHint) : str(host, '\0', '\0', service);
+
+    auto iter = cache.find(key);
+    if (iter != cache.end()) {
+      Entry& entry = *iter->second;
+      if (!entry.done) {
+        ++stats.coalescedLookups;
+        return KJ_ASSERT_NONNULL(entry.lookup).addBranch()
+            .then(mvCapture(kj::addRef(entry), [](Own<Entry>&& entry) {
+          return heapArray(entry->addresses.asPtr());
+        }));
+      } else if (!entry.failed && timer.now() < entry.expires) {
+        ++stats.cacheHits;
+        return heapArray(entry.addresses.asPtr());
       } else {
-        // getaddrinfo() can return multiple copies of the same address for several reasons.
-        // A major one is that we don't give it a socket type (SOCK_STREAM vs. SOCK_DGRAM), so
-        // it may return two copies of the same address, one for each type, unless it explicitly
-        // knows that the service name given is specific to one type.  But we can't tell it a type,
-        // because we don't actually know which one the user wants, and if we specify SOCK_STREAM
-        // while the user specified a UDP service name then they'll get a resolution error which
-        // is lame.  (At least, I think that's how it works.)
-        //
-        // So we instead resort to de-duping results.
-        if (alreadySeen.insert(current).second) {
-          addresses.add(current);
-        }
-        return read();
+        cache.erase(iter);
       }
+    }
+
+    if (cache.size() >= options.maxCacheEntries) {
+      evict();
+    }
+
+    ThreadPool* pool;
+    KJ_IF_MAYBE(p, options.threadPool) {
+      pool = p;
+    } else {
+      pool = &getDefaultDnsPool();
+    }
+    ++stats.inFlightLookups;
+
+    auto ownEntry = refcounted<Entry>();
+    Entry& entry = *ownEntry;
+    entry.key = kj::mv(key);
+    entry.resolver = this;
+
+    SocketAddress::LookupParams params = { kj::mv(host), kj::mv(service), portHint };
+    auto promise = pool->run(mvCapture(params, [](SocketAddress::LookupParams&& params) {
+      return SocketAddress::lookupHostBlocking(kj::mv(params));
+    })).then([&entry](Array<SocketAddress>&& addresses) {
+      entry.addresses = kj::mv(addresses);
+      entry.finished(false);
+    }, [&entry](Exception&& exception) {
+      entry.finished(true);
+      kj::throwRecoverableException(kj::mv(exception));
     });
+
+    // The fork belongs to the entry, so the lookup finishes (and is cached) even if every caller
+    // loses interest.
+    auto& fork = entry.lookup.emplace(promise.fork());
+    auto result = fork.addBranch().then(mvCapture(kj::addRef(entry), [](Own<Entry>&& entry) {
+      return heapArray(entry->addresses.asPtr());
+    }));
+
+    StringPtr keyPtr = entry.key;
+    cache.insert(std::make_pair(keyPtr, kj::mv(ownEntry)));
+    return kj::mv(result);
   }
 
+  Network::LookupStats getStats() { return stats; }
+
 private:
-  kj::Own<Thread> thread;
-  kj::Own<AsyncInputStream> input;
-  SocketAddress current;
-  kj::Vector<SocketAddress> addresses;
-  std::set<SocketAddress> alreadySeen;
+  struct Entry: public Refcounted {
+    String key;
+
+    HostResolver* resolver;
+    // Null once the resolver is destroyed.
+
+    Maybe<ForkedPromise<void>> lookup;
+    // The getaddrinfo() call, shared by everyone waiting for it.  Kept after it completes, since
+    // it's what calls finished().
+
+    Array<SocketAddress> addresses;
+    TimePoint expires = origin<TimePoint>();
+    bool done = false;
+    bool failed = false;
+
+    void finished(bool failed) {
+      done = true;
+      this->failed = failed;
+      if (resolver != nullptr) {
+        expires = resolver->timer.now() + resolver->options.cacheTtl;
+        --resolver->stats.inFlightLookups;
+      }
+    }
+  };
+
+  Timer& timer;
+  NameLookupOptions options;
+  std::map<StringPtr, Own<Entry>> cache;
+  Network::LookupStats stats = { 0, 0, 0 };
+
+  void evict() {
+    // Drop expired and failed entries.  If that's not enough, drop everything that's finished.
+
+    TimePoint now = timer.now();
+    for (auto iter = cache.begin(); iter != cache.end();) {
+      Entry& entry = *iter->second;
+      if (entry.done && (entry.failed || entry.expires <= now)) {
+        iter = cache.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+
+    if (cache.size() >= options.maxCacheEntries) {
+      for (auto iter = cache.begin(); iter != cache.end();) {
+        if (iter->second->done) {
+          iter = cache.erase(iter);
+        } else {
+          ++iter;
+        }
+      }
+    }
+  }
 };
 
-struct SocketAddress::LookupParams {
-  kj::String host;
-  kj::String service;
+Promise<Array<SocketAddress>> lookupHost(
+    HostResolver& resolver, String host, String service, uint portHint) {
+  return resolver.lookup(kj::mv(host), kj::mv(service), portHint);
+}
+
+// =======================================================================================
+
+constexpr uint FILE_THREAD_COUNT = 4;
+// Threads for file I/O where io_uring is unavailable.  Enough to keep a few requests in flight
+// for the disk without spawning a thread per call.
+
+ThreadPool& getDefaultFilePool() {
+  // Shared by every event loop in the process, like getDefaultDnsPool(), and never destroyed for
+  // the same reasons.
+  static ThreadPool* pool = new ThreadPool(FILE_THREAD_COUNT);
+  return *pool;
+}
+
+constexpr size_t MAX_FILE_CHUNK = 1 << 30;
+// Largest single read or write we ask the kernel for; io_uring lengths are 32 bits and results are
+// ints.
+
+constexpr size_t MAX_BOUNCE_SIZE = 1 << 20;
+// Largest buffer of our own that a read or write of the caller's buffers goes through at a time.
+// Bigger calls are done a chunk at a time, so that they don't need a copy of all the data at once.
+
+Array<byte> trimmed(Array<byte> buffer, size_t size) {
+  // The first `size` bytes of `buffer`.  Only a read cut short by end-of-file needs to copy.
+  return size == buffer.size() ? kj::mv(buffer) : heapArray<byte>(buffer.slice(0, size));
+}
+
+template <typename T, typename Pieces>
+Array<ArrayPtr<T>> skipBytes(Pieces pieces, size_t n) {
+  // Returns what's left of `pieces` after the first `n` bytes, leaving out empty pieces.
+
+  size_t skipped = 0;
+  for (auto& piece: pieces) {
+    if (n < piece.size()) break;
+    n -= piece.size();
+    ++skipped;
+  }
+
+  size_t count = 0;
+  for (auto& piece: pieces.slice(skipped, pieces.size())) {
+    if (piece.size() > 0) ++count;
+  }
+
+  auto builder = heapArrayBuilder<ArrayPtr<T>>(count);
+  for (auto& piece: pieces.slice(skipped, pieces.size())) {
+    if (piece.size() > n) {
+      builder.add(piece.slice(n, piece.size()));
+    }
+    n = 0;
+  }
+  return builder.finish();
+}
+
+template <typename Pieces>
+size_t totalSize(Pieces pieces) {
+  size_t result = 0;
+  for (auto& piece: pieces) {
+    result += piece.size();
+  }
+  return result;
+}
+
+size_t preadFully(int fd, ArrayPtr<byte> buffer, uint64_t offset) {
+  // Blocking.  Stops short only at EOF.
+
+  size_t total = 0;
+  while (total < buffer.size()) {
+    ssize_t n;
+    KJ_SYSCALL(n = ::pread(fd, buffer.begin() + total, buffer.size() - total, offset + total));
+    if (n == 0) break;
+    total += n;
+  }
+  return total;
+}
+
+void pwriteFully(int fd, ArrayPtr<const byte> data, uint64_t offset) {
+  size_t total = 0;
+  while (total < data.size()) {
+    ssize_t n;
+    KJ_SYSCALL(n = ::pwrite(fd, data.begin() + total, data.size() - total, offset + total));
+    total += n;
+  }
+}
+
+class SharedFd final: private Disposer {
+  // A file descriptor used by pool threads as well as by the event loop.  An owned descriptor is
+  // closed only once the last reference is dropped, so that a call still running on the pool never
+  // finds its fd closed -- or worse, reused -- underneath it.
+
+public:
+  static Own<SharedFd> make(int fd, uint flags) {
+    return (new SharedFd(fd, flags))->addRef();
+  }
+
+  Own<SharedFd> addRef() {
+    __atomic_add_fetch(&refcount, 1, __ATOMIC_RELAXED);
+    return Own<SharedFd>(this, *this);
+  }
+
+  const int fd;
+
+private:
+  uint flags;
+  uint refcount = 0;
+  // Accessed atomically.
+
+  SharedFd(int fd, uint flags): fd(fd), flags(flags) {
+    if ((flags & LowLevelAsyncIoProvider::TAKE_OWNERSHIP) &&
+        !(flags & LowLevelAsyncIoProvider::ALREADY_CLOEXEC)) {
+      setCloseOnExec(fd);
+    }
+  }
+
+  ~SharedFd() noexcept(false) {
+    // Don't use SYSCALL() here because close() should not be repeated on EINTR.
+    if ((flags & LowLevelAsyncIoProvider::TAKE_OWNERSHIP) && close(fd) < 0) {
+      KJ_FAIL_SYSCALL("close", errno, fd) {
+        // Recoverable exceptions are safe in destructors.
+        break;
+      }
+    }
+  }
+
+  void disposeImpl(void* pointer) const override {
+    auto self = const_cast<SharedFd*>(this);
+    if (__atomic_sub_fetch(&self->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+      delete self;
+    }
+  }
 };
 
-Promise<Array<SocketAddress>> SocketAddress::lookupHost(
-    LowLevelAsyncIoProvider& lowLevel, kj::String host, kj::String service, uint portHint) {
-  // This shitty function spawns a thread to run getaddrinfo().  Unfortunately, getaddrinfo() is
-  // the only cross-platform DNS API and it is blocking.
-  //
-  // TODO(perf):  Use a thread pool?  Maybe kj::Thread should use a thread pool automatically?
-  //   Maybe use the various platform-specific asynchronous DNS libraries?  Please do not implement
-  //   a custom DNS resolver...
+#if KJ_USE_EPOLL
+class FileRequest final: public UnixEventPort::IoAttachment, public Refcounted {
+  // What an io_uring request on an AsyncFileFd owns.  A canceled request may still be running in
+  // the kernel, so like a pool call it holds a reference to the file and owns the buffer the kernel
+  // is using.
 
-  int fds[2];
-#if __linux__ && !__BIONIC__
-  KJ_SYSCALL(pipe2(fds, O_NONBLOCK | O_CLOEXEC));
-#else
-  KJ_SYSCALL(pipe(fds));
+public:
+  FileRequest(Own<SharedFd> file, Array<byte> data): file(kj::mv(file)), data(kj::mv(data)) {}
+
+  Own<UnixEventPort::IoAttachment> attachment() { return kj::addRef(*this); }
+
+  Own<SharedFd> file;
+  Array<byte> data;
+};
 #endif
 
-  auto input = lowLevel.wrapInputFd(fds[0], NEW_FD_FLAGS);
-
-  int outFd = fds[1];
-
-  LookupParams params = { kj::mv(host), kj::mv(service) };
-
-  auto thread = heap<Thread>(kj::mvCapture(params, [outFd,portHint](LookupParams&& params) {
-    FdOutputStream output((AutoCloseFd(outFd)));
-
-    struct addrinfo* list;
-    int status = getaddrinfo(
-        params.host == "*" ? nullptr : params.host.cStr(),
-        params.service == nullptr ? nullptr : params.service.cStr(),
-        nullptr, &list);
-    if (status == 0) {
-      KJ_DEFER(freeaddrinfo(list));
-
-      struct addrinfo* cur = list;
-      while (cur != nullptr) {
-        if (params.service == nullptr) {
-          switch (cur->ai_addr->sa_family) {
-            case AF_INET:
-              ((struct sockaddr_in*)cur->ai_addr)->sin_port = htons(portHint);
-              break;
-            case AF_INET6:
-              ((struct sockaddr_in6*)cur->ai_addr)->sin6_port = htons(portHint);
-              break;
-            default:
-              break;
-          }
-        }
+class AsyncFileFd final: public AsyncFile {
+  // Calls run on io_uring if available, and otherwise on `pool`.  Either way, they use only
+  // buffers they own:  neither a pool thread nor (once canceled) a ring request can be stopped
+  // midway, so they must not touch the caller's buffers, which may be gone by the time they
+  // finish.  Calls on the caller's buffers copy through one of our own, a chunk at a time.
 
-        SocketAddress addr;
-        memset(&addr, 0, sizeof(addr));  // mollify valgrind
-        if (params.host == "*") {
-          // Set up a wildcard SocketAddress.  Only use the port number returned by getaddrinfo().
-          addr.wildcard = true;
-          addr.addrlen = sizeof(addr.addr.inet6);
-          addr.addr.inet6.sin6_family = AF_INET6;
-          switch (cur->ai_addr->sa_family) {
-            case AF_INET:
-              addr.addr.inet6.sin6_port = ((struct sockaddr_in*)cur->ai_addr)->sin_port;
-              break;
-            case AF_INET6:
-              addr.addr.inet6.sin6_port = ((struct sockaddr_in6*)cur->ai_addr)->sin6_port;
-              break;
-            default:
-              addr.addr.inet6.sin6_port = portHint;
-              break;
-          }
-        } else {
-          addr.addrlen = cur->ai_addrlen;
-          memcpy(&addr.addr.generic, cur->ai_addr, cur->ai_addrlen);
+public:
+  AsyncFileFd(UnixEventPort& eventPort, Maybe<ThreadPool&> pool, int fd, uint flags)
+      : eventPort(eventPort), pool(pool), file(SharedFd::make(fd, flags)) {
+    // Pipes and sockets would report EAGAIN, which neither the pool nor the ring waits out.
+    struct stat stats;
+    KJ_SYSCALL(fstat(fd, &stats));
+    KJ_REQUIRE(S_ISREG(stats.st_mode) || S_ISBLK(stats.st_mode),
+               "AsyncFile needs a regular file or block device; wrap other fds as streams.");
+  }
+
+  Promise<size_t> read(uint64_t offset, ArrayPtr<byte> buffer) override {
+    ArrayPtr<byte> pieces[] = { buffer };
+    return read(offset, pieces);
+  }
+
+  Promise<size_t> read(uint64_t offset, ArrayPtr<ArrayPtr<byte>> pieces) override {
+    return bounceRead(offset, skipBytes<byte>(pieces, 0), 0);
+  }
+
+  Promise<Array<byte>> read(uint64_t offset, Array<byte>&& buffer) override {
+#if KJ_USE_EPOLL
+    if (eventPort.isUsingIoUring()) {
+      return ringRead(eventPort, refcounted<FileRequest>(file->addRef(), kj::mv(buffer)),
+                      offset, 0);
+    }
+#endif
+
+    return getPool().run(mvCapture(buffer, mvCapture(file->addRef(),
+        [offset](Own<SharedFd>&& file, Array<byte>&& buffer) {
+      size_t n = preadFully(file->fd, buffer, offset);
+      return trimmed(kj::mv(buffer), n);
+    })));
+  }
+
+  Promise<void> write(uint64_t offset, ArrayPtr<const byte> data) override {
+    ArrayPtr<const byte> pieces[] = { data };
+    return write(offset, pieces);
+  }
+
+  Promise<void> write(uint64_t offset, ArrayPtr<const ArrayPtr<const byte>> pieces) override {
+    return bounceWrite(offset, skipBytes<const byte>(pieces, 0));
+  }
+
+  Promise<void> write(uint64_t offset, Array<byte>&& data) override {
+#if KJ_USE_EPOLL
+    if (eventPort.isUsingIoUring()) {
+      return ringWrite(eventPort, refcounted<FileRequest>(file->addRef(), kj::mv(data)), offset, 0);
+    }
+#endif
+
+    return getPool().run(mvCapture(data, mvCapture(file->addRef(),
+        [offset](Own<SharedFd>&& file, Array<byte>&& data) {
+      pwriteFully(file->fd, data, offset);
+    })));
+  }
+
+  Promise<void> sync() override {
+#if KJ_USE_EPOLL
+    if (eventPort.isUsingIoUring()) {
+      auto request = refcounted<FileRequest>(file->addRef(), nullptr);
+      int fd = request->file->fd;
+      return eventPort.ioFsync(fd, request->attachment()).then([](int result) {
+        if (result < 0) {
+          KJ_FAIL_SYSCALL("fsync", -result) { break; }
         }
-        static_assert(canMemcpy<SocketAddress>(), "Can't write() SocketAddress...");
-        output.write(&addr, sizeof(addr));
-        cur = cur->ai_next;
+      });
+    }
+#endif
+
+    return getPool().run(mvCapture(file->addRef(), [](Own<SharedFd>&& file) {
+      KJ_SYSCALL(fsync(file->fd));
+    }));
+  }
+
+private:
+  UnixEventPort& eventPort;
+  Maybe<ThreadPool&> pool;
+  Own<SharedFd> file;
+
+  ThreadPool& getPool() {
+    KJ_IF_MAYBE(p, pool) {
+      return *p;
+    } else {
+      KJ_FAIL_ASSERT("AsyncFile has no thread pool.");
+    }
+  }
+
+  Promise<size_t> bounceRead(uint64_t offset, Array<ArrayPtr<byte>> pieces, size_t alreadyRead) {
+    // Reads a chunk into a buffer of our own, copies it out to `pieces`, and repeats.
+
+    size_t size = kj::min(totalSize(pieces.asPtr()), MAX_BOUNCE_SIZE);
+    if (size == 0) {
+      return alreadyRead;
+    }
+
+    return read(offset, heapArray<byte>(size)).then(mvCapture(pieces,
+        [this,offset,size,alreadyRead](Array<ArrayPtr<byte>>&& pieces, Array<byte>&& data)
+            -> Promise<size_t> {
+      size_t pos = 0;
+      for (auto& piece: pieces) {
+        if (pos == data.size()) break;
+        size_t count = kj::min(piece.size(), data.size() - pos);
+        memcpy(piece.begin(), data.begin() + pos, count);
+        pos += count;
       }
-    } else if (status == EAI_SYSTEM) {
-      KJ_FAIL_SYSCALL("getaddrinfo", errno, params.host, params.service) {
-        return;
+
+      if (data.size() < size) {
+        // End of file.
+        return alreadyRead + data.size();
       }
-    } else {
-      KJ_FAIL_REQUIRE("DNS lookup failed.",
-                      params.host, params.service, gai_strerror(status)) {
-        return;
+      return bounceRead(offset + size, skipBytes<byte>(pieces.asPtr(), size),
+                        alreadyRead + size);
+    }));
+  }
+
+  Promise<void> bounceWrite(uint64_t offset, Array<ArrayPtr<const byte>> pieces) {
+    // Copies a chunk of `pieces` into a buffer of our own, writes it, and repeats.
+
+    size_t size = kj::min(totalSize(pieces.asPtr()), MAX_BOUNCE_SIZE);
+    if (size == 0) {
+      return READY_NOW;
+    }
+
+    auto data = heapArray<byte>(size);
+    size_t pos = 0;
+    for (auto& piece: pieces) {
+      if (pos == size) break;
+      size_t count = kj::min(piece.size(), size - pos);
+      memcpy(data.begin() + pos, piece.begin(), count);
+      pos += count;
+    }
+
+    return write(offset, kj::mv(data)).then(mvCapture(pieces,
+        [this,offset,size](Array<ArrayPtr<const byte>>&& pieces) {
+      return bounceWrite(offset + size, skipBytes<const byte>(pieces.asPtr(), size));
+    }));
+  }
+
+#if KJ_USE_EPOLL
+  static bool isTransientError(int result) {
+    // Only regular files and block devices are accepted, so EAGAIN is unexpected and retrying
+    // won't spin, but an interrupted call is simply retried.
+    return result == -EAGAIN || result == -EWOULDBLOCK || result == -EINTR;
+  }
+
+  static Promise<Array<byte>> ringRead(UnixEventPort& eventPort, Own<FileRequest> request,
+                                       uint64_t offset, size_t alreadyRead) {
+    // Reads into `request->data` from `alreadyRead` on, until it's full or end-of-file.
+
+    auto rest = request->data.slice(alreadyRead, request->data.size());
+    if (rest.size() == 0) {
+      return kj::mv(request->data);
+    }
+
+    auto chunk = rest.slice(0, kj::min(rest.size(), MAX_FILE_CHUNK));
+    int fd = request->file->fd;
+    auto attachment = request->attachment();
+    return eventPort.ioPread(fd, chunk, offset, kj::mv(attachment)).then(mvCapture(request,
+        [&eventPort,offset,alreadyRead](Own<FileRequest>&& request, int n)
+            -> Promise<Array<byte>> {
+      if (isTransientError(n)) {
+        return ringRead(eventPort, kj::mv(request), offset, alreadyRead);
+      } else if (n < 0) {
+        KJ_FAIL_SYSCALL("pread", -n) { break; }
+        return trimmed(kj::mv(request->data), alreadyRead);
+      } else if (n == 0) {
+        return trimmed(kj::mv(request->data), alreadyRead);
+      } else {
+        return ringRead(eventPort, kj::mv(request), offset + n, alreadyRead + n);
       }
+    }));
+  }
+
+  static Promise<void> ringWrite(UnixEventPort& eventPort, Own<FileRequest> request,
+                                 uint64_t offset, size_t alreadyWritten) {
+    // Writes `request->data` from `alreadyWritten` on.
+
+    auto rest = request->data.slice(alreadyWritten, request->data.size());
+    if (rest.size() == 0) {
+      return READY_NOW;
     }
-  }));
 
-  auto reader = heap<LookupReader>(kj::mv(thread), kj::mv(input));
-  return reader->read().attach(kj::mv(reader));
-}
+    auto chunk = rest.slice(0, kj::min(rest.size(), MAX_FILE_CHUNK));
+    int fd = request->file->fd;
+    auto attachment = request->attachment();
+    return eventPort.ioPwrite(fd, chunk, offset, kj::mv(attachment)).then(mvCapture(request,
+        [&eventPort,offset,alreadyWritten](Own<FileRequest>&& request, int n) -> Promise<void> {
+      if (isTransientError(n)) {
+        return ringWrite(eventPort, kj::mv(request), offset, alreadyWritten);
+      } else if (n < 0) {
+        KJ_FAIL_SYSCALL("pwrite", -n) { break; }
+        return READY_NOW;
+      } else {
+        return ringWrite(eventPort, kj::mv(request), offset + n, alreadyWritten + n);
+      }
+    }));
+  }
+#endif
+};
+
+class AsyncFileInputStream final: public AsyncInputStream {
+public:
+  AsyncFileInputStream(AsyncFile& file, uint64_t offset): file(file), offset(offset) {}
+
+  Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+    // A file read only comes up short at EOF, so there's no point reading less than `maxBytes`.
+    return file.read(offset, arrayPtr(reinterpret_cast<byte*>(buffer), maxBytes))
+        .then([this](size_t n) {
+      offset += n;
+      return n;
+    });
+  }
+
+private:
+  AsyncFile& file;
+  uint64_t offset;
+};
+
+class AsyncFileOutputStream final: public AsyncOutputStream {
+public:
+  AsyncFileOutputStream(AsyncFile& file, uint64_t offset): file(file), offset(offset) {}
+
+  Promise<void> write(const void* buffer, size_t size) override {
+    auto promise = file.write(offset, arrayPtr(reinterpret_cast<const byte*>(buffer), size));
+    offset += size;
+    return promise;
+  }
+
+  Promise<void> write(ArrayPtr<const ArrayPtr<const byte>> pieces) override {
+    auto promise = file.write(offset, pieces);
+    offset += totalSize(pieces);
+    return promise;
+  }
+
+private:
+  AsyncFile& file;
+  uint64_t offset;
+};
 
 // =======================================================================================
 
@@ -919,6 +1511,14 @@ public:
   Own<DatagramPort> wrapDatagramSocketFd(int fd, uint flags = 0) override {
     return heap<DatagramPortImpl>(*this, eventPort, fd, flags);
   }
+  Own<AsyncFile> wrapFileFd(int fd, uint flags = 0) override {
+#if KJ_USE_EPOLL
+    if (eventPort.isUsingIoUring()) {
+      return heap<AsyncFileFd>(eventPort, nullptr, fd, flags);
+    }
+#endif
+    return heap<AsyncFileFd>(eventPort, getDefaultFilePool(), fd, flags);
+  }
 
   Timer& getTimer() override { return eventPort.getTimer(); }
 
@@ -1037,13 +1637,15 @@ private:
 
 class SocketNetwork final: public Network {
 public:
-  explicit SocketNetwork(LowLevelAsyncIoProvider& lowLevel): lowLevel(lowLevel) {}
+  SocketNetwork(LowLevelAsyncIoProvider& lowLevel, NameLookupOptions nameLookupOptions)
+      : lowLevel(lowLevel), resolver(lowLevel.getTimer(), nameLookupOptions) {}
 
   Promise<Own<NetworkAddress>> parseAddress(StringPtr addr, uint portHint = 0) override {
     auto& lowLevelCopy = lowLevel;
+    auto& resolverCopy = resolver;
     return evalLater(mvCapture(heapString(addr),
-        [&lowLevelCopy,portHint](String&& addr) {
-      return SocketAddress::parse(lowLevelCopy, addr, portHint);
+        [&resolverCopy,portHint](String&& addr) {
+      return SocketAddress::parse(resolverCopy, addr, portHint);
     })).then([&lowLevelCopy](Array<SocketAddress> addresses) -> Own<NetworkAddress> {
       return heap<NetworkAddressImpl>(lowLevelCopy, kj::mv(addresses));
     });
@@ -1055,8 +1657,13 @@ public:
     return Own<NetworkAddress>(heap<NetworkAddressImpl>(lowLevel, array.finish()));
   }
 
+  LookupStats getLookupStats() override {
+    return resolver.getStats();
+  }
+
 private:
   LowLevelAsyncIoProvider& lowLevel;
+  HostResolver resolver;
 };
 
 // =======================================================================================
@@ -1247,8 +1854,9 @@ Own<DatagramReceiver> DatagramPortImpl::makeReceiver(DatagramReceiver::Capacity
 
 class AsyncIoProviderImpl final: public AsyncIoProvider {
 public:
-  AsyncIoProviderImpl(LowLevelAsyncIoProvider& lowLevel)
-      : lowLevel(lowLevel), network(lowLevel) {}
+  AsyncIoProviderImpl(LowLevelAsyncIoProvider& lowLevel, NameLookupOptions nameLookupOptions)
+      : lowLevel(lowLevel), nameLookupOptions(nameLookupOptions),
+        network(lowLevel, nameLookupOptions) {}
 
   OneWayPipe newOneWayPipe() override {
     int fds[2];
@@ -1294,11 +1902,13 @@ public:
 
     auto pipe = lowLevel.wrapSocketFd(fds[0], NEW_FD_FLAGS);
 
+    NameLookupOptions options = nameLookupOptions;
     auto thread = heap<Thread>(kj::mvCapture(startFunc,
-        [threadFd](Function<void(AsyncIoProvider&, AsyncIoStream&, WaitScope&)>&& startFunc) {
+        [threadFd,options](
+            Function<void(AsyncIoProvider&, AsyncIoStream&, WaitScope&)>&& startFunc) mutable {
       LowLevelAsyncIoProviderImpl lowLevel;
       auto stream = lowLevel.wrapSocketFd(threadFd, NEW_FD_FLAGS);
-      AsyncIoProviderImpl ioProvider(lowLevel);
+      AsyncIoProviderImpl ioProvider(lowLevel, options);
       startFunc(ioProvider, *stream, lowLevel.getWaitScope());
     }));
 
@@ -1309,6 +1919,7 @@ public:
 
 private:
   LowLevelAsyncIoProvider& lowLevel;
+  NameLookupOptions nameLookupOptions;
   SocketNetwork network;
 };
 
@@ -1317,6 +1928,16 @@ private:
 Promise<void> AsyncInputStream::read(void* buffer, size_t bytes) {
   return read(buffer, bytes, bytes).then([](size_t) {});
 }
+Promise<void> AsyncInputStream::read(ArrayPtr<ArrayPtr<byte>> pieces) {
+  if (pieces.size() == 0) {
+    return READY_NOW;
+  }
+  auto first = pieces[0];
+  auto rest = pieces.slice(1, pieces.size());
+  return read(first.begin(), first.size()).then([this,rest]() mutable {
+    return read(rest);
+  });
+}
 Promise<size_t> AsyncInputStream::read(void* buffer, size_t minBytes, size_t maxBytes) {
   return tryRead(buffer, minBytes, maxBytes).then([=](size_t result) {
     KJ_REQUIRE(result >= minBytes, "Premature EOF") {
@@ -1328,6 +1949,24 @@ Promise<size_t> AsyncInputStream::read(void* buffer, size_t minBytes, size_t max
   });
 }
 
+Promise<Array<byte>> AsyncFile::read(uint64_t offset, Array<byte>&& buffer) {
+  auto ptr = buffer.asPtr();
+  return read(offset, ptr).then(mvCapture(buffer, [](Array<byte>&& buffer, size_t n) {
+    return trimmed(kj::mv(buffer), n);
+  }));
+}
+Promise<void> AsyncFile::write(uint64_t offset, Array<byte>&& data) {
+  ArrayPtr<const byte> ptr = data;
+  return write(offset, ptr).attach(kj::mv(data));
+}
+
+Own<AsyncInputStream> AsyncFile::readStream(uint64_t offset) {
+  return heap<AsyncFileInputStream>(*this, offset);
+}
+Own<AsyncOutputStream> AsyncFile::writeStream(uint64_t offset) {
+  return heap<AsyncFileOutputStream>(*this, offset);
+}
+
 void AsyncIoStream::getsockopt(int level, int option, void* value, uint* length) {
   KJ_UNIMPLEMENTED("Not a socket.");
 }
@@ -1355,17 +1994,32 @@ void DatagramPort::setsockopt(int level, int option, const void* value, uint len
 Own<DatagramPort> NetworkAddress::bindDatagramPort() {
   KJ_UNIMPLEMENTED("Datagram sockets not implemented.");
 }
+Network::LookupStats Network::getLookupStats() {
+  return { 0, 0, 0 };
+}
 Own<DatagramPort> LowLevelAsyncIoProvider::wrapDatagramSocketFd(int fd, uint flags) {
   KJ_UNIMPLEMENTED("Datagram sockets not implemented.");
 }
+Own<AsyncFile> LowLevelAsyncIoProvider::wrapFileFd(int fd, uint flags) {
+  KJ_UNIMPLEMENTED("Asynchronous file I/O not implemented.");
+}
 
 Own<AsyncIoProvider> newAsyncIoProvider(LowLevelAsyncIoProvider& lowLevel) {
-  return kj::heap<AsyncIoProviderImpl>(lowLevel);
+  return kj::heap<AsyncIoProviderImpl>(lowLevel, NameLookupOptions());
+}
+
+Own<AsyncIoProvider> newAsyncIoProvider(LowLevelAsyncIoProvider& lowLevel,
+                                        NameLookupOptions nameLookupOptions) {
+  return kj::heap<AsyncIoProviderImpl>(lowLevel, nameLookupOptions);
 }
 
 AsyncIoContext setupAsyncIo() {
+  return setupAsyncIo(NameLookupOptions());
+}
+
+AsyncIoContext setupAsyncIo(NameLookupOptions nameLookupOptions) {
   auto lowLevel = heap<LowLevelAsyncIoProviderImpl>();
-  auto ioProvider = kj::heap<AsyncIoProviderImpl>(*lowLevel);
+  auto ioProvider = kj::heap<AsyncIoProviderImpl>(*lowLevel, nameLookupOptions);
   auto& waitScope = lowLevel->getWaitScope();
   auto& eventPort = lowLevel->getEventPort();
   return { kj::mv(lowLevel), kj::mv(ioProvider), waitScope, eventPort };
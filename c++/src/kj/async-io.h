@@ -42,6 +42,7 @@ class UnixEventPort;
 #endif
 
 class NetworkAddress;
+class ThreadPool;
 
 // =======================================================================================
 // Streaming I/O
@@ -54,6 +55,12 @@ public:
   virtual Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) = 0;
 
   Promise<void> read(void* buffer, size_t bytes);
+
+  virtual Promise<void> read(ArrayPtr<ArrayPtr<byte>> pieces);
+  // Reads exactly enough bytes to fill each byte array in sequence, failing on premature EOF.  The
+  // arrays (and `pieces` itself) must remain valid until the promise resolves.  The default
+  // implementation read()s each array in turn; implementations backed by a file descriptor use
+  // readv() so that all of the arrays can be filled with one syscall.
 };
 
 class AsyncOutputStream {
@@ -123,6 +130,53 @@ public:
   // Same as the methods of AsyncIoStream.
 };
 
+// =======================================================================================
+// File I/O
+
+class AsyncFile {
+  // A file read and written at explicit offsets.  Disk files are always "ready" as far as poll()
+  // and epoll are concerned, so the usual non-blocking tricks don't apply:  where the event port
+  // uses io_uring, calls go through it, and otherwise they run on a small pool of background
+  // threads.  Either way the event loop keeps running while the disk works.
+  //
+  // An AsyncFile has no current position, and any number of calls may be in progress at once, but
+  // the order in which overlapping writes land is unspecified.
+  //
+  // A disk read or write can't be stopped once it has started, so an implementation may have to
+  // copy data through a buffer of its own rather than use one the caller could free as soon as it
+  // cancels.  The overloads taking an `Array` hand the buffer over instead, avoiding the copy.
+
+public:
+  virtual Promise<size_t> read(uint64_t offset, ArrayPtr<byte> buffer) = 0;
+  // Reads into `buffer` starting at `offset`.  Resolves to the number of bytes read, which is less
+  // than `buffer.size()` only if end-of-file was reached.  The buffer must remain valid until the
+  // promise resolves or is destroyed.
+
+  virtual Promise<size_t> read(uint64_t offset, ArrayPtr<ArrayPtr<byte>> pieces) = 0;
+  // Like read(), but fills each array in sequence, as with preadv().  `pieces` itself is copied.
+
+  virtual Promise<Array<byte>> read(uint64_t offset, Array<byte>&& buffer);
+  // Like read(), but takes ownership of `buffer` and resolves to it, cut down to the bytes read if
+  // end-of-file was reached.
+
+  virtual Promise<void> write(uint64_t offset, ArrayPtr<const byte> data) = 0;
+  virtual Promise<void> write(uint64_t offset, ArrayPtr<const ArrayPtr<const byte>> pieces) = 0;
+  // Writes all of the data starting at `offset`, extending the file if necessary.  The data must
+  // remain valid until the promise resolves or is destroyed.
+
+  virtual Promise<void> write(uint64_t offset, Array<byte>&& data);
+  // Like write(), but takes ownership of `data`.
+
+  virtual Promise<void> sync() = 0;
+  // Waits until everything written so far has reached stable storage, as with fsync().
+
+  Own<AsyncInputStream> readStream(uint64_t offset = 0);
+  Own<AsyncOutputStream> writeStream(uint64_t offset = 0);
+  // Returns a stream which reads or writes sequentially starting at `offset`, e.g. so that
+  // `capnp::readMessage()` and `capnp::writeMessage()` can be used on a file.  The AsyncFile must
+  // outlive the stream.
+};
+
 // =======================================================================================
 // Datagram I/O
 
@@ -281,6 +335,21 @@ public:
 
   virtual Own<NetworkAddress> getSockaddr(const void* sockaddr, uint len) = 0;
   // Construct a network address from a legacy struct sockaddr.
+
+  struct LookupStats {
+    uint64_t cacheHits;
+    // parseAddress() calls answered from the name lookup cache.
+
+    uint64_t coalescedLookups;
+    // parseAddress() calls that joined a lookup of the same name already in progress.
+
+    uint inFlightLookups;
+    // Name lookups currently in progress.
+  };
+
+  virtual LookupStats getLookupStats();
+  // Returns counters describing the name lookups performed by parseAddress().  The default
+  // implementation, for networks that don't look up names, returns all zeros.
 };
 
 // =======================================================================================
@@ -440,6 +509,13 @@ public:
 
   virtual Own<DatagramPort> wrapDatagramSocketFd(Fd fd, uint flags = 0);
 
+  virtual Own<AsyncFile> wrapFileFd(Fd fd, uint flags = 0);
+  // Create an AsyncFile wrapping a file descriptor opened on a regular file or block device.  Only
+  // TAKE_OWNERSHIP and ALREADY_CLOEXEC are meaningful here:  non-blocking mode has no effect on
+  // disk files, so it is left alone.
+  //
+  // The default implementation throws UNIMPLEMENTED.
+
   virtual Timer& getTimer() = 0;
   // Returns a `Timer` based on real time.  Time does not pass while event handlers are running --
   // it only updates when the event loop polls for system events.  This means that calling `now()`
@@ -449,7 +525,29 @@ public:
   // continues to count while the system is suspended.
 };
 
+struct NameLookupOptions {
+  // Controls how the `Network` of an `AsyncIoProvider` looks up host names.  Concurrent lookups of
+  // the same name always share a single getaddrinfo() call; these options control whether finished
+  // lookups are remembered, and where the calls run.
+
+  Duration cacheTtl = 0 * SECONDS;
+  // How long a successful lookup is remembered.  Zero (the default) disables the cache, so that
+  // every parseAddress() sees the current DNS records.  getaddrinfo() doesn't report the records'
+  // actual TTLs, so any nonzero value is a guess; keep it short if you follow DNS changes.
+
+  uint maxCacheEntries = 256;
+  // Names remembered at once, including lookups in progress.  When full, expired and then all
+  // finished entries are dropped.
+
+  Maybe<ThreadPool&> threadPool = nullptr;
+  // Pool on which the getaddrinfo() calls run, which must outlive the `Network`.  If null, they
+  // run on a pool of a few threads shared by every `Network` in the process that doesn't name its
+  // own, started on first use.
+};
+
 Own<AsyncIoProvider> newAsyncIoProvider(LowLevelAsyncIoProvider& lowLevel);
+Own<AsyncIoProvider> newAsyncIoProvider(LowLevelAsyncIoProvider& lowLevel,
+                                        NameLookupOptions nameLookupOptions);
 // Make a new AsyncIoProvider wrapping a `LowLevelAsyncIoProvider`.
 
 struct AsyncIoContext {
@@ -467,10 +565,12 @@ struct AsyncIoContext {
 };
 
 AsyncIoContext setupAsyncIo();
+AsyncIoContext setupAsyncIo(NameLookupOptions nameLookupOptions);
 // Convenience method which sets up the current thread with everything it needs to do async I/O.
 // The returned objects contain an `EventLoop` which is wrapping an appropriate `EventPort` for
 // doing I/O on the host system, so everything is ready for the thread to start making async calls
-// and waiting on promises.
+// and waiting on promises.  The second form passes `nameLookupOptions` to the provider's
+// `Network`, as newAsyncIoProvider() does.
 //
 // You would typically call this in your main() loop or in the start function of a thread.
 // Example:
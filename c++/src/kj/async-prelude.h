@@ -175,6 +175,8 @@ class ForkHub;
 class TaskSetImpl;
 
 class Event;
+class XThreadEvent;
+class PromisePool;
 
 class PromiseBase {
 public:
@@ -192,6 +194,7 @@ private:
   template <typename>
   friend class kj::Promise;
   friend class TaskSetImpl;
+  friend class XThreadEvent;
   template <typename U>
   friend Promise<Array<U>> kj::joinPromises(Array<Promise<U>>&& promises);
   friend Promise<void> kj::joinPromises(Array<Promise<void>>&& promises);
@@ -695,6 +695,75 @@ TEST(Async, Detach) {
   EXPECT_TRUE(ran3);
 }
 
+TEST(Async, ExecutorSameThread) {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  const Executor& executor = getCurrentThreadExecutor();
+  EXPECT_EQ(&loop.getExecutor(), &executor);
+
+  EXPECT_EQ(123, executor.executeAsync([]() { return 123; }).wait(waitScope));
+  EXPECT_EQ(456, executor.executeAsync([]() {
+    return evalLater([]() { return 456; });
+  }).wait(waitScope));
+
+  EXPECT_ANY_THROW(executor.executeAsync([]() -> int {
+    KJ_FAIL_ASSERT("example executor failure");
+  }).wait(waitScope));
+
+  // Canceled before it runs.
+  bool ran = false;
+  { auto canceled = executor.executeAsync([&]() { ran = true; }); }
+  executor.executeAsync([]() {}).wait(waitScope);
+  EXPECT_FALSE(ran);
+
+  // Canceled while waiting on the promise the function returned.
+  bool destroyed = false;
+  {
+    auto paf = newPromiseAndFulfiller<void>();
+    auto promise = executor.executeAsync([&]() {
+      return kj::mv(paf.promise).attach(kj::heap<DestructorDetector>(destroyed));
+    });
+    executor.executeAsync([]() {}).wait(waitScope);
+    EXPECT_FALSE(destroyed);
+  }
+  executor.executeAsync([]() {}).wait(waitScope);
+  EXPECT_TRUE(destroyed);
+}
+
+TEST(Async, PooledAllocation) {
+  // Promise nodes are recycled by the EventLoop.  The first chain has to malloc each of its nodes;
+  // after that, chains of the same shape shouldn't call malloc at all.
+
+  static constexpr uint LINKS = 1000;
+
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  for (uint round = 0; round < 3; round++) {
+    auto before = loop.getAllocationStats();
+
+    Promise<uint> promise = 0u;
+    for (uint i = 0; i < LINKS; i++) {
+      promise = promise.then([](uint n) { return n + 1; });
+    }
+    EXPECT_EQ(LINKS, promise.wait(waitScope));
+
+    auto after = loop.getAllocationStats();
+    uint64_t allocations = after.allocations - before.allocations;
+    uint64_t mallocs = after.mallocs - before.mallocs;
+    KJ_LOG(INFO, "promise chain", LINKS, round, allocations, mallocs);
+
+    EXPECT_GE(allocations, LINKS);
+    EXPECT_EQ(before.live, after.live);
+    if (round == 0) {
+      EXPECT_GE(mallocs, LINKS);
+    } else {
+      EXPECT_EQ(0u, mallocs);
+    }
+  }
+}
+
 class DummyEventPort: public EventPort {
 public:
   bool runnable = false;
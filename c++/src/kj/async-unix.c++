@@ -36,6 +36,26 @@
 #include <sys/epoll.h>
 #include <sys/signalfd.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#if !defined(KJ_USE_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_POLL_ADD_MULTI) && defined(IORING_FEAT_RSRC_TAGS)
+// Also build the io_uring backend when the kernel headers are new enough for it (5.13 or newer).
+// Whether it is actually used is decided at runtime; see UnixEventPort::setIoUringEnabled().
+// This is only decided here, not in the header, so that the header's class layouts don't depend
+// on the kernel headers.
+#define KJ_USE_IO_URING 1
+#endif
+#endif
+#endif
+#if KJ_USE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#endif
 #else
 #include <poll.h>
 #endif
@@ -50,6 +70,11 @@ TimePoint UnixEventPort::readClock() {
       std::chrono::steady_clock::now().time_since_epoch()).count() * NANOSECONDS;
 }
 
+void UnixEventPort::setTimerSlack(Duration slack) {
+  KJ_REQUIRE(slack >= 0 * NANOSECONDS, "timer slack can't be negative") { return; }
+  timerSlack = slack;
+}
+
 // =======================================================================================
 // Signal code common to multiple implementations
 
@@ -190,6 +215,437 @@ void UnixEventPort::gotSignal(const siginfo_t& siginfo) {
   }
 }
 
+#if KJ_USE_EPOLL
+
+namespace {
+
+bool ioUringEnabled = true;
+// Accessed atomically, since setIoUringEnabled() may be called from any thread.
+
+}  // namespace
+
+void UnixEventPort::setIoUringEnabled(bool enabled) {
+  __atomic_store_n(&ioUringEnabled, enabled, __ATOMIC_RELAXED);
+}
+
+UnixEventPort::IoAttachment::~IoAttachment() noexcept(false) {}
+
+#endif  // KJ_USE_EPOLL
+
+#if KJ_USE_IO_URING
+// =======================================================================================
+// io_uring support
+//
+// The ring is used in place of epoll:  FdObservers submit multishot polls, the signalfd and the
+// eventfd used by wake() are polled the same way, and wait() passes the timer's deadline straight
+// to io_uring_enter().  Disk I/O submitted through ioPread() etc. completes into promises; streams
+// and sockets do their I/O with ordinary non-blocking system calls once their polls fire.
+// Submissions accumulate in the submission queue and are passed to the kernel in one
+// io_uring_enter() per turn of the event loop, together with the wait for completions.
+
+namespace {
+
+constexpr uint64_t SIGNAL_TOKEN = 0;
+constexpr uint64_t WAKE_TOKEN = 1;
+constexpr uint64_t CANCEL_TOKEN = 2;
+// user_data values for internal requests.  Anything else is an IoCompletion pointer.
+
+constexpr uint IO_URING_ENTRIES = 256;
+
+int ioUringSetup(uint entries, struct io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int ioUringEnter(int fd, uint toSubmit, uint minComplete, uint flags,
+                 const void* arg, size_t argSize) {
+  return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+int ioUringRegister(int fd, uint opcode, const void* arg, uint count) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+}  // namespace
+
+class UnixEventPort::IoCompletion {
+public:
+  virtual ~IoCompletion() noexcept(false) {}
+
+  virtual void complete(int result, bool more) = 0;
+  // Called from wait() or poll() with the result of the request whose user_data points here.
+  // `more` is true if the request is multishot and will complete again.
+
+  bool canceled = false;
+  // Set by IoUring::cancel(), which takes ownership.  complete() is no longer called; the ring
+  // frees the object on its final completion instead.
+};
+
+class UnixEventPort::IoUring {
+public:
+  static Maybe<Own<IoUring>> tryCreate() {
+    // Returns null if io_uring is disabled or the kernel lacks it or any feature we need, in
+    // which case the caller falls back to epoll.
+
+    if (!__atomic_load_n(&ioUringEnabled, __ATOMIC_RELAXED)) return nullptr;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = ioUringSetup(IO_URING_ENTRIES, &params);
+    if (fd < 0) return nullptr;  // ENOSYS, or EPERM under seccomp or sysctl restrictions
+    AutoCloseFd ownFd(fd);
+
+    // There's no feature flag for multishot polls, but they arrived in the same release (5.13)
+    // as IORING_FEAT_RSRC_TAGS.
+    constexpr uint32_t required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+        IORING_FEAT_RW_CUR_POS | IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+    if ((params.features & required) != required) return nullptr;
+
+    return heap<IoUring>(kj::mv(ownFd), params);
+  }
+
+  IoUring(AutoCloseFd fdParam, const struct io_uring_params& params)
+      : fd(kj::mv(fdParam)), sqEntries(params.sq_entries) {
+    ringSize = kj::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+                       params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    ring = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                fd, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) KJ_FAIL_SYSCALL("mmap(io_uring)", errno);
+
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqesPtr = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQES);
+    if (sqesPtr == MAP_FAILED) {
+      int error = errno;
+      munmap(ring, ringSize);
+      KJ_FAIL_SYSCALL("mmap(io_uring)", error);
+    }
+    sqes = reinterpret_cast<struct io_uring_sqe*>(sqesPtr);
+
+    byte* base = reinterpret_cast<byte*>(ring);
+    sqHead = reinterpret_cast<uint32_t*>(base + params.sq_off.head);
+    sqTail = reinterpret_cast<uint32_t*>(base + params.sq_off.tail);
+    sqMask = *reinterpret_cast<uint32_t*>(base + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<uint32_t*>(base + params.sq_off.array);
+    cqHead = reinterpret_cast<uint32_t*>(base + params.cq_off.head);
+    cqTail = reinterpret_cast<uint32_t*>(base + params.cq_off.tail);
+    cqMask = *reinterpret_cast<uint32_t*>(base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(base + params.cq_off.cqes);
+
+    localTail = *sqTail;
+  }
+
+  ~IoUring() noexcept(false) {
+    // Closing the ring would cancel outstanding requests too, but without waiting for them, so
+    // wait here until the kernel is done with the buffers of the requests we're holding.
+    while (canceled.size() > 0) {
+      submit(1, nullptr);
+      reap([this](uint64_t userData, int, bool more) {
+        if (!more) release(userData);
+      });
+    }
+
+    munmap(sqes, sqesSize);
+    munmap(ring, ringSize);
+  }
+
+  KJ_DISALLOW_COPY(IoUring);
+
+  struct io_uring_sqe& getSqe() {
+    // Get a zeroed submission queue entry, to be submitted with the next batch.  If the queue is
+    // full, the batch so far is submitted right away.
+
+    if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+      submit(0, nullptr);
+    }
+
+    uint32_t index = localTail & sqMask;
+    struct io_uring_sqe& sqe = sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqArray[index] = index;
+    ++localTail;
+    return sqe;
+  }
+
+  void submit(uint minComplete, const struct __kernel_timespec* timeout) {
+    // Submit everything queued and optionally wait for completions.  A timeout expiring is not
+    // an error.
+
+    __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+    uint toSubmit = localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uintptr_t>(timeout);
+
+    // Always ask for events: even with minComplete == 0, entering with IORING_ENTER_GETEVENTS
+    // runs completion work (e.g. for polls) that the kernel has queued for this thread.
+    uint flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+
+    if (ioUringEnter(fd, toSubmit, minComplete, flags, &arg, sizeof(arg)) < 0) {
+      int error = errno;
+      switch (error) {
+        case EINTR:
+        case ETIME:
+        case EBUSY:   // completion queue backlogged; reaping will make room
+        case EAGAIN:
+          break;
+        default:
+          KJ_FAIL_SYSCALL("io_uring_enter", error);
+      }
+    }
+  }
+
+  template <typename Func>
+  void reap(Func&& func) {
+    // Call func(userData, result, more) for each completion.  Completions are copied out of the
+    // ring before any callback runs, so callbacks may submit new requests.
+
+    for (;;) {
+      struct { uint64_t userData; int result; bool more; } batch[32];
+      uint count = 0;
+
+      uint32_t head = *cqHead;
+      uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+      while (head != tail && count < kj::size(batch)) {
+        auto& cqe = cqes[head & cqMask];
+        batch[count].userData = cqe.user_data;
+        batch[count].result = cqe.res;
+        batch[count].more = cqe.flags & IORING_CQE_F_MORE;
+        ++count;
+        ++head;
+      }
+      __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+      if (count == 0) return;
+      for (uint i = 0; i < count; i++) {
+        func(batch[i].userData, batch[i].result, batch[i].more);
+      }
+    }
+  }
+
+  void cancel(Own<IoCompletion> op) {
+    // Cancel an in-flight request without waiting.  The kernel may go on using the request's
+    // buffers until its final completion, so the ring keeps `op` until then.
+    //
+    // The cancellation is submitted right away rather than with the next batch:  a request holds
+    // a reference to its file, so e.g. the peer of a socket that is closed next wouldn't see EOF
+    // until the request is gone, and the loop might not turn again before someone waits for that.
+
+    auto& sqe = getSqe();
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.fd = -1;
+    sqe.addr = reinterpret_cast<uintptr_t>(op.get());
+    sqe.user_data = CANCEL_TOKEN;
+
+    op->canceled = true;
+    canceled.add(kj::mv(op));
+
+    submit(0, nullptr);
+  }
+
+  void release(uint64_t userData) {
+    // Free a canceled request, given its final completion.  Does nothing if `userData` isn't one.
+
+    for (auto& op: canceled) {
+      if (reinterpret_cast<uintptr_t>(op.get()) == userData) {
+        auto dropped = kj::mv(op);
+        op = kj::mv(canceled.back());
+        canceled.removeLast();
+        return;
+      }
+    }
+  }
+
+  void registerBuffers(ArrayPtr<const ArrayPtr<byte>> buffers) {
+    if (fixedBuffers.size() > 0) {
+      KJ_SYSCALL(ioUringRegister(fd, IORING_UNREGISTER_BUFFERS, nullptr, 0));
+      fixedBuffers.clear();
+    }
+    if (buffers.size() == 0) return;
+
+    auto iov = heapArray<struct iovec>(buffers.size());
+    for (auto i: indices(buffers)) {
+      iov[i].iov_base = const_cast<byte*>(buffers[i].begin());
+      iov[i].iov_len = buffers[i].size();
+    }
+    KJ_SYSCALL(ioUringRegister(fd, IORING_REGISTER_BUFFERS, iov.begin(), iov.size()));
+    fixedBuffers.addAll(buffers);
+  }
+
+  Maybe<uint16_t> findFixedBuffer(const byte* begin, size_t size) {
+    for (auto i: indices(fixedBuffers)) {
+      auto& buffer = fixedBuffers[i];
+      if (begin >= buffer.begin() && begin <= buffer.end() &&
+          size <= size_t(buffer.end() - begin)) {
+        return uint16_t(i);
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  AutoCloseFd fd;
+  void* ring;
+  size_t ringSize;
+  struct io_uring_sqe* sqes;
+  size_t sqesSize;
+
+  uint32_t sqEntries;
+  uint32_t* sqHead;
+  uint32_t* sqTail;
+  uint32_t sqMask;
+  uint32_t* sqArray;
+  uint32_t localTail;  // entries up to here have been filled in but maybe not submitted
+
+  uint32_t* cqHead;
+  uint32_t* cqTail;
+  uint32_t cqMask;
+  struct io_uring_cqe* cqes;
+
+  Vector<ArrayPtr<byte>> fixedBuffers;
+
+  Vector<Own<IoCompletion>> canceled;
+  // Requests canceled by cancel() whose final completion hasn't arrived yet.  Short, since
+  // canceling a poll is prompt and disk I/O soon finishes.
+};
+
+inline void setPollEvents(struct io_uring_sqe& sqe, uint32_t events) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  // The kernel reads the 32-bit mask as two swapped 16-bit halves.
+  events = (events << 16) | (events >> 16);
+#endif
+  sqe.poll32_events = events;
+}
+
+class UnixEventPort::FdObserver::PollOp final: public UnixEventPort::IoCompletion {
+  // A multishot poll serving one of the observer's fulfillers.  Like epoll's edge-triggered
+  // registration it reports each change in readiness once and stays armed until destroyed.
+  //
+  // Level-triggered (one-shot) polls won't do: the kernel always adds POLLHUP and POLLRDHUP to
+  // the requested events, so a write poll on a socket whose peer has shut down its end would
+  // complete over and over without the socket ever becoming writable.
+
+public:
+  PollOp(FdObserver& observer, short events, short reportMask,
+         Maybe<Own<PromiseFulfiller<void>>>& fulfiller)
+      : observer(observer), events(events), reportMask(reportMask), fulfiller(fulfiller) {}
+
+  static void dispose(Own<PollOp>& op) {
+    // Called when the observer is destroyed.  A poll still in flight is canceled and handed to the
+    // ring, which frees it once the kernel lets go of it.
+    if (op.get() != nullptr && op->inFlight) {
+      auto& ring = *op->observer.eventPort.ioUring;
+      ring.cancel(kj::mv(op));
+    }
+  }
+
+  void arm() {
+    // Called after a new fulfiller has been set.
+
+    if (pending != 0) {
+      // Readiness was reported while nobody was waiting.  It may be stale, but FdObserver is
+      // allowed to fire spuriously.
+      short events = pending;
+      pending = 0;
+      observer.fire(events);
+    }
+
+    if (inFlight) return;
+
+    auto& sqe = observer.eventPort.ioUring->getSqe();
+    sqe.opcode = IORING_OP_POLL_ADD;
+    sqe.fd = observer.fd;
+    setPollEvents(sqe, events);
+    sqe.len = IORING_POLL_ADD_MULTI;
+    sqe.user_data = reinterpret_cast<uintptr_t>(static_cast<IoCompletion*>(this));
+    inFlight = true;
+  }
+
+  void complete(int result, bool more) override {
+    // The kernel ends a multishot poll on error or if the completion queue overflows; it is
+    // re-armed the next time a promise is requested.
+    inFlight = more;
+
+    short events = result < 0 ? POLLERR : result & reportMask;
+    if (fulfiller == nullptr) {
+      // Remember the event for the next request, since an I/O request that completed in the
+      // same batch as this poll may be about to ask for it.  Still fire, to update atEndHint().
+      pending |= events;
+      observer.fire(events);
+    } else {
+      observer.fire(events);
+      if (!inFlight && fulfiller != nullptr) arm();
+    }
+  }
+
+private:
+  FdObserver& observer;
+  short events;
+  short reportMask;
+  Maybe<Own<PromiseFulfiller<void>>>& fulfiller;
+  short pending = 0;
+  bool inFlight = false;
+};
+
+void UnixEventPort::FdObserver::armPoll(Own<PollOp>& op, short events, short reportMask,
+                                        Maybe<Own<PromiseFulfiller<void>>>& fulfiller) {
+  if (!eventPort.isUsingIoUring()) return;
+  if (op.get() == nullptr) {
+    op = heap<PollOp>(*this, events, reportMask, fulfiller);
+  }
+  op->arm();
+}
+
+class UnixEventPort::IoRequest final: public UnixEventPort::IoCompletion {
+  // A request made through one of the I/O methods.  Owned by its IoPromiseAdapter until that is
+  // destroyed, then by the ring if the request was still in flight.
+
+public:
+  IoRequest(PromiseFulfiller<int>& fulfiller, Maybe<Own<IoAttachment>> attachment)
+      : fulfiller(fulfiller), attachment(kj::mv(attachment)) {}
+
+  void complete(int result, bool more) override {
+    done = true;
+    fulfiller.fulfill(kj::cp(result));
+  }
+
+  PromiseFulfiller<int>& fulfiller;
+  bool done = false;
+
+  Array<struct iovec> iov;
+  // Copy of the iovecs, which the kernel reads asynchronously.
+
+  Maybe<Own<IoAttachment>> attachment;
+};
+
+class UnixEventPort::IoPromiseAdapter {
+  // Adapts an io_uring request to a Promise<int>.
+
+public:
+  template <typename Prepare>
+  IoPromiseAdapter(PromiseFulfiller<int>& fulfiller, IoUring& ring,
+                   Maybe<Own<IoAttachment>> attachment, Prepare&& prepare)
+      : ring(ring), request(heap<IoRequest>(fulfiller, kj::mv(attachment))) {
+    auto& sqe = ring.getSqe();
+    prepare(sqe, *request);
+    sqe.user_data = reinterpret_cast<uintptr_t>(static_cast<IoCompletion*>(request.get()));
+  }
+
+  ~IoPromiseAdapter() noexcept(false) {
+    if (!request->done) {
+      ring.cancel(kj::mv(request));
+    }
+  }
+
+  KJ_DISALLOW_COPY(IoPromiseAdapter);
+
+private:
+  IoUring& ring;
+  Own<IoRequest> request;
+};
+
+#endif  // KJ_USE_IO_URING
+
 #if KJ_USE_EPOLL
 // =======================================================================================
 // epoll FdObserver implementation
@@ -198,13 +654,11 @@ UnixEventPort::UnixEventPort()
     : timerImpl(readClock()),
       epollFd(-1),
       signalFd(-1),
-      eventFd(-1) {
+      eventFd(-1),
+      timerFd(-1) {
   pthread_once(&registerReservedSignalOnce, &registerReservedSignal);
 
   int fd;
-  KJ_SYSCALL(fd = epoll_create1(EPOLL_CLOEXEC));
-  epollFd = AutoCloseFd(fd);
-
   KJ_SYSCALL(sigemptyset(&signalFdSigset));
   KJ_SYSCALL(fd = signalfd(-1, &signalFdSigset, SFD_NONBLOCK | SFD_CLOEXEC));
   signalFd = AutoCloseFd(fd);
@@ -212,6 +666,17 @@ UnixEventPort::UnixEventPort()
   KJ_SYSCALL(fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
   eventFd = AutoCloseFd(fd);
 
+#if KJ_USE_IO_URING
+  KJ_IF_MAYBE(ring, IoUring::tryCreate()) {
+    ioUring = kj::mv(*ring);
+    armInternalPoll(signalFd, SIGNAL_TOKEN);
+    armInternalPoll(eventFd, WAKE_TOKEN);
+    return;
+  }
+#endif
+
+  KJ_SYSCALL(fd = epoll_create1(EPOLL_CLOEXEC));
+  epollFd = AutoCloseFd(fd);
 
   struct epoll_event event;
   memset(&event, 0, sizeof(event));
@@ -220,12 +685,26 @@ UnixEventPort::UnixEventPort()
   KJ_SYSCALL(epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &event));
   event.data.u64 = 1;
   KJ_SYSCALL(epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &event));
+
+  // epoll_wait() only takes a timeout in milliseconds, so timers are driven by a timerfd instead.
+  // readClock() uses std::chrono::steady_clock, which is CLOCK_MONOTONIC.
+  KJ_SYSCALL(fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+  timerFd = AutoCloseFd(fd);
+  event.data.u64 = 2;
+  KJ_SYSCALL(epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event));
 }
 
 UnixEventPort::~UnixEventPort() noexcept(false) {}
 
 UnixEventPort::FdObserver::FdObserver(UnixEventPort& eventPort, int fd, uint flags)
     : eventPort(eventPort), fd(fd), flags(flags) {
+#if KJ_USE_IO_URING
+  if (eventPort.isUsingIoUring()) {
+    // Nothing to register; polls are submitted as promises are requested.
+    return;
+  }
+#endif
+
   struct epoll_event event;
   memset(&event, 0, sizeof(event));
 
@@ -246,6 +725,14 @@ UnixEventPort::FdObserver::FdObserver(UnixEventPort& eventPort, int fd, uint fla
 }
 
 UnixEventPort::FdObserver::~FdObserver() noexcept(false) {
+#if KJ_USE_IO_URING
+  if (eventPort.isUsingIoUring()) {
+    PollOp::dispose(readPoll);
+    PollOp::dispose(writePoll);
+    PollOp::dispose(urgentPoll);
+    return;
+  }
+#endif
   KJ_SYSCALL(epoll_ctl(eventPort.epollFd, EPOLL_CTL_DEL, fd, nullptr)) { break; }
 }
 
@@ -284,6 +771,9 @@ Promise<void> UnixEventPort::FdObserver::whenBecomesReadable() {
 
   auto paf = newPromiseAndFulfiller<void>();
   readFulfiller = kj::mv(paf.fulfiller);
+#if KJ_USE_IO_URING
+  armPoll(readPoll, POLLIN | POLLRDHUP, ~0, readFulfiller);
+#endif
   return kj::mv(paf.promise);
 }
 
@@ -292,6 +782,9 @@ Promise<void> UnixEventPort::FdObserver::whenBecomesWritable() {
 
   auto paf = newPromiseAndFulfiller<void>();
   writeFulfiller = kj::mv(paf.fulfiller);
+#if KJ_USE_IO_URING
+  armPoll(writePoll, POLLOUT, POLLOUT | POLLERR | POLLHUP, writeFulfiller);
+#endif
   return kj::mv(paf.promise);
 }
 
@@ -301,17 +794,38 @@ Promise<void> UnixEventPort::FdObserver::whenUrgentDataAvailable() {
 
   auto paf = newPromiseAndFulfiller<void>();
   urgentFulfiller = kj::mv(paf.fulfiller);
+#if KJ_USE_IO_URING
+  // Some kernels never complete a poll for POLLPRI alone when TCP urgent data arrives, so also
+  // wake on in-band data, but only report POLLPRI.
+  armPoll(urgentPoll, POLLPRI | POLLIN, POLLPRI, urgentFulfiller);
+#endif
   return kj::mv(paf.promise);
 }
 
 bool UnixEventPort::wait() {
-  return doEpollWait(
-      timerImpl.timeoutToNextEvent(readClock(), MILLISECONDS, int(maxValue))
-          .map([](uint64_t t) -> int { return t; })
-          .orDefault(-1));
+#if KJ_USE_IO_URING
+  if (isUsingIoUring()) {
+    uint64_t slack = timerSlack / NANOSECONDS;
+    return doIoUringWait(
+        timerImpl.timeoutToNextEvent(readClock(), NANOSECONDS, uint64_t(maxValue) - slack)
+            .map([&](uint64_t t) { return t == 0 ? t : t + slack; }));
+  }
+#endif
+  KJ_IF_MAYBE(next, timerImpl.nextEvent()) {
+    if (*next <= readClock()) {
+      return doEpollWait(0);
+    }
+    armTimerFd(*next);
+  }
+  return doEpollWait(-1);
 }
 
 bool UnixEventPort::poll() {
+#if KJ_USE_IO_URING
+  if (isUsingIoUring()) {
+    return doIoUringWait(uint64_t(0));
+  }
+#endif
   return doEpollWait(0);
 }
 
@@ -430,7 +944,7 @@ static siginfo_t toRegularSiginfo(const struct signalfd_siginfo& siginfo) {
   return result;
 }
 
-bool UnixEventPort::doEpollWait(int timeout) {
+void UnixEventPort::updateSignalFdMask() {
   sigset_t newMask;
   sigemptyset(&newMask);
 
@@ -448,6 +962,47 @@ bool UnixEventPort::doEpollWait(int timeout) {
     signalFdSigset = newMask;
     KJ_SYSCALL(signalfd(signalFd, &signalFdSigset, SFD_NONBLOCK | SFD_CLOEXEC));
   }
+}
+
+void UnixEventPort::handleSignals() {
+  for (;;) {
+    struct signalfd_siginfo siginfo;
+    ssize_t n;
+    KJ_NONBLOCKING_SYSCALL(n = read(signalFd, &siginfo, sizeof(siginfo)));
+    if (n < 0) break;  // no more signals
+
+    KJ_ASSERT(n == sizeof(siginfo));
+
+    gotSignal(toRegularSiginfo(siginfo));
+  }
+}
+
+void UnixEventPort::handleWake() {
+  // Someone called wake() from another thread. Consume the event.
+  uint64_t value;
+  ssize_t n;
+  KJ_NONBLOCKING_SYSCALL(n = read(eventFd, &value, sizeof(value)));
+  KJ_ASSERT(n < 0 || n == sizeof(value));
+}
+
+void UnixEventPort::armTimerFd(TimePoint nextEvent) {
+  // Leave the timer alone if it's already set to go off within the slack window.
+  TimePoint target = nextEvent + timerSlack;
+  KJ_IF_MAYBE(current, timerFdTime) {
+    if (*current >= nextEvent && *current <= target) return;
+  }
+
+  uint64_t ns = (target - origin<TimePoint>()) / NANOSECONDS;
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = ns / 1000000000;
+  spec.it_value.tv_nsec = ns % 1000000000;
+  KJ_SYSCALL(timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr));
+  timerFdTime = target;
+}
+
+bool UnixEventPort::doEpollWait(int timeout) {
+  updateSignalFdMask();
 
   struct epoll_event events[16];
   int n;
@@ -457,25 +1012,18 @@ bool UnixEventPort::doEpollWait(int timeout) {
 
   for (int i = 0; i < n; i++) {
     if (events[i].data.u64 == 0) {
-      for (;;) {
-        struct signalfd_siginfo siginfo;
-        ssize_t n;
-        KJ_NONBLOCKING_SYSCALL(n = read(signalFd, &siginfo, sizeof(siginfo)));
-        if (n < 0) break;  // no more signals
-
-        KJ_ASSERT(n == sizeof(siginfo));
-
-        gotSignal(toRegularSiginfo(siginfo));
-      }
+      handleSignals();
     } else if (events[i].data.u64 == 1) {
-      // Someone called wake() from another thread. Consume the event.
-      uint64_t value;
-      ssize_t n;
-      KJ_NONBLOCKING_SYSCALL(n = read(eventFd, &value, sizeof(value)));
-      KJ_ASSERT(n < 0 || n == sizeof(value));
+      handleWake();
 
       // We were woken. Need to return true.
       woken = true;
+    } else if (events[i].data.u64 == 2) {
+      // The timerfd went off.  Consume the expiration; the timers themselves fire below.
+      uint64_t expirations;
+      ssize_t n;
+      KJ_NONBLOCKING_SYSCALL(n = read(timerFd, &expirations, sizeof(expirations)));
+      timerFdTime = nullptr;
     } else {
       FdObserver* observer = reinterpret_cast<FdObserver*>(events[i].data.ptr);
       observer->fire(events[i].events);
@@ -487,6 +1035,179 @@ bool UnixEventPort::doEpollWait(int timeout) {
   return woken;
 }
 
+#if KJ_USE_IO_URING
+
+void UnixEventPort::armInternalPoll(int fd, uint64_t token) {
+  auto& sqe = ioUring->getSqe();
+  sqe.opcode = IORING_OP_POLL_ADD;
+  sqe.fd = fd;
+  setPollEvents(sqe, POLLIN);
+  sqe.user_data = token;
+}
+
+bool UnixEventPort::doIoUringWait(Maybe<uint64_t> timeoutNs) {
+  updateSignalFdMask();
+
+  auto& ring = *ioUring;
+
+  struct __kernel_timespec ts;
+  const struct __kernel_timespec* timeout = nullptr;
+  uint minComplete = 1;
+  KJ_IF_MAYBE(ns, timeoutNs) {
+    if (*ns == 0) {
+      minComplete = 0;
+    } else {
+      ts.tv_sec = *ns / 1000000000;
+      ts.tv_nsec = *ns % 1000000000;
+      timeout = &ts;
+    }
+  }
+
+  ring.submit(minComplete, timeout);
+
+  bool woken = false;
+  auto dispatch = [&](uint64_t userData, int result, bool more) {
+    switch (userData) {
+      case SIGNAL_TOKEN:
+        handleSignals();
+        armInternalPoll(signalFd, SIGNAL_TOKEN);
+        break;
+      case WAKE_TOKEN:
+        handleWake();
+        armInternalPoll(eventFd, WAKE_TOKEN);
+        woken = true;
+        break;
+      case CANCEL_TOKEN:
+        break;
+      default: {
+        auto op = reinterpret_cast<IoCompletion*>(static_cast<uintptr_t>(userData));
+        if (!op->canceled) {
+          op->complete(result, more);
+        } else if (!more) {
+          ring.release(userData);
+        }
+        break;
+      }
+    }
+  };
+
+  ring.reap(dispatch);
+
+  timerImpl.advanceTo(readClock());
+
+  return woken;
+}
+
+Promise<int> UnixEventPort::ioPread(int fd, ArrayPtr<byte> buffer, uint64_t offset,
+                                    Maybe<Own<IoAttachment>> attachment) {
+  KJ_REQUIRE(isUsingIoUring(), "io_uring is not in use.");
+  return newAdaptedPromise<int, IoPromiseAdapter>(*ioUring, kj::mv(attachment),
+      [&](struct io_uring_sqe& sqe, IoRequest&) {
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(buffer.begin());
+    sqe.len = buffer.size();
+    sqe.off = offset;
+    KJ_IF_MAYBE(index, ioUring->findFixedBuffer(buffer.begin(), buffer.size())) {
+      sqe.opcode = IORING_OP_READ_FIXED;
+      sqe.buf_index = *index;
+    } else {
+      sqe.opcode = IORING_OP_READ;
+    }
+  });
+}
+
+Promise<int> UnixEventPort::ioPreadv(int fd, ArrayPtr<const struct iovec> pieces,
+                                     uint64_t offset, Maybe<Own<IoAttachment>> attachment) {
+  KJ_REQUIRE(isUsingIoUring(), "io_uring is not in use.");
+  return newAdaptedPromise<int, IoPromiseAdapter>(*ioUring, kj::mv(attachment),
+      [&](struct io_uring_sqe& sqe, IoRequest& request) {
+    request.iov = heapArray(pieces);
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(request.iov.begin());
+    sqe.len = request.iov.size();
+    sqe.off = offset;
+  });
+}
+
+Promise<int> UnixEventPort::ioPwrite(int fd, ArrayPtr<const byte> buffer, uint64_t offset,
+                                     Maybe<Own<IoAttachment>> attachment) {
+  KJ_REQUIRE(isUsingIoUring(), "io_uring is not in use.");
+  return newAdaptedPromise<int, IoPromiseAdapter>(*ioUring, kj::mv(attachment),
+      [&](struct io_uring_sqe& sqe, IoRequest&) {
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(buffer.begin());
+    sqe.len = buffer.size();
+    sqe.off = offset;
+    KJ_IF_MAYBE(index, ioUring->findFixedBuffer(buffer.begin(), buffer.size())) {
+      sqe.opcode = IORING_OP_WRITE_FIXED;
+      sqe.buf_index = *index;
+    } else {
+      sqe.opcode = IORING_OP_WRITE;
+    }
+  });
+}
+
+Promise<int> UnixEventPort::ioPwritev(int fd, ArrayPtr<const struct iovec> pieces,
+                                      uint64_t offset, Maybe<Own<IoAttachment>> attachment) {
+  KJ_REQUIRE(isUsingIoUring(), "io_uring is not in use.");
+  return newAdaptedPromise<int, IoPromiseAdapter>(*ioUring, kj::mv(attachment),
+      [&](struct io_uring_sqe& sqe, IoRequest& request) {
+    request.iov = heapArray(pieces);
+    sqe.opcode = IORING_OP_WRITEV;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(request.iov.begin());
+    sqe.len = request.iov.size();
+    sqe.off = offset;
+  });
+}
+
+Promise<int> UnixEventPort::ioFsync(int fd, Maybe<Own<IoAttachment>> attachment) {
+  KJ_REQUIRE(isUsingIoUring(), "io_uring is not in use.");
+  return newAdaptedPromise<int, IoPromiseAdapter>(*ioUring, kj::mv(attachment),
+      [&](struct io_uring_sqe& sqe, IoRequest&) {
+    sqe.opcode = IORING_OP_FSYNC;
+    sqe.fd = fd;
+  });
+}
+
+void UnixEventPort::registerBuffers(ArrayPtr<const ArrayPtr<byte>> buffers) {
+  KJ_REQUIRE(isUsingIoUring(), "io_uring is not in use.");
+  ioUring->registerBuffers(buffers);
+}
+
+#else  // KJ_USE_IO_URING
+// Built against kernel headers that predate the features we need, so isUsingIoUring() is always
+// false and the I/O methods always throw.
+
+class UnixEventPort::IoUring {};
+class UnixEventPort::FdObserver::PollOp {};
+
+Promise<int> UnixEventPort::ioPread(int fd, ArrayPtr<byte> buffer, uint64_t offset,
+                                    Maybe<Own<IoAttachment>> attachment) {
+  KJ_UNIMPLEMENTED("io_uring is not supported by this build.");
+}
+Promise<int> UnixEventPort::ioPreadv(int fd, ArrayPtr<const struct iovec> pieces,
+                                     uint64_t offset, Maybe<Own<IoAttachment>> attachment) {
+  KJ_UNIMPLEMENTED("io_uring is not supported by this build.");
+}
+Promise<int> UnixEventPort::ioPwrite(int fd, ArrayPtr<const byte> buffer, uint64_t offset,
+                                     Maybe<Own<IoAttachment>> attachment) {
+  KJ_UNIMPLEMENTED("io_uring is not supported by this build.");
+}
+Promise<int> UnixEventPort::ioPwritev(int fd, ArrayPtr<const struct iovec> pieces,
+                                      uint64_t offset, Maybe<Own<IoAttachment>> attachment) {
+  KJ_UNIMPLEMENTED("io_uring is not supported by this build.");
+}
+Promise<int> UnixEventPort::ioFsync(int fd, Maybe<Own<IoAttachment>> attachment) {
+  KJ_UNIMPLEMENTED("io_uring is not supported by this build.");
+}
+void UnixEventPort::registerBuffers(ArrayPtr<const ArrayPtr<byte>> buffers) {
+  KJ_UNIMPLEMENTED("io_uring is not supported by this build.");
+}
+
+#endif  // KJ_USE_IO_URING
+
 #else  // KJ_USE_EPOLL
 // =======================================================================================
 // Traditional poll() FdObserver implementation.
@@ -41,6 +41,10 @@
 #define KJ_USE_EPOLL 1
 #endif
 
+#if KJ_USE_EPOLL
+struct iovec;
+#endif
+
 namespace kj {
 
 class UnixEventPort: public EventPort {
@@ -99,6 +103,62 @@ public:
 
   Timer& getTimer() { return timerImpl; }
 
+  void setTimerSlack(Duration slack);
+  // Allow timers to fire up to `slack` after their scheduled time, so that timers scheduled close
+  // together can share one wakeup and the port need not reprogram its kernel timer every time the
+  // next event moves slightly.  Defaults to 50us.  On Linux, timers are otherwise accurate to the
+  // kernel's timer resolution; elsewhere they are rounded up to the next millisecond.
+
+#if KJ_USE_EPOLL
+  static void setIoUringEnabled(bool enabled);
+  // On Linux, UnixEventPort uses io_uring instead of epoll when the kernel supports it (5.13 or
+  // newer, and not blocked by a seccomp filter) and KJ was built against kernel headers that
+  // declare it, unless this is called with `false` first.  Only affects event ports constructed
+  // afterwards.  May be called from any thread.
+
+  inline bool isUsingIoUring() const { return ioUring.get() != nullptr; }
+  // Returns true if this event port is backed by io_uring, in which case the I/O methods below
+  // may be used.  Otherwise they throw.
+
+  class IoAttachment {
+    // Something an I/O operation's buffers or file descriptor belong to.  See ioPread().
+  public:
+    virtual ~IoAttachment() noexcept(false);
+  };
+
+  Promise<int> ioPread(int fd, ArrayPtr<byte> buffer, uint64_t offset,
+                       Maybe<Own<IoAttachment>> attachment = nullptr);
+  Promise<int> ioPreadv(int fd, ArrayPtr<const struct iovec> pieces, uint64_t offset,
+                        Maybe<Own<IoAttachment>> attachment = nullptr);
+  Promise<int> ioPwrite(int fd, ArrayPtr<const byte> buffer, uint64_t offset,
+                        Maybe<Own<IoAttachment>> attachment = nullptr);
+  Promise<int> ioPwritev(int fd, ArrayPtr<const struct iovec> pieces, uint64_t offset,
+                         Maybe<Own<IoAttachment>> attachment = nullptr);
+  Promise<int> ioFsync(int fd, Maybe<Own<IoAttachment>> attachment = nullptr);
+  // Submit the equivalent system call to io_uring.  Each resolves to what the system call would
+  // have returned, or to -errno on failure.  These are for disk files, where pread() and pwrite()
+  // always block:  on the ring they run in the kernel's own worker threads instead.  AsyncFile
+  // uses them.  The iovec arrays are copied.
+  //
+  // Streams and sockets don't use the ring for their I/O.  FdObservers wait for readiness with
+  // polls on the ring, and the reads and writes themselves are ordinary non-blocking system calls.
+  // That way a canceled read can never leave the kernel writing into a buffer its caller has
+  // already freed, which matters for streams, whose reads may wait indefinitely.
+  //
+  // Operations are submitted in batches, once per turn of the event loop.  Canceling the promise
+  // cancels the operation without waiting:  the kernel may go on using the buffers and the fd
+  // until a later wait() or poll() reaps the operation's final completion.  `attachment` is
+  // destroyed only then (or when the promise is destroyed after resolving), so unless the buffers
+  // and the fd are sure to outlive the operation anyway, they should belong to it.
+
+  void registerBuffers(ArrayPtr<const ArrayPtr<byte>> buffers);
+  // Registers buffers with the kernel so that ioPread() and ioPwrite() on memory within them skip
+  // the per-operation page pinning.  AsyncFile's read() and write() taking an `Array` hand the
+  // caller's memory straight to these, so an application that does file I/O through a pool of
+  // buffers of its own can register the pool here.  Replaces any previously-registered set.  The
+  // buffers must remain valid until they are replaced or the event port is destroyed.
+#endif
+
   // implements EventPort ------------------------------------------------------
   bool wait() override;
   bool poll() override;
@@ -110,6 +170,7 @@ private:
   class SignalPromiseAdapter;
 
   TimerImpl timerImpl;
+  Duration timerSlack = 50 * MICROSECONDS;
 
   SignalPromiseAdapter* signalHead = nullptr;
   SignalPromiseAdapter** signalTail = &signalHead;
@@ -123,12 +184,31 @@ private:
   AutoCloseFd epollFd;
   AutoCloseFd signalFd;
   AutoCloseFd eventFd;   // Used for cross-thread wakeups.
+  AutoCloseFd timerFd;   // Fires when the next timer is due.
+
+  Maybe<TimePoint> timerFdTime;
+  // When timerFd is currently set to fire, or null if it's not set.
 
   sigset_t signalFdSigset;
   // Signal mask as currently set on the signalFd. Tracked so we can detect whether or not it
   // needs updating.
 
   bool doEpollWait(int timeout);
+  void armTimerFd(TimePoint nextEvent);
+  void updateSignalFdMask();
+  void handleSignals();
+  void handleWake();
+
+  class IoUring;
+  class IoCompletion;
+  class IoRequest;
+  class IoPromiseAdapter;
+  Own<IoUring> ioUring;  // null if using epoll
+  // Declared whether or not KJ was built with io_uring support, so that the layout of this class
+  // doesn't depend on which kernel headers are installed.
+
+  bool doIoUringWait(Maybe<uint64_t> timeoutNs);
+  void armInternalPoll(int fd, uint64_t token);
 
 #else
   class PollContext;
@@ -257,7 +337,16 @@ private:
 
   void fire(short events);
 
-#if !KJ_USE_EPOLL
+#if KJ_USE_EPOLL
+  class PollOp;
+  Own<PollOp> readPoll;
+  Own<PollOp> writePoll;
+  Own<PollOp> urgentPoll;
+  // In io_uring mode, polls armed when the corresponding promise is first requested.
+
+  void armPoll(Own<PollOp>& op, short events, short reportMask,
+               Maybe<Own<PromiseFulfiller<void>>>& fulfiller);
+#else
   FdObserver* next;
   FdObserver** prev;
   // Linked list of observers which currently have a non-null readFulfiller or writeFulfiller.
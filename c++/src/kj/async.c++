@@ -23,6 +23,7 @@
 #include "debug.h"
 #include "vector.h"
 #include "threadlocal.h"
+#include "mutex.h"
 #include <exception>
 #include <map>
 
@@ -147,7 +148,7 @@ public:
   };
 
   void add(Promise<void>&& promise) {
-    auto task = heap<Task>(*this, kj::mv(promise.node));
+    auto task = allocPromise<Task>(*this, kj::mv(promise.node));
     Task* ptr = task;
     tasks.insert(std::make_pair(ptr, kj::mv(task)));
   }
@@ -197,6 +198,147 @@ public:
 
 NullEventPort NullEventPort::instance = NullEventPort();
 
+// -------------------------------------------------------------------
+
+class PromisePool {
+  // Freelist allocator behind allocPromiseStorage(), one per EventLoop.
+  //
+  // Sizes are rounded up to a multiple of GRANULARITY and each multiple up to MAX_SIZE gets its
+  // own freelist; anything larger goes straight to operator new and delete.  Each block is
+  // preceded by a header pointing at the pool that owns it, or null for blocks allocated when no
+  // loop was current.
+
+public:
+  static void* allocate(size_t size) {
+    EventLoop* loop = threadLocalEventLoop;
+    Header* header;
+    if (loop == nullptr) {
+      header = reinterpret_cast<Header*>(operator new(HEADER_SIZE + size));
+      header->pool = nullptr;
+    } else {
+      header = loop->promisePool->allocateBlock(size);
+    }
+    return reinterpret_cast<byte*>(header) + HEADER_SIZE;
+  }
+
+  static void free(void* storage, size_t size) noexcept {
+    Header* header = reinterpret_cast<Header*>(reinterpret_cast<byte*>(storage) - HEADER_SIZE);
+    if (header->pool == nullptr) {
+      operator delete(header);
+    } else {
+      header->pool->freeBlock(header, size);
+    }
+  }
+
+  EventLoop::AllocationStats stats;
+
+  void detach() {
+    // Called when the EventLoop is destroyed.  Free everything we were holding on to.  If any
+    // blocks are still out, then the application leaked some promises; stick around so that they
+    // can still be freed.
+
+    for (auto& freeList: freeLists) {
+      while (freeList.head != nullptr) {
+        FreeBlock* block = freeList.head;
+        freeList.head = block->next;
+        operator delete(block);
+      }
+      freeList.count = 0;
+    }
+
+    if (stats.live == 0) {
+      delete this;
+    } else {
+      detached = true;
+    }
+  }
+
+private:
+  struct Header {
+    PromisePool* pool;
+  };
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+  struct FreeList {
+    FreeBlock* head = nullptr;
+    uint count = 0;
+  };
+
+  static constexpr size_t HEADER_SIZE = 16;
+  // Keeps the object 16-byte aligned, like malloc().
+
+  static constexpr size_t GRANULARITY = 16;
+  static constexpr size_t MAX_SIZE = 512;
+  static constexpr size_t MAX_FREE_BYTES = 256 * 1024;
+  // Freed blocks beyond this many bytes per size class go back to operator delete, so that one
+  // burst of promises doesn't pin memory forever.
+
+  FreeList freeLists[MAX_SIZE / GRANULARITY];
+  bool detached = false;
+
+  static inline size_t sizeClass(size_t size) {
+    return size == 0 ? 0 : (size - 1) / GRANULARITY;
+  }
+
+  Header* allocateBlock(size_t size) {
+    ++stats.allocations;
+    ++stats.live;
+
+    Header* header;
+    if (size <= MAX_SIZE) {
+      size_t index = sizeClass(size);
+      FreeList& freeList = freeLists[index];
+      if (freeList.head != nullptr) {
+        FreeBlock* block = freeList.head;
+        freeList.head = block->next;
+        --freeList.count;
+        header = reinterpret_cast<Header*>(block);
+      } else {
+        ++stats.mallocs;
+        header = reinterpret_cast<Header*>(
+            operator new(HEADER_SIZE + (index + 1) * GRANULARITY));
+      }
+    } else {
+      ++stats.mallocs;
+      header = reinterpret_cast<Header*>(operator new(HEADER_SIZE + size));
+    }
+
+    header->pool = this;
+    return header;
+  }
+
+  void freeBlock(Header* header, size_t size) {
+    --stats.live;
+
+    if (!detached && size <= MAX_SIZE) {
+      size_t index = sizeClass(size);
+      FreeList& freeList = freeLists[index];
+      if (freeList.count * (index + 1) * GRANULARITY < MAX_FREE_BYTES) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(header);
+        block->next = freeList.head;
+        freeList.head = block;
+        ++freeList.count;
+        return;
+      }
+    }
+
+    operator delete(header);
+
+    if (detached && stats.live == 0) {
+      delete this;
+    }
+  }
+};
+
+void* allocPromiseStorage(size_t size) {
+  return PromisePool::allocate(size);
+}
+
+void freePromiseStorage(void* storage, size_t size) noexcept {
+  PromisePool::free(storage, size);
+}
+
 }  // namespace _ (private)
 
 // =======================================================================================
@@ -210,17 +352,27 @@ void EventPort::wake() const {
 
 EventLoop::EventLoop()
     : port(_::NullEventPort::instance),
-      daemons(kj::heap<_::TaskSetImpl>(_::LoggingErrorHandler::instance)) {}
+      promisePool(new _::PromisePool),
+      daemons(kj::heap<_::TaskSetImpl>(_::LoggingErrorHandler::instance)),
+      executor(*this) {}
 
 EventLoop::EventLoop(EventPort& port)
     : port(port),
-      daemons(kj::heap<_::TaskSetImpl>(_::LoggingErrorHandler::instance)) {}
+      promisePool(new _::PromisePool),
+      daemons(kj::heap<_::TaskSetImpl>(_::LoggingErrorHandler::instance)),
+      executor(*this) {}
 
 EventLoop::~EventLoop() noexcept(false) {
+  // Last of all, let go of cached memory.  (Leaked promises, if any, keep the pool alive.)
+  KJ_DEFER(promisePool->detach());
+
   // Destroy all "daemon" tasks, noting that their destructors might try to access the EventLoop
   // some more.
   daemons = nullptr;
 
+  // Fail requests from other threads, and cancel the ones that are running here.
+  executor.shutdown();
+
   // The application _should_ destroy everything using the EventLoop before destroying the
   // EventLoop itself, so if there are events on the loop, this indicates a memory leak.
   KJ_REQUIRE(head == nullptr, "EventLoop destroyed with events still in the queue.  Memory leak?",
@@ -247,6 +399,8 @@ void EventLoop::run(uint maxTurnCount) {
   running = true;
   KJ_DEFER(running = false);
 
+  executor.poll();
+
   for (uint i = 0; i < maxTurnCount; i++) {
     if (!turn()) {
       break;
@@ -288,6 +442,10 @@ bool EventLoop::turn() {
   }
 }
 
+EventLoop::AllocationStats EventLoop::getAllocationStats() {
+  return promisePool->stats;
+}
+
 bool EventLoop::isRunnable() {
   return head != nullptr;
 }
@@ -328,8 +486,10 @@ void waitImpl(Own<_::PromiseNode>&& node, _::ExceptionOrValue& result, WaitScope
 
   while (!doneEvent.fired) {
     if (!loop.turn()) {
-      // No events in the queue.  Wait for callback.
-      loop.port.wait();
+      // No events in the queue.  Unless other threads have sent us something, wait for callback.
+      if (!loop.executor.poll()) {
+        loop.port.wait();
+      }
     }
   }
 
@@ -344,11 +504,11 @@ void waitImpl(Own<_::PromiseNode>&& node, _::ExceptionOrValue& result, WaitScope
 }
 
 Promise<void> yield() {
-  return Promise<void>(false, kj::heap<YieldPromiseNode>());
+  return Promise<void>(false, _::allocPromise<YieldPromiseNode>());
 }
 
 Own<PromiseNode> neverDone() {
-  return kj::heap<NeverDonePromiseNode>();
+  return _::allocPromise<NeverDonePromiseNode>();
 }
 
 void NeverDone::wait(WaitScope& waitScope) const {
@@ -488,6 +648,285 @@ kj::String TaskSet::trace() {
   return impl->trace();
 }
 
+// =======================================================================================
+// Cross-thread execution
+//
+// A request starts out QUEUED in the target executor's queue.  The target thread moves it to
+// EXECUTING and calls the function from a TargetEvent, which then waits for whatever promise the
+// function returned.  Once that settles, the target thread moves the request to DONE and pushes it
+// onto the requesting thread's queue, where it is delivered to the promise.
+//
+// If the requester destroys the promise first, it moves the request from QUEUED or EXECUTING to
+// CANCELED without waiting.  A QUEUED request is still in the target's queue, so the target frees
+// it when it gets to it; an EXECUTING one is pushed onto the target's queue again for the same
+// purpose.  A request that is already DONE is (or is about to be) in the requester's own queue,
+// which frees it.
+//
+// The queues are intrusive lock-free stacks:  any thread pushes with compare-and-swap, and the
+// owning thread takes everything at once with an exchange and reverses it into FIFO order.
+
+namespace _ {  // private
+
+class XThreadEvent::TargetEvent final: public Event {
+public:
+  TargetEvent(XThreadEvent& request): request(request) {}
+
+  Maybe<Own<Event>> fire() override {
+    if (!started) {
+      if (__atomic_load_n(&request.state, __ATOMIC_ACQUIRE) == CANCELED) {
+        // Canceled before the function got to run.  The cancellation is on its way through our
+        // executor's queue and will destroy this event.
+        return nullptr;
+      }
+      started = true;
+      node = request.execute();
+      node->setSelfPointer(&node);
+      node->onReady(*this);
+      return nullptr;
+    }
+
+    node->get(request.result);
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([this]() {
+      node = nullptr;
+    })) {
+      request.result.addException(kj::mv(*exception));
+    }
+
+    // finish() may hand the request back to the requesting thread, after which we must not touch
+    // it, so take ownership of ourselves first.
+    Own<Event> self = kj::mv(request.targetEvent);
+    request.finish();
+    return kj::mv(self);
+  }
+
+  _::PromiseNode* getInnerForTrace() override {
+    return node;
+  }
+
+private:
+  XThreadEvent& request;
+  Own<PromiseNode> node;
+  bool started = false;
+};
+
+XThreadEvent::XThreadEvent(ExceptionOrValue& result, const Executor& targetExecutor)
+    : result(result), targetExecutor(targetExecutor),
+      replyExecutor(currentEventLoop().getExecutor()), state(QUEUED) {
+  if (&targetExecutor != &replyExecutor) {
+    // Both ends will need to wake each other.  Better to find out now than to have the reply go
+    // astray.
+    targetExecutor.requireWake();
+    replyExecutor.requireWake();
+  }
+}
+
+XThreadEvent::~XThreadEvent() noexcept(false) {}
+
+void XThreadEvent::onReady(Event& event) noexcept {
+  onReadyEvent.init(event);
+}
+
+void XThreadEvent::start() {
+  // On the target thread, after moving to EXECUTING.
+
+  Executor& executor = const_cast<Executor&>(targetExecutor);
+  nextExecuting = executor.executing;
+  if (nextExecuting != nullptr) {
+    nextExecuting->prevExecuting = &nextExecuting;
+  }
+  prevExecuting = &executor.executing;
+  executor.executing = this;
+
+  if (executor.shuttingDown) {
+    result.addException(KJ_EXCEPTION(DISCONNECTED, "Executor's EventLoop was destroyed."));
+    finish();
+  } else {
+    targetEvent = allocPromise<TargetEvent>(*this);
+    targetEvent->armBreadthFirst();
+  }
+}
+
+void XThreadEvent::finish() {
+  // On the target thread, once the result is in place.
+
+  uint expected = EXECUTING;
+  if (__atomic_compare_exchange_n(&state, &expected, DONE, false,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    unlinkExecuting();
+    // Even if waking the requester throws, the reply is queued, and the requester must not be
+    // left waiting for us.
+    KJ_DEFER(__atomic_store_n(&replySent, true, __ATOMIC_RELEASE));
+    replyExecutor.send(*this);
+  } else {
+    // Canceled.  The requester is pushing us back onto the target's queue, where we'll be freed.
+    // Until then we stay on the executing list, so that shutdown() knows to wait.
+  }
+}
+
+void XThreadEvent::unlinkExecuting() {
+  if (prevExecuting != nullptr) {
+    *prevExecuting = nextExecuting;
+    if (nextExecuting != nullptr) {
+      nextExecuting->prevExecuting = prevExecuting;
+    }
+    prevExecuting = nullptr;
+    nextExecuting = nullptr;
+  }
+}
+
+void XThreadEvent::deliver() {
+  // On the requesting thread, after the reply arrives.
+
+  if (disposed) {
+    delete this;
+  } else {
+    delivered = true;
+    onReadyEvent.arm();
+  }
+}
+
+void XThreadEvent::disposeImpl(void* pointer) const {
+  // On the requesting thread, when the promise is destroyed.
+
+  XThreadEvent& self = const_cast<XThreadEvent&>(*this);
+
+  uint current = __atomic_load_n(&self.state, __ATOMIC_ACQUIRE);
+  while (current != DONE) {
+    if (__atomic_compare_exchange_n(&self.state, &current, CANCELED, true,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      if (current == EXECUTING) {
+        // The target has already taken the request off its queue.  Put it back so that the target
+        // notices and cleans up.
+        targetExecutor.send(self);
+      }
+      return;
+    }
+  }
+
+  // The target has finished.  Make sure it's done touching the request, then leave the reply to
+  // be freed when it's taken off our queue, if it hasn't been already.
+  while (!__atomic_load_n(&self.replySent, __ATOMIC_ACQUIRE)) {
+    yieldThread();
+  }
+
+  if (delivered) {
+    delete &self;
+  } else {
+    self.disposed = true;
+  }
+}
+
+}  // namespace _ (private)
+
+Executor::Executor(EventLoop& loop): loop(loop) {}
+
+Executor::~Executor() noexcept(false) {}
+
+void Executor::requireWake() const {
+  uint support = __atomic_load_n(&wakeSupport, __ATOMIC_RELAXED);
+  if (support == WAKE_UNKNOWN) {
+    // There's no way to ask an EventPort whether it implements wake() other than calling it.  A
+    // spurious wake-up only costs the loop one extra poll.
+    support = kj::runCatchingExceptions([this]() { loop.port.wake(); }) == nullptr
+        ? WAKE_SUPPORTED : WAKE_UNSUPPORTED;
+    __atomic_store_n(&wakeSupport, support, __ATOMIC_RELAXED);
+  }
+  KJ_REQUIRE(support == WAKE_SUPPORTED,
+      "Cross-thread executeAsync() requires the EventPorts of both threads to implement wake().");
+}
+
+void Executor::send(_::XThreadEvent& event) const {
+  _::XThreadEvent* head = __atomic_load_n(&queue, __ATOMIC_RELAXED);
+  do {
+    event.next = head;
+  } while (!__atomic_compare_exchange_n(&queue, &head, &event, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  if (head == nullptr && threadLocalEventLoop != &loop) {
+    // The queue was empty, so the loop may be asleep.  Otherwise, a wake is already on its way.
+    // (A loop checks its own queue before it sleeps, so it needs no wake from its own thread.)
+    loop.port.wake();
+  }
+}
+
+bool Executor::poll() {
+  _::XThreadEvent* stack = __atomic_exchange_n(&queue, nullptr, __ATOMIC_ACQUIRE);
+  if (stack == nullptr) return false;
+
+  _::XThreadEvent* list = nullptr;
+  while (stack != nullptr) {
+    _::XThreadEvent* next = stack->next;
+    stack->next = list;
+    list = stack;
+    stack = next;
+  }
+
+  while (list != nullptr) {
+    _::XThreadEvent* event = list;
+    // Read the link first:  once the request is EXECUTING, the requester may reuse it.
+    list = event->next;
+    event->next = nullptr;
+
+    uint current = __atomic_load_n(&event->state, __ATOMIC_ACQUIRE);
+    switch (current) {
+      case _::XThreadEvent::QUEUED:
+        if (__atomic_compare_exchange_n(&event->state, &current, _::XThreadEvent::EXECUTING,
+                                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+          event->start();
+        } else {
+          // Canceled just now.
+          delete event;
+        }
+        break;
+
+      case _::XThreadEvent::CANCELED:
+        // Canceled, either before we got to it or while executing.  Destroying the TargetEvent (if
+        // any) cancels whatever promise the function returned.
+        event->unlinkExecuting();
+        event->targetEvent = nullptr;
+        delete event;
+        break;
+
+      case _::XThreadEvent::DONE:
+        // A reply to one of our own requests.
+        event->deliver();
+        break;
+
+      default:
+        KJ_FAIL_ASSERT("Executing request found in an executor's queue.", current) { break; }
+        break;
+    }
+  }
+
+  return true;
+}
+
+void Executor::shutdown() {
+  shuttingDown = true;
+  poll();
+
+  // Cancel the requests still running here and send back errors.
+  _::XThreadEvent* event = executing;
+  while (event != nullptr) {
+    _::XThreadEvent* next = event->nextExecuting;
+    event->targetEvent = nullptr;
+    event->result.addException(KJ_EXCEPTION(DISCONNECTED, "Executor's EventLoop was destroyed."));
+    event->finish();
+    event = next;
+  }
+
+  // Requests that lost a race with their cancellation stay on the list until the requester's push
+  // arrives, which won't take long.
+  while (executing != nullptr) {
+    _::yieldThread();
+    poll();
+  }
+}
+
+const Executor& getCurrentThreadExecutor() {
+  return currentEventLoop().getExecutor();
+}
+
 namespace _ {  // private
 
 kj::String PromiseBase::trace() {
@@ -737,7 +1176,7 @@ Maybe<Own<Event>> ChainPromiseNode::fire() {
     // There is an exception.  If there is also a value, delete it.
     kj::runCatchingExceptions([&,this]() { intermediate.value = nullptr; });
     // Now set step2 to a rejected promise.
-    inner = heap<ImmediateBrokenPromiseNode>(kj::mv(*exception));
+    inner = allocPromise<ImmediateBrokenPromiseNode>(kj::mv(*exception));
   } else KJ_IF_MAYBE(value, intermediate.value) {
     // There is a value and no exception.  The value is itself a promise.  Adopt it as our
     // step2.
@@ -908,7 +1347,7 @@ void ArrayJoinPromiseNode<void>::getNoError(ExceptionOrValue& output) noexcept {
 }  // namespace _ (private)
 
 Promise<void> joinPromises(Array<Promise<void>>&& promises) {
-  return Promise<void>(false, kj::heap<_::ArrayJoinPromiseNode<void>>(
+  return Promise<void>(false, _::allocPromise<_::ArrayJoinPromiseNode<void>>(
       KJ_MAP(p, promises) { return kj::mv(p.node); },
       heapArray<_::ExceptionOr<_::Void>>(promises.size())));
 }
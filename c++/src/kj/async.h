@@ -29,6 +29,7 @@
 #include "async-prelude.h"
 #include "exception.h"
 #include "refcount.h"
+#include <inttypes.h>
 
 namespace kj {
 
@@ -310,6 +311,7 @@ private:
   template <typename U>
   friend Promise<Array<U>> joinPromises(Array<Promise<U>>&& promises);
   friend Promise<void> joinPromises(Array<Promise<void>>&& promises);
+  friend class _::XThreadEvent;
 };
 
 template <typename T>
@@ -523,6 +525,83 @@ private:
   Own<_::TaskSetImpl> impl;
 };
 
+// =======================================================================================
+// Cross-thread execution
+
+class Executor {
+  // Lets other threads schedule work on a particular `EventLoop`.  Get one from
+  // `EventLoop::getExecutor()` or `getCurrentThreadExecutor()` and pass the reference to the
+  // threads that need it.  Unlike nearly everything else in KJ's async framework, `Executor`'s
+  // methods may be called from any thread.
+  //
+  // Requests travel through a lock-free queue.  The target loop's `EventPort` is woken only when
+  // that queue goes from empty to non-empty, so a burst of requests costs a single `wake()`.
+  // Results return to the requesting thread the same way, so the `EventPort`s of both threads
+  // must implement `wake()` (as `UnixEventPort` does); `executeAsync()` throws if either doesn't.
+  //
+  // The executor lives as long as its `EventLoop`.  Requests still pending when the loop is
+  // destroyed fail with a DISCONNECTED exception, but it's up to the application to make sure
+  // no thread calls `executeAsync()` on an executor whose loop may already be gone.
+
+public:
+  template <typename Func>
+  PromiseForResult<Func, void> executeAsync(Func&& func) const KJ_WARN_UNUSED_RESULT;
+  // Calls `func()` on the executor's thread during a future turn of its event loop, and returns a
+  // promise, on the calling thread's event loop, for the result.  If `func()` returns a promise,
+  // the executor's thread waits for it and the returned promise resolves to its result.  The
+  // calling thread must have an `EventLoop`.
+  //
+  // `func` is moved to the executor's thread and normally destroyed there, and its result is
+  // moved back, so neither may hold references to objects that aren't safe to use (or destroy)
+  // from the other thread.
+  //
+  // Destroying the returned promise cancels the request:  if `func()` hasn't run yet it never
+  // will, and if it has returned a promise, that promise is destroyed on the executor's thread.
+  // Cancellation doesn't block the caller.
+
+private:
+  EventLoop& loop;
+
+  mutable _::XThreadEvent* queue = nullptr;
+  // New requests, cancellations and replies, most recent first.  Pushed to by any thread; only
+  // the loop's thread takes items off.
+
+  _::XThreadEvent* executing = nullptr;
+  // Requests whose function has started on this thread and whose reply hasn't been sent.  Only
+  // accessed from the loop's thread.
+
+  bool shuttingDown = false;
+
+  mutable uint wakeSupport = WAKE_UNKNOWN;
+  // Whether `loop.port` implements wake(), found out on first cross-thread use.  Accessed
+  // atomically.
+  enum WakeSupport: uint { WAKE_UNKNOWN, WAKE_SUPPORTED, WAKE_UNSUPPORTED };
+
+  explicit Executor(EventLoop& loop);
+  ~Executor() noexcept(false);
+  KJ_DISALLOW_COPY(Executor);
+
+  void send(_::XThreadEvent& event) const;
+  // Push onto `queue`, waking the loop if it was empty.
+
+  void requireWake() const;
+  // Throws if the loop's EventPort can't be woken from another thread.
+
+  bool poll();
+  // Handle everything in `queue`.  Returns false if it was empty.  Called on the loop's thread
+  // before it sleeps.
+
+  void shutdown();
+
+  friend class EventLoop;
+  friend class _::XThreadEvent;
+  friend void _::waitImpl(Own<_::PromiseNode>&& node, _::ExceptionOrValue& result,
+                          WaitScope& waitScope);
+};
+
+const Executor& getCurrentThreadExecutor();
+// Get the executor for the current thread's event loop.
+
 // =======================================================================================
 // The EventLoop class
 
@@ -627,9 +706,32 @@ public:
   bool isRunnable();
   // Returns true if run() would currently do anything, or false if the queue is empty.
 
+  inline const Executor& getExecutor() { return executor; }
+  // Returns an `Executor` that other threads can use to schedule work on this loop.
+
+  struct AllocationStats {
+    uint64_t allocations = 0;
+    // Promise nodes and events allocated while this loop was current.
+
+    uint64_t mallocs = 0;
+    // How many of those allocations had to go to operator new, because no block of the right
+    // size had been freed back to the loop.
+
+    uint64_t live = 0;
+    // How many of those allocations have not yet been freed.
+  };
+
+  AllocationStats getAllocationStats();
+  // Returns counters for the loop's promise node allocator.  Useful for checking that a hot path
+  // has stopped touching malloc.
+
 private:
   EventPort& port;
 
+  _::PromisePool* promisePool;
+  // Recycles memory for promise nodes and events.  Not an Own because it may need to outlive the
+  // loop, if the application leaks promises.
+
   bool running = false;
   // True while looping -- wait() is then not allowed.
 
@@ -642,6 +744,8 @@ private:
 
   Own<_::TaskSetImpl> daemons;
 
+  Executor executor;
+
   bool turn();
   void setRunnable(bool runnable);
   void enterScope();
@@ -652,6 +756,8 @@ private:
                           WaitScope& waitScope);
   friend class _::Event;
   friend class WaitScope;
+  friend class Executor;
+  friend class _::PromisePool;
 };
 
 class WaitScope {
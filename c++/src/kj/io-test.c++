@@ -54,6 +54,34 @@ TEST(Io, WriteVec) {
   EXPECT_STREQ("foobar", buf);
 }
 
+TEST(Io, ReadVec) {
+  // Check that reading into an array of arrays works, including empty arrays and arrays that are
+  // only partially filled by one readv().
+
+  int fds[2];
+  KJ_SYSCALL(miniposix::pipe(fds));
+
+  FdInputStream in((AutoCloseFd(fds[0])));
+  FdOutputStream out((AutoCloseFd(fds[1])));
+
+  out.write("foob", 4);
+  out.write("arbaz", 5);
+
+  char buf[10];
+  memset(buf, 0, sizeof(buf));
+  ArrayPtr<byte> pieces[5] = {
+    arrayPtr(implicitCast<byte*>(nullptr), 0),
+    arrayPtr(reinterpret_cast<byte*>(buf), 3),
+    arrayPtr(implicitCast<byte*>(nullptr), 0),
+    arrayPtr(reinterpret_cast<byte*>(buf + 3), 3),
+    arrayPtr(reinterpret_cast<byte*>(buf + 6), 3)
+  };
+
+  in.read(pieces);
+
+  EXPECT_STREQ("foobarbaz", buf);
+}
+
 KJ_TEST("stringify AutoCloseFd") {
   int fds[2];
   KJ_SYSCALL(miniposix::pipe(fds));
@@ -53,6 +53,12 @@ size_t InputStream::read(void* buffer, size_t minBytes, size_t maxBytes) {
   return n;
 }
 
+void InputStream::read(ArrayPtr<ArrayPtr<byte>> pieces) {
+  for (auto piece: pieces) {
+    read(piece.begin(), piece.size());
+  }
+}
+
 void InputStream::skip(size_t bytes) {
   char scratch[8192];
   while (bytes > 0) {
@@ -312,6 +318,62 @@ size_t FdInputStream::tryRead(void* buffer, size_t minBytes, size_t maxBytes) {
   return pos - reinterpret_cast<byte*>(buffer);
 }
 
+void FdInputStream::read(ArrayPtr<ArrayPtr<byte>> pieces) {
+#if _WIN32
+  // Windows has no reasonable readv(); see FdOutputStream::write() below.
+  InputStream::read(pieces);
+
+#else
+  const size_t iovmax = miniposix::iovMax(pieces.size());
+  while (pieces.size() > iovmax) {
+    read(pieces.slice(0, iovmax));
+    pieces = pieces.slice(iovmax, pieces.size());
+  }
+
+  KJ_STACK_ARRAY(struct iovec, iov, pieces.size(), 16, 128);
+
+  for (uint i = 0; i < pieces.size(); i++) {
+    iov[i].iov_base = pieces[i].begin();
+    iov[i].iov_len = pieces[i].size();
+  }
+
+  struct iovec* current = iov.begin();
+
+  // Advance past any leading empty buffers so that a read into only empty buffers does not
+  // cause a syscall at all.
+  while (current < iov.end() && current->iov_len == 0) {
+    ++current;
+  }
+
+  while (current < iov.end()) {
+    ssize_t n = 0;
+    KJ_SYSCALL(n = ::readv(fd, current, iov.end() - current), fd);
+    if (n == 0) {
+      KJ_FAIL_REQUIRE("Premature EOF") {
+        // Pretend we read zeros from the input.
+        for (; current < iov.end(); ++current) {
+          memset(current->iov_base, 0, current->iov_len);
+        }
+        return;
+      }
+    }
+
+    // Advance past all buffers that were fully-read.
+    while (current < iov.end() && static_cast<size_t>(n) >= current->iov_len) {
+      n -= current->iov_len;
+      ++current;
+    }
+
+    // If we only partially-filled one of the buffers, adjust the pointer and size to include only
+    // the unfilled part.
+    if (n > 0) {
+      current->iov_base = reinterpret_cast<byte*>(current->iov_base) + n;
+      current->iov_len -= n;
+    }
+  }
+#endif
+}
+
 FdOutputStream::~FdOutputStream() noexcept(false) {}
 
 void FdOutputStream::write(const void* buffer, size_t size) {
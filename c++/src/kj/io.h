@@ -63,6 +63,11 @@ public:
   inline void read(void* buffer, size_t bytes) { read(buffer, bytes, bytes); }
   // Convenience method for reading an exact number of bytes.
 
+  virtual void read(ArrayPtr<ArrayPtr<byte>> pieces);
+  // Reads exactly enough bytes to fill each byte array in sequence, throwing an exception on
+  // premature EOF.  The default implementation read()s each array in turn.  Override if you can
+  // do something better, e.g. use readv() to fill all the arrays in a single syscall.
+
   virtual void skip(size_t bytes);
   // Skips past the given number of bytes, discarding them.  The default implementation read()s
   // into a scratch buffer.
@@ -302,7 +307,9 @@ public:
   KJ_DISALLOW_COPY(FdInputStream);
   ~FdInputStream() noexcept(false);
 
+  using InputStream::read;
   size_t tryRead(void* buffer, size_t minBytes, size_t maxBytes) override;
+  void read(ArrayPtr<ArrayPtr<byte>> pieces) override;
 
 private:
   int fd;
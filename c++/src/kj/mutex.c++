@@ -49,9 +49,21 @@
 #include <windows.h>
 #endif
 
+#if !_WIN32
+#include <sched.h>
+#endif
+
 namespace kj {
 namespace _ {  // private
 
+void yieldThread() {
+#if _WIN32
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
 #if KJ_USE_FUTEX
 // =======================================================================================
 // Futex-based implementation (Linux-only)
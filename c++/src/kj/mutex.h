@@ -151,6 +151,10 @@ private:
 #endif
 };
 
+void yieldThread();
+// Give up the rest of this thread's time slice.  For lock-free code waiting on another thread
+// that's only a few instructions away from finishing something.
+
 }  // namespace _ (private)
 
 // =======================================================================================
@@ -0,0 +1,200 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "thread-pool.h"
+#include "async-io.h"
+#include "debug.h"
+#include <kj/compat/gtest.h>
+
+namespace kj {
+namespace {
+
+class Gate {
+  // Holds pool threads until opened.
+
+public:
+  void pass() const {
+    while (!__atomic_load_n(&open, __ATOMIC_ACQUIRE)) {}
+  }
+
+  void release() {
+    __atomic_store_n(&open, true, __ATOMIC_RELEASE);
+  }
+
+private:
+  bool open = false;
+};
+
+void waitForRunning(ThreadPool& pool, uint count) {
+  while (pool.getStats().running < count) {}
+}
+
+TEST(ThreadPool, Run) {
+  auto io = setupAsyncIo();
+  ThreadPool pool(2);
+
+  EXPECT_EQ(123, pool.run([]() { return 123; }).wait(io.waitScope));
+  EXPECT_EQ("foo", pool.run([]() { return heapString("foo"); }).wait(io.waitScope));
+
+  bool ran = false;
+  pool.run([&ran]() { ran = true; }).wait(io.waitScope);
+  EXPECT_TRUE(ran);
+
+  kj::String message;
+  pool.run([]() -> int { KJ_FAIL_ASSERT("oops"); }).then([](int) {
+    KJ_FAIL_EXPECT("Expected exception.");
+  }, [&message](Exception&& e) {
+    message = kj::str(e.getDescription());
+  }).wait(io.waitScope);
+  KJ_EXPECT(message.endsWith("oops"), message);
+
+  // Many calls at once.
+  Vector<Promise<uint>> promises;
+  for (uint i = 0; i < 1000; i++) {
+    promises.add(pool.run([i]() { return i * 2; }));
+  }
+  auto results = joinPromises(promises.releaseAsArray()).wait(io.waitScope);
+  for (uint i = 0; i < results.size(); i++) {
+    EXPECT_EQ(i * 2, results[i]);
+  }
+
+  auto stats = pool.getStats();
+  EXPECT_EQ(1004u, stats.submitted);
+  EXPECT_EQ(1004u, stats.completed);
+  EXPECT_EQ(0u, stats.queued);
+  EXPECT_EQ(0u, stats.waiting);
+}
+
+TEST(ThreadPool, Steal) {
+  // A call queued behind a slow one is picked up by another thread.
+
+  auto io = setupAsyncIo();
+  ThreadPool pool(2);
+
+  Gate gate;
+  auto slow = pool.run([&gate]() { gate.pass(); return 1; });
+  auto other = pool.run([]() { return 2; });
+  auto behindSlow = pool.run([]() { return 3; });
+
+  EXPECT_EQ(2, other.wait(io.waitScope));
+  EXPECT_EQ(3, behindSlow.wait(io.waitScope));
+  EXPECT_GE(pool.getStats().stolen, 1u);
+
+  gate.release();
+  EXPECT_EQ(1, slow.wait(io.waitScope));
+}
+
+TEST(ThreadPool, Backpressure) {
+  auto io = setupAsyncIo();
+  ThreadPool pool(1, 2, 3);
+
+  Gate gate;
+  auto blocker = pool.run([&gate]() { gate.pass(); });
+  waitForRunning(pool, 1);
+
+  Vector<Promise<uint>> promises;
+  for (uint i = 0; i < 5; i++) {
+    promises.add(pool.run([i]() { return i; }));
+  }
+
+  auto stats = pool.getStats();
+  EXPECT_EQ(2u, stats.queued);
+  EXPECT_EQ(3u, stats.waiting);
+
+  // With the queue and the overflow list both full, further calls are refused.
+  bool ran = false;
+  Maybe<Exception> rejection;
+  pool.run([&ran]() { ran = true; }).then([]() {
+    KJ_FAIL_EXPECT("Expected exception.");
+  }, [&rejection](Exception&& e) {
+    rejection = kj::mv(e);
+  }).wait(io.waitScope);
+  KJ_IF_MAYBE(e, rejection) {
+    EXPECT_EQ(Exception::Type::OVERLOADED, e->getType());
+  } else {
+    KJ_FAIL_EXPECT("run() should have been rejected.");
+  }
+
+  stats = pool.getStats();
+  EXPECT_EQ(1u, stats.rejected);
+  EXPECT_EQ(3u, stats.waiting);
+
+  gate.release();
+  blocker.wait(io.waitScope);
+  auto results = joinPromises(promises.releaseAsArray()).wait(io.waitScope);
+  for (uint i = 0; i < results.size(); i++) {
+    EXPECT_EQ(i, results[i]);
+  }
+  EXPECT_FALSE(ran);
+
+  stats = pool.getStats();
+  EXPECT_EQ(6u, stats.completed);
+  EXPECT_EQ(0u, stats.queued);
+  EXPECT_EQ(0u, stats.waiting);
+
+  // Once there's room again, calls are accepted.
+  EXPECT_EQ(7u, pool.run([]() { return 7u; }).wait(io.waitScope));
+}
+
+TEST(ThreadPool, Cancel) {
+  auto io = setupAsyncIo();
+  ThreadPool pool(1);
+
+  Gate gate;
+  auto blocker = pool.run([&gate]() { gate.pass(); });
+  waitForRunning(pool, 1);
+
+  bool ran = false;
+  {
+    auto canceled = pool.run([&ran]() { ran = true; });
+  }
+
+  // Canceling the running call just drops its result.
+  {
+    auto canceled = kj::mv(blocker);
+  }
+
+  gate.release();
+  pool.run([]() {}).wait(io.waitScope);
+
+  EXPECT_FALSE(ran);
+  auto stats = pool.getStats();
+  EXPECT_EQ(1u, stats.canceled);
+  EXPECT_EQ(2u, stats.completed);
+}
+
+TEST(ThreadPool, DestroyWhileQueued) {
+  // Destroying the pool finishes the calls already made, and the results are delivered anyway.
+
+  auto io = setupAsyncIo();
+  Gate gate;
+  Promise<uint> promise = nullptr;
+  {
+    ThreadPool pool(1);
+    auto blocker = pool.run([&gate]() { gate.pass(); });
+    promise = pool.run([]() { return 5u; });
+    gate.release();
+  }
+  EXPECT_EQ(5u, promise.wait(io.waitScope));
+}
+
+}  // namespace
+}  // namespace kj
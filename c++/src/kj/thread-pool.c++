@@ -0,0 +1,412 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "thread-pool.h"
+#include "thread.h"
+#include "debug.h"
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN 1  // lolz
+#include <windows.h>
+#include "async-win32.h"
+#include "windows-sanity.h"
+#else
+#include "async-unix.h"
+#endif
+
+namespace kj {
+
+// =======================================================================================
+// A call starts out QUEUED, in a thread's queue or the overflow list.  The thread that takes it
+// moves it to RUNNING and calls the function.  Then it moves it to SENDING, hands the result to
+// the requesting thread's Executor, and marks it SENT.
+//
+// If the requester destroys the promise first, it moves the call from QUEUED or RUNNING to
+// CANCELED, so that the function is skipped or its result dropped.  A call that's SENDING is a
+// few instructions from being SENT, and the requester waits for that:  once the result is in the
+// Executor's queue, the Executor takes care of it even if the requester's loop goes away, but
+// before that, the pool thread must not be allowed to touch an Executor that may be gone.
+
+namespace {
+
+template <typename T>
+inline void increment(T& counter) {
+  __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+}
+
+template <typename T>
+inline void decrement(T& counter) {
+  __atomic_sub_fetch(&counter, 1, __ATOMIC_RELAXED);
+}
+
+class ReplyErrorHandler final: public TaskSet::ErrorHandler {
+public:
+  void taskFailed(Exception&& exception) override {
+    // DISCONNECTED means the requesting thread's loop was destroyed, and the promise with it.
+    if (exception.getType() != Exception::Type::DISCONNECTED) {
+      KJ_LOG(ERROR, "ThreadPool couldn't deliver a result.", exception);
+    }
+  }
+};
+
+}  // namespace
+
+namespace _ {  // private
+
+class ThreadPoolJob::Delivery {
+  // Runs on the requesting thread through its Executor, and delivers the result.  Also delivers
+  // if it's destroyed without running, which happens (on the requesting thread) if the pool
+  // thread's loop goes away first.
+
+public:
+  explicit Delivery(ThreadPoolJob& job): job(&job) {}
+  Delivery(Delivery&& other): job(other.job) { other.job = nullptr; }
+  KJ_DISALLOW_COPY(Delivery);
+
+  ~Delivery() noexcept(false) {
+    if (job != nullptr) {
+      deliver();
+    }
+  }
+
+  void operator()() {
+    deliver();
+  }
+
+private:
+  ThreadPoolJob* job;
+
+  void deliver() {
+    ThreadPoolJob* j = job;
+    job = nullptr;
+    KJ_DEFER(j->release());
+    j->deliver();
+  }
+};
+
+ThreadPoolJob::ThreadPoolJob(): replyExecutor(getCurrentThreadExecutor()) {}
+ThreadPoolJob::~ThreadPoolJob() noexcept(false) {}
+
+void ThreadPoolJob::cancel() {
+  uint current = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+  for (;;) {
+    switch (current) {
+      case QUEUED:
+      case RUNNING:
+        if (__atomic_compare_exchange_n(&state, &current, CANCELED, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+          return;
+        }
+        break;
+      case SENDING:
+        yieldThread();
+        current = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+        break;
+      default:
+        return;
+    }
+  }
+}
+
+void ThreadPoolJob::release() {
+  if (__atomic_sub_fetch(&refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+    delete this;
+  }
+}
+
+}  // namespace _ (private)
+
+struct ThreadPool::Worker {
+  struct Queue {
+    Array<_::ThreadPoolJob*> ring;
+    uint front = 0;
+    uint count = 0;
+
+    explicit Queue(uint capacity): ring(heapArray<_::ThreadPoolJob*>(capacity)) {}
+
+    bool push(_::ThreadPoolJob& job) {
+      if (count == ring.size()) return false;
+      ring[(front + count++) % ring.size()] = &job;
+      return true;
+    }
+
+    _::ThreadPoolJob* popFront() {
+      if (count == 0) return nullptr;
+      _::ThreadPoolJob* job = ring[front];
+      front = (front + 1) % ring.size();
+      --count;
+      return job;
+    }
+
+    _::ThreadPoolJob* popBack() {
+      if (count == 0) return nullptr;
+      return ring[(front + --count) % ring.size()];
+    }
+  };
+
+  Worker(uint index, uint capacity): index(index), queue(capacity) {}
+
+  uint index;
+  MutexGuarded<Queue> queue;
+
+  Own<EventPort> port;
+  // Created by the thread before it first goes idle, but owned here, so that it's safe to wake
+  // even after the thread has exited.
+
+  bool idle = false;
+  // Set (atomically) by the thread just before it checks for work one last time and sleeps.
+  // Whoever clears it wakes the thread.
+
+  Own<Thread> thread;
+};
+
+ThreadPool::ThreadPool(uint threadCount, uint queueCapacity, uint maxWaiting)
+    : queueCapacity(queueCapacity), maxWaiting(maxWaiting), stats({ 0, 0, 0, 0, 0, 0, 0, 0 }) {
+  KJ_REQUIRE(threadCount > 0, "ThreadPool needs at least one thread.");
+  KJ_REQUIRE(queueCapacity > 0, "ThreadPool needs room to queue calls.");
+
+  auto builder = heapArrayBuilder<Own<Worker>>(threadCount);
+  for (uint i = 0; i < threadCount; i++) {
+    builder.add(heap<Worker>(i, queueCapacity));
+  }
+  workers = builder.finish();
+
+  KJ_ON_SCOPE_FAILURE(stop());
+  for (auto& worker: workers) {
+    Worker& workerRef = *worker;
+    worker->thread = heap<Thread>([this,&workerRef]() { work(workerRef); });
+  }
+}
+
+ThreadPool::~ThreadPool() noexcept(false) {
+  stop();
+}
+
+void ThreadPool::stop() {
+  __atomic_store_n(&stopping, true, __ATOMIC_SEQ_CST);
+  for (auto& worker: workers) {
+    wake(*worker);
+  }
+
+  // Threads finish everything that's queued before they exit.
+  for (auto& worker: workers) {
+    worker->thread = nullptr;
+  }
+}
+
+ThreadPool::Stats ThreadPool::getStats() const {
+  Stats result;
+  result.submitted = __atomic_load_n(&stats.submitted, __ATOMIC_RELAXED);
+  result.completed = __atomic_load_n(&stats.completed, __ATOMIC_RELAXED);
+  result.canceled = __atomic_load_n(&stats.canceled, __ATOMIC_RELAXED);
+  result.stolen = __atomic_load_n(&stats.stolen, __ATOMIC_RELAXED);
+  result.rejected = __atomic_load_n(&stats.rejected, __ATOMIC_RELAXED);
+  result.queued = __atomic_load_n(&stats.queued, __ATOMIC_RELAXED);
+  result.waiting = __atomic_load_n(&stats.waiting, __ATOMIC_RELAXED);
+  result.running = __atomic_load_n(&stats.running, __ATOMIC_RELAXED);
+  return result;
+}
+
+bool ThreadPool::submit(_::ThreadPoolJob& job) {
+  increment(stats.submitted);
+
+  uint start = __atomic_fetch_add(&nextWorker, 1, __ATOMIC_RELAXED);
+  for (uint i = 0; i < workers.size(); i++) {
+    Worker& worker = *workers[(start + i) % workers.size()];
+    if (worker.queue.lockExclusive()->push(job)) {
+      increment(stats.queued);
+      if (!wake(worker)) {
+        // Busy.  Someone else may be free to steal the call.
+        wakeAny();
+      }
+      return true;
+    }
+  }
+
+  // Every queue is full.
+  {
+    auto lock = overflow.lockExclusive();
+    if (lock->count >= maxWaiting) {
+      increment(stats.rejected);
+      return false;
+    }
+    *lock->tail = &job;
+    lock->tail = &job.next;
+    ++lock->count;
+  }
+  increment(stats.waiting);
+
+  // In case all the threads emptied their queues and went idle just now.
+  wakeAny();
+  return true;
+}
+
+Exception ThreadPool::overloaded() {
+  return KJ_EXCEPTION(OVERLOADED, "ThreadPool has too many calls waiting.");
+}
+
+bool ThreadPool::wake(Worker& worker) {
+  if (__atomic_exchange_n(&worker.idle, false, __ATOMIC_SEQ_CST)) {
+    worker.port->wake();
+    return true;
+  } else {
+    return false;
+  }
+}
+
+void ThreadPool::wakeAny() {
+  for (auto& worker: workers) {
+    if (wake(*worker)) return;
+  }
+}
+
+Maybe<_::ThreadPoolJob&> ThreadPool::take(Worker& worker) {
+  _::ThreadPoolJob* job = worker.queue.lockExclusive()->popFront();
+
+  if (job == nullptr) {
+    // Steal the newest call from another thread, leaving it the ones that have waited longest.
+    for (uint i = 1; i < workers.size() && job == nullptr; i++) {
+      job = workers[(worker.index + i) % workers.size()]->queue.lockExclusive()->popBack();
+    }
+    if (job != nullptr) {
+      increment(stats.stolen);
+    }
+  }
+
+  if (job != nullptr) {
+    decrement(stats.queued);
+    refill();
+    return *job;
+  }
+
+  {
+    auto lock = overflow.lockExclusive();
+    job = lock->head;
+    if (job == nullptr) return nullptr;
+    lock->head = job->next;
+    if (lock->head == nullptr) lock->tail = &lock->head;
+    --lock->count;
+  }
+  job->next = nullptr;
+  decrement(stats.waiting);
+  return *job;
+}
+
+void ThreadPool::refill() {
+  // Move the oldest call in the overflow list into the queue slot that just opened up.
+
+  _::ThreadPoolJob* job;
+  {
+    auto lock = overflow.lockExclusive();
+    job = lock->head;
+    if (job == nullptr) return;
+    lock->head = job->next;
+    if (lock->head == nullptr) lock->tail = &lock->head;
+    --lock->count;
+  }
+  job->next = nullptr;
+
+  for (auto& worker: workers) {
+    if (worker->queue.lockExclusive()->push(*job)) {
+      decrement(stats.waiting);
+      increment(stats.queued);
+      wake(*worker);
+      return;
+    }
+  }
+
+  // submit() beat us to the slot.  Put the call back at the front.
+  auto lock = overflow.lockExclusive();
+  job->next = lock->head;
+  lock->head = job;
+  if (lock->tail == &lock->head) lock->tail = &job->next;
+  ++lock->count;
+}
+
+void ThreadPool::finish(_::ThreadPoolJob& job, TaskSet& replies) {
+  typedef _::ThreadPoolJob Job;
+
+  uint expected = Job::QUEUED;
+  if (!__atomic_compare_exchange_n(&job.state, &expected, Job::RUNNING, false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    // Canceled before it started.
+    increment(stats.canceled);
+    job.release();
+    return;
+  }
+
+  increment(stats.running);
+  job.execute();
+  decrement(stats.running);
+  increment(stats.completed);
+
+  expected = Job::RUNNING;
+  if (__atomic_compare_exchange_n(&job.state, &expected, Job::SENDING, false,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    KJ_DEFER(__atomic_store_n(&job.state, Job::SENT, __ATOMIC_RELEASE));
+    replies.add(job.replyExecutor.executeAsync(Job::Delivery(job)));
+  } else {
+    // Canceled while running.
+    job.release();
+  }
+}
+
+void ThreadPool::work(Worker& worker) {
+#if _WIN32
+  worker.port = heap<Win32IocpEventPort>();
+#else
+  worker.port = heap<UnixEventPort>();
+#endif
+  EventPort& port = *worker.port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  // Replies are sent through the requesting threads' Executors, and this loop exists to receive
+  // their acknowledgments.
+  ReplyErrorHandler errorHandler;
+  TaskSet replies(errorHandler);
+
+  for (;;) {
+    loop.run();
+
+    KJ_IF_MAYBE(job, take(worker)) {
+      finish(*job, replies);
+      continue;
+    }
+
+    __atomic_store_n(&worker.idle, true, __ATOMIC_SEQ_CST);
+
+    KJ_IF_MAYBE(job, take(worker)) {
+      __atomic_store_n(&worker.idle, false, __ATOMIC_SEQ_CST);
+      finish(*job, replies);
+      continue;
+    }
+
+    if (__atomic_load_n(&stopping, __ATOMIC_SEQ_CST)) {
+      break;
+    }
+
+    port.wait();
+    __atomic_store_n(&worker.idle, false, __ATOMIC_SEQ_CST);
+  }
+}
+
+}  // namespace kj
@@ -0,0 +1,287 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef KJ_THREAD_POOL_H_
+#define KJ_THREAD_POOL_H_
+
+#if defined(__GNUC__) && !KJ_HEADER_WARNINGS
+#pragma GCC system_header
+#endif
+
+#include "async.h"
+#include "mutex.h"
+
+namespace kj {
+
+class ThreadPool;
+
+namespace _ {  // private
+
+class ThreadPoolJob {
+  // A call to ThreadPool::run().  Shared by the requesting thread and the pool, and freed by
+  // whichever lets go last.
+
+public:
+  void cancel();
+  // On the requesting thread, when the promise is destroyed.  Prevents the function from running
+  // if it hasn't started, and the reply from being sent if it hasn't been.
+
+  void release();
+
+protected:
+  ThreadPoolJob();
+  virtual ~ThreadPoolJob() noexcept(false);
+
+  virtual void execute() = 0;
+  // On a pool thread.  Calls the function and stores its result.
+
+  virtual void deliver() = 0;
+  // On the requesting thread, once the result is in place.
+
+private:
+  const Executor& replyExecutor;
+
+  uint refcount = 2;
+  // The requesting thread's promise, and the pool.
+
+  enum State {
+    QUEUED,
+    RUNNING,
+    SENDING,
+    SENT,
+    CANCELED
+  };
+  uint state = QUEUED;
+
+  ThreadPoolJob* next = nullptr;
+  // Link in the pool's overflow list.
+
+  class Delivery;
+  friend class kj::ThreadPool;
+};
+
+template <typename T>
+class ThreadPoolResult: public ThreadPoolJob {
+public:
+  PromiseFulfiller<T>* fulfiller = nullptr;
+  // Null once the promise is gone.  Only touched on the requesting thread.
+
+protected:
+  ExceptionOr<FixVoid<T>> result;
+
+  void deliver() override {
+    KJ_IF_MAYBE(f, fulfiller) {
+      KJ_IF_MAYBE(exception, result.exception) {
+        f->reject(kj::mv(*exception));
+      } else KJ_IF_MAYBE(value, result.value) {
+        f->fulfill(kj::mv(*value));
+      }
+    }
+  }
+};
+
+template <typename T, typename Func>
+class ThreadPoolCall final: public ThreadPoolResult<T> {
+public:
+  template <typename F>
+  ThreadPoolCall(F&& func): func(kj::fwd<F>(func)) {}
+
+protected:
+  void execute() override {
+    KJ_IF_MAYBE(f, func) {
+      KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+        this->result.value = MaybeVoidCaller<Void, FixVoid<T>>::apply(*f, Void());
+      })) {
+        this->result.addException(kj::mv(*exception));
+      }
+    }
+    func = nullptr;
+  }
+
+private:
+  Maybe<Func> func;
+};
+
+template <typename T>
+class ThreadPoolAdapter {
+public:
+  ThreadPoolAdapter(PromiseFulfiller<T>& fulfiller, ThreadPoolResult<T>& job, ThreadPool& pool);
+  ~ThreadPoolAdapter() noexcept(false) {
+    job.fulfiller = nullptr;
+    job.cancel();
+    job.release();
+  }
+  KJ_DISALLOW_COPY(ThreadPoolAdapter);
+
+private:
+  ThreadPoolResult<T>& job;
+};
+
+}  // namespace _ (private)
+
+class ThreadPool {
+  // A fixed set of threads for running blocking or CPU-heavy functions -- compression, disk reads,
+  // getaddrinfo() -- without stalling an event loop.
+  //
+  // Each thread has its own bounded queue.  New calls are spread across the queues round-robin,
+  // and a thread whose queue runs dry takes calls from the back of the others' before it sleeps,
+  // so one slow call doesn't hold up everything queued behind it.  When every queue is full, new
+  // calls wait in an overflow list and are moved into a queue as space frees up.  The overflow
+  // list is bounded too:  once it is full, run() fails with an OVERLOADED exception instead of
+  // queuing more, so a caller that outpaces the pool finds out rather than growing its memory
+  // without limit.
+  //
+  // Results are delivered through the calling thread's `Executor`, so the calling thread's
+  // `EventPort` must implement `wake()` (as `UnixEventPort` does).
+
+public:
+  explicit ThreadPool(uint threadCount, uint queueCapacity = 64, uint maxWaiting = 1024);
+  // Starts `threadCount` threads, each with room for `queueCapacity` pending calls.  Up to
+  // `maxWaiting` more may wait for room in the queues; beyond that, calls are rejected.
+
+  ~ThreadPool() noexcept(false);
+  // Waits for every call already made to finish, then joins the threads.  Results that couldn't be
+  // delivered yet are delivered when the requesting thread next runs its event loop.
+  //
+  // The wait can't be shortened:  a call that's already running can't be interrupted.  If the pool
+  // is destroyed on an event loop's thread while a slow call is running -- a getaddrinfo() waiting
+  // out a DNS timeout, say -- the loop stalls until that call returns.  Keep such pools alive as
+  // long as their loop, or destroy them somewhere a stall doesn't matter.
+
+  KJ_DISALLOW_COPY(ThreadPool);
+
+  template <typename Func>
+  Promise<_::ReturnType<Func, void>> run(Func&& func) KJ_WARN_UNUSED_RESULT;
+  // Calls `func()` on one of the pool's threads, and returns a promise, on the calling thread's
+  // event loop, for the result.  `func` should do its work synchronously; it must not return a
+  // promise.  Destroying the returned promise before `func()` has started means it never will.
+  // If the pool already has `maxWaiting` calls waiting for room, the promise is rejected with an
+  // OVERLOADED exception and `func` is never called.
+  //
+  // `func` is destroyed on the pool's thread after it runs (or on either thread, if it never
+  // does), and its result is moved to the calling thread, so neither may hold references to objects
+  // that aren't safe to use from another thread.
+
+  struct Stats {
+    uint64_t submitted;
+    // Calls made to run().
+
+    uint64_t completed;
+    // Calls whose function has returned.
+
+    uint64_t canceled;
+    // Calls whose promise was destroyed before their function could start.
+
+    uint64_t stolen;
+    // Calls run by a thread other than the one whose queue they were put in.
+
+    uint64_t rejected;
+    // Calls refused because `maxWaiting` calls were already waiting.
+
+    uint queued;
+    // Calls sitting in a thread's queue.
+
+    uint waiting;
+    // Calls waiting for room in a queue.
+
+    uint running;
+    // Calls whose function is running right now.
+  };
+
+  Stats getStats() const;
+
+  inline uint getThreadCount() const { return workers.size(); }
+
+private:
+  struct Worker;
+
+  uint queueCapacity;
+  uint maxWaiting;
+  Array<Own<Worker>> workers;
+
+  struct Overflow {
+    _::ThreadPoolJob* head = nullptr;
+    _::ThreadPoolJob** tail = &head;
+    uint count = 0;
+  };
+  MutexGuarded<Overflow> overflow;
+
+  bool stopping = false;
+  uint nextWorker = 0;
+  // Accessed atomically.
+
+  mutable Stats stats;
+  // Updated atomically.
+
+  bool submit(_::ThreadPoolJob& job);
+  // Queue `job` and wake a thread for it.  Returns false, without taking the pool's reference to
+  // the job, if it was rejected.
+
+  void work(Worker& worker);
+  // Main loop of a pool thread.
+
+  Maybe<_::ThreadPoolJob&> take(Worker& worker);
+  void refill();
+  void finish(_::ThreadPoolJob& job, TaskSet& replies);
+
+  static Exception overloaded();
+  // The exception for a rejected call.
+
+  bool wake(Worker& worker);
+  void wakeAny();
+  void stop();
+
+  template <typename T>
+  friend class _::ThreadPoolAdapter;
+};
+
+// =======================================================================================
+// inline implementation details
+
+namespace _ {  // private
+
+template <typename T>
+ThreadPoolAdapter<T>::ThreadPoolAdapter(
+    PromiseFulfiller<T>& fulfiller, ThreadPoolResult<T>& job, ThreadPool& pool)
+    : job(job) {
+  KJ_ON_SCOPE_FAILURE({
+    job.release();
+    job.release();
+  });
+  job.fulfiller = &fulfiller;
+  if (!pool.submit(job)) {
+    job.release();
+    fulfiller.reject(ThreadPool::overloaded());
+  }
+}
+
+}  // namespace _ (private)
+
+template <typename Func>
+Promise<_::ReturnType<Func, void>> ThreadPool::run(Func&& func) {
+  typedef _::ReturnType<Func, void> T;
+  auto job = new _::ThreadPoolCall<T, Decay<Func>>(kj::fwd<Func>(func));
+  return newAdaptedPromise<T, _::ThreadPoolAdapter<T>>(*job, *this);
+}
+
+}  // namespace kj
+
+#endif  // KJ_THREAD_POOL_H_
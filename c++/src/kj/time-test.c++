@@ -0,0 +1,265 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "time.h"
+#include "debug.h"
+#include "vector.h"
+#include <kj/compat/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace kj {
+namespace {
+
+TEST(Time, TimerOrder) {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  TimePoint start = origin<TimePoint>() + 1234 * SECONDS;
+  TimerImpl timer(start);
+  EXPECT_TRUE(timer.nextEvent() == nullptr);
+
+  Vector<uint> fired;
+  auto schedule = [&](TimePoint time, uint id) {
+    return timer.atTime(time).then([&fired,id]() { fired.add(id); }).eagerlyEvaluate(nullptr);
+  };
+
+  auto far = schedule(start + 3 * DAYS, 6);
+  auto b = schedule(start + 5 * SECONDS, 3);
+  auto a = schedule(start + 5 * NANOSECONDS, 1);
+  auto b2 = schedule(start + 5 * SECONDS, 4);  // same time as b; fires after it
+  auto canceled = schedule(start + 2 * SECONDS, 99);
+  auto past = schedule(start - 1 * SECONDS, 0);
+  auto c = schedule(start + 90 * SECONDS, 5);
+  auto a2 = schedule(start + 2 * MILLISECONDS, 2);
+
+  EXPECT_TRUE(KJ_ASSERT_NONNULL(timer.nextEvent()) == start - 1 * SECONDS);
+  canceled = nullptr;
+
+  timer.advanceTo(start);
+  loop.run();
+  EXPECT_EQ(1u, fired.size());
+  EXPECT_TRUE(KJ_ASSERT_NONNULL(timer.nextEvent()) == start + 5 * NANOSECONDS);
+
+  // Less than a tick:  only the exact deadlines that have passed fire.
+  timer.advanceTo(start + 4 * NANOSECONDS);
+  loop.run();
+  EXPECT_EQ(1u, fired.size());
+  timer.advanceTo(start + 5 * NANOSECONDS);
+  loop.run();
+  EXPECT_EQ(2u, fired.size());
+  EXPECT_TRUE(KJ_ASSERT_NONNULL(timer.nextEvent()) == start + 2 * MILLISECONDS);
+
+  timer.advanceTo(start + 10 * SECONDS);
+  loop.run();
+  EXPECT_EQ(5u, fired.size());
+  EXPECT_TRUE(KJ_ASSERT_NONNULL(timer.nextEvent()) == start + 90 * SECONDS);
+
+  timer.advanceTo(start + 1 * DAYS);
+  loop.run();
+  EXPECT_TRUE(KJ_ASSERT_NONNULL(timer.nextEvent()) == start + 3 * DAYS);
+
+  timer.advanceTo(start + 1000 * DAYS);
+  loop.run();
+  EXPECT_TRUE(timer.nextEvent() == nullptr);
+
+  ASSERT_EQ(7u, fired.size());
+  for (uint i = 0; i < fired.size(); i++) {
+    EXPECT_EQ(i, fired[i]);
+  }
+}
+
+TEST(Time, TimerRandomized) {
+  // Compare against a sorted list, over a mix of near and far deadlines, cancellations, and
+  // advances of all sizes.
+
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  TimePoint start = origin<TimePoint>();
+  TimerImpl timer(start);
+
+  std::mt19937_64 random(1234);
+  auto randomDelay = [&]() {
+    switch (random() % 4) {
+      case 0: return int64_t(random() % 5000) * NANOSECONDS;
+      case 1: return int64_t(random() % 5000) * MICROSECONDS;
+      case 2: return int64_t(random() % 5000) * MILLISECONDS;
+      default: return int64_t(random() % 5000) * SECONDS;
+    }
+  };
+
+  struct Expected {
+    TimePoint time;
+    uint id;
+  };
+  Vector<Expected> expected;
+  Vector<Maybe<Promise<void>>> promises;
+  Vector<uint> fired;
+
+  for (uint round = 0; round < 200; round++) {
+    for (uint i = 0; i < 50; i++) {
+      uint id = promises.size();
+      TimePoint time = timer.now() + randomDelay();
+      promises.add(timer.atTime(time).then([&fired,id]() { fired.add(id); })
+          .eagerlyEvaluate(nullptr));
+      expected.add(Expected { time, id });
+    }
+
+    // Cancel some.
+    for (uint i = 0; i < 20; i++) {
+      promises[random() % promises.size()] = nullptr;
+    }
+    Vector<Expected> live;
+    for (auto& e: expected) {
+      if (promises[e.id] != nullptr) live.add(e);
+    }
+    expected = kj::mv(live);
+
+    // Sort, breaking ties in scheduling order.
+    std::stable_sort(expected.begin(), expected.end(),
+        [](const Expected& a, const Expected& b) { return a.time < b.time; });
+    if (expected.size() == 0) {
+      EXPECT_TRUE(timer.nextEvent() == nullptr);
+    } else {
+      EXPECT_TRUE(KJ_ASSERT_NONNULL(timer.nextEvent()) == expected[0].time);
+    }
+
+    TimePoint newTime = timer.now() + randomDelay();
+    timer.advanceTo(newTime);
+    loop.run();
+
+    Vector<Expected> remaining;
+    Vector<uint> expectedFired;
+    for (auto& e: expected) {
+      if (e.time <= newTime) {
+        expectedFired.add(e.id);
+        promises[e.id] = nullptr;
+      } else {
+        remaining.add(e);
+      }
+    }
+    expected = kj::mv(remaining);
+
+    ASSERT_EQ(expectedFired.size(), fired.size());
+    for (uint i = 0; i < fired.size(); i++) {
+      EXPECT_EQ(expectedFired[i], fired[i]);
+    }
+    fired.clear();
+  }
+}
+
+TEST(Time, TimerBenchmark) {
+  // A million timeouts pending at once, the way an RPC server with a deadline on every call would
+  // see them:  each scheduled for a fixed delay after "now", with almost all canceled because the
+  // call finished first.
+
+  static constexpr uint COUNT = 1000000;
+
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  TimePoint start = origin<TimePoint>();
+  TimerImpl timer(start);
+
+  uint firedCount = 0;
+  auto clockStart = std::chrono::steady_clock::now();
+
+  Vector<Promise<void>> pending(COUNT);
+  for (uint i = 0; i < COUNT; i++) {
+    // 1000 calls per millisecond, each with a 30-second timeout.
+    timer.advanceTo(start + int64_t(i) * MICROSECONDS);
+    pending.add(timer.afterDelay(30 * SECONDS).then([&firedCount]() { ++firedCount; })
+        .eagerlyEvaluate(nullptr));
+  }
+  auto clockScheduled = std::chrono::steady_clock::now();
+
+  // 99% of calls complete.
+  for (uint i = 0; i < COUNT; i++) {
+    if (i % 100 != 0) {
+      pending[i] = nullptr;
+    }
+  }
+  auto clockCanceled = std::chrono::steady_clock::now();
+
+  for (uint ms = 1000; ms <= 31000; ms++) {
+    timer.advanceTo(start + int64_t(ms) * MILLISECONDS);
+    loop.run();
+  }
+  auto clockFired = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(COUNT / 100, firedCount);
+  EXPECT_TRUE(timer.nextEvent() == nullptr);
+
+  auto ns = [](std::chrono::steady_clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / COUNT;
+  };
+  KJ_LOG(INFO, "timer benchmark, ns per timer",
+         ns(clockScheduled - clockStart), ns(clockCanceled - clockScheduled),
+         ns(clockFired - clockCanceled));
+}
+
+TEST(Time, TimerInterleavedDurations) {
+  // Timeouts of two lengths, 5 and 30 seconds, scheduled alternately for long enough that each new
+  // short timeout lands among long ones scheduled 25 seconds earlier, rather than after them.
+
+  static constexpr uint COUNT = 100000;
+  static constexpr auto INTERVAL = 350 * MICROSECONDS;
+
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  TimePoint start = origin<TimePoint>();
+  TimerImpl timer(start);
+
+  Vector<TimePoint> fired(COUNT);
+  auto clockStart = std::chrono::steady_clock::now();
+
+  Vector<Promise<void>> pending(COUNT);
+  for (uint i = 0; i < COUNT; i++) {
+    timer.advanceTo(start + int64_t(i) * INTERVAL);
+    loop.run();
+    TimePoint time = timer.now() + (i % 2 == 0 ? 5 : 30) * SECONDS;
+    pending.add(timer.atTime(time).then([&fired,time]() { fired.add(time); })
+        .eagerlyEvaluate(nullptr));
+  }
+  auto clockScheduled = std::chrono::steady_clock::now();
+
+  timer.advanceTo(start + int64_t(COUNT) * INTERVAL + 30 * SECONDS);
+  loop.run();
+  auto clockFired = std::chrono::steady_clock::now();
+
+  ASSERT_EQ(COUNT, fired.size());
+  for (uint i = 1; i < fired.size(); i++) {
+    EXPECT_TRUE(fired[i - 1] <= fired[i]);
+  }
+  EXPECT_TRUE(timer.nextEvent() == nullptr);
+
+  auto ns = [](std::chrono::steady_clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / COUNT;
+  };
+  KJ_LOG(INFO, "interleaved timer benchmark, ns per timer",
+         ns(clockScheduled - clockStart), ns(clockFired - clockScheduled));
+}
+
+}  // namespace
+}  // namespace kj
@@ -22,7 +22,6 @@
 
 #include "time.h"
 #include "debug.h"
-#include <set>
 
 namespace kj {
 
@@ -30,44 +29,265 @@ kj::Exception Timer::makeTimeoutException() {
   return KJ_EXCEPTION(OVERLOADED, "operation timed out");
 }
 
+namespace {
+
+inline uint lowestBit(uint64_t bits) {
+  // Index of the lowest set bit.  `bits` must not be zero.
+#if _MSC_VER
+  unsigned long result;
+  _BitScanForward64(&result, bits);
+  return result;
+#else
+  return __builtin_ctzll(bits);
+#endif
+}
+
+inline uint highestBit(uint64_t bits) {
+  // Index of the highest set bit.  `bits` must not be zero.
+#if _MSC_VER
+  unsigned long result;
+  _BitScanReverse64(&result, bits);
+  return result;
+#else
+  return 63 - __builtin_clzll(bits);
+#endif
+}
+
+}  // namespace
+
 struct TimerImpl::Impl {
-  struct TimerBefore {
-    bool operator()(TimerPromiseAdapter* lhs, TimerPromiseAdapter* rhs);
+  // Pending timers live in a hierarchical timing wheel, so that scheduling and canceling a timer
+  // are constant-time no matter how many are pending.  (Each timer also moves down the wheel at
+  // most once per level, and takes part in sorting its slot, as described below.)
+  //
+  // Time is divided into ticks of 2^TICK_BITS nanoseconds (about a millisecond), counted from the
+  // timer's start time.  Level 0 of the wheel has a slot for each of the 64 ticks in the current
+  // 64-tick block, level 1 has a slot for each 64-tick block in the current 4096-tick block, and
+  // so on.  A timer is filed at the lowest level at which its tick is in the current block, so
+  // every timer at a lower level is due before every timer at a higher level, and within a level,
+  // lower slots come first.  As time reaches a higher-level slot, its timers are redistributed
+  // into the levels below.
+  //
+  // Timers are appended to their slot in whatever order they arrive.  A slot is sorted -- by time,
+  // then by scheduling order -- only once it holds the earliest timers, so that nextEvent() is
+  // exact and timers fire in order.  Timers with a single fixed delay arrive in deadline order,
+  // so usually the slot turns out to be sorted already and no work is needed; slots that mix
+  // delays are merge-sorted once, rather than searched on every insert.
+
+  static constexpr uint TICK_BITS = 20;
+  static constexpr uint SLOT_BITS = 6;
+  static constexpr uint SLOTS = 1u << SLOT_BITS;
+  static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+  static constexpr uint LEVELS = (64 - TICK_BITS + SLOT_BITS - 1) / SLOT_BITS;
+
+  struct Slot {
+    TimerPromiseAdapter* head = nullptr;
+    TimerPromiseAdapter* tail = nullptr;
+    bool sorted = true;
+    // False if a timer was appended after a later one.
   };
-  using Timers = std::multiset<TimerPromiseAdapter*, TimerBefore>;
-  Timers timers;
+
+  explicit Impl(TimePoint startTime): startTime(startTime) {}
+
+  const TimePoint startTime;
+
+  uint64_t elapsed = 0;
+  // The tick the wheel has been advanced to.
+
+  uint64_t nextSequence = 0;
+  // Breaks ties between timers at the same time in favor of the one scheduled first.
+
+  uint64_t occupied[LEVELS] = {};
+  // Bit N of occupied[L] is set if slots[L][N] is non-empty.
+
+  Slot slots[LEVELS][SLOTS];
+
+  inline uint64_t toTick(TimePoint time) {
+    return time <= startTime ? 0 : uint64_t((time - startTime) / NANOSECONDS) >> TICK_BITS;
+  }
+
+  void insert(TimerPromiseAdapter& timer);
+  void remove(TimerPromiseAdapter& timer);
+
+  void cascade(uint level, uint index);
+  // Redistribute the timers in a slot, which time has just reached, into the levels below.
+
+  void sort(Slot& slot);
+  // Sort the slot's timers if they aren't already.
+
+  bool findEarliest(uint& level, uint& index) {
+    // Find the slot holding the earliest timers.  Returns false if there are no timers.
+    for (uint i = 0; i < LEVELS; i++) {
+      if (occupied[i] != 0) {
+        level = i;
+        index = lowestBit(occupied[i]);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  inline uint64_t slotStart(uint level, uint index) {
+    // The first tick covered by the given slot, which must be in the current block.
+    uint shift = level * SLOT_BITS;
+    uint blockShift = shift + SLOT_BITS;
+    uint64_t block = blockShift >= 64 ? 0 : elapsed >> blockShift << blockShift;
+    return block | (uint64_t(index) << shift);
+  }
 };
 
 class TimerImpl::TimerPromiseAdapter {
 public:
   TimerPromiseAdapter(PromiseFulfiller<void>& fulfiller, TimerImpl::Impl& impl, TimePoint time)
-      : time(time), fulfiller(fulfiller), impl(impl) {
-    pos = impl.timers.insert(this);
+      : time(time), sequence(impl.nextSequence++), fulfiller(fulfiller), impl(impl) {
+    impl.insert(*this);
   }
 
   ~TimerPromiseAdapter() {
-    if (pos != impl.timers.end()) {
-      impl.timers.erase(pos);
+    if (scheduled) {
+      impl.remove(*this);
     }
   }
 
   void fulfill() {
+    impl.remove(*this);
     fulfiller.fulfill();
-    impl.timers.erase(pos);
-    pos = impl.timers.end();
   }
 
   const TimePoint time;
+  const uint64_t sequence;
+
+  inline bool operator<(const TimerPromiseAdapter& other) const {
+    return time < other.time || (time == other.time && sequence < other.sequence);
+  }
 
 private:
   PromiseFulfiller<void>& fulfiller;
   TimerImpl::Impl& impl;
-  Impl::Timers::const_iterator pos;
+
+  // Position in the wheel.
+  bool scheduled = false;
+  uint level = 0;
+  uint index = 0;
+  TimerPromiseAdapter* prev = nullptr;
+  TimerPromiseAdapter* next = nullptr;
+
+  friend struct TimerImpl::Impl;
 };
 
-inline bool TimerImpl::Impl::TimerBefore::operator()(
-    TimerPromiseAdapter* lhs, TimerPromiseAdapter* rhs) {
-  return lhs->time < rhs->time;
+void TimerImpl::Impl::insert(TimerPromiseAdapter& timer) {
+  // Timers already due go in the current tick's slot, so they fire on the next advanceTo().
+  uint64_t tick = kj::max(toTick(timer.time), elapsed);
+  uint level = highestBit((tick ^ elapsed) | SLOT_MASK) / SLOT_BITS;
+  uint index = (tick >> (level * SLOT_BITS)) & SLOT_MASK;
+  Slot& slot = slots[level][index];
+
+  timer.prev = slot.tail;
+  timer.next = nullptr;
+  if (slot.tail == nullptr) {
+    slot.head = &timer;
+  } else {
+    if (timer < *slot.tail) slot.sorted = false;
+    slot.tail->next = &timer;
+  }
+  slot.tail = &timer;
+
+  occupied[level] |= uint64_t(1) << index;
+  timer.level = level;
+  timer.index = index;
+  timer.scheduled = true;
+}
+
+void TimerImpl::Impl::remove(TimerPromiseAdapter& timer) {
+  Slot& slot = slots[timer.level][timer.index];
+
+  if (timer.prev == nullptr) {
+    slot.head = timer.next;
+  } else {
+    timer.prev->next = timer.next;
+  }
+  if (timer.next == nullptr) {
+    slot.tail = timer.prev;
+  } else {
+    timer.next->prev = timer.prev;
+  }
+
+  if (slot.head == nullptr) {
+    occupied[timer.level] &= ~(uint64_t(1) << timer.index);
+    slot.sorted = true;
+  }
+
+  timer.prev = nullptr;
+  timer.next = nullptr;
+  timer.scheduled = false;
+}
+
+void TimerImpl::Impl::cascade(uint level, uint index) {
+  Slot& slot = slots[level][index];
+  TimerPromiseAdapter* timer = slot.head;
+  slot.head = nullptr;
+  slot.tail = nullptr;
+  slot.sorted = true;
+  occupied[level] &= ~(uint64_t(1) << index);
+
+  // If this slot was sorted, each timer lands in order at the tail of its new slot.
+  while (timer != nullptr) {
+    TimerPromiseAdapter* next = timer->next;
+    timer->prev = nullptr;
+    timer->next = nullptr;
+    insert(*timer);
+    timer = next;
+  }
+}
+
+void TimerImpl::Impl::sort(Slot& slot) {
+  if (slot.sorted) return;
+
+  // Bottom-up merge sort of the singly-linked list, merging runs of `width` timers on each pass.
+  TimerPromiseAdapter* list = slot.head;
+  for (size_t width = 1;; width *= 2) {
+    auto split = [width](TimerPromiseAdapter* run) {
+      // Cut off the first `width` timers of `run` and return the rest.
+      for (size_t i = 1; run != nullptr && i < width; i++) run = run->next;
+      if (run == nullptr) return run;
+      TimerPromiseAdapter* rest = run->next;
+      run->next = nullptr;
+      return rest;
+    };
+
+    TimerPromiseAdapter* result = nullptr;
+    TimerPromiseAdapter** resultTail = &result;
+    TimerPromiseAdapter* rest = list;
+    uint merges = 0;
+    while (rest != nullptr) {
+      ++merges;
+      TimerPromiseAdapter* a = rest;
+      TimerPromiseAdapter* b = split(a);
+      rest = split(b);
+
+      while (a != nullptr && b != nullptr) {
+        TimerPromiseAdapter*& first = *b < *a ? b : a;
+        *resultTail = first;
+        resultTail = &first->next;
+        first = first->next;
+      }
+      *resultTail = a != nullptr ? a : b;
+      while (*resultTail != nullptr) resultTail = &(*resultTail)->next;
+    }
+
+    list = result;
+    if (merges <= 1) break;
+  }
+
+  // Restore the back links.
+  TimerPromiseAdapter* prev = nullptr;
+  for (TimerPromiseAdapter* timer = list; timer != nullptr; timer = timer->next) {
+    timer->prev = prev;
+    prev = timer;
+  }
+  slot.head = list;
+  slot.tail = prev;
+  slot.sorted = true;
 }
 
 Promise<void> TimerImpl::atTime(TimePoint time) {
@@ -79,16 +299,18 @@ Promise<void> TimerImpl::afterDelay(Duration delay) {
 }
 
 TimerImpl::TimerImpl(TimePoint startTime)
-    : time(startTime), impl(heap<Impl>()) {}
+    : time(startTime), impl(heap<Impl>(startTime)) {}
 
 TimerImpl::~TimerImpl() noexcept(false) {}
 
 Maybe<TimePoint> TimerImpl::nextEvent() {
-  auto iter = impl->timers.begin();
-  if (iter == impl->timers.end()) {
-    return nullptr;
+  uint level, index;
+  if (impl->findEarliest(level, index)) {
+    Impl::Slot& slot = impl->slots[level][index];
+    impl->sort(slot);
+    return slot.head->time;
   } else {
-    return (*iter)->time;
+    return nullptr;
   }
 }
 
@@ -113,13 +335,28 @@ void TimerImpl::advanceTo(TimePoint newTime) {
   KJ_REQUIRE(newTime >= time, "can't advance backwards in time") { return; }
 
   time = newTime;
-  for (;;) {
-    auto front = impl->timers.begin();
-    if (front == impl->timers.end() || (*front)->time > time) {
-      break;
+  uint64_t newTick = impl->toTick(newTime);
+
+  uint level, index;
+  while (impl->findEarliest(level, index)) {
+    uint64_t start = impl->slotStart(level, index);
+    if (start > newTick) break;
+    impl->elapsed = start;
+
+    Impl::Slot& slot = impl->slots[level][index];
+    if (level == 0) {
+      impl->sort(slot);
+      while (slot.head != nullptr && slot.head->time <= time) {
+        slot.head->fulfill();
+      }
+      // Anything left is due later in the current tick.
+      if (slot.head != nullptr) break;
+    } else {
+      impl->cascade(level, index);
     }
-    (*front)->fulfill();
   }
+
+  impl->elapsed = kj::max(impl->elapsed, newTick);
 }
 
 }  // namespace kj